@@ -11,7 +11,8 @@
  * The intended use for this method is a reference point for evaluating
  * CoreObject performance.
  *
- * The result is cached after the first time it is calculated.
+ * The result is the median measured by +[BenchmarkHarness sharedHarness], and
+ * is cached after the first time it is calculated.
  */
 + (NSTimeInterval)timeToCommit1KUsingSQLite;
 
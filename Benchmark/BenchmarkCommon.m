@@ -3,6 +3,7 @@
 #import "FMDatabaseAdditions.h"
 #import <EtoileFoundation/EtoileFoundation.h>
 #import "TestCommon.h"
+#import "BenchmarkHarness.h"
 
 @implementation BenchmarkCommon
 
@@ -34,21 +35,23 @@
         ETAssert([[tempDatabase stringForQuery: @"PRAGMA journal_mode=WAL"] isEqual: @"wal"]);
         ETAssert([tempDatabase executeUpdate: @"CREATE TABLE test(blob BLOB)"]);
 
-        // Warm up
-        [self insertRandomData1K: tempDatabase];
-
-        // Make 100 commits and take the mean
-        NSDate *startDate = [NSDate date];
-        for (int i = 0; i < 100; i++)
+        // Make 100 commits per run and take the median
+        BenchmarkResult *commitResult =
+            [[BenchmarkHarness sharedHarness] measure: @"SQLite 1K commit"
+                                           operations: 100
+                                                block: ^()
         {
-            [tempDatabase beginTransaction];
-            [self insertRandomData1K: tempDatabase];
-            [tempDatabase commit];
-        }
-        NSTimeInterval timeFor100Commits = [[NSDate date] timeIntervalSinceDate: startDate];
-        result = timeFor100Commits / 100.0;
-
-        ETAssert(101 == [tempDatabase intForQuery: @"SELECT COUNT(*) FROM test"]);
+            for (int i = 0; i < 100; i++)
+            {
+                [tempDatabase beginTransaction];
+                [self insertRandomData1K: tempDatabase];
+                [tempDatabase commit];
+            }
+        }];
+        result = commitResult.median;
+
+        ETAssert(100 * (commitResult.samples.count + [BenchmarkHarness sharedHarness].warmupRunCount)
+            == [tempDatabase intForQuery: @"SELECT COUNT(*) FROM test"]);
     }
     return result;
 }
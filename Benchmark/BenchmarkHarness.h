@@ -0,0 +1,256 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Returns the process resident size high-water mark in bytes.
+ */
+int64_t BenchmarkPeakResidentSize(void);
+
+/**
+ * The timings and memory usage measured for a benchmark.
+ *
+ * Each run adds a sample, which is the time per operation in seconds.
+ */
+@interface BenchmarkResult : NSObject
+{
+@private
+    NSString *_name;
+    NSUInteger _operationCount;
+    NSMutableArray *_samples;
+    int64_t _peakResidentSize;
+    int64_t _peakResidentSizeGrowth;
+    NSUInteger _memoryRunCount;
+    int64_t _totalRetainedBytes;
+    int64_t _totalRetainedBlockCount;
+    NSMutableDictionary *_values;
+}
+
+/**
+ * The benchmark name, unique in a benchmark suite.
+ */
+@property (nonatomic, readonly) NSString *name;
+/**
+ * The number of operations measured per run.
+ */
+@property (nonatomic, readonly) NSUInteger operationCount;
+/**
+ * The time per operation in seconds for each run.
+ */
+@property (nonatomic, readonly) NSArray<NSNumber *> *samples;
+/**
+ * The median time per operation in seconds.
+ */
+@property (nonatomic, readonly) NSTimeInterval median;
+@property (nonatomic, readonly) NSTimeInterval mean;
+@property (nonatomic, readonly) NSTimeInterval min;
+@property (nonatomic, readonly) NSTimeInterval max;
+@property (nonatomic, readonly) NSTimeInterval standardDeviation;
+/**
+ * Returns the sample at the given percentile (between 0 and 1) with the
+ * nearest-rank method.
+ */
+- (NSTimeInterval)percentile: (double)aPercentile;
+/**
+ * The process resident size high-water mark in bytes, once the last runs are
+ * over.
+ *
+ * Like the other memory measurements, it covers all the runs when a benchmark
+ * name is measured several times.
+ */
+@property (nonatomic, readonly) int64_t peakResidentSize;
+/**
+ * The increase of the process resident size high-water mark in bytes during
+ * the runs.
+ */
+@property (nonatomic, readonly) int64_t peakResidentSizeGrowth;
+/**
+ * The mean number of bytes allocated with malloc() during a run and not freed
+ * at the end of the run.
+ *
+ * This is the net change of the bytes in use, so the memory allocated and
+ * freed during a run isn't counted.
+ */
+@property (nonatomic, readonly) int64_t retainedBytes;
+/**
+ * The mean number of memory blocks allocated with malloc() during a run and
+ * not freed at the end of the run.
+ *
+ * When the malloc implementation doesn't report block counts (e.g. glibc),
+ * returns -1.
+ */
+@property (nonatomic, readonly) int64_t retainedBlockCount;
+/**
+ * Additional measurements reported with the timings (e.g. sizes in bytes),
+ * set by the benchmark.
+ */
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, id> *values;
+/**
+ * Returns a JSON object describing the result, written by
+ * -[BenchmarkHarness writeResultsToURL:error:].
+ */
+@property (nonatomic, readonly) NSDictionary *JSONObject;
+
+@end
+
+
+/**
+ * @abstract Runs benchmarks and reports statistics about their timings.
+ *
+ * Each benchmark block is run a few times untimed to warm up caches, then
+ * repeatedly to collect one timing sample per run. A setup block can reset the
+ * state the benchmark block consumes before each run, without being timed.
+ *
+ * The results can be written as JSON, and compared with the results written
+ * by a previous session to flag regressions.
+ *
+ * The Benchmark tool reads these environment variables:
+ *
+ * <deflist>
+ * <term>COBENCHMARK_RUNS</term><desc>-runCount</desc>
+ * <term>COBENCHMARK_WARMUP_RUNS</term><desc>-warmupRunCount</desc>
+ * <term>COBENCHMARK_OUTPUT</term><desc>path where the JSON results are
+ * written</desc>
+ * <term>COBENCHMARK_BASELINE</term><desc>path to JSON results to compare the
+ * results with (the tool exits with a non-zero status on regressions)</desc>
+ * <term>COBENCHMARK_TOLERANCE</term><desc>-regressionTolerance</desc>
+ * </deflist>
+ */
+@interface BenchmarkHarness : NSObject
+{
+@private
+    NSUInteger _runCount;
+    NSUInteger _warmupRunCount;
+    double _regressionTolerance;
+    NSMutableDictionary *_resultsByName;
+    NSMutableArray *_resultNames;
+}
+
+
+/** @taskunit Initialization */
+
+
+/**
+ * Returns the harness used by all the benchmarks of the Benchmark tool.
+ */
++ (BenchmarkHarness *)sharedHarness;
+/**
+ * Configures the receiver with the COBENCHMARK_ environment variables.
+ */
+- (void)configureWithEnvironment: (NSDictionary<NSString *, NSString *> *)environment;
+
+
+/** @taskunit Settings */
+
+
+/**
+ * The number of timed runs per benchmark.
+ *
+ * By default, returns 5.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger runCount;
+/**
+ * The number of untimed runs before the timed ones.
+ *
+ * By default, returns 1.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger warmupRunCount;
+/**
+ * The ratio by which a median can exceed its baseline before being reported
+ * as a regression.
+ *
+ * By default, returns 0.2 (20% slower).
+ */
+@property (nonatomic, readwrite, assign) double regressionTolerance;
+
+
+/** @taskunit Measuring */
+
+
+/**
+ * Runs the block -warmupRunCount times, then times it -runCount times.
+ *
+ * The operation count is the number of operations the block performs, and
+ * divides the time of each run.
+ *
+ * Measuring a benchmark name again adds its samples to the existing result.
+ */
+- (BenchmarkResult *)measure: (NSString *)aName
+                  operations: (NSUInteger)operationCount
+                       block: (void (^)(void))aBlock;
+/**
+ * Same as -measure:operations:block:, but calls the setup block untimed before
+ * each run.
+ */
+- (BenchmarkResult *)measure: (NSString *)aName
+                  operations: (NSUInteger)operationCount
+                       setUp: (nullable void (^)(void))aSetUpBlock
+                       block: (void (^)(void))aBlock;
+/**
+ * Times the block a single time without warming up.
+ *
+ * For a benchmark that changes the state it measures and can't be repeated
+ * (e.g. building a history to navigate later).
+ */
+- (BenchmarkResult *)measureOnce: (NSString *)aName
+                      operations: (NSUInteger)operationCount
+                           block: (void (^)(void))aBlock;
+/**
+ * Times the block with the given number of runs and warmup runs, ignoring
+ * -runCount and -warmupRunCount.
+ */
+- (BenchmarkResult *)measure: (NSString *)aName
+                        runs: (NSUInteger)runCount
+                  warmupRuns: (NSUInteger)warmupRunCount
+                  operations: (NSUInteger)operationCount
+                       setUp: (nullable void (^)(void))aSetUpBlock
+                       block: (void (^)(void))aBlock;
+/**
+ * Adds a sample measured by the benchmark itself, as the time in seconds of a
+ * single operation.
+ *
+ * For timings collected outside the harness (e.g. the latencies reported by
+ * BenchmarkWorkload).
+ */
+- (BenchmarkResult *)addSample: (NSTimeInterval)aTime toBenchmark: (NSString *)aName;
+
+
+/** @taskunit Reporting */
+
+
+/**
+ * The results in the order the benchmarks were first measured.
+ */
+@property (nonatomic, readonly) NSArray<BenchmarkResult *> *results;
+/**
+ * Returns the result for the given benchmark name, or nil if the benchmark
+ * wasn't measured.
+ */
+- (nullable BenchmarkResult *)resultForName: (NSString *)aName;
+/**
+ * Returns a JSON object describing the settings and results.
+ */
+@property (nonatomic, readonly) NSDictionary *JSONObject;
+/**
+ * Writes -JSONObject to the given file URL.
+ */
+- (BOOL)writeResultsToURL: (NSURL *)aURL error: (NSError **)anError;
+/**
+ * Returns a description of each benchmark whose median exceeds the median
+ * recorded in the baseline by more than -regressionTolerance.
+ *
+ * The baseline is a JSON object returned by -JSONObject in a previous
+ * session. Benchmarks missing from the baseline are ignored.
+ */
+- (NSArray<NSString *> *)regressionsComparedToBaseline: (NSDictionary *)aBaseline;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,474 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "BenchmarkHarness.h"
+#import <EtoileFoundation/Macros.h>
+#import "COJSONSerialization.h"
+#import "COStoreMetrics.h"
+#include <sys/resource.h>
+#ifdef __APPLE__
+#   include <malloc/malloc.h>
+#else
+#   include <malloc.h>
+#endif
+
+static const NSUInteger BenchmarkDefaultRunCount = 5;
+static const NSUInteger BenchmarkDefaultWarmupRunCount = 1;
+static const double BenchmarkDefaultRegressionTolerance = 0.2;
+
+/**
+ * The bytes and blocks allocated with malloc() and not freed yet.
+ */
+typedef struct
+{
+    int64_t bytes;
+    int64_t blocks;
+} BenchmarkMallocUsage;
+
+static BenchmarkMallocUsage CurrentMallocUsage(void)
+{
+#if defined(__APPLE__)
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    return (BenchmarkMallocUsage){ statistics.size_in_use, statistics.blocks_in_use };
+#elif defined(__GLIBC__)
+#   if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 info = mallinfo2();
+#   else
+    struct mallinfo info = mallinfo();
+#   endif
+    // glibc doesn't count the blocks in use
+    return (BenchmarkMallocUsage){ (int64_t)info.uordblks, -1 };
+#else
+    return (BenchmarkMallocUsage){ 0, -1 };
+#endif
+}
+
+int64_t BenchmarkPeakResidentSize(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    // In kilobytes on Linux and BSDs
+    return (int64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+static NSString *FormatTimeInterval(NSTimeInterval s)
+{
+    const double us = s * 1000000.0;
+    const double ms = s * 1000.0;
+
+    if (ms > 1000)
+        return [NSString stringWithFormat: @"%.3f s", s];
+    else if (us > 1000)
+        return [NSString stringWithFormat: @"%.3f ms", ms];
+    else
+        return [NSString stringWithFormat: @"%.3f us", us];
+}
+
+
+@implementation BenchmarkResult
+
+@synthesize name = _name, operationCount = _operationCount, samples = _samples;
+@synthesize peakResidentSize = _peakResidentSize, peakResidentSizeGrowth = _peakResidentSizeGrowth;
+@synthesize values = _values;
+
+- (instancetype)initWithName: (NSString *)aName operationCount: (NSUInteger)operationCount
+{
+    NILARG_EXCEPTION_TEST(aName);
+    INVALIDARG_EXCEPTION_TEST(operationCount, operationCount > 0);
+    SUPERINIT;
+    _name = [aName copy];
+    _operationCount = operationCount;
+    _samples = [NSMutableArray new];
+    _values = [NSMutableDictionary new];
+    return self;
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wnonnull"
+
+- (instancetype)init
+{
+    return [self initWithName: nil operationCount: 0];
+}
+
+#pragma clang diagnostic pop
+
+- (void)addSampleWithTime: (NSTimeInterval)aTime
+{
+    [_samples addObject: @(aTime / _operationCount)];
+}
+
+/**
+ * Accumulates the memory measured for some runs with the measurements of the
+ * previous runs.
+ *
+ * The block count is -1 when the malloc implementation doesn't report it.
+ */
+- (void)addMemoryUsageOfRuns: (NSUInteger)runCount
+            peakResidentSize: (int64_t)aSize
+                      growth: (int64_t)aGrowth
+               retainedBytes: (int64_t)bytes
+          retainedBlockCount: (int64_t)blockCount
+{
+    _peakResidentSize = MAX(_peakResidentSize, aSize);
+    _peakResidentSizeGrowth += aGrowth;
+    _totalRetainedBytes += bytes;
+    _totalRetainedBlockCount = (blockCount < 0 || _totalRetainedBlockCount < 0 ? -1 : _totalRetainedBlockCount + blockCount);
+    _memoryRunCount += runCount;
+}
+
+- (int64_t)retainedBytes
+{
+    if (_memoryRunCount == 0)
+        return 0;
+
+    return _totalRetainedBytes / (int64_t)_memoryRunCount;
+}
+
+- (int64_t)retainedBlockCount
+{
+    if (_memoryRunCount == 0 || _totalRetainedBlockCount < 0)
+        return -1;
+
+    return _totalRetainedBlockCount / (int64_t)_memoryRunCount;
+}
+
+- (NSArray *)sortedSamples
+{
+    return [_samples sortedArrayUsingSelector: @selector(compare:)];
+}
+
+- (NSTimeInterval)percentile: (double)aPercentile
+{
+    NSArray *sortedSamples = [self sortedSamples];
+
+    if (sortedSamples.count == 0)
+        return 0;
+
+    const NSUInteger rank = (NSUInteger)ceil(aPercentile * sortedSamples.count);
+    return [sortedSamples[MAX(rank, 1) - 1] doubleValue];
+}
+
+- (NSTimeInterval)median
+{
+    NSArray *sortedSamples = [self sortedSamples];
+    const NSUInteger count = sortedSamples.count;
+
+    if (count == 0)
+        return 0;
+
+    if (count % 2 == 1)
+        return [sortedSamples[count / 2] doubleValue];
+
+    return ([sortedSamples[count / 2 - 1] doubleValue] + [sortedSamples[count / 2] doubleValue]) / 2;
+}
+
+- (NSTimeInterval)mean
+{
+    if (_samples.count == 0)
+        return 0;
+
+    return [[_samples valueForKeyPath: @"@sum.doubleValue"] doubleValue] / _samples.count;
+}
+
+- (NSTimeInterval)min
+{
+    return [[_samples valueForKeyPath: @"@min.doubleValue"] doubleValue];
+}
+
+- (NSTimeInterval)max
+{
+    return [[_samples valueForKeyPath: @"@max.doubleValue"] doubleValue];
+}
+
+- (NSTimeInterval)standardDeviation
+{
+    if (_samples.count < 2)
+        return 0;
+
+    const NSTimeInterval mean = self.mean;
+    double sumOfSquares = 0;
+
+    for (NSNumber *sample in _samples)
+    {
+        sumOfSquares += (sample.doubleValue - mean) * (sample.doubleValue - mean);
+    }
+    return sqrt(sumOfSquares / (_samples.count - 1));
+}
+
+- (NSDictionary *)JSONObject
+{
+    NSMutableDictionary *object = [@{ @"name" : _name,
+                                      @"operations" : @(_operationCount),
+                                      @"samples" : [_samples copy],
+                                      @"median" : @(self.median),
+                                      @"mean" : @(self.mean),
+                                      @"min" : @(self.min),
+                                      @"max" : @(self.max),
+                                      @"p90" : @([self percentile: 0.9]),
+                                      @"standardDeviation" : @(self.standardDeviation),
+                                      @"peakResidentSize" : @(_peakResidentSize),
+                                      @"peakResidentSizeGrowth" : @(_peakResidentSizeGrowth),
+                                      @"retainedBytes" : @(self.retainedBytes) } mutableCopy];
+
+    if (self.retainedBlockCount >= 0)
+    {
+        object[@"retainedBlockCount"] = @(self.retainedBlockCount);
+    }
+    if (_values.count > 0)
+    {
+        object[@"values"] = [_values copy];
+    }
+    return object;
+}
+
+- (NSString *)description
+{
+    NSMutableString *description = [NSMutableString stringWithFormat:
+        @"%@: %@ per operation (median of %lu runs, p90 %@, min %@, max %@), "
+         "peak RSS +%lld KB, %lld KB",
+        _name, FormatTimeInterval(self.median), (unsigned long)_samples.count,
+        FormatTimeInterval([self percentile: 0.9]), FormatTimeInterval(self.min),
+        FormatTimeInterval(self.max), _peakResidentSizeGrowth / 1024, self.retainedBytes / 1024];
+
+    if (self.retainedBlockCount >= 0)
+    {
+        [description appendFormat: @" in %lld blocks", self.retainedBlockCount];
+    }
+    [description appendString: @" retained per run"];
+
+    if (_values.count > 0)
+    {
+        [description appendFormat: @", %@", [_values.description stringByReplacingOccurrencesOfString: @"\n"
+                                                                                          withString: @" "]];
+    }
+    return description;
+}
+
+@end
+
+
+@implementation BenchmarkHarness
+
+@synthesize runCount = _runCount, warmupRunCount = _warmupRunCount;
+@synthesize regressionTolerance = _regressionTolerance;
+
++ (BenchmarkHarness *)sharedHarness
+{
+    static BenchmarkHarness *sharedHarness = nil;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^()
+    {
+        sharedHarness = [self new];
+    });
+    return sharedHarness;
+}
+
+- (instancetype)init
+{
+    SUPERINIT;
+    _runCount = BenchmarkDefaultRunCount;
+    _warmupRunCount = BenchmarkDefaultWarmupRunCount;
+    _regressionTolerance = BenchmarkDefaultRegressionTolerance;
+    _resultsByName = [NSMutableDictionary new];
+    _resultNames = [NSMutableArray new];
+    return self;
+}
+
+- (void)configureWithEnvironment: (NSDictionary *)environment
+{
+    if (environment[@"COBENCHMARK_RUNS"] != nil)
+    {
+        _runCount = MAX([environment[@"COBENCHMARK_RUNS"] integerValue], 1);
+    }
+    if (environment[@"COBENCHMARK_WARMUP_RUNS"] != nil)
+    {
+        _warmupRunCount = MAX([environment[@"COBENCHMARK_WARMUP_RUNS"] integerValue], 0);
+    }
+    if (environment[@"COBENCHMARK_TOLERANCE"] != nil)
+    {
+        _regressionTolerance = [environment[@"COBENCHMARK_TOLERANCE"] doubleValue];
+    }
+}
+
+#pragma mark Measuring -
+
+- (BenchmarkResult *)resultForName: (NSString *)aName operationCount: (NSUInteger)operationCount
+{
+    BenchmarkResult *result = _resultsByName[aName];
+
+    if (result == nil)
+    {
+        result = [[BenchmarkResult alloc] initWithName: aName operationCount: operationCount];
+        _resultsByName[aName] = result;
+        [_resultNames addObject: aName];
+    }
+    ETAssert(result.operationCount == operationCount);
+    return result;
+}
+
+- (BenchmarkResult *)measure: (NSString *)aName
+                        runs: (NSUInteger)runCount
+                  warmupRuns: (NSUInteger)warmupRunCount
+                  operations: (NSUInteger)operationCount
+                       setUp: (void (^)(void))aSetUpBlock
+                       block: (void (^)(void))aBlock
+{
+    NILARG_EXCEPTION_TEST(aBlock);
+    INVALIDARG_EXCEPTION_TEST(runCount, runCount > 0);
+    BenchmarkResult *result = [self resultForName: aName operationCount: operationCount];
+
+    for (NSUInteger i = 0; i < warmupRunCount; i++)
+    {
+        @autoreleasepool
+        {
+            if (aSetUpBlock != nil)
+            {
+                aSetUpBlock();
+            }
+            aBlock();
+        }
+    }
+
+    const int64_t initialPeakResidentSize = BenchmarkPeakResidentSize();
+    int64_t retainedBytes = 0;
+    int64_t retainedBlockCount = 0;
+
+    for (NSUInteger i = 0; i < runCount; i++)
+    {
+        BenchmarkMallocUsage initialUsage;
+
+        @autoreleasepool
+        {
+            if (aSetUpBlock != nil)
+            {
+                aSetUpBlock();
+            }
+            initialUsage = CurrentMallocUsage();
+
+            const uint64_t startTime = COStoreMetricsNow();
+            aBlock();
+            [result addSampleWithTime: (COStoreMetricsNow() - startTime) / 1e9];
+        }
+
+        const BenchmarkMallocUsage usage = CurrentMallocUsage();
+
+        retainedBytes += usage.bytes - initialUsage.bytes;
+        retainedBlockCount = (usage.blocks < 0 ? -1 : retainedBlockCount + usage.blocks - initialUsage.blocks);
+    }
+
+    const int64_t peakResidentSize = BenchmarkPeakResidentSize();
+
+    [result addMemoryUsageOfRuns: runCount
+                peakResidentSize: peakResidentSize
+                          growth: peakResidentSize - initialPeakResidentSize
+                   retainedBytes: retainedBytes
+              retainedBlockCount: retainedBlockCount];
+
+    NSLog(@"%@", result);
+    return result;
+}
+
+- (BenchmarkResult *)measure: (NSString *)aName
+                  operations: (NSUInteger)operationCount
+                       setUp: (void (^)(void))aSetUpBlock
+                       block: (void (^)(void))aBlock
+{
+    return [self measure: aName
+                    runs: _runCount
+              warmupRuns: _warmupRunCount
+              operations: operationCount
+                   setUp: aSetUpBlock
+                   block: aBlock];
+}
+
+- (BenchmarkResult *)measure: (NSString *)aName
+                  operations: (NSUInteger)operationCount
+                       block: (void (^)(void))aBlock
+{
+    return [self measure: aName operations: operationCount setUp: nil block: aBlock];
+}
+
+- (BenchmarkResult *)measureOnce: (NSString *)aName
+                      operations: (NSUInteger)operationCount
+                           block: (void (^)(void))aBlock
+{
+    return [self measure: aName runs: 1 warmupRuns: 0 operations: operationCount setUp: nil block: aBlock];
+}
+
+- (BenchmarkResult *)addSample: (NSTimeInterval)aTime toBenchmark: (NSString *)aName
+{
+    BenchmarkResult *result = [self resultForName: aName operationCount: 1];
+
+    [result addSampleWithTime: aTime];
+    return result;
+}
+
+#pragma mark Reporting -
+
+- (NSArray *)results
+{
+    return [_resultsByName objectsForKeys: _resultNames notFoundMarker: [NSNull null]];
+}
+
+- (BenchmarkResult *)resultForName: (NSString *)aName
+{
+    return _resultsByName[aName];
+}
+
+- (NSDictionary *)JSONObject
+{
+    return @{ @"runCount" : @(_runCount),
+              @"warmupRunCount" : @(_warmupRunCount),
+              @"benchmarks" : [self.results valueForKey: @"JSONObject"] };
+}
+
+- (BOOL)writeResultsToURL: (NSURL *)aURL error: (NSError **)anError
+{
+    NILARG_EXCEPTION_TEST(aURL);
+    NSData *data = CODataWithJSONObject(self.JSONObject, anError);
+
+    return data != nil && [data writeToURL: aURL options: NSDataWritingAtomic error: anError];
+}
+
+- (NSArray *)regressionsComparedToBaseline: (NSDictionary *)aBaseline
+{
+    NILARG_EXCEPTION_TEST(aBaseline);
+    NSMutableArray *regressions = [NSMutableArray new];
+    NSMutableDictionary *baselineMedians = [NSMutableDictionary new];
+
+    for (NSDictionary *benchmark in aBaseline[@"benchmarks"])
+    {
+        baselineMedians[benchmark[@"name"]] = benchmark[@"median"];
+    }
+
+    for (BenchmarkResult *result in self.results)
+    {
+        NSNumber *baselineMedian = baselineMedians[result.name];
+
+        if (baselineMedian == nil)
+            continue;
+
+        const double ratio = result.median / baselineMedian.doubleValue;
+
+        if (ratio > 1 + _regressionTolerance)
+        {
+            [regressions addObject: [NSString stringWithFormat: @"%@: %@ per operation instead of %@ (%.0f%% slower)",
+                result.name, FormatTimeInterval(result.median),
+                FormatTimeInterval(baselineMedian.doubleValue), (ratio - 1) * 100]];
+        }
+    }
+    return regressions;
+}
+
+@end
@@ -6,6 +6,7 @@
  */
 
 #import "TestCommon.h"
+#import "BenchmarkHarness.h"
 
 @interface BenchmarkItem : NSObject <UKTest>
 @end
@@ -59,24 +60,23 @@ static id values[ATTRIBUTES];
 
 - (void)testWrite
 {
-    NSDate *startDate = [NSDate date];
-    COMutableItem *item = [[COMutableItem alloc] init];
-
-    for (NSUInteger i = 0; i < ITERATIONS; i++)
+    [[BenchmarkHarness sharedHarness] measure: @"COMutableItem attribute write"
+                                   operations: ITERATIONS
+                                        block: ^()
     {
-        [item setValue: values[i % ATTRIBUTES]
-          forAttribute: attributes[i % ATTRIBUTES]
-                  type: types[i % ATTRIBUTES]];
-    }
-
-    NSLog(@"writing %d attributes in COMutableItem took %lf ms",
-          ITERATIONS,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+        COMutableItem *item = [[COMutableItem alloc] init];
+
+        for (NSUInteger i = 0; i < ITERATIONS; i++)
+        {
+            [item setValue: values[i % ATTRIBUTES]
+              forAttribute: attributes[i % ATTRIBUTES]
+                      type: types[i % ATTRIBUTES]];
+        }
+    }];
 }
 
 - (void)testRead
 {
-    NSDate *startDate = [NSDate date];
     COMutableItem *item = [[COMutableItem alloc] init];
 
     for (NSUInteger i = 0; i < 10; i++)
@@ -86,18 +86,20 @@ static id values[ATTRIBUTES];
                   type: types[i]];
     }
 
-    BOOL ok = YES;
-    for (NSUInteger i = 0; i < ITERATIONS; i++)
+    __block BOOL ok = YES;
+
+    [[BenchmarkHarness sharedHarness] measure: @"COItem attribute read"
+                                   operations: ITERATIONS
+                                        block: ^()
     {
-        // N.B. These could be UKObjectsEqual checks, but this test case would become about 100x slower
-        ok = ok && [values[i % ATTRIBUTES] isEqual: [item valueForAttribute: attributes[i % ATTRIBUTES]]];
-        ok = ok && (types[i % ATTRIBUTES] == [item typeForAttribute: attributes[i % ATTRIBUTES]]);
-    }
+        for (NSUInteger i = 0; i < ITERATIONS; i++)
+        {
+            // N.B. These could be UKObjectsEqual checks, but this test case would become about 100x slower
+            ok = ok && [values[i % ATTRIBUTES] isEqual: [item valueForAttribute: attributes[i % ATTRIBUTES]]];
+            ok = ok && (types[i % ATTRIBUTES] == [item typeForAttribute: attributes[i % ATTRIBUTES]]);
+        }
+    }];
     UKTrue(ok);
-
-    NSLog(@"reading %d attributes in COItem took %lf ms",
-          ITERATIONS,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
 }
 
 @end
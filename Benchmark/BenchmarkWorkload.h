@@ -0,0 +1,312 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+
+@class COEditingContext, COSQLiteStore, COUndoTrack;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The operations run by BenchmarkWorkload once the store is generated.
+ */
+typedef NS_ENUM(NSUInteger, BenchmarkWorkloadOperation)
+{
+    /** Loads the current item graph of a branch */
+    BenchmarkWorkloadOperationRead,
+    /** Commits a revision touching a few items on a branch */
+    BenchmarkWorkloadOperationCommit,
+    /** Undoes the last commit recorded on the workload undo track */
+    BenchmarkWorkloadOperationUndo,
+    /** Runs a full text search for a word used in item labels */
+    BenchmarkWorkloadOperationSearch,
+    /** Compacts the history of a persistent root with
+        -[COSQLiteStore compactHistory:] */
+    BenchmarkWorkloadOperationCompact,
+    /** Deletes a persistent root and finalizes its deletion */
+    BenchmarkWorkloadOperationDelete,
+    BenchmarkWorkloadOperationCount
+};
+
+/**
+ * Returns the name used for the operation in the workload configuration and
+ * timeline (e.g. "read").
+ */
+NSString *BenchmarkWorkloadOperationName(BenchmarkWorkloadOperation anOperation);
+
+
+/**
+ * @abstract The shape of the store generated by BenchmarkWorkload, and the
+ * operation mix run against it.
+ *
+ * The Soak benchmark reads these environment variables:
+ *
+ * <deflist>
+ * <term>COBENCHMARK_SOAK_SEED</term><desc>-seed</desc>
+ * <term>COBENCHMARK_SOAK_PERSISTENT_ROOTS</term><desc>-persistentRootCount</desc>
+ * <term>COBENCHMARK_SOAK_BRANCHES</term><desc>-branchCount</desc>
+ * <term>COBENCHMARK_SOAK_REVISIONS</term><desc>-revisionCount</desc>
+ * <term>COBENCHMARK_SOAK_ITEMS</term><desc>-itemCount</desc>
+ * <term>COBENCHMARK_SOAK_REFERENCE_DENSITY</term><desc>-referenceDensity</desc>
+ * <term>COBENCHMARK_SOAK_ATTACHMENT_SIZE</term><desc>-attachmentSize</desc>
+ * <term>COBENCHMARK_SOAK_ATTACHMENT_FREQUENCY</term><desc>-attachmentFrequency</desc>
+ * <term>COBENCHMARK_SOAK_MIX</term><desc>-weights as a list such as
+ * "read=60,commit=25,undo=5,search=8,compact=2,delete=1"</desc>
+ * <term>COBENCHMARK_SOAK_DURATION</term><desc>-duration in seconds</desc>
+ * <term>COBENCHMARK_SOAK_OPERATIONS</term><desc>-maxOperationCount</desc>
+ * <term>COBENCHMARK_SOAK_REPORT_INTERVAL</term><desc>-reportInterval in
+ * seconds</desc>
+ * </deflist>
+ */
+@interface BenchmarkWorkloadConfiguration : NSObject
+{
+@private
+    uint64_t _seed;
+    NSUInteger _persistentRootCount;
+    NSUInteger _branchCount;
+    NSUInteger _revisionCount;
+    NSUInteger _itemCount;
+    double _referenceDensity;
+    NSUInteger _attachmentSize;
+    double _attachmentFrequency;
+    NSMutableArray *_weights;
+    NSTimeInterval _duration;
+    NSUInteger _maxOperationCount;
+    NSTimeInterval _reportInterval;
+}
+
+
+/** @taskunit Initialization */
+
+
+/**
+ * Returns a configuration with the default values, overriden by the
+ * COBENCHMARK_SOAK_ environment variables.
+ */
++ (BenchmarkWorkloadConfiguration *)configurationWithEnvironment: (NSDictionary<NSString *, NSString *> *)environment;
+
+
+/** @taskunit Store Shape */
+
+
+/**
+ * The seed from which the store contents, UUIDs included, and the operation
+ * sequence are derived.
+ *
+ * By default, returns 1.
+ */
+@property (nonatomic, readwrite, assign) uint64_t seed;
+/**
+ * By default, returns 100.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger persistentRootCount;
+/**
+ * The number of branches per persistent root.
+ *
+ * By default, returns 2.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger branchCount;
+/**
+ * The number of revisions per branch, the initial revision shared by all the
+ * branches included.
+ *
+ * By default, returns 20.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger revisionCount;
+/**
+ * The number of items per item graph, the root item included (at least 2).
+ *
+ * By default, returns 20.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger itemCount;
+/**
+ * The probability for an item to reference another item in the same graph,
+ * between 0 and 1.
+ *
+ * By default, returns 0.2.
+ */
+@property (nonatomic, readwrite, assign) double referenceDensity;
+/**
+ * The size in bytes of the attachment held by a root item, or 0 for no
+ * attachments.
+ *
+ * By default, returns 4096.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger attachmentSize;
+/**
+ * The probability for a persistent root to hold an attachment, between 0 and
+ * 1.
+ *
+ * By default, returns 0.1.
+ */
+@property (nonatomic, readwrite, assign) double attachmentFrequency;
+
+
+/** @taskunit Operation Mix */
+
+
+/**
+ * Returns the relative frequency of the operation in the mix.
+ *
+ * By default, read is 60, commit 25, undo 5, search 8, compact 2 and
+ * delete 1.
+ */
+- (NSUInteger)weightForOperation: (BenchmarkWorkloadOperation)anOperation;
+- (void)setWeight: (NSUInteger)aWeight forOperation: (BenchmarkWorkloadOperation)anOperation;
+/**
+ * How long the operation mix runs, in seconds.
+ *
+ * By default, returns 10.
+ */
+@property (nonatomic, readwrite, assign) NSTimeInterval duration;
+/**
+ * The number of operations after which the operation mix stops before
+ * -duration elapses, or 0 for no limit.
+ *
+ * With a limit and a long enough duration, the same seed runs the same
+ * operation sequence.
+ *
+ * By default, returns 0.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger maxOperationCount;
+/**
+ * The interval between two timeline entries, in seconds.
+ *
+ * By default, returns 1.
+ */
+@property (nonatomic, readwrite, assign) NSTimeInterval reportInterval;
+/**
+ * Returns a JSON object describing the configuration.
+ */
+@property (nonatomic, readonly) NSDictionary *JSONObject;
+
+@end
+
+
+/**
+ * @abstract Generates a store with a configurable shape, then runs a mixed
+ * operation workload against it and reports throughput and latencies over
+ * time.
+ *
+ * The generated contents are deterministic for a given seed: the UUIDs, item
+ * labels, references and attachments are all derived from it, so two stores
+ * generated with the same configuration are identical.
+ *
+ * The workload uses the store API directly, like the store benchmarks, so the
+ * costs measured are the store ones. Each commit is also recorded on
+ * -undoTrack, as an editing context would, and undo runs -[COUndoTrack undo]
+ * on it. So the commit latency includes recording the command, and the undo
+ * latency includes loading the persistent root into -editingContext.
+ *
+ * Compaction discards the revisions of a persistent root that precede the last
+ * 5 revisions of each branch. Deletion deletes a persistent root, finalizes
+ * the deletion (which removes its backing store and unreachable attachments),
+ * then generates a new persistent root in its place, so the store shape stays
+ * constant over long runs. Only the deletion and finalization are included in
+ * the deletion latency. When the last command on the undo track refers to a
+ * compacted revision or a deleted persistent root, undo clears the track
+ * instead.
+ */
+@interface BenchmarkWorkload : NSObject
+{
+@private
+    COSQLiteStore *_store;
+    COEditingContext *_editingContext;
+    COUndoTrack *_undoTrack;
+    BenchmarkWorkloadConfiguration *_configuration;
+    uint64_t _randomState;
+    uint64_t _nextRevisionIndex;
+    uint32_t *_generations;
+    NSMutableArray *_currentRevisionUUIDs;
+    NSMutableArray *_headRevisionUUIDs;
+    NSUInteger _generatedRevisionCount;
+    NSUInteger _operationCount;
+    NSMutableArray *_timeline;
+    uint64_t _revisionCacheHitCount;
+    uint64_t _revisionCacheMissCount;
+    void (^_intervalHandler)(NSDictionary *interval);
+}
+
+
+/** @taskunit Initialization */
+
+
+/**
+ * <init />
+ * Initializes a workload for an empty store.
+ *
+ * For nil arguments, raises a NSInvalidArgumentException.
+ */
+- (instancetype)initWithStore: (COSQLiteStore *)aStore
+                configuration: (BenchmarkWorkloadConfiguration *)aConfiguration NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+@property (nonatomic, readonly) COSQLiteStore *store;
+@property (nonatomic, readonly) BenchmarkWorkloadConfiguration *configuration;
+/**
+ * The editing context used to undo commits, whose undo track store is hosted
+ * in -store.
+ */
+@property (nonatomic, readonly) COEditingContext *editingContext;
+/**
+ * The undo track on which the commits run by -run are recorded.
+ */
+@property (nonatomic, readonly) COUndoTrack *undoTrack;
+
+
+/** @taskunit Generating and Running */
+
+
+/**
+ * Generates the persistent roots, branches and revisions described by the
+ * configuration.
+ */
+- (void)generateStore;
+/**
+ * Runs the operation mix until -[BenchmarkWorkloadConfiguration duration]
+ * elapses or -[BenchmarkWorkloadConfiguration maxOperationCount] is reached.
+ *
+ * Must be called after -generateStore.
+ */
+- (void)run;
+/**
+ * The number of revisions written by -generateStore.
+ */
+@property (nonatomic, readonly) NSUInteger generatedRevisionCount;
+/**
+ * The number of operations run by -run.
+ */
+@property (nonatomic, readonly) NSUInteger operationCount;
+
+
+/** @taskunit Reporting */
+
+
+/**
+ * A block called by -run at the end of each report interval with the
+ * timeline entry.
+ */
+@property (nonatomic, readwrite, copy, nullable) void (^intervalHandler)(NSDictionary *interval);
+/**
+ * The timeline entries collected by -run, one per report interval.
+ *
+ * Each entry includes the keys <em>elapsed</em> (seconds since -run
+ * started), <em>operations</em> (count per operation name),
+ * <em>throughput</em> (operations per second), <em>latencies</em> (count,
+ * mean, p50, p90, p99 and max in seconds per operation name),
+ * <em>revisionCacheHitRate</em> when the revision cache was used during the
+ * interval, and
+ * <em>peakResidentSize</em> in bytes.
+ */
+@property (nonatomic, readonly) NSArray<NSDictionary *> *timeline;
+/**
+ * Writes the configuration and timeline as JSON to the given file URL.
+ */
+- (BOOL)writeTimelineToURL: (NSURL *)aURL error: (NSError **)anError;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,966 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "BenchmarkWorkload.h"
+#import "BenchmarkHarness.h"
+#import <EtoileFoundation/EtoileFoundation.h>
+#import <CoreObject/CoreObject.h>
+#import "COSQLiteStore+Attachments.h"
+#import "COStoreTransaction.h"
+#import "COCommandGroup.h"
+#import "COCommandSetCurrentVersionForBranch.h"
+#import "COJSONSerialization.h"
+#import "COStoreMetrics.h"
+#import "COBasicHistoryCompaction.h"
+
+/**
+ * The number of revisions after which -generateStore commits the transaction
+ * it is filling.
+ */
+static const NSUInteger BenchmarkWorkloadRevisionsPerTransaction = 1000;
+
+/**
+ * The maximum number of items touched by a commit.
+ */
+static const NSUInteger BenchmarkWorkloadMaxModifiedItemCount = 3;
+
+/**
+ * The number of revisions per branch, the current one included, kept when
+ * compacting the history.
+ */
+static const NSUInteger BenchmarkWorkloadKeptUndoDepth = 5;
+
+/**
+ * The metadata key for the branch index in the commands recorded on the undo
+ * track.
+ */
+static NSString *const BenchmarkWorkloadBranchIndexKey = @"benchmarkWorkloadBranchIndex";
+
+static NSString *const BenchmarkWorkloadWords[] = {
+    @"apple", @"banana", @"cherry", @"delta", @"ember", @"falcon", @"garnet", @"harbor",
+    @"island", @"jasper", @"kettle", @"lantern", @"meadow", @"nectar", @"orchid", @"pepper",
+    @"quartz", @"raven", @"saddle", @"timber", @"umber", @"velvet", @"willow", @"xenon",
+    @"yarrow", @"zephyr", @"anchor", @"beacon", @"canyon", @"dune", @"engine", @"forest",
+    @"glacier", @"hollow", @"ivory", @"jungle", @"kernel", @"ledger", @"marble", @"north",
+    @"ocean", @"pillar", @"quiver", @"river", @"summit", @"tundra", @"upland", @"valley",
+    @"walnut", @"yonder", @"zenith", @"amber", @"birch", @"cobalt", @"dawn", @"echo",
+    @"fern", @"grove", @"heron", @"indigo", @"juniper", @"kestrel", @"lilac", @"maple"
+};
+
+static const NSUInteger BenchmarkWorkloadWordCount =
+    sizeof(BenchmarkWorkloadWords) / sizeof(BenchmarkWorkloadWords[0]);
+
+typedef NS_ENUM(uint64_t, BenchmarkWorkloadUUIDKind)
+{
+    BenchmarkWorkloadUUIDKindPersistentRoot = 1,
+    BenchmarkWorkloadUUIDKindBranch,
+    BenchmarkWorkloadUUIDKindItem,
+    BenchmarkWorkloadUUIDKindRevision
+};
+
+NSString *BenchmarkWorkloadOperationName(BenchmarkWorkloadOperation anOperation)
+{
+    switch (anOperation)
+    {
+        case BenchmarkWorkloadOperationRead:
+            return @"read";
+        case BenchmarkWorkloadOperationCommit:
+            return @"commit";
+        case BenchmarkWorkloadOperationUndo:
+            return @"undo";
+        case BenchmarkWorkloadOperationSearch:
+            return @"search";
+        case BenchmarkWorkloadOperationCompact:
+            return @"compact";
+        case BenchmarkWorkloadOperationDelete:
+            return @"delete";
+        default:
+            [NSException raise: NSInvalidArgumentException
+                        format: @"Unknown workload operation %lu", (unsigned long)anOperation];
+            return nil;
+    }
+}
+
+/**
+ * Returns the next value of a SplitMix64 sequence.
+ */
+static inline uint64_t NextRandom(uint64_t *state)
+{
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static inline NSUInteger RandomIndex(uint64_t *state, NSUInteger count)
+{
+    return (NSUInteger)(NextRandom(state) % count);
+}
+
+static inline double RandomProbability(uint64_t *state)
+{
+    return (NextRandom(state) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Returns a version 4 UUID derived from the seed, kind and key, without
+ * consuming the workload random sequence.
+ */
+static ETUUID *DeterministicUUID(uint64_t seed, BenchmarkWorkloadUUIDKind kind, uint64_t key)
+{
+    uint64_t kindState = seed ^ (kind * UINT64_C(0xD1B54A32D192ED03));
+    // Two outputs per key, so the states of two keys never overlap
+    uint64_t state = NextRandom(&kindState) + key * 2 * UINT64_C(0x9E3779B97F4A7C15);
+    uint64_t words[2] = { NextRandom(&state), NextRandom(&state) };
+    unsigned char *bytes = (unsigned char *)words;
+
+    bytes[6] = (bytes[6] & 0x0F) | 0x40;
+    bytes[8] = (bytes[8] & 0x3F) | 0x80;
+    return [ETUUID UUIDWithData: [NSData dataWithBytes: bytes length: 16]];
+}
+
+/**
+ * Returns the value at the given percentile with the nearest-rank method.
+ */
+static double PercentileOfSortedValues(NSArray *sortedValues, double aPercentile)
+{
+    const NSUInteger rank = (NSUInteger)ceil(aPercentile * sortedValues.count);
+    return [sortedValues[MAX(rank, 1) - 1] doubleValue];
+}
+
+
+@implementation BenchmarkWorkloadConfiguration
+
+@synthesize seed = _seed, persistentRootCount = _persistentRootCount, branchCount = _branchCount;
+@synthesize revisionCount = _revisionCount, itemCount = _itemCount, referenceDensity = _referenceDensity;
+@synthesize attachmentSize = _attachmentSize, attachmentFrequency = _attachmentFrequency;
+@synthesize duration = _duration, maxOperationCount = _maxOperationCount, reportInterval = _reportInterval;
+
+- (instancetype)init
+{
+    SUPERINIT;
+    _seed = 1;
+    _persistentRootCount = 100;
+    _branchCount = 2;
+    _revisionCount = 20;
+    _itemCount = 20;
+    _referenceDensity = 0.2;
+    _attachmentSize = 4096;
+    _attachmentFrequency = 0.1;
+    _weights = [@[@60, @25, @5, @8, @2, @1] mutableCopy];
+    ETAssert(_weights.count == BenchmarkWorkloadOperationCount);
+    _duration = 10;
+    _reportInterval = 1;
+    return self;
+}
+
++ (BenchmarkWorkloadConfiguration *)configurationWithEnvironment: (NSDictionary *)environment
+{
+    NILARG_EXCEPTION_TEST(environment);
+    BenchmarkWorkloadConfiguration *configuration = [self new];
+
+    if (environment[@"COBENCHMARK_SOAK_SEED"] != nil)
+    {
+        configuration.seed = strtoull([environment[@"COBENCHMARK_SOAK_SEED"] UTF8String], NULL, 10);
+    }
+    if (environment[@"COBENCHMARK_SOAK_PERSISTENT_ROOTS"] != nil)
+    {
+        configuration.persistentRootCount = [environment[@"COBENCHMARK_SOAK_PERSISTENT_ROOTS"] integerValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_BRANCHES"] != nil)
+    {
+        configuration.branchCount = [environment[@"COBENCHMARK_SOAK_BRANCHES"] integerValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_REVISIONS"] != nil)
+    {
+        configuration.revisionCount = [environment[@"COBENCHMARK_SOAK_REVISIONS"] integerValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_ITEMS"] != nil)
+    {
+        configuration.itemCount = [environment[@"COBENCHMARK_SOAK_ITEMS"] integerValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_REFERENCE_DENSITY"] != nil)
+    {
+        configuration.referenceDensity = [environment[@"COBENCHMARK_SOAK_REFERENCE_DENSITY"] doubleValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_ATTACHMENT_SIZE"] != nil)
+    {
+        configuration.attachmentSize = [environment[@"COBENCHMARK_SOAK_ATTACHMENT_SIZE"] integerValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_ATTACHMENT_FREQUENCY"] != nil)
+    {
+        configuration.attachmentFrequency = [environment[@"COBENCHMARK_SOAK_ATTACHMENT_FREQUENCY"] doubleValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_MIX"] != nil)
+    {
+        [configuration setWeightsWithString: environment[@"COBENCHMARK_SOAK_MIX"]];
+    }
+    if (environment[@"COBENCHMARK_SOAK_DURATION"] != nil)
+    {
+        configuration.duration = [environment[@"COBENCHMARK_SOAK_DURATION"] doubleValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_OPERATIONS"] != nil)
+    {
+        configuration.maxOperationCount = [environment[@"COBENCHMARK_SOAK_OPERATIONS"] integerValue];
+    }
+    if (environment[@"COBENCHMARK_SOAK_REPORT_INTERVAL"] != nil)
+    {
+        configuration.reportInterval = [environment[@"COBENCHMARK_SOAK_REPORT_INTERVAL"] doubleValue];
+    }
+    return configuration;
+}
+
+/**
+ * Parses a list such as "read=60,commit=25". The operations missing from the
+ * list keep their weight.
+ */
+- (void)setWeightsWithString: (NSString *)aMix
+{
+    for (NSString *component in [aMix componentsSeparatedByString: @","])
+    {
+        NSArray *pair = [component componentsSeparatedByString: @"="];
+        NSString *name = [pair.firstObject stringByTrimmingCharactersInSet:
+            [NSCharacterSet whitespaceCharacterSet]];
+        BenchmarkWorkloadOperation operation = 0;
+
+        while (operation < BenchmarkWorkloadOperationCount
+               && ![BenchmarkWorkloadOperationName(operation) isEqualToString: name])
+        {
+            operation++;
+        }
+
+        if (pair.count != 2 || operation == BenchmarkWorkloadOperationCount)
+        {
+            [NSException raise: NSInvalidArgumentException
+                        format: @"Invalid workload operation mix entry '%@' in '%@'", component, aMix];
+        }
+        [self setWeight: [pair.lastObject integerValue] forOperation: operation];
+    }
+}
+
+- (void)setPersistentRootCount: (NSUInteger)aCount
+{
+    _persistentRootCount = MAX(aCount, 1);
+}
+
+- (void)setBranchCount: (NSUInteger)aCount
+{
+    _branchCount = MAX(aCount, 1);
+}
+
+- (void)setRevisionCount: (NSUInteger)aCount
+{
+    _revisionCount = MAX(aCount, 1);
+}
+
+- (void)setItemCount: (NSUInteger)aCount
+{
+    _itemCount = MAX(aCount, 2);
+}
+
+- (NSUInteger)weightForOperation: (BenchmarkWorkloadOperation)anOperation
+{
+    NSParameterAssert(anOperation < BenchmarkWorkloadOperationCount);
+    return [_weights[anOperation] unsignedIntegerValue];
+}
+
+- (void)setWeight: (NSUInteger)aWeight forOperation: (BenchmarkWorkloadOperation)anOperation
+{
+    NSParameterAssert(anOperation < BenchmarkWorkloadOperationCount);
+    _weights[anOperation] = @(aWeight);
+}
+
+- (NSDictionary *)JSONObject
+{
+    NSMutableDictionary *mix = [NSMutableDictionary new];
+
+    for (BenchmarkWorkloadOperation operation = 0; operation < BenchmarkWorkloadOperationCount; operation++)
+    {
+        mix[BenchmarkWorkloadOperationName(operation)] = _weights[operation];
+    }
+    return @{ @"seed" : @(_seed),
+              @"persistentRootCount" : @(_persistentRootCount),
+              @"branchCount" : @(_branchCount),
+              @"revisionCount" : @(_revisionCount),
+              @"itemCount" : @(_itemCount),
+              @"referenceDensity" : @(_referenceDensity),
+              @"attachmentSize" : @(_attachmentSize),
+              @"attachmentFrequency" : @(_attachmentFrequency),
+              @"mix" : mix,
+              @"duration" : @(_duration),
+              @"maxOperationCount" : @(_maxOperationCount),
+              @"reportInterval" : @(_reportInterval) };
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat: @"<%@ %p - %@>", NSStringFromClass([self class]), self, self.JSONObject];
+}
+
+@end
+
+
+/**
+ * Compacts the history of the compactable persistent roots, keeping the given
+ * live revisions and the more recent ones.
+ */
+@interface BenchmarkWorkloadHistoryCompaction : COBasicHistoryCompaction
+{
+@private
+    NSSet *_liveRevisionUUIDs;
+}
+
+- (instancetype)initWithLiveRevisionUUIDs: (NSSet *)liveRevisionUUIDs;
+
+@end
+
+
+@implementation BenchmarkWorkloadHistoryCompaction
+
+- (instancetype)initWithLiveRevisionUUIDs: (NSSet *)liveRevisionUUIDs
+{
+    NILARG_EXCEPTION_TEST(liveRevisionUUIDs);
+    SUPERINIT;
+    _liveRevisionUUIDs = [liveRevisionUUIDs copy];
+    return self;
+}
+
+- (NSSet *)liveRevisionUUIDsForPersistentRootUUIDs: (NSArray *)persistentRootUUIDs
+{
+    return _liveRevisionUUIDs;
+}
+
+@end
+
+
+@implementation BenchmarkWorkload
+
+@synthesize store = _store, configuration = _configuration, operationCount = _operationCount;
+@synthesize editingContext = _editingContext, undoTrack = _undoTrack;
+@synthesize generatedRevisionCount = _generatedRevisionCount, intervalHandler = _intervalHandler;
+
+- (instancetype)initWithStore: (COSQLiteStore *)aStore
+                configuration: (BenchmarkWorkloadConfiguration *)aConfiguration
+{
+    NILARG_EXCEPTION_TEST(aStore);
+    NILARG_EXCEPTION_TEST(aConfiguration);
+    SUPERINIT;
+    _store = aStore;
+    _editingContext = [[COEditingContext alloc] initWithStore: aStore
+                                   modelDescriptionRepository: [ETModelDescriptionRepository mainRepository]
+                                               undoTrackStore: [[COUndoTrackStore alloc] initWithStore: aStore]];
+    _undoTrack = [COUndoTrack trackForName: @"org.etoile.CoreObject.benchmark-workload"
+                               withContext: _editingContext];
+    _configuration = aConfiguration;
+    _randomState = aConfiguration.seed;
+    _generations = calloc(aConfiguration.persistentRootCount, sizeof(uint32_t));
+    _currentRevisionUUIDs = [NSMutableArray new];
+    _headRevisionUUIDs = [NSMutableArray new];
+    _timeline = [NSMutableArray new];
+    return self;
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wnonnull"
+
+- (instancetype)init
+{
+    return [self initWithStore: nil configuration: nil];
+}
+
+#pragma clang diagnostic pop
+
+- (void)dealloc
+{
+    free(_generations);
+}
+
+- (NSArray *)timeline
+{
+    return [_timeline copy];
+}
+
+#pragma mark Deterministic Contents -
+
+- (uint64_t)rootKeyForSlot: (NSUInteger)aSlot
+{
+    return (uint64_t)_generations[aSlot] * _configuration.persistentRootCount + aSlot;
+}
+
+- (ETUUID *)persistentRootUUIDForSlot: (NSUInteger)aSlot
+{
+    return DeterministicUUID(_configuration.seed,
+                             BenchmarkWorkloadUUIDKindPersistentRoot,
+                             [self rootKeyForSlot: aSlot]);
+}
+
+/**
+ * Branches are indexed from 0 to persistentRootCount * branchCount - 1, the
+ * branches of a persistent root being contiguous.
+ */
+- (ETUUID *)branchUUIDAtIndex: (NSUInteger)aBranchIndex
+{
+    const NSUInteger branchCount = _configuration.branchCount;
+    const uint64_t rootKey = [self rootKeyForSlot: aBranchIndex / branchCount];
+
+    return DeterministicUUID(_configuration.seed,
+                             BenchmarkWorkloadUUIDKindBranch,
+                             rootKey * branchCount + aBranchIndex % branchCount);
+}
+
+- (ETUUID *)itemUUIDAtIndex: (NSUInteger)anItemIndex rootKey: (uint64_t)aRootKey
+{
+    return DeterministicUUID(_configuration.seed,
+                             BenchmarkWorkloadUUIDKindItem,
+                             aRootKey * _configuration.itemCount + anItemIndex);
+}
+
+- (ETUUID *)nextRevisionUUID
+{
+    return DeterministicUUID(_configuration.seed, BenchmarkWorkloadUUIDKindRevision, _nextRevisionIndex++);
+}
+
+- (NSString *)randomWord
+{
+    return BenchmarkWorkloadWords[RandomIndex(&_randomState, BenchmarkWorkloadWordCount)];
+}
+
+- (NSString *)randomLabel
+{
+    return [NSString stringWithFormat: @"%@ %@ %@", [self randomWord], [self randomWord], [self randomWord]];
+}
+
+- (NSData *)randomDataWithLength: (NSUInteger)aLength
+{
+    NSMutableData *data = [NSMutableData dataWithLength: aLength];
+    unsigned char *bytes = data.mutableBytes;
+
+    for (NSUInteger offset = 0; offset < aLength; offset += sizeof(uint64_t))
+    {
+        const uint64_t word = NextRandom(&_randomState);
+        memcpy(bytes + offset, &word, MIN(sizeof(uint64_t), aLength - offset));
+    }
+    return data;
+}
+
+- (COMutableItem *)itemAtIndex: (NSUInteger)anItemIndex rootKey: (uint64_t)aRootKey
+{
+    COMutableItem *item = [[COMutableItem alloc] initWithUUID: [self itemUUIDAtIndex: anItemIndex
+                                                                             rootKey: aRootKey]];
+
+    [item setValue: [self randomLabel] forAttribute: @"label" type: kCOTypeString];
+    [item setValue: @(anItemIndex) forAttribute: @"index" type: kCOTypeInt64];
+
+    if (RandomProbability(&_randomState) < _configuration.referenceDensity)
+    {
+        const NSUInteger targetIndex = 1 + RandomIndex(&_randomState, _configuration.itemCount - 1);
+
+        [item setValue: [self itemUUIDAtIndex: targetIndex rootKey: aRootKey]
+          forAttribute: @"related"
+                  type: kCOTypeReference];
+    }
+    return item;
+}
+
+- (COItemGraph *)initialItemGraphForRootKey: (uint64_t)aRootKey
+{
+    COMutableItem *rootItem = [[COMutableItem alloc] initWithUUID: [self itemUUIDAtIndex: 0 rootKey: aRootKey]];
+    NSMutableArray *items = [NSMutableArray arrayWithObject: rootItem];
+
+    for (NSUInteger i = 1; i < _configuration.itemCount; i++)
+    {
+        [items addObject: [self itemAtIndex: i rootKey: aRootKey]];
+    }
+
+    [rootItem setValue: [self randomLabel] forAttribute: @"label" type: kCOTypeString];
+    [rootItem setValue: [[items subarrayWithRange: NSMakeRange(1, items.count - 1)] valueForKey: @"UUID"]
+          forAttribute: @"children"
+                  type: kCOTypeCompositeReference | kCOTypeArray];
+
+    if (_configuration.attachmentSize > 0
+        && RandomProbability(&_randomState) < _configuration.attachmentFrequency)
+    {
+        COAttachmentID *attachmentID =
+            [_store importAttachmentFromData: [self randomDataWithLength: _configuration.attachmentSize]];
+
+        ETAssert(attachmentID != nil);
+        [rootItem setValue: attachmentID forAttribute: @"attachment" type: kCOTypeAttachment];
+    }
+    return [[COItemGraph alloc] initWithItems: items rootItemUUID: rootItem.UUID];
+}
+
+/**
+ * Returns a delta item graph that replaces a few non-root items.
+ */
+- (COItemGraph *)modifiedItemGraphForRootKey: (uint64_t)aRootKey
+{
+    const NSUInteger itemCount = MIN(1 + RandomIndex(&_randomState, BenchmarkWorkloadMaxModifiedItemCount),
+                                     _configuration.itemCount - 1);
+    NSMutableDictionary *itemsByUUID = [NSMutableDictionary new];
+
+    for (NSUInteger i = 0; i < itemCount; i++)
+    {
+        const NSUInteger itemIndex = 1 + RandomIndex(&_randomState, _configuration.itemCount - 1);
+        COMutableItem *item = [self itemAtIndex: itemIndex rootKey: aRootKey];
+
+        itemsByUUID[item.UUID] = item;
+    }
+    return [[COItemGraph alloc] initWithItemForUUID: itemsByUUID
+                                       rootItemUUID: [self itemUUIDAtIndex: 0 rootKey: aRootKey]];
+}
+
+#pragma mark Generating -
+
+- (ETUUID *)writeRevisionOnBranchAtIndex: (NSUInteger)aBranchIndex
+                          parentRevision: (ETUUID *)aParentRevision
+                           inTransaction: (COStoreTransaction *)aTransaction
+{
+    const NSUInteger slot = aBranchIndex / _configuration.branchCount;
+    ETUUID *revisionUUID = [self nextRevisionUUID];
+
+    [aTransaction writeRevisionWithModifiedItems: [self modifiedItemGraphForRootKey: [self rootKeyForSlot: slot]]
+                                    revisionUUID: revisionUUID
+                                        metadata: nil
+                                parentRevisionID: aParentRevision
+                           mergeParentRevisionID: nil
+                              persistentRootUUID: [self persistentRootUUIDForSlot: slot]
+                                      branchUUID: [self branchUUIDAtIndex: aBranchIndex]
+                                   schemaVersion: 0];
+    return revisionUUID;
+}
+
+/**
+ * Adds a persistent root with its branches and revisions to the transaction,
+ * and returns the number of revisions written.
+ */
+- (NSUInteger)createPersistentRootInSlot: (NSUInteger)aSlot inTransaction: (COStoreTransaction *)aTransaction
+{
+    const NSUInteger branchCount = _configuration.branchCount;
+    const NSUInteger firstBranchIndex = aSlot * branchCount;
+    ETUUID *persistentRootUUID = [self persistentRootUUIDForSlot: aSlot];
+    ETUUID *mainBranchUUID = [self branchUUIDAtIndex: firstBranchIndex];
+    ETUUID *initialRevisionUUID = [self nextRevisionUUID];
+    NSUInteger revisionCount = 1;
+
+    [aTransaction writeRevisionWithModifiedItems: [self initialItemGraphForRootKey: [self rootKeyForSlot: aSlot]]
+                                    revisionUUID: initialRevisionUUID
+                                        metadata: nil
+                                parentRevisionID: nil
+                           mergeParentRevisionID: nil
+                              persistentRootUUID: persistentRootUUID
+                                      branchUUID: mainBranchUUID
+                                   schemaVersion: 0];
+    [aTransaction createPersistentRootCopyWithUUID: persistentRootUUID
+                          parentPersistentRootUUID: nil
+                                        branchUUID: mainBranchUUID
+                                  parentBranchUUID: nil
+                               initialRevisionUUID: initialRevisionUUID];
+
+    for (NSUInteger branchIndex = firstBranchIndex; branchIndex < firstBranchIndex + branchCount; branchIndex++)
+    {
+        ETUUID *branchUUID = [self branchUUIDAtIndex: branchIndex];
+        ETUUID *currentRevisionUUID = initialRevisionUUID;
+
+        if (branchIndex != firstBranchIndex)
+        {
+            [aTransaction createBranchWithUUID: branchUUID
+                                  parentBranch: mainBranchUUID
+                               initialRevision: initialRevisionUUID
+                             forPersistentRoot: persistentRootUUID];
+        }
+
+        for (NSUInteger i = 1; i < _configuration.revisionCount; i++)
+        {
+            currentRevisionUUID = [self writeRevisionOnBranchAtIndex: branchIndex
+                                                      parentRevision: currentRevisionUUID
+                                                       inTransaction: aTransaction];
+            revisionCount++;
+        }
+
+        [aTransaction setCurrentRevision: currentRevisionUUID
+                            headRevision: currentRevisionUUID
+                               forBranch: branchUUID
+                        ofPersistentRoot: persistentRootUUID];
+
+        if (branchIndex < _currentRevisionUUIDs.count)
+        {
+            _currentRevisionUUIDs[branchIndex] = currentRevisionUUID;
+            _headRevisionUUIDs[branchIndex] = currentRevisionUUID;
+        }
+        else
+        {
+            ETAssert(branchIndex == _currentRevisionUUIDs.count);
+            [_currentRevisionUUIDs addObject: currentRevisionUUID];
+            [_headRevisionUUIDs addObject: currentRevisionUUID];
+        }
+    }
+    return revisionCount;
+}
+
+- (void)generateStore
+{
+    ETAssert(_currentRevisionUUIDs.isEmpty);
+    COStoreTransaction *transaction = [COStoreTransaction new];
+    NSUInteger transactionRevisionCount = 0;
+
+    for (NSUInteger slot = 0; slot < _configuration.persistentRootCount; slot++)
+    {
+        @autoreleasepool
+        {
+            transactionRevisionCount += [self createPersistentRootInSlot: slot inTransaction: transaction];
+
+            if (transactionRevisionCount >= BenchmarkWorkloadRevisionsPerTransaction
+                || slot == _configuration.persistentRootCount - 1)
+            {
+                ETAssert([_store commitStoreTransaction: transaction]);
+
+                _generatedRevisionCount += transactionRevisionCount;
+                transaction = [COStoreTransaction new];
+                transactionRevisionCount = 0;
+            }
+        }
+    }
+}
+
+#pragma mark Operations -
+
+- (void)readBranchAtIndex: (NSUInteger)aBranchIndex
+{
+    COItemGraph *itemGraph =
+        [_store itemGraphForRevisionUUID: _currentRevisionUUIDs[aBranchIndex]
+                          persistentRoot: [self persistentRootUUIDForSlot: aBranchIndex / _configuration.branchCount]];
+
+    ETAssert(itemGraph.itemUUIDs.count == _configuration.itemCount);
+}
+
+- (void)commitOnBranchAtIndex: (NSUInteger)aBranchIndex
+{
+    ETUUID *persistentRootUUID = [self persistentRootUUIDForSlot: aBranchIndex / _configuration.branchCount];
+    ETUUID *branchUUID = [self branchUUIDAtIndex: aBranchIndex];
+    COStoreTransaction *transaction = [COStoreTransaction new];
+    ETUUID *revisionUUID = [self writeRevisionOnBranchAtIndex: aBranchIndex
+                                               parentRevision: _currentRevisionUUIDs[aBranchIndex]
+                                                inTransaction: transaction];
+
+    [transaction setCurrentRevision: revisionUUID
+                       headRevision: revisionUUID
+                          forBranch: branchUUID
+                   ofPersistentRoot: persistentRootUUID];
+
+    ETAssert([_store commitStoreTransaction: transaction]);
+
+    // Recorded like the editing context records a branch revision change
+    COCommandSetCurrentVersionForBranch *command = [COCommandSetCurrentVersionForBranch new];
+    COCommandGroup *group = [COCommandGroup new];
+
+    command.storeUUID = _store.UUID;
+    command.persistentRootUUID = persistentRootUUID;
+    command.branchUUID = branchUUID;
+    command.oldRevisionUUID = _currentRevisionUUIDs[aBranchIndex];
+    command.revisionUUID = revisionUUID;
+    command.oldHeadRevisionUUID = _headRevisionUUIDs[aBranchIndex];
+    command.headRevisionUUID = revisionUUID;
+
+    group.metadata = @{ BenchmarkWorkloadBranchIndexKey : @(aBranchIndex) };
+    [group.contents addObject: command];
+    [_undoTrack recordCommand: group];
+
+    _currentRevisionUUIDs[aBranchIndex] = revisionUUID;
+    _headRevisionUUIDs[aBranchIndex] = revisionUUID;
+}
+
+- (void)undo
+{
+    if (!_undoTrack.canUndo)
+        return;
+
+    COCommandGroup *group = (COCommandGroup *)_undoTrack.currentNode;
+    COCommandSetCurrentVersionForBranch *command = group.contents.firstObject;
+    ETUUID *persistentRootUUID = command.persistentRootUUID;
+
+    // The commands recorded before a compaction or deletion can't be undone
+    if ([_store revisionInfoForRevisionUUID: command.oldRevisionUUID
+                         persistentRootUUID: persistentRootUUID] == nil)
+    {
+        [_undoTrack clear];
+        return;
+    }
+
+    [_undoTrack undo];
+
+    // Don't let the loaded persistent roots accumulate over long runs
+    for (COPersistentRoot *persistentRoot in _editingContext.loadedPersistentRoots)
+    {
+        [_editingContext unloadPersistentRoot: persistentRoot];
+    }
+
+    const NSUInteger branchIndex = [group.metadata[BenchmarkWorkloadBranchIndexKey] unsignedIntegerValue];
+    COBranchInfo *branchInfo =
+        [[_store persistentRootInfoForUUID: persistentRootUUID] branchInfoForUUID: command.branchUUID];
+
+    _currentRevisionUUIDs[branchIndex] = branchInfo.currentRevisionUUID;
+    _headRevisionUUIDs[branchIndex] = branchInfo.headRevisionUUID;
+}
+
+- (void)searchWord: (NSString *)aWord
+{
+    (void)[_store searchResultsForQuery: aWord];
+}
+
+- (void)compactHistoryOfPersistentRootInSlot: (NSUInteger)aSlot
+{
+    ETUUID *persistentRootUUID = [self persistentRootUUIDForSlot: aSlot];
+    NSMutableSet *branchUUIDs = [NSMutableSet new];
+    NSMutableSet *liveRevisionUUIDs = [NSMutableSet new];
+
+    for (NSUInteger i = 0; i < _configuration.branchCount; i++)
+    {
+        const NSUInteger branchIndex = aSlot * _configuration.branchCount + i;
+        ETUUID *revisionUUID = _currentRevisionUUIDs[branchIndex];
+
+        [branchUUIDs addObject: [self branchUUIDAtIndex: branchIndex]];
+
+        for (NSUInteger depth = 0; depth < BenchmarkWorkloadKeptUndoDepth && revisionUUID != nil; depth++)
+        {
+            CORevisionInfo *info = [_store revisionInfoForRevisionUUID: revisionUUID
+                                                    persistentRootUUID: persistentRootUUID];
+
+            if (info == nil)
+                break;
+
+            [liveRevisionUUIDs addObject: revisionUUID];
+            revisionUUID = info.parentRevisionUUID;
+        }
+    }
+
+    BenchmarkWorkloadHistoryCompaction *compaction =
+        [[BenchmarkWorkloadHistoryCompaction alloc] initWithLiveRevisionUUIDs: liveRevisionUUIDs];
+
+    compaction.compactablePersistentRootUUIDs = [NSSet setWithObject: persistentRootUUID];
+    compaction.compactableBranchUUIDs = branchUUIDs;
+
+    ETAssert([_store compactHistory: compaction]);
+}
+
+- (void)deletePersistentRootInSlot: (NSUInteger)aSlot
+{
+    ETUUID *persistentRootUUID = [self persistentRootUUIDForSlot: aSlot];
+    COStoreTransaction *transaction = [COStoreTransaction new];
+
+    [transaction deletePersistentRoot: persistentRootUUID];
+
+    ETAssert([_store commitStoreTransaction: transaction]);
+    ETAssert([_store finalizeDeletionsForPersistentRoot: persistentRootUUID error: NULL]);
+}
+
+- (void)regeneratePersistentRootInSlot: (NSUInteger)aSlot
+{
+    COStoreTransaction *transaction = [COStoreTransaction new];
+
+    _generations[aSlot]++;
+    [self createPersistentRootInSlot: aSlot inTransaction: transaction];
+
+    ETAssert([_store commitStoreTransaction: transaction]);
+}
+
+#pragma mark Running -
+
+- (BenchmarkWorkloadOperation)randomOperationWithTotalWeight: (NSUInteger)aTotalWeight
+{
+    NSUInteger draw = RandomIndex(&_randomState, aTotalWeight);
+
+    for (BenchmarkWorkloadOperation operation = 0; operation < BenchmarkWorkloadOperationCount; operation++)
+    {
+        const NSUInteger weight = [_configuration weightForOperation: operation];
+
+        if (draw < weight)
+            return operation;
+
+        draw -= weight;
+    }
+    ETAssertUnreachable();
+    return BenchmarkWorkloadOperationRead;
+}
+
+/**
+ * Runs the operation and returns its latency in seconds.
+ */
+- (NSTimeInterval)runOperation: (BenchmarkWorkloadOperation)anOperation
+{
+    const NSUInteger branchIndex = RandomIndex(&_randomState, _currentRevisionUUIDs.count);
+    const NSUInteger slot = branchIndex / _configuration.branchCount;
+    NSString *word = [self randomWord];
+    const uint64_t startTime = COStoreMetricsNow();
+
+    switch (anOperation)
+    {
+        case BenchmarkWorkloadOperationRead:
+            [self readBranchAtIndex: branchIndex];
+            break;
+        case BenchmarkWorkloadOperationCommit:
+            [self commitOnBranchAtIndex: branchIndex];
+            break;
+        case BenchmarkWorkloadOperationUndo:
+            [self undo];
+            break;
+        case BenchmarkWorkloadOperationSearch:
+            [self searchWord: word];
+            break;
+        case BenchmarkWorkloadOperationCompact:
+            [self compactHistoryOfPersistentRootInSlot: slot];
+            break;
+        case BenchmarkWorkloadOperationDelete:
+            [self deletePersistentRootInSlot: slot];
+            break;
+        default:
+            ETAssertUnreachable();
+    }
+
+    const NSTimeInterval latency = (COStoreMetricsNow() - startTime) / 1e9;
+
+    if (anOperation == BenchmarkWorkloadOperationDelete)
+    {
+        [self regeneratePersistentRootInSlot: slot];
+    }
+    return latency;
+}
+
+- (NSArray *)emptyLatencies
+{
+    NSMutableArray *latencies = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < BenchmarkWorkloadOperationCount; i++)
+    {
+        [latencies addObject: [NSMutableArray new]];
+    }
+    return latencies;
+}
+
+- (void)addTimelineEntryWithElapsedTime: (NSTimeInterval)anElapsedTime
+                       intervalDuration: (NSTimeInterval)anIntervalDuration
+                              latencies: (NSArray *)latencies
+{
+    NSMutableDictionary *operations = [NSMutableDictionary new];
+    NSMutableDictionary *latencyStatistics = [NSMutableDictionary new];
+    NSUInteger operationCount = 0;
+
+    for (BenchmarkWorkloadOperation operation = 0; operation < BenchmarkWorkloadOperationCount; operation++)
+    {
+        NSArray *sortedLatencies = [latencies[operation] sortedArrayUsingSelector: @selector(compare:)];
+        NSString *name = BenchmarkWorkloadOperationName(operation);
+
+        operations[name] = @(sortedLatencies.count);
+        operationCount += sortedLatencies.count;
+
+        if (sortedLatencies.isEmpty)
+            continue;
+
+        const double sum = [[sortedLatencies valueForKeyPath: @"@sum.doubleValue"] doubleValue];
+
+        latencyStatistics[name] = @{ @"count" : @(sortedLatencies.count),
+                                     @"mean" : @(sum / sortedLatencies.count),
+                                     @"p50" : @(PercentileOfSortedValues(sortedLatencies, 0.5)),
+                                     @"p90" : @(PercentileOfSortedValues(sortedLatencies, 0.9)),
+                                     @"p99" : @(PercentileOfSortedValues(sortedLatencies, 0.99)),
+                                     @"max" : sortedLatencies.lastObject };
+    }
+
+    NSMutableDictionary *entry = [@{ @"elapsed" : @(anElapsedTime),
+                                     @"operations" : operations,
+                                     @"throughput" : @(operationCount / anIntervalDuration),
+                                     @"latencies" : latencyStatistics,
+                                     @"peakResidentSize" : @(BenchmarkPeakResidentSize()) } mutableCopy];
+    // The store counters are cumulative, so we report the interval ones
+    const uint64_t hitCount = [_store.metrics valueForCounter: COStoreCounterRevisionCacheHits];
+    const uint64_t missCount = [_store.metrics valueForCounter: COStoreCounterRevisionCacheMisses];
+    const uint64_t intervalHitCount = hitCount - _revisionCacheHitCount;
+    const uint64_t intervalLookupCount = intervalHitCount + (missCount - _revisionCacheMissCount);
+
+    if (intervalLookupCount > 0)
+    {
+        entry[@"revisionCacheHitRate"] = @((double)intervalHitCount / intervalLookupCount);
+    }
+    _revisionCacheHitCount = hitCount;
+    _revisionCacheMissCount = missCount;
+
+    [_timeline addObject: entry];
+
+    if (_intervalHandler != nil)
+    {
+        _intervalHandler(entry);
+    }
+}
+
+- (void)run
+{
+    // -generateStore must be called first
+    ETAssert(!_currentRevisionUUIDs.isEmpty);
+    NSUInteger totalWeight = 0;
+
+    for (BenchmarkWorkloadOperation operation = 0; operation < BenchmarkWorkloadOperationCount; operation++)
+    {
+        totalWeight += [_configuration weightForOperation: operation];
+    }
+    ETAssert(totalWeight > 0);
+
+    const uint64_t startTime = COStoreMetricsNow();
+    const uint64_t endTime = startTime + (uint64_t)(_configuration.duration * 1e9);
+    const uint64_t reportInterval = MAX((uint64_t)(_configuration.reportInterval * 1e9), 1);
+    const NSUInteger maxOperationCount = _configuration.maxOperationCount;
+    uint64_t intervalStartTime = startTime;
+    NSArray *latencies = [self emptyLatencies];
+    BOOL hasLatencies = NO;
+
+    _operationCount = 0;
+    [_timeline removeAllObjects];
+    _revisionCacheHitCount = [_store.metrics valueForCounter: COStoreCounterRevisionCacheHits];
+    _revisionCacheMissCount = [_store.metrics valueForCounter: COStoreCounterRevisionCacheMisses];
+
+    while (YES)
+    {
+        uint64_t now = COStoreMetricsNow();
+        const BOOL isDone = (now >= endTime || (maxOperationCount > 0 && _operationCount >= maxOperationCount));
+
+        if (now - intervalStartTime >= reportInterval || (isDone && hasLatencies))
+        {
+            [self addTimelineEntryWithElapsedTime: (now - startTime) / 1e9
+                                 intervalDuration: (now - intervalStartTime) / 1e9
+                                        latencies: latencies];
+            intervalStartTime = now;
+            latencies = [self emptyLatencies];
+            hasLatencies = NO;
+        }
+
+        if (isDone)
+            break;
+
+        @autoreleasepool
+        {
+            const BenchmarkWorkloadOperation operation = [self randomOperationWithTotalWeight: totalWeight];
+
+            [latencies[operation] addObject: @([self runOperation: operation])];
+        }
+        hasLatencies = YES;
+        _operationCount++;
+    }
+}
+
+#pragma mark Reporting -
+
+- (BOOL)writeTimelineToURL: (NSURL *)aURL error: (NSError **)anError
+{
+    NILARG_EXCEPTION_TEST(aURL);
+    NSData *data = CODataWithJSONObject(@{ @"configuration" : _configuration.JSONObject,
+                                           @"generatedRevisionCount" : @(_generatedRevisionCount),
+                                           @"operationCount" : @(_operationCount),
+                                           @"timeline" : self.timeline }, anError);
+
+    return data != nil && [data writeToURL: aURL options: NSDataWritingAtomic error: anError];
+}
+
+@end
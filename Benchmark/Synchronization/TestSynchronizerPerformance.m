@@ -6,6 +6,49 @@
  */
 
 #import "TestSynchronizerCommon.h"
+#import "COSynchronizerJSONUtils.h"
+#import "COSynchronizerBinaryUtils.h"
+#import "COSynchronizerPushedRevisionsFromClientMessage.h"
+#import "COSynchronizerResponseToClientForSentRevisionsMessage.h"
+#import "BenchmarkHarness.h"
+
+#define WIRE_FORMAT_COMMITS 100
+#define REBASE_CHILDREN 50
+#define REBASE_CLIENT_COMMITS 500
+#define REBASE_SERVER_COMMITS 100
+
+/**
+ * Collects the text or data that the JSON and binary transports send.
+ */
+@interface TestSynchronizerWireFormatRecorder : NSObject <COSynchronizerJSONClientDelegate, COSynchronizerJSONServerDelegate>
+{
+@public
+    NSString *lastText;
+}
+
+@end
+
+
+@implementation TestSynchronizerWireFormatRecorder
+
+- (void)JSONServer: (COSynchronizerJSONServer *)server
+          sendText: (NSString *)text
+          toClient: (NSString *)client
+{
+    lastText = text;
+}
+
+- (void)JSONClient: (COSynchronizerJSONClient *)client sendTextToServer: (NSString *)text
+{
+    lastText = text;
+}
+
+- (void)JSONClient: (COSynchronizerJSONClient *)client didStartSharingOnBranch: (COBranch *)aBranch
+{
+}
+
+@end
+
 
 @interface TestSynchronizerPerformance : TestSynchronizerCommon <UKTest>
 @end
@@ -65,7 +108,9 @@
                                             stringToInsert,
                                             baseString] isEqualToString: serverWrapper.string]));
 
-    [transport deliverMessagesToClient];
+    [[BenchmarkHarness sharedHarness] measureOnce: @"Synchronizer attributed string rebase"
+                                       operations: charactersToInsert.length - 1
+                                            block: ^() { [transport deliverMessagesToClient]; }];
 
     // Send confirmation to server
     [transport deliverMessagesToServer];
@@ -130,7 +175,9 @@
     [transport deliverMessagesToServer];
 
     // Merge in the server's changes on the client
-    [transport deliverMessagesToClient];
+    [[BenchmarkHarness sharedHarness] measureOnce: @"Synchronizer regular rebase"
+                                       operations: objectsToInsert - 1
+                                            block: ^() { [transport deliverMessagesToClient]; }];
 
     // Send confirmation to server
     [transport deliverMessagesToServer];
@@ -145,5 +192,163 @@
     UKIntsEqual(0, self.serverMessages.count);
 }
 
-@end
+/**
+ * Rebases many local client revisions, each editing a single child, over a
+ * server branch which received many commits meanwhile.
+ */
+- (void)testManyRevisionsRebasePerformance
+{
+    OrderedGroupNoOpposite *serverGroup = [[OrderedGroupNoOpposite alloc] initWithObjectGraphContext: serverBranch.objectGraphContext];
+    for (NSUInteger i = 0; i < REBASE_CHILDREN; i++)
+    {
+        OrderedGroupNoOpposite *child = [[OrderedGroupNoOpposite alloc] initWithObjectGraphContext: serverBranch.objectGraphContext];
+        [[serverGroup mutableArrayValueForKey: @"contents"] addObject: child];
+    }
+    [(UnorderedGroupNoOpposite *)serverBranch.rootObject setContents: S(serverGroup)];
+    [serverPersistentRoot commit];
+
+    [transport deliverMessagesToClient];
+
+    // several commits on client
+
+    OrderedGroupNoOpposite *clientGroup = [[(UnorderedGroupNoOpposite *)clientBranch.rootObject contents] anyObject];
+    for (NSUInteger i = 0; i < REBASE_CLIENT_COMMITS; i++)
+    {
+        OrderedGroupNoOpposite *child = clientGroup.contents[i % REBASE_CHILDREN];
+        child.label = [NSString stringWithFormat: @"client %d", (int)i];
+        [clientPersistentRoot commit];
+    }
+
+    // several commits on server
+
+    for (NSUInteger i = 0; i < REBASE_SERVER_COMMITS; i++)
+    {
+        OrderedGroupNoOpposite *child = [[OrderedGroupNoOpposite alloc] initWithObjectGraphContext: serverBranch.objectGraphContext];
+        child.label = [NSString stringWithFormat: @"server %d", (int)i];
+        [[serverGroup mutableArrayValueForKey: @"contents"] addObject: child];
+        [serverPersistentRoot commit];
+    }
+
+    // The server rebases the first client commit
+    [transport deliverMessagesToServer];
+
+    // The client rebases its remaining commits onto the server ones
+    [[BenchmarkHarness sharedHarness] measureOnce: @"Synchronizer many revisions rebase"
+                                       operations: REBASE_CLIENT_COMMITS - 1
+                                            block: ^() { [transport deliverMessagesToClient]; }];
+
+    [transport deliverMessagesToServer];
+    [transport deliverMessagesToClient];
+
+    UKIntsEqual(REBASE_CHILDREN + REBASE_SERVER_COMMITS, clientGroup.contents.count);
+    UKIntsEqual(REBASE_CHILDREN + REBASE_SERVER_COMMITS, serverGroup.contents.count);
+    UKObjectsEqual(([NSString stringWithFormat: @"client %d", REBASE_CLIENT_COMMITS - 1]),
+                   [serverGroup.contents[(REBASE_CLIENT_COMMITS - 1) % REBASE_CHILDREN] label]);
+
+    UKIntsEqual(0, self.clientMessages.count);
+    UKIntsEqual(0, self.serverMessages.count);
+}
+
+/**
+ * Returns the messages exchanged while the client commits a child at a time,
+ * and the server acknowledges each commit.
+ */
+- (NSArray *)exchangedMessagesForClientCommits: (NSUInteger)nbOfCommits
+{
+    NSMutableArray *messages = [NSMutableArray new];
+
+    OrderedGroupNoOpposite *serverGroup = [[OrderedGroupNoOpposite alloc] initWithObjectGraphContext: serverBranch.objectGraphContext];
+    [(UnorderedGroupNoOpposite *)serverBranch.rootObject setContents: S(serverGroup)];
+    [serverPersistentRoot commit];
+
+    [transport deliverMessagesToClient];
+
+    OrderedGroupNoOpposite *clientGroup = [[(UnorderedGroupNoOpposite *)clientBranch.rootObject contents] anyObject];
+    for (NSUInteger i = 0; i < nbOfCommits; i++)
+    {
+        OrderedGroupNoOpposite *child = [[OrderedGroupNoOpposite alloc] initWithObjectGraphContext: clientBranch.objectGraphContext];
+        child.label = [NSString stringWithFormat: @"Child number %d of the group", (int)i];
+        [[clientGroup mutableArrayValueForKey: @"contents"] addObject: child];
+        [clientPersistentRoot commit];
+
+        [messages addObjectsFromArray: self.serverMessages];
+        [transport deliverMessagesToServer];
+        [messages addObjectsFromArray: self.clientMessages];
+        [transport deliverMessagesToClient];
+    }
+    UKIntsEqual(nbOfCommits, serverGroup.contents.count);
 
+    return messages;
+}
+
+- (void)testWireFormatPerformance
+{
+    NSArray *messages = [self exchangedMessagesForClientCommits: WIRE_FORMAT_COMMITS];
+    TestSynchronizerWireFormatRecorder *recorder = [TestSynchronizerWireFormatRecorder new];
+    COSynchronizerJSONClient *jsonClient = [COSynchronizerJSONClient new];
+    COSynchronizerJSONServer *jsonServer = [COSynchronizerJSONServer new];
+
+    jsonClient.delegate = recorder;
+    jsonServer.delegate = recorder;
+
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+
+    // JSON
+
+    __block NSUInteger jsonBytes = 0;
+    BenchmarkResult *jsonResult =
+        [harness measure: @"Synchronizer JSON message encoding and decoding"
+              operations: messages.count
+                   block: ^()
+    {
+        jsonBytes = 0;
+        for (id message in messages)
+        {
+            if ([message isKindOfClass: [COSynchronizerPushedRevisionsFromClientMessage class]])
+            {
+                [jsonClient sendPushToServer: message];
+            }
+            else
+            {
+                [jsonServer sendResponseMessage: message toClient: @"client"];
+            }
+            jsonBytes += [recorder->lastText lengthOfBytesUsingEncoding: NSUTF8StringEncoding];
+
+            id plist = [COSynchronizerJSONUtils deserializePropertyList: recorder->lastText];
+            UKNotNil([COSynchronizerJSONUtils revisionsArrayForPropertyList: plist[@"revisions"]]);
+        }
+    }];
+    jsonResult.values[@"bytes"] = @(jsonBytes);
+
+    // Binary
+
+    NSUInteger binaryBytes[2] = {0, 0};
+
+    for (int compressed = 0; compressed < 2; compressed++)
+    {
+        __block NSUInteger bytes = 0;
+        BenchmarkResult *binaryResult =
+            [harness measure: (compressed ? @"Synchronizer compressed binary message encoding and decoding"
+                                          : @"Synchronizer binary message encoding and decoding")
+                  operations: messages.count
+                       block: ^()
+        {
+            bytes = 0;
+            for (id message in messages)
+            {
+                NSData *frame = [COSynchronizerBinaryUtils frameWithMessage: message
+                                                                 compressed: compressed];
+                bytes += frame.length;
+
+                UKNotNil([COSynchronizerBinaryUtils messageWithFrame: frame]);
+            }
+        }];
+        binaryResult.values[@"bytes"] = @(bytes);
+        binaryBytes[compressed] = bytes;
+    }
+
+    UKTrue(binaryBytes[0] < jsonBytes);
+    UKTrue(binaryBytes[1] <= binaryBytes[0]);
+}
+
+@end
@@ -12,6 +12,7 @@
 #import "COEditingContext.h"
 #import "TestCommon.h"
 #import "TestAttributedStringCommon.h"
+#import "BenchmarkHarness.h"
 
 @interface TestAttributedStringDiffPerformance : EditingContextTestCase <UKTest>
 @end
@@ -41,31 +42,33 @@
 
 - (NSTimeInterval)timeToCopyObjectGraph: (COObjectGraphContext *)objectGraph
 {
-    NSDate *start = [NSDate date];
-    COObjectGraphContext *tempObjectGraph = [COObjectGraphContext new];
     COCopierOptions options = COCopierCopiesNonCompositeReferencesMissingInDestination
                             | COCopierCopiesNonCompositeReferencesExistingInDestination;
 
-    (void)[[COCopier new] copyItemWithUUID: objectGraph.rootItemUUID
-                                 fromGraph: objectGraph
-                                   toGraph: tempObjectGraph
-                                   options: options];
+    return [[BenchmarkHarness sharedHarness] measure: @"COCopier 1K chunk attributed string copy"
+                                          operations: 1
+                                               block: ^()
+    {
+        COObjectGraphContext *tempObjectGraph = [COObjectGraphContext new];
 
-    NSTimeInterval time = [[NSDate date] timeIntervalSinceDate: start];
-    return time;
+        (void)[[COCopier new] copyItemWithUUID: objectGraph.rootItemUUID
+                                     fromGraph: objectGraph
+                                       toGraph: tempObjectGraph
+                                       options: options];
+    }].median;
 }
 
 - (NSTimeInterval)timeToDiffAttributedString: (COAttributedString *)as1
                         withAttributedString: (COAttributedString *)as2
 {
-    NSDate *start = [NSDate date];
-
-    (void)[[COAttributedStringDiff alloc] initWithFirstAttributedString: as1
-                                                 secondAttributedString: as2
-                                                                 source: nil];
-
-    NSTimeInterval time = [[NSDate date] timeIntervalSinceDate: start];
-    return time;
+    return [[BenchmarkHarness sharedHarness] measure: @"COAttributedStringDiff 1K chunk diff"
+                                          operations: 1
+                                               block: ^()
+    {
+        (void)[[COAttributedStringDiff alloc] initWithFirstAttributedString: as1
+                                                     secondAttributedString: as2
+                                                                     source: nil];
+    }].median;
 }
 
 - (void)testDiffPerformance
@@ -8,11 +8,20 @@
 #import "TestCommon.h"
 #import "COBinaryReader.h"
 #import "COBinaryWriter.h"
+#import "COContentsBlobWriter.h"
+#import "COSQLiteStorePersistentRootBackingStore.h"
+#import "BenchmarkHarness.h"
 
 #define WRITE_ITERATIONS 10000LL
 
 #define READ_ITERATIONS 10000LL
 
+#define CONTENTS_WRITE_ITERATIONS 100LL
+
+#define REFERENCING_ITEM_COUNT 10000
+#define REFERENCES_PER_ITEM 100
+#define REFERENCED_PERSISTENT_ROOT_COUNT 100
+
 @interface TestBinaryReadWrite : NSObject <UKTest>
 {
     NSMutableArray *readObjects;
@@ -92,8 +101,6 @@ static void test_read_null(void *ctx)
 
 - (void)testBasic
 {
-    NSDate *startDate = [NSDate date];
-
     ETUUID *uuid = [ETUUID UUID];
 
     co_buffer_t buf;
@@ -153,24 +160,23 @@ static void test_read_null(void *ctx)
         test_read_null
     };
 
-    for (NSUInteger i = 0; i < READ_ITERATIONS; i++)
-    {
-        [readObjects removeAllObjects];
-        co_reader_read(co_buffer_get_data(&buf),
-                       co_buffer_get_length(&buf),
-                       (__bridge void *)(self),
-                       cb);
+    const unsigned char *data = co_buffer_get_data(&buf);
+    const size_t length = co_buffer_get_length(&buf);
 
-        if (i == 0)
+    co_reader_read(data, length, (__bridge void *)(self), cb);
+    UKObjectsEqual(expected, readObjects);
+
+    [[BenchmarkHarness sharedHarness] measure: @"co_reader_read"
+                                   operations: READ_ITERATIONS
+                                        block: ^()
+    {
+        for (NSUInteger i = 0; i < READ_ITERATIONS; i++)
         {
-            UKObjectsEqual(expected, readObjects);
+            [readObjects removeAllObjects];
+            co_reader_read(data, length, (__bridge void *)(self), cb);
         }
-    }
+    }];
     co_buffer_free(&buf);
-
-    NSLog(@"reading %lld iterations of the reading test took %lf ms",
-          READ_ITERATIONS,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
 }
 
 
@@ -179,41 +185,182 @@ static volatile char dest[2048];
 - (void)testWritePerf
 {
     ETUUID *uuid = [ETUUID UUID];
-    NSDate *startDate = [NSDate date];
-    int64_t iter = 0;
-    for (int64_t i = 0; i < WRITE_ITERATIONS; i++)
+
+    [[BenchmarkHarness sharedHarness] measure: @"co_buffer write"
+                                   operations: WRITE_ITERATIONS
+                                        block: ^()
+    {
+        for (int64_t i = 0; i < WRITE_ITERATIONS; i++)
+        {
+            co_buffer_t buf;
+            co_buffer_init(&buf);
+            co_buffer_begin_object(&buf);
+            co_buffer_begin_array(&buf);
+            co_buffer_store_integer(&buf, 0);
+            co_buffer_store_integer(&buf, -1);
+            co_buffer_store_integer(&buf, 1);
+            co_buffer_store_integer(&buf, -255);
+            co_buffer_store_integer(&buf, 255);
+            co_buffer_store_integer(&buf, -256);
+            co_buffer_store_integer(&buf, 256);
+            co_buffer_store_integer(&buf, -65535);
+            co_buffer_store_integer(&buf, 65535);
+            co_buffer_store_integer(&buf, -65536);
+            co_buffer_store_integer(&buf, 65536);
+            co_buffer_store_double(&buf, 3.14159);
+            co_buffer_store_string(&buf, @"hello world!");
+            co_buffer_store_uuid(&buf, uuid);
+            co_buffer_end_array(&buf);
+            co_buffer_end_object(&buf);
+
+            memcpy((void *)dest, co_buffer_get_data(&buf), co_buffer_get_length(&buf));
+
+            co_buffer_free(&buf);
+        }
+    }];
+}
+
+- (COItemGraph *)itemGraphWithItemCount: (NSUInteger)count
+{
+    NSMutableArray *items = [NSMutableArray array];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        COMutableItem *item = [COMutableItem item];
+
+        item.entityName = @"OutlineItem";
+        [item setValue: [NSString stringWithFormat: @"item%lu", (unsigned long)i]
+          forAttribute: @"label"
+                  type: kCOTypeString];
+        [item setValue: @(i)
+          forAttribute: @"index"
+                  type: kCOTypeInt64];
+        [item setValue: S(@"red", @"green", @"blue")
+          forAttribute: @"tags"
+                  type: COTypeMakeSetOf(kCOTypeString)];
+        [items addObject: item];
+    }
+    return [[COItemGraph alloc] initWithItems: items rootItemUUID: [items[0] UUID]];
+}
+
+/**
+ * Returns the serialized items of a graph where each item holds
+ * REFERENCES_PER_ITEM references, half of them to other items and half of
+ * them to other persistent roots.
+ */
+- (NSArray *)dataOfItemsWithDenseReferencesWrittenAsStrings: (BOOL)writesPathsAsStrings
+{
+    NSMutableArray *persistentRoots = [NSMutableArray new];
+    NSMutableArray *branches = [NSMutableArray new];
+    NSMutableArray *itemUUIDs = [NSMutableArray new];
+    NSMutableArray *itemData = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < REFERENCED_PERSISTENT_ROOT_COUNT; i++)
     {
-        co_buffer_t buf;
-        co_buffer_init(&buf);
-        co_buffer_begin_object(&buf);
-        co_buffer_begin_array(&buf);
-        co_buffer_store_integer(&buf, 0);
-        co_buffer_store_integer(&buf, -1);
-        co_buffer_store_integer(&buf, 1);
-        co_buffer_store_integer(&buf, -255);
-        co_buffer_store_integer(&buf, 255);
-        co_buffer_store_integer(&buf, -256);
-        co_buffer_store_integer(&buf, 256);
-        co_buffer_store_integer(&buf, -65535);
-        co_buffer_store_integer(&buf, 65535);
-        co_buffer_store_integer(&buf, -65536);
-        co_buffer_store_integer(&buf, 65536);
-        co_buffer_store_double(&buf, 3.14159);
-        co_buffer_store_string(&buf, @"hello world!");
-        co_buffer_store_uuid(&buf, uuid);
-        co_buffer_end_array(&buf);
-        co_buffer_end_object(&buf);
-
-        memcpy((void *)dest, co_buffer_get_data(&buf), co_buffer_get_length(&buf));
-
-        co_buffer_free(&buf);
-
-        iter++;
+        [persistentRoots addObject: [ETUUID UUID]];
+        [branches addObject: [ETUUID UUID]];
     }
+    for (NSUInteger i = 0; i < REFERENCING_ITEM_COUNT; i++)
+    {
+        [itemUUIDs addObject: [ETUUID UUID]];
+    }
+
+    for (NSUInteger i = 0; i < REFERENCING_ITEM_COUNT; i++)
+    {
+        NSMutableArray *paths = [NSMutableArray new];
+        NSMutableArray *references = [NSMutableArray new];
+
+        for (NSUInteger j = 0; j < REFERENCES_PER_ITEM / 2; j++)
+        {
+            const NSUInteger rootIndex = (i + j) % REFERENCED_PERSISTENT_ROOT_COUNT;
+            ETUUID *branch = (j % 2 == 0 ? branches[rootIndex] : nil);
+
+            [paths addObject: [COPath pathWithPersistentRoot: persistentRoots[rootIndex] branch: branch]];
+            [references addObject: itemUUIDs[(i * 31 + j * 7) % REFERENCING_ITEM_COUNT]];
+        }
+
+        COMutableItem *item = [[COMutableItem alloc] initWithUUID: itemUUIDs[i]];
+
+        [item setValue: paths forAttribute: @"paths" type: kCOTypeArray | kCOTypeReference];
+        [item setValue: references forAttribute: @"references" type: kCOTypeArray | kCOTypeReference];
+        [itemData addObject: (writesPathsAsStrings ? item.dataValueWithPathsWrittenAsStrings : item.dataValue)];
+    }
+    return itemData;
+}
+
+- (BenchmarkResult *)measureReadingItemData: (NSArray *)itemData benchmarkName: (NSString *)aName
+{
+    __block NSMutableArray *items = nil;
+
+    BenchmarkResult *result =
+        [[BenchmarkHarness sharedHarness] measure: aName
+                                       operations: REFERENCING_ITEM_COUNT
+                                            setUp: ^()
+    {
+        items = [NSMutableArray new];
+    }
+                                            block: ^()
+    {
+        for (NSData *data in itemData)
+        {
+            [items addObject: [[COItem alloc] initWithData: data]];
+        }
+    }];
+
+    // The retained bytes are the memory kept by the read items
+    result.values[@"referenceCount"] = @(REFERENCING_ITEM_COUNT * REFERENCES_PER_ITEM);
+    result.values[@"bytes"] = [itemData valueForKeyPath: @"@sum.length"];
+    return result;
+}
+
+/**
+ * Compares reading paths written as strings (each one parsed into a new path
+ * and UUIDs) with reading paths written as UUIDs (interned).
+ */
+- (void)testDenseReferencesRead
+{
+    BenchmarkResult *stringResult =
+        [self measureReadingItemData: [self dataOfItemsWithDenseReferencesWrittenAsStrings: YES]
+                       benchmarkName: @"Item read with dense references written as strings"];
+    BenchmarkResult *UUIDResult =
+        [self measureReadingItemData: [self dataOfItemsWithDenseReferencesWrittenAsStrings: NO]
+                       benchmarkName: @"Item read with dense references"];
+
+    NSLog(@"Dense references retain %lld bytes written as strings, %lld bytes written as UUIDs",
+          (long long)stringResult.retainedBytes, (long long)UUIDResult.retainedBytes);
+}
+
+- (void)testContentsBlobWritePerf
+{
+    COItemGraph *graph = [self itemGraphWithItemCount: 1000];
+    COContentsBlobWriter *writer = [COContentsBlobWriter new];
+    const NSUInteger length = [writer contentsBlobWithItemGraph: graph].length;
+
+    ETAssert(length == contentsBLOBWithItemTree(graph).length);
+
+    BenchmarkResult *copying =
+        [[BenchmarkHarness sharedHarness] measure: @"Contents blob write with a new writer"
+                                       operations: CONTENTS_WRITE_ITERATIONS
+                                            block: ^()
+    {
+        for (int64_t i = 0; i < CONTENTS_WRITE_ITERATIONS; i++)
+        {
+            (void)contentsBLOBWithItemTree(graph);
+        }
+    }];
+    BenchmarkResult *reusing =
+        [[BenchmarkHarness sharedHarness] measure: @"Contents blob write with a reused writer"
+                                       operations: CONTENTS_WRITE_ITERATIONS
+                                            block: ^()
+    {
+        for (int64_t i = 0; i < CONTENTS_WRITE_ITERATIONS; i++)
+        {
+            (void)[writer contentsBlobWithItemGraph: graph];
+        }
+    }];
 
-    NSLog(@"writing %lld iterations of the writing test took %lf ms",
-          iter,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+    copying.values[@"bytes"] = @(length);
+    reusing.values[@"bytes"] = @(length);
 }
 
 @end
@@ -6,6 +6,9 @@
  */
 
 #import "TestCommon.h"
+#import "COJSONSerialization.h"
+#import "COUndoCommandBinarySerialization.h"
+#import "BenchmarkHarness.h"
 
 @interface NSString (RandomStringGeneration)
 
@@ -34,6 +37,10 @@
 
 #define NUM_COMMITS 100
 
+#define NUM_RECORDED_COMMANDS 50000
+
+#define NUM_RECORDED_COMMANDS_PER_BATCH 1000
+
 - (NSArray *)commitPersistentRootsWithUndoTrack: (COUndoTrack *)track
                                      entityName: (NSString *)entityName
                                           count: (int)nbOfPersistentRoots
@@ -65,49 +72,71 @@
     [ctx commitWithUndoTrack: track];
 }
 
+/**
+ * Measures going to the oldest node, then back to the newest node, and
+ * returns the times of this first navigation, which has to load the
+ * revisions from the store.
+ *
+ * The median times to go back and forth once the revisions are loaded are
+ * reported separately with a "(warmed)" suffix.
+ */
+- (NSArray *)measureNavigationOnTrack: (COUndoTrack *)track benchmarkName: (NSString *)aName
+{
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    BenchmarkResult *oldestResult =
+        [harness measureOnce: [aName stringByAppendingString: @": go to oldest node"]
+                  operations: 1
+                       block: ^() { [track setCurrentNode: track.nodes.firstObject]; }];
+    BenchmarkResult *newestResult =
+        [harness measureOnce: [aName stringByAppendingString: @": go to newest node"]
+                  operations: 1
+                       block: ^() { [track setCurrentNode: track.nodes.lastObject]; }];
+
+    [harness measure: [aName stringByAppendingString: @": go to oldest node (warmed)"]
+          operations: 1
+               setUp: ^() { [track setCurrentNode: track.nodes.lastObject]; }
+               block: ^() { [track setCurrentNode: track.nodes.firstObject]; }];
+    [harness measure: [aName stringByAppendingString: @": go to newest node (warmed)"]
+          operations: 1
+               setUp: ^() { [track setCurrentNode: track.nodes.firstObject]; }
+               block: ^() { [track setCurrentNode: track.nodes.lastObject]; }];
+
+    return @[@(oldestResult.median), @(newestResult.median)];
+}
+
 - (void)testGoToOldestAndNewestNodesInHistory
 {
     COUndoTrack *track = [COUndoTrack trackForName: @"TestHistoryNavigationPerformance"
                                 withContext: ctx];
 
-    NSDate *startDate = [NSDate date];
-    NSArray *proots = [self commitPersistentRootsWithUndoTrack: track
-                                                    entityName: @"COTag"
-                                                         count: NUM_PERSISTENT_ROOTS];
-
-
-    NSTimeInterval creationTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to commit %d new persistent roots with undo track: %0.2fs",
-          NUM_PERSISTENT_ROOTS,
-          creationTime);
-    startDate = [NSDate date];
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block NSArray *proots = nil;
 
-    for (int session = 0; session < NUM_COMMITS; session++)
+    [harness measureOnce: @"History navigation: persistent root creation with undo track"
+              operations: NUM_PERSISTENT_ROOTS
+                   block: ^()
     {
-        const int prootIndex = rand() % NUM_PERSISTENT_ROOTS;
-        COPersistentRoot *proot = proots[prootIndex];
-
-        [self commitSessionWithPersistentRoot: proot onUndoTrack: track];
-    }
-
-    NSTimeInterval commitTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to make %d commits with undo track: %0.2fs", NUM_COMMITS, commitTime);
-    startDate = [NSDate date];
-
-    [track setCurrentNode: track.nodes.firstObject];
-
-    NSTimeInterval goToFirstNodeTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to go to newest node on undo track: %0.2fs", goToFirstNodeTime);
-    startDate = [NSDate date];
-
-    UKTrue(goToFirstNodeTime < 1.1); // FIXME: 0.5
+        proots = [self commitPersistentRootsWithUndoTrack: track
+                                               entityName: @"COTag"
+                                                    count: NUM_PERSISTENT_ROOTS];
+    }];
+    [harness measureOnce: @"History navigation: commit with undo track"
+              operations: NUM_COMMITS
+                   block: ^()
+    {
+        for (int session = 0; session < NUM_COMMITS; session++)
+        {
+            const int prootIndex = rand() % NUM_PERSISTENT_ROOTS;
+            COPersistentRoot *proot = proots[prootIndex];
 
-    [track setCurrentNode: track.nodes.lastObject];
+            [self commitSessionWithPersistentRoot: proot onUndoTrack: track];
+        }
+    }];
 
-    NSTimeInterval goToLastNodeTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to go to oldest node on undo track: %0.2fs", goToLastNodeTime);
+    NSArray *navigationTimes = [self measureNavigationOnTrack: track benchmarkName: @"History navigation"];
 
-    UKTrue(goToLastNodeTime < 1.0); // FIXME: 0.5
+    UKTrue([navigationTimes[0] doubleValue] < 1.1); // FIXME: 0.5
+    UKTrue([navigationTimes[1] doubleValue] < 1.0); // FIXME: 0.5
 }
 
 - (void)commitDeletionOfPersistentRoots: (NSArray *)prootSlice onUndoTrack: (COUndoTrack *)track
@@ -132,55 +161,58 @@
     COUndoTrack *track = [COUndoTrack trackForName: @"TestHistoryNavigationPerformance"
                                 withContext: ctx];
 
-    NSDate *startDate = [NSDate date];
-    NSArray *proots = [self commitPersistentRootsWithUndoTrack: track
-                                                    entityName: @"COTag"
-                                                         count: BIG_NUM_PERSISTENT_ROOTS];
-
-    NSTimeInterval creationTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to commit %d new persistent roots with undo track: %0.2fs",
-          BIG_NUM_PERSISTENT_ROOTS,
-          creationTime);
-    startDate = [NSDate date];
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block NSArray *proots = nil;
 
-    for (int session = 0; session < NUM_COMMITS; session++)
+    [harness measureOnce: @"Deleted persistent roots reloading: persistent root creation with undo track"
+              operations: BIG_NUM_PERSISTENT_ROOTS
+                   block: ^()
+    {
+        proots = [self commitPersistentRootsWithUndoTrack: track
+                                               entityName: @"COTag"
+                                                    count: BIG_NUM_PERSISTENT_ROOTS];
+    }];
+    [harness measureOnce: @"Deleted persistent roots reloading: deletion commit with undo track"
+              operations: NUM_COMMITS
+                   block: ^()
     {
-        NSUInteger sliceCount = BIG_NUM_PERSISTENT_ROOTS / NUM_COMMITS;
-        NSUInteger splitIndex = proots.count - sliceCount;
-        NSArray *prootSlice = [proots subarrayFromIndex: splitIndex];
+        for (int session = 0; session < NUM_COMMITS; session++)
+        {
+            NSUInteger sliceCount = BIG_NUM_PERSISTENT_ROOTS / NUM_COMMITS;
+            NSUInteger splitIndex = proots.count - sliceCount;
+            NSArray *prootSlice = [proots subarrayFromIndex: splitIndex];
 
-        proots = [proots subarrayWithRange: NSMakeRange(0, splitIndex)];
+            proots = [proots subarrayWithRange: NSMakeRange(0, splitIndex)];
 
-        ETAssert(prootSlice.count == sliceCount);
-        ETAssert(proots.count % sliceCount == 0);
+            ETAssert(prootSlice.count == sliceCount);
+            ETAssert(proots.count % sliceCount == 0);
 
-        [self commitDeletionOfPersistentRoots: prootSlice onUndoTrack: track];
-    }
+            [self commitDeletionOfPersistentRoots: prootSlice onUndoTrack: track];
+        }
+    }];
 
     UKTrue(ctx.loadedPersistentRoots.isEmpty);
 
-    NSTimeInterval commitTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to make %d commits with undo track: %0.2fs", NUM_COMMITS, commitTime);
-
     COEditingContext *ctx2 = [self newContext];
     COUndoTrack *track2 = [COUndoTrack trackForName: @"TestHistoryNavigationPerformance"
                                  withContext: ctx2];
 
     // Destroy the context to prevent it to catch any distributed notifications
     ctx = nil;
-    startDate = [NSDate date];
 
     UKTrue(ctx2.loadedPersistentRoots.isEmpty);
 
-    [track2 setCurrentNode: track2.nodes[1]];
+    // Going to the node a second time would be a no-op, so we measure it once
+    BenchmarkResult *result =
+        [harness measureOnce: @"Deleted persistent roots reloading: go to first commit node"
+                  operations: 1
+                       block: ^()
+    {
+        [track2 setCurrentNode: track2.nodes[1]];
+    }];
 
     UKTrue(ctx2.loadedPersistentRoots.isEmpty);
-
-    NSTimeInterval goToNodeTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to go to first commit node on undo track: %0.2fs", goToNodeTime);
-    startDate = [NSDate date];
-
-    UKTrue(goToNodeTime < 0.5);
+    UKTrue(result.median < 0.5);
 }
 
 - (void)updatePerson: (Person *)person includesNewStudents: (BOOL)includesNewStudents
@@ -236,41 +268,149 @@
     COUndoTrack *track = [COUndoTrack trackForName: @"TestHistoryNavigationPerformance"
                                 withContext: ctx];
 
-    NSDate *startDate = [NSDate date];
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block NSArray *proots = nil;
+
+    [harness measureOnce: @"Many properties history navigation: persistent root creation with undo track"
+              operations: NUM_PERSISTENT_ROOTS
+                   block: ^()
+    {
+        proots = [self commitPersistentRootsWithUndoTrack: track
+                                               entityName: @"Person"
+                                                    count: NUM_PERSISTENT_ROOTS];
+    }];
+    [harness measureOnce: @"Many properties history navigation: commit with undo track"
+              operations: NUM_COMMITS
+                   block: ^()
+    {
+        for (int session = 0; session < NUM_COMMITS; session++)
+        {
+            [self commitSessionWithPersons: proots onUndoTrack: track];
+        }
+    }];
+
+    NSArray *navigationTimes = [self measureNavigationOnTrack: track
+                                                benchmarkName: @"Many properties history navigation"];
+
+    UKTrue([navigationTimes[0] doubleValue] < 3.0); // FIXME: 0.5
+    UKTrue([navigationTimes[1] doubleValue] < 5.0); // FIXME: 0.5
+}
+
+- (void)testRecordCommandLatency
+{
+    COUndoTrack *track = [COUndoTrack trackForName: @"TestRecordCommandLatency"
+                                       withContext: ctx];
+    NSString *benchmarkName = @"COUndoTrack command recording";
+
+    [track clear];
+
+    // Each batch adds a sample, to compare the first and last batches
+    for (int batch = 0; batch < NUM_RECORDED_COMMANDS / NUM_RECORDED_COMMANDS_PER_BATCH; batch++)
+    {
+        [[BenchmarkHarness sharedHarness] measure: benchmarkName
+                                             runs: 1
+                                       warmupRuns: 0
+                                       operations: NUM_RECORDED_COMMANDS_PER_BATCH
+                                            setUp: nil
+                                            block: ^()
+        {
+            for (int i = 0; i < NUM_RECORDED_COMMANDS_PER_BATCH; i++)
+            {
+                [track recordCommand: [COCommandGroup new]];
+            }
+        }];
+    }
+
+    UKIntsEqual(NUM_RECORDED_COMMANDS + 1, track.count);
+
+    BenchmarkResult *result = [[BenchmarkHarness sharedHarness] resultForName: benchmarkName];
+    const double firstBatchLatency = [result.samples.firstObject doubleValue];
+    const double lastBatchLatency = [result.samples.lastObject doubleValue];
+
+    NSLog(@"Per-record latency: %0.3f ms (first %d), %0.3f ms (last %d)",
+          firstBatchLatency * 1000, NUM_RECORDED_COMMANDS_PER_BATCH,
+          lastBatchLatency * 1000, NUM_RECORDED_COMMANDS_PER_BATCH);
+
+    // Recording must not get slower as the track grows
+    UKTrue(lastBatchLatency < firstBatchLatency * 5);
+}
+
+/**
+ * Compares the JSON encoding used by undo track stores up to version 1, and
+ * the binary encoding used now, for the commands recorded on a track.
+ */
+- (void)testCommandEncoding
+{
+    COUndoTrack *track = [COUndoTrack trackForName: @"TestCommandEncoding"
+                                       withContext: ctx];
     NSArray *proots = [self commitPersistentRootsWithUndoTrack: track
                                                     entityName: @"Person"
                                                          count: NUM_PERSISTENT_ROOTS];
 
-
-    const NSTimeInterval creationTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to commit %d new persistent roots with undo track: %0.2fs",
-          NUM_PERSISTENT_ROOTS,
-          creationTime);
-    startDate = [NSDate date];
-
     for (int session = 0; session < NUM_COMMITS; session++)
     {
         [self commitSessionWithPersons: proots onUndoTrack: track];
     }
 
-    const NSTimeInterval commitTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to make %d commits with undo track: %0.2fs", NUM_COMMITS, commitTime);
-    startDate = [NSDate date];
-
-    [track setCurrentNode: track.nodes.firstObject];
+    NSMutableArray *commands = [NSMutableArray new];
 
-    const NSTimeInterval goToFirstNodeTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to go to oldest node on undo track: %0.2fs", goToFirstNodeTime);
-    startDate = [NSDate date];
+    for (ETUUID *uuid in [ctx.undoTrackStore allCommandUUIDsOnTrackWithName: track.name])
+    {
+        [commands addObject: [ctx.undoTrackStore commandForUUID: uuid].JSONData];
+    }
 
-    UKTrue(goToFirstNodeTime < 3.0); // FIXME: 0.5
+    NSArray *encodings = @[@"JSON", @"binary", @"compressed binary"];
+    NSArray *(^encode)(NSUInteger) = ^(NSUInteger encoding)
+    {
+        NSMutableArray *result = [NSMutableArray new];
 
-    [track setCurrentNode: track.nodes.lastObject];
+        for (id command in commands)
+        {
+            [result addObject: (encoding == 0 ? CODataWithJSONObject(command, NULL)
+                                              : COUndoCommandDataWithJSONObject(command, encoding == 2))];
+        }
+        return result;
+    };
 
-    const NSTimeInterval goToLastNodeTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to go to newest node on undo track: %0.2fs", goToLastNodeTime);
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    NSUInteger JSONSize = 0;
 
-    UKTrue(goToLastNodeTime < 5.0); // FIXME: 0.5
+    for (NSUInteger encoding = 0; encoding < encodings.count; encoding++)
+    {
+        __block NSArray *encodedCommands = nil;
+        BenchmarkResult *encodingResult =
+            [harness measure: [NSString stringWithFormat: @"Undo command %@ encoding", encodings[encoding]]
+                  operations: commands.count
+                       block: ^()
+        {
+            encodedCommands = encode(encoding);
+        }];
+        BenchmarkResult *decodingResult =
+            [harness measure: [NSString stringWithFormat: @"Undo command %@ decoding", encodings[encoding]]
+                  operations: commands.count
+                       block: ^()
+        {
+            for (NSData *data in encodedCommands)
+            {
+                (void)(encoding == 0 ? COJSONObjectWithData(data, NULL) : COUndoCommandJSONObjectWithData(data));
+            }
+        }];
+        NSUInteger size = 0;
+
+        for (NSData *data in encodedCommands)
+        {
+            size += data.length;
+        }
+
+        if (encoding == 0)
+        {
+            JSONSize = size;
+        }
+        UKTrue(size <= JSONSize);
+
+        encodingResult.values[@"bytes"] = @(size);
+        decodingResult.values[@"bytes"] = @(size);
+    }
 }
 
 @end
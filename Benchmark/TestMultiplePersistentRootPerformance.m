@@ -1,4 +1,6 @@
 #import "TestCommon.h"
+#import "BenchmarkHarness.h"
+#import "COSharedRevisionCache.h"
 
 @interface TestMultiplePersistentRootPerformance : EditingContextTestCase <UKTest>
 @end
@@ -12,6 +14,8 @@
 
 #define NUM_EDITING_SESSIONS 40
 
+#define NUM_ENUMERATED_PERSISTENT_ROOTS 2000
+
 - (NSArray *)commitPersistentRoots
 {
     NSMutableArray *proots = [NSMutableArray new];
@@ -53,21 +57,99 @@
     }
 }
 
+/**
+ * Measures reading back the current revisions from the database, by emptying
+ * the revision cache before each run.
+ */
+- (void)measureReadBackPersistentRoots: (NSArray *)proots
+                         benchmarkName: (NSString *)aName
+                                 block: (void (^)(void))aBlock
+{
+    [[BenchmarkHarness sharedHarness] measure: aName
+                                   operations: NUM_PERSISTENT_ROOTS
+                                        setUp: ^() { [[proots.firstObject store].revisionCache removeAllRevisions]; }
+                                        block: aBlock];
+}
+
 - (void)testMultiplePersistentRoots
 {
-    NSArray *proots = [self commitPersistentRoots];
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block NSArray *proots = nil;
 
-    [self readBackPersistentRootsBefore: proots];
+    [harness measureOnce: @"Multiple persistent roots: creation"
+              operations: NUM_PERSISTENT_ROOTS
+                   block: ^()
+    {
+        proots = [self commitPersistentRoots];
+    }];
+
+    [self measureReadBackPersistentRoots: proots
+                           benchmarkName: @"Multiple persistent roots: read back initial revisions"
+                                   block: ^() { [self readBackPersistentRootsBefore: proots]; }];
+
+    [harness measureOnce: @"Multiple persistent roots: commit"
+              operations: NUM_EDITING_SESSIONS * NUM_COMMITS_PER_EDITING_SESSION
+                   block: ^()
+    {
+        for (int session = 0; session < NUM_EDITING_SESSIONS; session++)
+        {
+            const int prootIndex = rand() % NUM_PERSISTENT_ROOTS;
+            COPersistentRoot *proot = proots[prootIndex];
+
+            [self commitSessionWithPersistentRoot: proot];
+        }
+    }];
+
+    [self measureReadBackPersistentRoots: proots
+                           benchmarkName: @"Multiple persistent roots: read back edited revisions"
+                                   block: ^() { [self readBackPersistentRootsAfter: proots]; }];
+}
 
-    for (int session = 0; session < NUM_EDITING_SESSIONS; session++)
+- (void)testEnumeratingPersistentRoots
+{
+    for (int i = 0; i < NUM_ENUMERATED_PERSISTENT_ROOTS; i++)
     {
-        const int prootIndex = rand() % NUM_PERSISTENT_ROOTS;
-        COPersistentRoot *proot = proots[prootIndex];
+        COPersistentRoot *proot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+
+        for (int j = 0; j < 10; j++)
+        {
+            OutlineItem *item = [[OutlineItem alloc] initWithObjectGraphContext: proot.objectGraphContext];
+            item.label = [NSString stringWithFormat: @"Item %d", j];
+            [[proot.rootObject mutableArrayValueForKey: @"contents"] addObject: item];
+        }
+    }
+    [ctx commit];
+
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block COEditingContext *ctx2 = nil;
+    __block NSSet *proots = nil;
+
+    [harness measure: @"Persistent root enumeration"
+          operations: NUM_ENUMERATED_PERSISTENT_ROOTS
+               setUp: ^() { ctx2 = [self newContext]; }
+               block: ^() { proots = ctx2.persistentRoots; }];
 
-        [self commitSessionWithPersistentRoot: proot];
+    UKIntsEqual(NUM_ENUMERATED_PERSISTENT_ROOTS, proots.count);
+
+    __block BOOL loaded = YES;
+
+    [harness measure: @"Enumerated persistent root loading"
+          operations: NUM_ENUMERATED_PERSISTENT_ROOTS
+               setUp: ^()
+    {
+        ctx2 = [self newContext];
+        proots = ctx2.persistentRoots;
+        [ctx2.store.revisionCache removeAllRevisions];
     }
+               block: ^()
+    {
+        for (COPersistentRoot *proot in proots)
+        {
+            loaded = loaded && [[proot.rootObject contents] count] == 10;
+        }
+    }];
 
-    [self readBackPersistentRootsAfter: proots];
+    UKTrue(loaded);
 }
 
 @end
@@ -10,6 +10,8 @@
 #import "COEditingContext.h"
 #import "TestCommon.h"
 #import "BenchmarkCommon.h"
+#import "BenchmarkHarness.h"
+#import "COSharedRevisionCache.h"
 
 @interface TestObjectGraphPerformance : EditingContextTestCase <UKTest>
 @end
@@ -53,10 +55,9 @@
     COObjectGraphContext *graph = persistentRoot.objectGraphContext;
     [self make3LevelNestedTreeInContainer: graph.rootObject];
 
-    NSDate *start = [NSDate date];
-    [ctx commit];
-    const NSTimeInterval secondsForFullSave = [[NSDate date] timeIntervalSinceDate: start];
-    return secondsForFullSave;
+    return [[BenchmarkHarness sharedHarness] measureOnce: @"Initial commit of a 1K object tree"
+                                              operations: 1
+                                                   block: ^() { [ctx commit]; }].median;
 }
 
 - (void)makeIncrementalCommitToPersistentRoot: (COPersistentRoot *)persistentRoot
@@ -71,13 +72,15 @@
 
 - (NSTimeInterval)timeToMakeIncrementalCommitToPersistentRoot: (COPersistentRoot *)persistentRoot
 {
-    NSDate *start = [NSDate date];
-    for (int i = 0; i < COMMIT_ITERATIONS; i++)
+    return [[BenchmarkHarness sharedHarness] measure: @"Incremental commit to a 1K object tree"
+                                          operations: COMMIT_ITERATIONS
+                                               block: ^()
     {
-        [self makeIncrementalCommitToPersistentRoot: persistentRoot];
-    }
-    const NSTimeInterval time = [[NSDate date] timeIntervalSinceDate: start] / COMMIT_ITERATIONS;
-    return time;
+        for (int i = 0; i < COMMIT_ITERATIONS; i++)
+        {
+            [self makeIncrementalCommitToPersistentRoot: persistentRoot];
+        }
+    }].median;
 }
 
 - (void)testCommitIsIncremental
@@ -105,19 +108,22 @@
 {
     COPersistentRoot *persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
 
-    NSTimeInterval timeToMakeInitialCommitToPersistentRoot = [self timeToMakeInitialCommitToPersistentRoot: persistentRoot];
+    [self timeToMakeInitialCommitToPersistentRoot: persistentRoot];
 
-    NSDate *start = [NSDate date];
-    COEditingContext *ctx2 = [COEditingContext contextWithURL: persistentRoot.store.URL];
-    COPersistentRoot *ctx2PersistentRoot = [ctx2 persistentRootForUUID: persistentRoot.UUID];
-    NSArray *contents = [ctx2PersistentRoot.rootObject contents];
-    const NSTimeInterval time = [[NSDate date] timeIntervalSinceDate: start];
+    __block NSArray *contents = nil;
 
-    NSLog(@"Took %f ms to commit %d objects",
-          timeToMakeInitialCommitToPersistentRoot * MS_PER_SECOND,
-          (int)persistentRoot.objectGraphContext.itemUUIDs.count);
+    [[BenchmarkHarness sharedHarness] measure: @"Load of a 1K object tree in a new editing context"
+                                   operations: 1
+                                        setUp: ^() { [persistentRoot.store.revisionCache removeAllRevisions]; }
+                                        block: ^()
+    {
+        COEditingContext *ctx2 = [COEditingContext contextWithURL: persistentRoot.store.URL];
+        COPersistentRoot *ctx2PersistentRoot = [ctx2 persistentRootForUUID: persistentRoot.UUID];
+
+        contents = [ctx2PersistentRoot.rootObject contents];
+    }];
 
-    NSLog(@"Took %f ms to load back objects. Top level objects: %@", time, contents);
+    UKIntsEqual(10, contents.count);
 }
 
 @end
@@ -9,6 +9,7 @@
 #import <UnitKit/UnitKit.h>
 #import "COEditingContext.h"
 #import "TestCommon.h"
+#import "BenchmarkHarness.h"
 
 #define CREATION_ITERATIONS 1000
 
@@ -95,43 +96,55 @@
     coreobjectParent.contents = @[coreobjectChild1, coreobjectChild2, coreobjectChild3];
 }
 
-#pragma mark - macros
-
-#define TIME_METHOD(name, iterations, expression) \
-- (NSTimeInterval) name \
-{ \
-    NSDate *start = [NSDate date]; \
-    for (int i=0; i<(iterations); i++) \
-    { \
-        expression; \
-    } \
-    return [[NSDate date] timeIntervalSinceDate: start] / iterations; \
-}
+#pragma mark - measuring
 
-#define TIME_METHOD_WITH_EXPECTED_RESULT(name, iterations, expression, expected) \
-- (NSTimeInterval) name \
-{ \
-    NSDate *start = [NSDate date]; \
-    id result = nil; \
-    for (int i=0; i<(iterations); i++) \
-    { \
-        result = (expression); \
-    } \
-    NSTimeInterval time = [[NSDate date] timeIntervalSinceDate: start] / iterations; \
-    ETAssert([(expected) isEqual: result]); \
-    return time; \
+/**
+ * Measures the block run the given number of times, and returns the median
+ * time per iteration.
+ */
+static NSTimeInterval MeasureIterations(NSString *aName, NSUInteger iterations, void (^aBlock)(void))
+{
+    return [[BenchmarkHarness sharedHarness] measure: aName
+                                          operations: iterations
+                                               block: ^()
+    {
+        for (NSUInteger i = 0; i < iterations; i++)
+        {
+            aBlock();
+        }
+    }].median;
 }
 
-#pragma mark - object graph access
+/**
+ * Same as MeasureIterations(), but asserts the last value returned by the
+ * block is equal to the expected one.
+ */
+static NSTimeInterval MeasureIterationsWithExpectedResult(NSString *aName,
+                                                          NSUInteger iterations,
+                                                          id (^aBlock)(void),
+                                                          id expected)
+{
+    __block id result = nil;
+    const NSTimeInterval time = MeasureIterations(aName, iterations, ^() { result = aBlock(); });
 
-TIME_METHOD(timeToCreateFoundationObjectGraph, CREATION_ITERATIONS, [self createFoundationObjects]);
+    ETAssert([expected isEqual: result]);
+    return time;
+}
 
-TIME_METHOD(timeToCreateCoreObjectGraph, CREATION_ITERATIONS, [self createCoreObjects]);
+#pragma mark - object graph access
 
 - (void)testObjectGraphCreationPerformance
 {
-    NSTimeInterval timeToCreateFoundationObjectGraph = [self timeToCreateFoundationObjectGraph];
-    NSTimeInterval timeToCreateCoreObjectGraph = [self timeToCreateCoreObjectGraph];
+    NSTimeInterval timeToCreateFoundationObjectGraph =
+        MeasureIterations(@"Foundation object graph creation", CREATION_ITERATIONS, ^()
+    {
+        [self createFoundationObjects];
+    });
+    NSTimeInterval timeToCreateCoreObjectGraph =
+        MeasureIterations(@"CoreObject object graph creation", CREATION_ITERATIONS, ^()
+    {
+        [self createCoreObjects];
+    });
 
     const double coreObjectTimesWorse = timeToCreateCoreObjectGraph / timeToCreateFoundationObjectGraph;
 
@@ -143,20 +156,18 @@ TIME_METHOD(timeToCreateCoreObjectGraph, CREATION_ITERATIONS, [self createCoreOb
 
 #pragma mark - string property access
 
-TIME_METHOD_WITH_EXPECTED_RESULT(timeToAccessFoundationObjectStringProperty,
-                                 ACCESS_ITERATIONS,
-                                 foundationParent.stringProperty,
-                                 @"parent")
-
-TIME_METHOD_WITH_EXPECTED_RESULT(timeToAccessCoreObjectStringProperty,
-                                 ACCESS_ITERATIONS,
-                                 coreobjectParent.label,
-                                 @"parent")
-
 - (void)testStringPropertyAccess
 {
-    NSTimeInterval timeToAccessFoundationObjectStringProperty = [self timeToAccessFoundationObjectStringProperty];
-    NSTimeInterval timeToAccessCoreObjectStringProperty = [self timeToAccessCoreObjectStringProperty];
+    NSTimeInterval timeToAccessFoundationObjectStringProperty =
+        MeasureIterationsWithExpectedResult(@"Foundation object string property access", ACCESS_ITERATIONS, ^()
+    {
+        return (id)foundationParent.stringProperty;
+    }, @"parent");
+    NSTimeInterval timeToAccessCoreObjectStringProperty =
+        MeasureIterationsWithExpectedResult(@"CoreObject object string property access", ACCESS_ITERATIONS, ^()
+    {
+        return (id)coreobjectParent.label;
+    }, @"parent");
 
     const double coreObjectTimesWorse = timeToAccessCoreObjectStringProperty / timeToAccessFoundationObjectStringProperty;
 
@@ -168,20 +179,18 @@ TIME_METHOD_WITH_EXPECTED_RESULT(timeToAccessCoreObjectStringProperty,
 
 #pragma mark - ordered relationship access
 
-TIME_METHOD_WITH_EXPECTED_RESULT(timeToAccessFoundationObjectOrderedRelationship,
-                                 ACCESS_ITERATIONS,
-                                 foundationParent.arrayProperty,
-                                 A(foundationChild1, foundationChild2, foundationChild3))
-
-TIME_METHOD_WITH_EXPECTED_RESULT(timeToAccessCoreObjectOrderedRelationship,
-                                 ACCESS_ITERATIONS,
-                                 coreobjectParent.contents,
-                                 A(coreobjectChild1, coreobjectChild2, coreobjectChild3))
-
 - (void)testOrderedRelationshipAccess
 {
-    NSTimeInterval timeToAccessFoundationObjectOrderedRelationship = [self timeToAccessFoundationObjectOrderedRelationship];
-    NSTimeInterval timeToAccessCoreObjectOrderedRelationship = [self timeToAccessCoreObjectOrderedRelationship];
+    NSTimeInterval timeToAccessFoundationObjectOrderedRelationship =
+        MeasureIterationsWithExpectedResult(@"Foundation object ordered relationship access", ACCESS_ITERATIONS, ^()
+    {
+        return (id)foundationParent.arrayProperty;
+    }, A(foundationChild1, foundationChild2, foundationChild3));
+    NSTimeInterval timeToAccessCoreObjectOrderedRelationship =
+        MeasureIterationsWithExpectedResult(@"CoreObject object ordered relationship access", ACCESS_ITERATIONS, ^()
+    {
+        return (id)coreobjectParent.contents;
+    }, A(coreobjectChild1, coreobjectChild2, coreobjectChild3));
 
     const double coreObjectTimesWorse = timeToAccessCoreObjectOrderedRelationship / timeToAccessFoundationObjectOrderedRelationship;
 
@@ -213,18 +222,18 @@ TIME_METHOD_WITH_EXPECTED_RESULT(timeToAccessCoreObjectOrderedRelationship,
     [coreobjectParent addObject: coreobjectChild3];
 }
 
-TIME_METHOD(timeToModifyFoundationObjectOrderedRelationship,
-            MODIFICATION_ITERATIONS,
-            [self modifyFoundationRelationship]);
-
-TIME_METHOD(timeToModifyCoreObjectOrderedRelationship,
-            MODIFICATION_ITERATIONS,
-            [self modifyCoreObjectRelationship]);
-
 - (void)testOrderedRelationshipModification
 {
-    NSTimeInterval timeToModifyFoundationObjectOrderedRelationship = [self timeToModifyFoundationObjectOrderedRelationship];
-    NSTimeInterval timeToModifyCoreObjectOrderedRelationship = [self timeToModifyCoreObjectOrderedRelationship];
+    NSTimeInterval timeToModifyFoundationObjectOrderedRelationship =
+        MeasureIterations(@"Foundation object ordered relationship modification", MODIFICATION_ITERATIONS, ^()
+    {
+        [self modifyFoundationRelationship];
+    });
+    NSTimeInterval timeToModifyCoreObjectOrderedRelationship =
+        MeasureIterations(@"CoreObject object ordered relationship modification", MODIFICATION_ITERATIONS, ^()
+    {
+        [self modifyCoreObjectRelationship];
+    });
 
     UKObjectsEqual(A(coreobjectChild1, coreobjectChild2, coreobjectChild3),
                    coreobjectParent.contents);
@@ -241,53 +250,6 @@ TIME_METHOD(timeToModifyCoreObjectOrderedRelationship,
 
 @end
 
-@implementation TestCase (Timing)
-
-#pragma mark - Timing Methods
-
-// TODO: Timing infrastructure earlier in the file, using macros, looks awful.
-// Convert to use this.
-- (NSTimeInterval)timeBlock: (void (^)(void))aBlock iterations: (NSUInteger)iterations
-{
-    NSDate *start = [NSDate date];
-    for (NSUInteger i = 0; i < iterations; i++)
-    {
-        aBlock();
-    }
-    NSTimeInterval time = [[NSDate date] timeIntervalSinceDate: start] / iterations;
-    return time;
-}
-
-static const int DEFAULT_ITERATIONS = 1000;
-
-static NSString *FormatTimeInterval(NSTimeInterval s)
-{
-    const double us = s * US_PER_SECOND;
-    const double ms = s * 1000.0;
-    if (ms > 1000)
-        return [NSString stringWithFormat: @"%f s", s];
-    else if (us > 1000)
-        return [NSString stringWithFormat: @"%f ms", ms];
-    else
-        return [NSString stringWithFormat: @"%f us", us];
-}
-
-- (void)timeBlock: (void (^)(void))aBlock
-       iterations: (NSUInteger)iterations
-          message: (NSString *)message
-{
-    const NSTimeInterval time = [self timeBlock: aBlock iterations: iterations];
-    NSLog(@"%@ per iteration for '%@'", FormatTimeInterval(time), message);
-}
-
-
-- (void)timeBlock: (void (^)(void))aBlock message: (NSString *)message
-{
-    [self timeBlock: aBlock iterations: DEFAULT_ITERATIONS message: message];
-}
-
-@end
-
 #pragma mark - Test large relationships
 
 @interface TestLargeOrderedRelationsip : TestCase <UKTest>
@@ -299,92 +261,114 @@ static NSString *FormatTimeInterval(NSTimeInterval s)
 
 @implementation TestLargeOrderedRelationsip
 
+static const int LARGE_RELATIONSHIP_SIZE = 1000;
+
+static const int DEFAULT_ITERATIONS = 1000;
+
 - (instancetype)init
 {
     SUPERINIT;
+    [self resetParent];
+    return self;
+}
+
+- (void)resetParent
+{
     objectGraphContext = [COObjectGraphContext new];
     coreobjectParent = [[OutlineItem alloc] initWithObjectGraphContext: objectGraphContext];
-    return self;
 }
 
-static const int LARGE_RELATIONSHIP_SIZE = 1000;
+- (NSMutableArray *)makeItems
+{
+    NSMutableArray *items = [NSMutableArray new];
+
+    for (int i = 0; i < LARGE_RELATIONSHIP_SIZE; i++)
+    {
+        OutlineItem *child = [[OutlineItem alloc] initWithObjectGraphContext: objectGraphContext];
+        child.label = [NSString stringWithFormat: @"%d", i];
+        [items addObject: child];
+    }
+    return items;
+}
 
 // 2015-09-04: Typewriter performance is getting unusably slow on small documents
 
 - (void)testCreateLargeOrderedRelationsip
 {
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block NSMutableArray *items = nil;
+
     // compare speed of COObject's -addObject: with NSMutableArray's
-    NSMutableArray *items = [NSMutableArray new];
-    __block int i = 0;
-    [self timeBlock: ^(void)
-                     {
-                         OutlineItem *child = [[OutlineItem alloc] initWithObjectGraphContext: objectGraphContext];
-                         child.label = [NSString stringWithFormat: @"%d", i++];
-                         [items addObject: child];
-                     }
-         iterations: LARGE_RELATIONSHIP_SIZE
-            message: @"Create OutlineItem and add to an NSMutableArray with -addObject:"];
+    [harness measure: @"Create OutlineItem and add to an NSMutableArray with -addObject:"
+          operations: LARGE_RELATIONSHIP_SIZE
+               setUp: ^() { [self resetParent]; }
+               block: ^() { items = [self makeItems]; }];
 
     // compare speed of COObject's -addObject: with NSMutableArray's
-    i = 0;
-    [self timeBlock: ^(void)
-                     {
-                         OutlineItem *child = items[i++];
-                         [coreobjectParent addObject: child];
-                     }
-         iterations: LARGE_RELATIONSHIP_SIZE
-            message: @"Add OutlineItem to an OutlineItem with -addObject:"];
-
-    NSMutableArray *nsmutablearray = [NSMutableArray new];
-    i = 0;
-    [self timeBlock: ^(void)
-                     {
-                         OutlineItem *child = items[i++];
-                         [nsmutablearray addObject: child];
-                     }
-         iterations: LARGE_RELATIONSHIP_SIZE
-            message: @"Add OutlineItem to an NSMutableArray with -addObject:"];
+    [harness measure: @"Add OutlineItem to an OutlineItem with -addObject:"
+          operations: LARGE_RELATIONSHIP_SIZE
+               setUp: ^()
+    {
+        [self resetParent];
+        items = [self makeItems];
+    }
+               block: ^()
+    {
+        for (OutlineItem *child in items)
+        {
+            [coreobjectParent addObject: child];
+        }
+    }];
+
+    [harness measure: @"Add OutlineItem to an NSMutableArray with -addObject:"
+          operations: LARGE_RELATIONSHIP_SIZE
+               block: ^()
+    {
+        NSMutableArray *nsmutablearray = [NSMutableArray new];
+
+        for (OutlineItem *child in items)
+        {
+            [nsmutablearray addObject: child];
+        }
+    }];
 
     // test -count
 
     NSArray *parentContentsArray = coreobjectParent.contents;
+    NSArray *parentContentsArrayCopy = [NSArray arrayWithArray: coreobjectParent.contents];
     __unused __block NSUInteger count = 0;
-    [self timeBlock: ^(void)
-                     {
-                         count += parentContentsArray.count;
-                     }
-            message: [NSString stringWithFormat: @"-count on CoreObject array with %d elements",
-                                                 LARGE_RELATIONSHIP_SIZE]];
 
-    NSArray *parentContentsArrayCopy = [NSArray arrayWithArray: coreobjectParent.contents];
-    [self timeBlock: ^(void)
-                     {
-                         count += parentContentsArrayCopy.count;
-                     }
-            message: [NSString stringWithFormat: @"-count on NSArray with %d elements",
-                                                 LARGE_RELATIONSHIP_SIZE]];
+    UKIntsEqual(LARGE_RELATIONSHIP_SIZE, parentContentsArray.count);
+
+    MeasureIterations([NSString stringWithFormat: @"-count on CoreObject array with %d elements",
+                                                  LARGE_RELATIONSHIP_SIZE], DEFAULT_ITERATIONS, ^()
+    {
+        count += parentContentsArray.count;
+    });
+    MeasureIterations([NSString stringWithFormat: @"-count on NSArray with %d elements",
+                                                  LARGE_RELATIONSHIP_SIZE], DEFAULT_ITERATIONS, ^()
+    {
+        count += parentContentsArrayCopy.count;
+    });
 
     // test for/in loop
 
-    [self timeBlock: ^(void)
-                     {
-                         for (OutlineItem *child in parentContentsArray)
-                         {
-                             count += (intptr_t)(child);
-                         }
-                     }
-            message: [NSString stringWithFormat: @"for/in loop on CoreObject array with %d elements",
-                                                 LARGE_RELATIONSHIP_SIZE]];
-
-    [self timeBlock: ^(void)
-                     {
-                         for (OutlineItem *child in parentContentsArrayCopy)
-                         {
-                             count += (intptr_t)(child);
-                         }
-                     }
-            message: [NSString stringWithFormat: @"for/in loop on NSArray with %d elements",
-                                                 LARGE_RELATIONSHIP_SIZE]];
+    MeasureIterations([NSString stringWithFormat: @"for/in loop on CoreObject array with %d elements",
+                                                  LARGE_RELATIONSHIP_SIZE], DEFAULT_ITERATIONS, ^()
+    {
+        for (OutlineItem *child in parentContentsArray)
+        {
+            count += (intptr_t)(child);
+        }
+    });
+    MeasureIterations([NSString stringWithFormat: @"for/in loop on NSArray with %d elements",
+                                                  LARGE_RELATIONSHIP_SIZE], DEFAULT_ITERATIONS, ^()
+    {
+        for (OutlineItem *child in parentContentsArrayCopy)
+        {
+            count += (intptr_t)(child);
+        }
+    });
 }
 
 @end
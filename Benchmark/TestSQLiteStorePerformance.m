@@ -6,6 +6,18 @@
  */
 
 #import "TestCommon.h"
+#import "COSQLiteStorePersistentRootBackingStore.h"
+#import "FMDatabaseAdditions.h"
+#import "COSharedRevisionCache.h"
+#import "BenchmarkHarness.h"
+
+@interface COSQLiteStorePersistentRootBackingStore (Private)
+
+- (NSString *)tableName;
+- (NSString *)blobTableName;
+
+@end
+
 
 @interface TestSQLiteStorePerformance : SQLiteStoreTestCase <UKTest>
 {
@@ -30,6 +42,10 @@ static const int NUM_PERSISTENT_ROOT_COPIES = 200;
 
 static const int LOTS_OF_EMBEDDED_ITEMS = 10000;
 
+static const int LARGE_BLOB_LENGTH = 1024 * 1024;
+static const int LARGE_BLOB_COMMITS = 100;
+static const int LARGE_BLOB_DELTA_RUN = 10;
+
 static ETUUID *rootUUID;
 static ETUUID *childUUIDs[NUM_CHILDREN];
 
@@ -104,8 +120,23 @@ static int itemChangedAtCommit(int i)
 - (ETUUID *)makeDemoPersistentRoot
 {
     revisionUUIDs = [NSMutableArray array];
-    NSDate *startDate = [NSDate date];
+    __block ETUUID *prootUUID = nil;
+
+    [[BenchmarkHarness sharedHarness] measureOnce: @"Demo persistent root commit"
+                                       operations: NUM_COMMITS
+                                            block: ^()
+    {
+        prootUUID = [self commitDemoPersistentRoot];
+    }];
+    return prootUUID;
+}
 
+/**
+ * Commits a NUM_CHILDREN-item persistent root, then NUM_COMMITS commits which
+ * touch 1 item each.
+ */
+- (ETUUID *)commitDemoPersistentRoot
+{
     COItemGraph *initialTree = [self makeInitialItemTree];
 
     // Commit them to a persistet root
@@ -162,9 +193,6 @@ static int itemChangedAtCommit(int i)
 
     UKTrue([store commitStoreTransaction: txn]);
 
-    NSLog(@"committing a %d-item persistent root and then making %d commits which touched 1 item each took %lf ms",
-          NUM_CHILDREN, NUM_COMMITS, 1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
-
 //    for (int i=0; i<NUM_CHILDREN; i++)
 //    {
 //        NSLog(@"label: %@", [self labelForCommit: NUM_COMMITS - 1
@@ -209,84 +237,81 @@ static int itemChangedAtCommit(int i)
 - (void)testReadDelta
 {
     ETUUID *prootUUID = [self makeDemoPersistentRoot];
-
-    NSDate *startDate = [NSDate date];
-
     COPersistentRootInfo *proot = [store persistentRootInfoForUUID: prootUUID];
 
-    ETUUID *lastCommitId = proot.currentBranchInfo.currentRevisionUUID;
-
-    // Now traverse them in reverse order and test that the items are as expected.
-    // There are NUM_CHILDREN + 1 commits (the initial one made by creating the persistent roots)
-
-    for (int rev = NUM_COMMITS - 1; rev >= 1; rev--)
+    [[BenchmarkHarness sharedHarness] measure: @"Delta read"
+                                   operations: NUM_COMMITS - 1
+                                        setUp: ^() { [store.revisionCache removeAllRevisions]; }
+                                        block: ^()
     {
-        ETUUID *parentCommitId = [store revisionInfoForRevisionUUID: lastCommitId
-                                                 persistentRootUUID: prootUUID].parentRevisionUUID;
+        ETUUID *lastCommitId = proot.currentBranchInfo.currentRevisionUUID;
 
-        COItemGraph *tree = [store partialItemGraphFromRevisionUUID: parentCommitId
-                                                     toRevisionUUID: lastCommitId
-                                                     persistentRoot: prootUUID];
+        // Now traverse them in reverse order and test that the items are as expected.
+        // There are NUM_CHILDREN + 1 commits (the initial one made by creating the persistent roots)
 
-        int i = itemChangedAtCommit(rev);
-        COItem *item = [tree itemForUUID: childUUIDs[i]];
+        for (int rev = NUM_COMMITS - 1; rev >= 1; rev--)
+        {
+            ETUUID *parentCommitId = [store revisionInfoForRevisionUUID: lastCommitId
+                                                     persistentRootUUID: prootUUID].parentRevisionUUID;
 
-        NSString *expectedLabel = [self labelForCommit: rev child: i];
+            COItemGraph *tree = [store partialItemGraphFromRevisionUUID: parentCommitId
+                                                         toRevisionUUID: lastCommitId
+                                                         persistentRoot: prootUUID];
 
-        UKObjectsEqual(expectedLabel,
-                       [item valueForAttribute: @"name"]);
+            int i = itemChangedAtCommit(rev);
+            COItem *item = [tree itemForUUID: childUUIDs[i]];
 
-        // Step back one revision
+            NSString *expectedLabel = [self labelForCommit: rev child: i];
 
-        lastCommitId = parentCommitId;
-    }
+            UKObjectsEqual(expectedLabel,
+                           [item valueForAttribute: @"name"]);
+
+            // Step back one revision
 
-    NSLog(@"reading back %d deltas which touched 1 item each of a %d-item persistent root took %lf ms",
-          NUM_COMMITS, NUM_CHILDREN, 1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+            lastCommitId = parentCommitId;
+        }
+    }];
 }
 
 - (void)testReloadFullStates
 {
     ETUUID *prootUUID = [self makeDemoPersistentRoot];
-
-    NSDate *startDate = [NSDate date];
-
     COPersistentRootInfo *proot = [store persistentRootInfoForUUID: prootUUID];
 
-    ETUUID *lastCommitId = proot.currentBranchInfo.currentRevisionUUID;
-
-    for (int rev = NUM_COMMITS - 1; rev >= 0; rev--)
+    [[BenchmarkHarness sharedHarness] measure: @"Full snapshot reload"
+                                   operations: NUM_COMMITS
+                                        setUp: ^() { [store.revisionCache removeAllRevisions]; }
+                                        block: ^()
     {
-        COItemGraph *tree = [store itemGraphForRevisionUUID: lastCommitId
-                                             persistentRoot: prootUUID];
-
-        // Check the state
-        UKObjectsEqual(rootUUID, tree.rootItemUUID);
+        ETUUID *lastCommitId = proot.currentBranchInfo.currentRevisionUUID;
 
-        for (int i = 0; i < NUM_CHILDREN; i++)
+        for (int rev = NUM_COMMITS - 1; rev >= 0; rev--)
         {
-            // on rev=NUM_CHILDREN, child[NUM_CHILDREN - 1]'s name was changed
+            COItemGraph *tree = [store itemGraphForRevisionUUID: lastCommitId
+                                                 persistentRoot: prootUUID];
 
-            NSString *expectedLabel = [self labelForCommit: rev child: i];
+            // Check the state
+            UKObjectsEqual(rootUUID, tree.rootItemUUID);
 
-            // TODO: Should be UKObjectsEqual - UnitKit has performance problems
-            // cause by generating output messages that are never displayed
+            for (int i = 0; i < NUM_CHILDREN; i++)
+            {
+                // on rev=NUM_CHILDREN, child[NUM_CHILDREN - 1]'s name was changed
 
-            assert([expectedLabel isEqualToString:
-                [[tree itemForUUID: childUUIDs[i]] valueForAttribute: @"name"]]);
-        }
+                NSString *expectedLabel = [self labelForCommit: rev child: i];
 
-        // Step back one revision
+                // TODO: Should be UKObjectsEqual - UnitKit has performance problems
+                // cause by generating output messages that are never displayed
 
-        lastCommitId = [store revisionInfoForRevisionUUID: lastCommitId
-                                       persistentRootUUID: prootUUID].parentRevisionUUID;
-    }
+                assert([expectedLabel isEqualToString:
+                    [[tree itemForUUID: childUUIDs[i]] valueForAttribute: @"name"]]);
+            }
 
-    NSLog(@"reading back %d full snapshots of a %d-item persistent root took %lf ms",
-          MIN(25, NUM_COMMITS),
-          NUM_CHILDREN,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+            // Step back one revision
 
+            lastCommitId = [store revisionInfoForRevisionUUID: lastCommitId
+                                           persistentRootUUID: prootUUID].parentRevisionUUID;
+        }
+    }];
 }
 
 - (void)testFTS
@@ -296,12 +321,15 @@ static int itemChangedAtCommit(int i)
 
     const int itemIndex = itemChangedAtCommit(32);
 
-    NSDate *startDate = [NSDate date];
+    __block NSArray *results = nil;
 
-    NSArray *results = [store searchResultsForQuery: [NSString stringWithFormat: @"\"modified %d in commit 32\"",
-                                                                                 itemIndex]];
-
-    NSLog(@"FTS took %lf ms", 1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+    [[BenchmarkHarness sharedHarness] measure: @"FTS query"
+                                   operations: 1
+                                        block: ^()
+    {
+        results = [store searchResultsForQuery: [NSString stringWithFormat: @"\"modified %d in commit 32\"",
+                                                                            itemIndex]];
+    }];
 
     UKTrue(results.count == 1);
     if (results.count == 1)
@@ -316,86 +344,216 @@ static int itemChangedAtCommit(int i)
 {
     COItemGraph *it = [self makeItemTreeWithChildCount: NUM_CHILDREN_PER_PERSISTENT_ROOT];
 
-    NSDate *startDate = [NSDate date];
+    [[BenchmarkHarness sharedHarness] measureOnce: @"Persistent root creation"
+                                       operations: NUM_PERSISTENT_ROOTS
+                                            block: ^()
+    {
+        COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+        for (int i = 0; i < NUM_PERSISTENT_ROOTS; i++)
+        {
+            [txn createPersistentRootWithInitialItemGraph: it
+                                                     UUID: [ETUUID UUID]
+                                               branchUUID: [ETUUID UUID]
+                                         revisionMetadata: nil
+                                            schemaVersion: 0];
+        }
+        UKTrue([store commitStoreTransaction: txn]);
+    }];
+}
 
-    COStoreTransaction *txn = [[COStoreTransaction alloc] init];
-    for (int i = 0; i < NUM_PERSISTENT_ROOTS; i++)
+- (void)testLotsOfPersistentRootCopies
+{
+    [[BenchmarkHarness sharedHarness] measureOnce: @"Persistent root copy creation"
+                                       operations: NUM_PERSISTENT_ROOT_COPIES
+                                            block: ^()
     {
-        [txn createPersistentRootWithInitialItemGraph: it
-                                                 UUID: [ETUUID UUID]
-                                           branchUUID: [ETUUID UUID]
-                                     revisionMetadata: nil
-                                        schemaVersion: 0];
-    }
-    UKTrue([store commitStoreTransaction: txn]);
+        COItemGraph *it = [self makeItemTreeWithChildCount: NUM_CHILDREN_PER_PERSISTENT_ROOT];
+
+        COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+        COPersistentRootInfo *proot = [txn createPersistentRootWithInitialItemGraph: it
+                                                                               UUID: [ETUUID UUID]
+                                                                         branchUUID: [ETUUID UUID]
+                                                                   revisionMetadata: nil
+                                                                      schemaVersion: 0];
 
-    NSLog(@"creating %d persistent roots each containing a %d-item tree took %lf ms",
-          NUM_PERSISTENT_ROOTS,
-          NUM_CHILDREN_PER_PERSISTENT_ROOT,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+        for (int i = 0; i < NUM_PERSISTENT_ROOT_COPIES; i++)
+        {
+            [txn createPersistentRootCopyWithUUID: [ETUUID UUID]
+                         parentPersistentRootUUID: proot.UUID
+                                       branchUUID: [ETUUID UUID]
+                                 parentBranchUUID: nil
+                              initialRevisionUUID: proot.currentBranchInfo.currentRevisionUUID];
+        }
+        UKTrue([store commitStoreTransaction: txn]);
+    }];
 }
 
-- (void)testLotsOfPersistentRootCopies
+- (void)testMakeBigItemTree
 {
-    NSDate *startDate = [NSDate date];
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
 
-    COItemGraph *it = [self makeItemTreeWithChildCount: NUM_CHILDREN_PER_PERSISTENT_ROOT];
+    // 1. create in-memory tree
+
+    __block COItemGraph *it = nil;
+
+    [harness measure: @"Big item tree creation"
+          operations: LOTS_OF_EMBEDDED_ITEMS
+               block: ^()
+    {
+        it = [self makeItemTreeWithChildCount: LOTS_OF_EMBEDDED_ITEMS];
+    }];
+
+    // 2. commit it
+
+    __block COPersistentRootInfo *proot = nil;
+
+    [harness measureOnce: @"Big item tree commit"
+              operations: LOTS_OF_EMBEDDED_ITEMS
+                   block: ^()
+    {
+        COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+        proot = [txn createPersistentRootWithInitialItemGraph: it
+                                                         UUID: [ETUUID UUID]
+                                                   branchUUID: [ETUUID UUID]
+                                             revisionMetadata: nil
+                                                schemaVersion: 0];
+        UKTrue([store commitStoreTransaction: txn]);
+    }];
+
+    // 3. read it back
+
+    __block COItemGraph *readBack = nil;
+
+    [harness measure: @"Big item tree read"
+          operations: LOTS_OF_EMBEDDED_ITEMS
+               setUp: ^() { [store.revisionCache removeAllRevisions]; }
+               block: ^()
+    {
+        readBack = [self currentItemGraphForPersistentRoot: proot.UUID];
+    }];
+
+    UKIntsEqual(LOTS_OF_EMBEDDED_ITEMS + 1, readBack.itemUUIDs.count);
+}
+
+/**
+ * Commits LARGE_BLOB_COMMITS revisions touching the name of a root item, which
+ * also holds a large blob, and returns the persistent root UUID.
+ *
+ * A full snapshot is written every LARGE_BLOB_DELTA_RUN revisions.
+ */
+- (ETUUID *)makePersistentRootWithLargeBlob: (NSData *)blob
+{
+    COMutableItem *rootItem = [COMutableItem item];
+    [rootItem setValue: @"root" forAttribute: @"name" type: kCOTypeString];
+    [rootItem setValue: blob forAttribute: @"blob" type: kCOTypeBlob];
 
     COStoreTransaction *txn = [[COStoreTransaction alloc] init];
-    COPersistentRootInfo *proot = [txn createPersistentRootWithInitialItemGraph: it
-                                                                           UUID: [ETUUID UUID]
-                                                                     branchUUID: [ETUUID UUID]
-                                                               revisionMetadata: nil
-                                                                  schemaVersion: 0];
+    COPersistentRootInfo *proot =
+        [txn createPersistentRootWithInitialItemGraph: [COItemGraph itemGraphWithItemsRootFirst: @[[rootItem copy]]]
+                                                 UUID: [ETUUID UUID]
+                                           branchUUID: [ETUUID UUID]
+                                     revisionMetadata: nil
+                                        schemaVersion: 0];
+    ETUUID *lastRevisionUUID = proot.currentRevisionUUID;
 
-    for (int i = 0; i < NUM_PERSISTENT_ROOT_COPIES; i++)
+    for (int commit = 1; commit < LARGE_BLOB_COMMITS; commit++)
     {
-        [txn createPersistentRootCopyWithUUID: [ETUUID UUID]
-                     parentPersistentRootUUID: proot.UUID
-                                   branchUUID: [ETUUID UUID]
-                             parentBranchUUID: nil
-                          initialRevisionUUID: proot.currentBranchInfo.currentRevisionUUID];
+        COMutableItem *item = [rootItem mutableCopy];
+        [item setValue: [NSString stringWithFormat: @"root %d", commit] forAttribute: @"name"];
+
+        ETUUID *revisionUUID = [ETUUID UUID];
+
+        [txn writeRevisionWithModifiedItems: [COItemGraph itemGraphWithItemsRootFirst: @[item]]
+                               revisionUUID: revisionUUID
+                                   metadata: nil
+                           parentRevisionID: lastRevisionUUID
+                      mergeParentRevisionID: nil
+                         persistentRootUUID: proot.UUID
+                                 branchUUID: proot.currentBranchUUID
+                              schemaVersion: 0];
+        lastRevisionUUID = revisionUUID;
     }
+
+    [txn setCurrentRevision: lastRevisionUUID
+               headRevision: lastRevisionUUID
+                  forBranch: proot.currentBranchUUID
+           ofPersistentRoot: proot.UUID];
+
     UKTrue([store commitStoreTransaction: txn]);
+    return proot.UUID;
+}
 
-    NSLog(@"creating %d persistent root copies took %lf ms", NUM_PERSISTENT_ROOT_COPIES,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+- (int64_t)storageSizeForPersistentRoot: (ETUUID *)prootUUID
+{
+    __block int64_t size = 0;
+
+    [store testingRunBlockInStoreQueue: ^()
+    {
+        COSQLiteStorePersistentRootBackingStore *backing =
+            [store backingStoreForPersistentRootUUID: prootUUID createIfNotPresent: NO];
+
+        size = [store.database longLongForQuery: [NSString stringWithFormat:
+            @"SELECT SUM(length(contents)) FROM %@", [backing tableName]]];
+        size += [store.database longLongForQuery: [NSString stringWithFormat:
+            @"SELECT IFNULL(SUM(length(contents)), 0) FROM %@", [backing blobTableName]]];
+    }];
+    return size;
 }
 
-- (void)testMakeBigItemTree
+- (void)testLargeBlobStorage
 {
-    // 1. create in-memory tree
+    NSMutableData *blob = [NSMutableData dataWithLength: LARGE_BLOB_LENGTH];
+    unsigned char *bytes = blob.mutableBytes;
 
-    NSDate *startDate = [NSDate date];
+    for (int i = 0; i < LARGE_BLOB_LENGTH; i++)
+    {
+        bytes[i] = (unsigned char)(i * 31);
+    }
 
-    COItemGraph *it = [self makeItemTreeWithChildCount: LOTS_OF_EMBEDDED_ITEMS];
+    store.maxNumberOfDeltaCommits = LARGE_BLOB_DELTA_RUN;
 
-    NSLog(@"creating %d item itemtree took %lf ms", LOTS_OF_EMBEDDED_ITEMS,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block ETUUID *inlineProotUUID = nil;
+    __block ETUUID *outOfLineProotUUID = nil;
+    __block COItemGraph *inlineGraph = nil;
+    __block COItemGraph *outOfLineGraph = nil;
 
-    // 2. commit it
+    // Blobs inline in each full snapshot
 
-    startDate = [NSDate date];
+    store.outOfLineBlobThreshold = NSUIntegerMax;
 
-    COStoreTransaction *txn = [[COStoreTransaction alloc] init];
-    COPersistentRootInfo *proot = [txn createPersistentRootWithInitialItemGraph: it
-                                                                           UUID: [ETUUID UUID]
-                                                                     branchUUID: [ETUUID UUID]
-                                                               revisionMetadata: nil
-                                                                  schemaVersion: 0];
-    UKTrue([store commitStoreTransaction: txn]);
+    BenchmarkResult *inlineCommitResult =
+        [harness measureOnce: @"Large blob stored inline: commit"
+                  operations: LARGE_BLOB_COMMITS
+                       block: ^() { inlineProotUUID = [self makePersistentRootWithLargeBlob: blob]; }];
+    [harness measure: @"Large blob stored inline: read"
+          operations: 1
+               setUp: ^() { [store.revisionCache removeAllRevisions]; }
+               block: ^() { inlineGraph = [self currentItemGraphForPersistentRoot: inlineProotUUID]; }];
 
-    NSLog(@"committing %d item itemtree took %lf ms", LOTS_OF_EMBEDDED_ITEMS,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+    // Blobs stored once out of line
 
-    // 3. read it back
+    store.outOfLineBlobThreshold = 32 * 1024;
+
+    BenchmarkResult *outOfLineCommitResult =
+        [harness measureOnce: @"Large blob stored out of line: commit"
+                  operations: LARGE_BLOB_COMMITS
+                       block: ^() { outOfLineProotUUID = [self makePersistentRootWithLargeBlob: blob]; }];
+    [harness measure: @"Large blob stored out of line: read"
+          operations: 1
+               setUp: ^() { [store.revisionCache removeAllRevisions]; }
+               block: ^() { outOfLineGraph = [self currentItemGraphForPersistentRoot: outOfLineProotUUID]; }];
+
+    UKObjectsEqual(blob, [[inlineGraph itemForUUID: inlineGraph.rootItemUUID] valueForAttribute: @"blob"]);
+    UKObjectsEqual(blob, [[outOfLineGraph itemForUUID: outOfLineGraph.rootItemUUID] valueForAttribute: @"blob"]);
 
-    startDate = [NSDate date];
+    const int64_t inlineSize = [self storageSizeForPersistentRoot: inlineProotUUID];
+    const int64_t outOfLineSize = [self storageSizeForPersistentRoot: outOfLineProotUUID];
 
-    COItemGraph *readBack = [self currentItemGraphForPersistentRoot: proot.UUID];
+    UKTrue(outOfLineSize < inlineSize);
 
-    NSLog(@"reading %d item itemtree took %lf ms", (int)readBack.itemUUIDs.count,
-          1000.0 * [[NSDate date] timeIntervalSinceDate: startDate]);
+    inlineCommitResult.values[@"storageBytes"] = @(inlineSize);
+    outOfLineCommitResult.values[@"storageBytes"] = @(outOfLineSize);
 }
 
 @end
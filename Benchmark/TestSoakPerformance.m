@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "BenchmarkHarness.h"
+#import "BenchmarkWorkload.h"
+
+/**
+ * Generates a store and runs a mixed operation workload against it.
+ *
+ * By default, the store and the run are small enough for the Benchmark tool.
+ * For soak tests, use the COBENCHMARK_SOAK_ environment variables documented
+ * in BenchmarkWorkloadConfiguration (e.g. 100000 persistent roots and a
+ * duration of several hours), and set COBENCHMARK_SOAK_OUTPUT to write the
+ * timeline as JSON.
+ */
+@interface TestSoakPerformance : SQLiteStoreTestCase <UKTest>
+@end
+
+
+@implementation TestSoakPerformance
+
+- (void)testSoak
+{
+    NSDictionary *environment = [NSProcessInfo processInfo].environment;
+    BenchmarkWorkloadConfiguration *configuration =
+        [BenchmarkWorkloadConfiguration configurationWithEnvironment: environment];
+    BenchmarkWorkload *workload = [[BenchmarkWorkload alloc] initWithStore: store
+                                                             configuration: configuration];
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    const NSUInteger revisionCount = configuration.persistentRootCount
+        * (1 + configuration.branchCount * (configuration.revisionCount - 1));
+
+    NSLog(@"Soak configuration: %@", configuration.JSONObject);
+
+    [harness measureOnce: @"Soak: store generation"
+              operations: revisionCount
+                   block: ^()
+    {
+        [workload generateStore];
+    }];
+    UKIntsEqual(revisionCount, workload.generatedRevisionCount);
+
+    workload.intervalHandler = ^(NSDictionary *interval)
+    {
+        NSLog(@"Soak interval: %@", interval);
+
+        [interval[@"latencies"] enumerateKeysAndObjectsUsingBlock: ^(NSString *name, NSDictionary *latencies, BOOL *stop)
+        {
+            [harness addSample: [latencies[@"mean"] doubleValue]
+                   toBenchmark: [NSString stringWithFormat: @"Soak: %@ latency", name]];
+        }];
+
+        const double throughput = [interval[@"throughput"] doubleValue];
+
+        if (throughput > 0)
+        {
+            [harness addSample: 1 / throughput toBenchmark: @"Soak: mixed operation"];
+        }
+    };
+    [workload run];
+
+    NSString *outputPath = environment[@"COBENCHMARK_SOAK_OUTPUT"];
+    NSError *error = nil;
+
+    if (outputPath != nil && ![workload writeTimelineToURL: [NSURL fileURLWithPath: outputPath] error: &error])
+    {
+        NSLog(@"Failed to write soak timeline to %@: %@", outputPath, error);
+    }
+
+    UKTrue(workload.operationCount > 0);
+    UKIntsEqual(configuration.persistentRootCount, store.persistentRootUUIDs.count);
+}
+
+@end
@@ -10,6 +10,64 @@
 #import <UnitKit/UKRunner.h>
 #import <UnitKit/UKTestHandler.h>
 #import "TestCommon.h"
+#import "BenchmarkHarness.h"
+#import "COJSONSerialization.h"
+
+/**
+ * Logs the benchmark results, writes them to COBENCHMARK_OUTPUT and compares
+ * them with COBENCHMARK_BASELINE.
+ *
+ * Returns NO if a regression was found or the results couldn't be written.
+ */
+static BOOL ReportBenchmarkResults(BenchmarkHarness *harness, NSDictionary *environment)
+{
+    BOOL success = YES;
+
+    NSLog(@"Benchmark results (%lu runs, %lu warmup runs):",
+          (unsigned long)harness.runCount, (unsigned long)harness.warmupRunCount);
+    for (BenchmarkResult *result in harness.results)
+    {
+        NSLog(@"  %@", result);
+    }
+
+    NSString *outputPath = environment[@"COBENCHMARK_OUTPUT"];
+
+    if (outputPath != nil)
+    {
+        NSError *error = nil;
+
+        if (![harness writeResultsToURL: [NSURL fileURLWithPath: outputPath] error: &error])
+        {
+            NSLog(@"Failed to write benchmark results to %@: %@", outputPath, error);
+            success = NO;
+        }
+    }
+
+    NSString *baselinePath = environment[@"COBENCHMARK_BASELINE"];
+
+    if (baselinePath != nil)
+    {
+        NSData *baselineData = [NSData dataWithContentsOfFile: baselinePath];
+        NSDictionary *baseline = (baselineData != nil ? COJSONObjectWithData(baselineData, NULL) : nil);
+
+        if (baseline == nil)
+        {
+            NSLog(@"Failed to read benchmark baseline %@", baselinePath);
+            return NO;
+        }
+
+        NSArray *regressions = [harness regressionsComparedToBaseline: baseline];
+
+        for (NSString *regression in regressions)
+        {
+            NSLog(@"Regression: %@", regression);
+        }
+        NSLog(@"%lu regressions compared to %@ (tolerance %.0f%%)", (unsigned long)regressions.count,
+              baselinePath, harness.regressionTolerance * 100);
+        success = success && regressions.isEmpty;
+    }
+    return success;
+}
 
 int main(int argc, const char *argv[])
 {
@@ -17,6 +75,11 @@ int main(int argc, const char *argv[])
     {
         NSLog(@"Store URL: %@", [EditingContextTestCase storeURL]);
 
+        NSDictionary *environment = [NSProcessInfo processInfo].environment;
+        BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+
+        [harness configureWithEnvironment: environment];
+
         UKRunner *runner = [UKRunner new];
 
         UKTestHandler *handler = [UKTestHandler handler];
@@ -25,7 +88,9 @@ int main(int argc, const char *argv[])
         [runner runTestsWithClassNames: nil principalClass: [EditingContextTestCase class]];
         [runner reportTestResults];
 
-        if ([handler exceptionsReported] > 0 || [handler testsFailed] > 0)
+        const BOOL reported = ReportBenchmarkResults(harness, environment);
+
+        if ([handler exceptionsReported] > 0 || [handler testsFailed] > 0 || !reported)
         {
             return 1;
         }
@@ -113,6 +113,7 @@ extern NSString *const kCOBranchLabel;
     BOOL _shouldMakeEmptyCommit;
     ETUUID *_parentBranchUUID;
     NSMutableArray *_revisions;
+    NSMutableDictionary *_revisionIndexesByUUID;
     COBranch *_mergingBranch;
     CORevision *_mergingRevision;
 }
@@ -285,6 +286,13 @@ extern NSString *const kCOBranchLabel;
  * The root object of the object graph context owned by the branch.
  */
 @property (nonatomic, readonly) __kindof COObject *rootObject;
+/**
+ * Returns a rough estimate of the bytes used by the branch and its object
+ * graph context, or only the branch if the object graph context isn't loaded.
+ *
+ * Doesn't cause the object graph context to be loaded.
+ */
+@property (nonatomic, readonly) NSUInteger estimatedMemoryUsage;
 
 
 /** @taskunit Pending Changes */
@@ -23,6 +23,7 @@
 #import "CODiffManager.h"
 #import "COMergeInfo.h"
 #import "COStoreTransaction.h"
+#include <objc/runtime.h>
 
 /**
  * Expensive, paranoid validation for debugging
@@ -427,6 +428,11 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
     return self.objectGraphContext.rootObject;
 }
 
+- (NSUInteger)estimatedMemoryUsage
+{
+    return class_getInstanceSize([self class]) + _objectGraph.estimatedMemoryUsage;
+}
+
 #pragma mark Pending Changes -
 
 - (BOOL)hasChangesOtherThanDeletionOrUndeletion
@@ -730,12 +736,20 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
                                                    headRevisionUUID: _currentRevisionUUID
                                                 oldHeadRevisionUUID: oldHeadRevUUID
                                                            ofBranch: self];
+            NSMutableDictionary *committedItems = [NSMutableDictionary new];
+
+            for (ETUUID *itemUUID in modifiedItems.itemUUIDs)
+            {
+                committedItems[itemUUID] = [modifiedItems itemForUUID: itemUUID];
+            }
+
             if (modifiedItemsSource == _objectGraph
                 && _objectGraph != nil)
             {
-                [_objectGraph acceptAllChanges];
+                [_objectGraph acceptAllChangesWithCommittedItems: committedItems];
 
-                if (self == self.persistentRoot.currentBranch)
+                if (self == self.persistentRoot.currentBranch
+                    && self.persistentRoot.objectGraphContextLoaded)
                 {
                     [self.persistentRoot.objectGraphContext setItemGraph: _objectGraph];
                 }
@@ -743,7 +757,7 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
             else if (modifiedItemsSource != nil)
             {
                 ETAssert(modifiedItemsSource == _persistentRoot.objectGraphContext);
-                [_persistentRoot.objectGraphContext acceptAllChanges];
+                [_persistentRoot.objectGraphContext acceptAllChangesWithCommittedItems: committedItems];
 
                 if (_objectGraph != nil)
                 {
@@ -751,6 +765,11 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
                 }
             }
         }
+        else if (modifiedItemsSource != nil)
+        {
+            // The changes were reverted since the last commit
+            [modifiedItemsSource discardUnchangedObjectsExceptItems: @{}];
+        }
     }
 
     // Write branch undeletion
@@ -797,7 +816,8 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
  */
 - (COObjectGraphContext *)modifiedItemsSource
 {
-    if (self == _persistentRoot.currentBranch && _persistentRoot.objectGraphContext.hasChanges)
+    if (self == _persistentRoot.currentBranch
+        && _persistentRoot.objectGraphContextWithoutUnfaulting.hasChanges)
     {
         COObjectGraphContext *graph = _persistentRoot.objectGraphContext;
 
@@ -814,7 +834,6 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
 
 - (COItemGraph *)modifiedItemsSnapshot
 {
-    NSSet *objectUUIDs = nil;
     COObjectGraphContext *graph = [self modifiedItemsSource];
 
     if (graph == nil)
@@ -824,31 +843,32 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
     }
     [graph doPreCommitChecks];
 
+    NSMutableDictionary *dict = nil;
+
     if (_currentRevisionUUID == nil)
     {
-        objectUUIDs = [NSSet setWithArray: graph.itemUUIDs];
-    }
-    else
-    {
-        objectUUIDs = graph.changedObjectUUIDs;
-    }
-
-    NSMutableDictionary *dict = [[NSMutableDictionary alloc] init];
+        dict = [[NSMutableDictionary alloc] init];
 
-    for (ETUUID *uuid in objectUUIDs)
-    {
-        COObject *obj = [graph loadedObjectForUUID: uuid];
-        COItem *item = [graph itemForUUID: uuid];
+        for (ETUUID *uuid in graph.itemUUIDs)
+        {
+            COObject *obj = [graph loadedObjectForUUID: uuid];
+            COItem *item = [graph itemForUUID: uuid];
 
-        dict[uuid] = item;
+            dict[uuid] = item;
 
-        // FIXME: Doing this here is wrong.. -changedObjectUUIDs should include
-        // all items needed to generate the new object graph state from the old state.
-        for (ETUUID *itemUUID in [obj.additionalStoreItemUUIDs objectEnumerator])
-        {
-            dict[itemUUID] = [obj additionalStoreItemForUUID: itemUUID];
+            // FIXME: Doing this here is wrong.. -changedObjectUUIDs should include
+            // all items needed to generate the new object graph state from the old state.
+            for (ETUUID *itemUUID in [obj.additionalStoreItemUUIDs objectEnumerator])
+            {
+                dict[itemUUID] = [obj additionalStoreItemForUUID: itemUUID];
+            }
         }
     }
+    else
+    {
+        // Skips the objects whose changes were reverted since the last commit
+        dict = [graph changedItemsForCommit];
+    }
 
     COItemGraph *modifiedItems = [[COItemGraph alloc] initWithItemForUUID: dict
                                                              rootItemUUID: graph.rootItemUUID];
@@ -957,7 +977,9 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
         [_objectGraph removeUnreachableObjects];
     }
 
-    if (self == self.persistentRoot.currentBranch)
+    // Not loaded persistent root objects will be loaded at the current revision
+    if (self == self.persistentRoot.currentBranch
+        && self.persistentRoot.objectGraphContextLoaded)
     {
         [self.persistentRoot.objectGraphContext setItemGraph: aGraph];
         [self.persistentRoot.objectGraphContext removeUnreachableObjects];
@@ -984,11 +1006,13 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
 
     if (isNewCommit)
     {
+        _revisionIndexesByUUID[currentRev.UUID] = @(_revisions.count);
         [_revisions addObject: currentRev];
     }
     else
     {
         _revisions = nil;
+        _revisionIndexesByUUID = nil;
     }
     [self didUpdate];
 }
@@ -1010,6 +1034,12 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
 - (void)reloadRevisions
 {
     _revisions = [self revisionsWithOptions: COBranchRevisionReadingParentBranches];
+    _revisionIndexesByUUID = [[NSMutableDictionary alloc] initWithCapacity: _revisions.count];
+
+    [_revisions enumerateObjectsUsingBlock: ^(CORevision *rev, NSUInteger i, BOOL *stop)
+    {
+        _revisionIndexesByUUID[rev.UUID] = @(i);
+    }];
 }
 
 #pragma mark Track Protocol -
@@ -1023,9 +1053,36 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
     return [_revisions copy];
 }
 
+- (NSArray *)nodesInRange: (NSRange)range
+{
+    if (_revisions == nil)
+    {
+        [self reloadRevisions];
+    }
+    return [_revisions subarrayWithRange: range];
+}
+
+- (NSUInteger)indexOfNode: (id <COTrackNode>)aNode
+{
+    NILARG_EXCEPTION_TEST(aNode);
+
+    if (_revisions == nil)
+    {
+        [self reloadRevisions];
+    }
+
+    NSNumber *index = _revisionIndexesByUUID[aNode.UUID];
+
+    if (index == nil)
+        return NSNotFound;
+
+    ETAssert([_revisions[index.unsignedIntegerValue] isEqual: aNode]);
+    return index.unsignedIntegerValue;
+}
+
 - (id)nextNodeOnTrackFrom: (id <COTrackNode>)aNode backwards: (BOOL)back
 {
-    NSInteger nodeIndex = [self.nodes indexOfObject: aNode];
+    NSInteger nodeIndex = [self indexOfNode: aNode];
 
     if (nodeIndex == NSNotFound)
     {
@@ -1042,12 +1099,12 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
         nodeIndex++;
     }
 
-    const BOOL hasNoPreviousOrNextNode = (nodeIndex < 0 || nodeIndex >= self.nodes.count);
+    const BOOL hasNoPreviousOrNextNode = (nodeIndex < 0 || nodeIndex >= _revisions.count);
 
     if (hasNoPreviousOrNextNode)
         return nil;
 
-    return self.nodes[nodeIndex];
+    return _revisions[nodeIndex];
 }
 
 - (id <COTrackNode>)currentNode
@@ -1136,6 +1193,15 @@ NSString *const kCOBranchLabel = @"COBranchLabel";
     return YES;
 }
 
+- (NSUInteger)count
+{
+    if (_revisions == nil)
+    {
+        [self reloadRevisions];
+    }
+    return _revisions.count;
+}
+
 - (id)content
 {
     return self.nodes;
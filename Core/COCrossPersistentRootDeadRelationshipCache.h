@@ -26,6 +26,10 @@ NS_ASSUME_NONNULL_BEGIN
  * point to the resurrected root object. To fix outgoing relationships accross 
  * persistent roots, we replace dead COPath references hidden in the 
  * COPrimitiveCollection backing by alive COObject references.
+ *
+ * For each referring object and path, the cache also records the properties
+ * holding the dead references, so fixing them doesn't require to visit every
+ * property of the referring objects.
  */
 @interface COCrossPersistentRootDeadRelationshipCache : NSObject
 {
@@ -35,6 +39,7 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (void)addReferringObject: (COObject *)aReferrer
+            sourceProperty: (NSString *)aProperty
                    forPath: (COPath *)aPath;
 /**
  * When no referring objects exist, returns nil.
@@ -44,6 +49,23 @@ NS_ASSUME_NONNULL_BEGIN
 #else
 - (nullable NSHashTable<__kindof COObject *> *)referringObjectsForPath: (COPath *)aPath;
 #endif
+/**
+ * Returns the properties of the referring object that hold a dead reference
+ * to the path.
+ *
+ * When the referring object has no dead references to the path, returns nil.
+ */
+- (nullable NSSet<NSString *> *)sourcePropertiesOfReferringObject: (COObject *)aReferrer
+                                                          forPath: (COPath *)aPath;
+/**
+ * Removes the dead reference to the path for the given property.
+ *
+ * The referring object is removed for the path once none of its properties
+ * hold a dead reference to it.
+ */
+- (void)removeReferringObject: (COObject *)aReferrer
+               sourceProperty: (NSString *)aProperty
+                      forPath: (COPath *)aPath;
 - (void)removeReferringObject: (COObject *)aReferrer
                       forPath: (COPath *)aPath;
 - (void)removeReferringObject: (COObject *)aReferrer;
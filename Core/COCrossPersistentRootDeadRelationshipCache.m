@@ -21,10 +21,12 @@
 }
 
 - (void)addReferringObject: (COObject *)aReferrer
+            sourceProperty: (NSString *)aProperty
                    forPath: (COPath *)aPath
 {
     NSHashTable *referringObjects = _pathToReferringObjects[aPath];
-    NSMutableSet *paths = [_referringObjectToPaths objectForKey: aReferrer];
+    NSMutableDictionary *paths = [_referringObjectToPaths objectForKey: aReferrer];
+    NSMutableSet *properties = paths[aPath];
 
     if (referringObjects == nil)
     {
@@ -37,11 +39,16 @@
     }
     if (paths == nil)
     {
-        paths = [NSMutableSet new];
+        paths = [NSMutableDictionary new];
         [_referringObjectToPaths setObject: paths
                                     forKey: aReferrer];
     }
-    [paths addObject: aPath];
+    if (properties == nil)
+    {
+        properties = [NSMutableSet new];
+        paths[aPath] = properties;
+    }
+    [properties addObject: aProperty];
     [referringObjects addObject: aReferrer];
 }
 
@@ -50,6 +57,12 @@
     return _pathToReferringObjects[aPath];
 }
 
+- (NSSet *)sourcePropertiesOfReferringObject: (COObject *)aReferrer
+                                     forPath: (COPath *)aPath
+{
+    return [_referringObjectToPaths objectForKey: aReferrer][aPath];
+}
+
 - (void)removeObjectFromPathsToReferringObjects: (COObject *)aReferrer forPath: (COPath *)path
 {
     NSHashTable *referringObjects = _pathToReferringObjects[path];
@@ -62,19 +75,33 @@
     }
 }
 
+- (void)removeReferringObject: (COObject *)aReferrer
+               sourceProperty: (NSString *)aProperty
+                      forPath: (COPath *)aPath
+{
+    NSMutableSet *properties = [_referringObjectToPaths objectForKey: aReferrer][aPath];
+
+    [properties removeObject: aProperty];
+
+    if (properties.count == 0)
+    {
+        [self removeReferringObject: aReferrer forPath: aPath];
+    }
+}
+
 - (void)removeReferringObject: (COObject *)aReferrer
                       forPath: (COPath *)aPath
 {
-    NSMutableSet *paths = [_referringObjectToPaths objectForKey: aReferrer];
+    NSMutableDictionary *paths = [_referringObjectToPaths objectForKey: aReferrer];
 
-    [paths removeObject: aPath];
+    [paths removeObjectForKey: aPath];
     [self removeObjectFromPathsToReferringObjects: aReferrer
                                           forPath: aPath];
 }
 
 - (void)removeReferringObject: (COObject *)aReferrer
 {
-    NSMutableSet *paths = [_referringObjectToPaths objectForKey: aReferrer];
+    NSMutableDictionary *paths = [_referringObjectToPaths objectForKey: aReferrer];
 
     if (paths == nil)
         return;
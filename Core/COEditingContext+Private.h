@@ -73,6 +73,14 @@ restrictedToPersistentRoots: (nullable NSArray *)persistentRoots
                                                     isFault: (BOOL)faulting;
 
 
+/** @taskunit Memory Budget */
+
+
+- (void)didLoadPersistentRoot: (COPersistentRoot *)aPersistentRoot;
+- (BOOL)isPersistentRootUUIDEvictable: (ETUUID *)aPersistentRootUUID;
+- (void)setEvictable: (BOOL)evictable forPersistentRootUUID: (ETUUID *)aPersistentRootUUID;
+
+
 /** @taskunit Accessing Store Revisions and Branches */
 
 
@@ -176,6 +176,16 @@ typedef NS_ENUM(NSUInteger, COEditingContextUnloadingBehavior)
     COObjectGraphContext *_internalTransientObjectGraphContext;
     NSMutableDictionary *_lastTransactionIDForPersistentRootUUID;
     BOOL _hasLoadedPersistentRootUUIDs;
+    /** Memory budget */
+    NSUInteger _memoryBudget;
+    NSUInteger _estimatedMemoryUsage;
+    NSMutableDictionary *_estimatedMemoryUsageForPersistentRootUUID;
+    /** Loaded persistent root UUIDs from the least to the most recently used */
+    NSMutableOrderedSet *_persistentRootUUIDsByRecentUse;
+    NSMutableSet *_evictedPersistentRootUUIDs;
+    NSMutableSet *_evictablePersistentRootUUIDs;
+    NSUInteger _evictedPersistentRootCount;
+    NSUInteger _reloadedPersistentRootCount;
 }
 
 
@@ -339,6 +349,55 @@ typedef NS_ENUM(NSUInteger, COEditingContextUnloadingBehavior)
 @property (nonatomic, readwrite, assign) COEditingContextUnloadingBehavior unloadingBehavior;
 
 
+/** @taskunit Memory Budget */
+
+
+/**
+ * The estimated bytes that loaded persistent roots can use, before the least
+ * recently used ones get unloaded automatically.
+ *
+ * Only persistent roots marked with -[COPersistentRoot isEvictable] are
+ * unloaded automatically, and only if they have no uncommitted changes, and are
+ * not referenced by inner objects with uncommitted changes in other persistent
+ * roots. Cross persistent root references pointing to an unloaded persistent
+ * root are turned into faults, and transparently reload it on access, as if
+ * -unloadPersistentRoot: had been called.
+ *
+ * The editing context cannot know whether the application still holds a
+ * persistent root, its branches or its inner objects. Once unloaded, these
+ * objects become invalid, so a persistent root must only be marked as
+ * evictable when the application accesses it through the editing context or
+ * through cross persistent root references.
+ *
+ * Persistent roots are unloaded after loading a persistent root and after
+ * committing, but never during a commit or while loading all persistent roots
+ * with -persistentRoots or -deletedPersistentRoots.
+ *
+ * By default, returns 0 which means there is no budget and persistent roots
+ * are never unloaded automatically. Setting a lower budget doesn't unload
+ * persistent roots immediately.
+ *
+ * This budget is independent from -unloadingBehavior.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger memoryBudget;
+/**
+ * The estimated bytes used by the loaded persistent roots.
+ *
+ * The estimate of a persistent root is updated when it gets loaded or 
+ * committed, and is based on -[COPersistentRoot estimatedMemoryUsage].
+ */
+@property (nonatomic, readonly) NSUInteger estimatedMemoryUsage;
+/**
+ * The number of persistent roots unloaded to stay within -memoryBudget.
+ */
+@property (nonatomic, readonly) NSUInteger evictedPersistentRootCount;
+/**
+ * The number of persistent roots reloaded after being unloaded to stay within 
+ * -memoryBudget.
+ */
+@property (nonatomic, readonly) NSUInteger reloadedPersistentRootCount;
+
+
 /** @taskunit Pending Changes */
 
 
@@ -13,6 +13,8 @@
 #import "COObject+Private.h"
 #import "COMetamodel.h"
 #import "COSQLiteStore.h"
+#import "COSQLiteStore+Private.h"
+#import "COStoreMetrics.h"
 #import "CORevision.h"
 #import "COBranch.h"
 #import "COPath.h"
@@ -21,6 +23,7 @@
 #import "COEditingContext+Undo.h"
 #import "COEditingContext+Private.h"
 #import "COCrossPersistentRootDeadRelationshipCache.h"
+#import "CORelationshipCache.h"
 #import "CORevisionCache.h"
 #import "COStoreTransaction.h"
 #import "CODistributedNotificationCenter.h"
@@ -34,6 +37,9 @@
 @synthesize persistentRootsPendingUndeletion = _persistentRootsPendingUndeletion;
 @synthesize deadRelationshipCache = _deadRelationshipCache;
 @synthesize undoTrackStore = _undoTrackStore, recordingUndo = _recordingUndo;
+@synthesize memoryBudget = _memoryBudget, estimatedMemoryUsage = _estimatedMemoryUsage;
+@synthesize evictedPersistentRootCount = _evictedPersistentRootCount;
+@synthesize reloadedPersistentRootCount = _reloadedPersistentRootCount;
 
 #pragma mark Creating a New Context -
 
@@ -67,6 +73,10 @@
     _internalTransientObjectGraphContext = [[COObjectGraphContext alloc]
         initWithModelDescriptionRepository: aRepo];
     _lastTransactionIDForPersistentRootUUID = [NSMutableDictionary new];
+    _estimatedMemoryUsageForPersistentRootUUID = [NSMutableDictionary new];
+    _persistentRootUUIDsByRecentUse = [NSMutableOrderedSet new];
+    _evictedPersistentRootUUIDs = [NSMutableSet new];
+    _evictablePersistentRootUUIDs = [NSMutableSet new];
     CORegisterCoreObjectMetamodel(_modelDescriptionRepository);
 
     NSOperationQueue *notifQueue = [NSOperationQueue currentQueue];
@@ -177,13 +187,20 @@
 
 #pragma mark Accessing All Persistent Roots -
 
+/**
+ * The persistent roots are loaded with a single store query, and their objects 
+ * are not loaded until accessed (see -[COPersistentRoot objectGraphContext]).
+ */
 - (void)loadAllPersistentRootsIfNeeded
 {
     if (!_hasLoadedPersistentRootUUIDs)
     {
-        for (ETUUID *uuid in _store.persistentRootUUIDs)
+        for (COPersistentRootInfo *info in _store.persistentRootInfos)
         {
-            [self persistentRootForUUID: uuid];
+            if (_loadedPersistentRoots[info.UUID] != nil)
+                continue;
+
+            [self makePersistentRootWithInfo: info objectGraphContext: nil];
         }
 
         _hasLoadedPersistentRootUUIDs = YES;
@@ -208,7 +225,7 @@
     /* Force deleted persistent roots to be reloaded (see -unloadPersistentRoot:) */
     for (ETUUID *persistentRootUUID in _store.deletedPersistentRootUUIDs)
     {
-        [self persistentRootForUUID: persistentRootUUID];
+        [self persistentRootForUUID: persistentRootUUID evictsIfNeeded: NO];
     }
 
     return [NSSet setWithArray:
@@ -233,12 +250,22 @@
  * change as covered in -storePersistentRootsDidChange:isDistributed:.
  */
 - (COPersistentRoot *)persistentRootForUUID: (ETUUID *)persistentRootUUID
+{
+    return [self persistentRootForUUID: persistentRootUUID evictsIfNeeded: YES];
+}
+
+- (COPersistentRoot *)persistentRootForUUID: (ETUUID *)persistentRootUUID
+                             evictsIfNeeded: (BOOL)evictsIfNeeded
 {
     COPersistentRoot *persistentRoot = _loadedPersistentRoots[persistentRootUUID];
 
     if (persistentRoot != nil)
+    {
+        [self didUsePersistentRoot: persistentRoot];
         return persistentRoot;
+    }
 
+    const uint64_t startTime = COStoreMetricsNow();
     COPersistentRootInfo *info = [_store persistentRootInfoForUUID: persistentRootUUID];
     BOOL persistentRootFound = (info != nil);
 
@@ -246,7 +273,12 @@
         return nil;
 
     persistentRoot = [self makePersistentRootWithInfo: info objectGraphContext: nil];
+    [_store.metrics recordDurationSince: startTime forMetric: COStoreMetricEditingContextLoadLatency];
 
+    if (evictsIfNeeded)
+    {
+        [self evictPersistentRootsIfNeeded];
+    }
     return persistentRoot;
 }
 
@@ -273,6 +305,11 @@
     [self updateCrossPersistentRootReferencesToPersistentRoot: persistentRoot
                                                        branch: nil
                                                       isFault: persistentRoot.deleted];
+
+    if (info != nil)
+    {
+        [self didLoadPersistentRoot: persistentRoot];
+    }
     return persistentRoot;
 }
 
@@ -411,6 +448,32 @@
     }
 }
 
+/**
+ * Records the properties of a referring object under its object graph context,
+ * in a map table whose values are map tables from referring objects to
+ * properties.
+ */
+static void addSourceProperties(NSMapTable *sourcePropertiesByReferrerByObjectGraph,
+                                COObject *aReferrer,
+                                id <NSFastEnumeration> properties)
+{
+    COObjectGraphContext *source = aReferrer.objectGraphContext;
+    NSMapTable *sourcePropertiesByReferrer = [sourcePropertiesByReferrerByObjectGraph objectForKey: source];
+
+    if (source == nil || properties == nil)
+        return;
+
+    if (sourcePropertiesByReferrer == nil)
+    {
+        sourcePropertiesByReferrer =
+            [NSMapTable mapTableWithKeyOptions: NSPointerFunctionsObjectPointerPersonality
+                                  valueOptions: NSPointerFunctionsStrongMemory];
+        [sourcePropertiesByReferrerByObjectGraph setObject: sourcePropertiesByReferrer
+                                                    forKey: source];
+    }
+    [sourcePropertiesByReferrer setObject: properties forKey: aReferrer];
+}
+
 /**
  * When isFault is YES, turns live references to the given persistent root
  * into dead ones in referring persistent roots.
@@ -465,6 +528,17 @@
     }
     else
     {
+        COPath *persistentRootPath = [COPath pathWithPersistentRoot: aPersistentRoot.UUID];
+        const BOOL hasDeadReferences =
+            [_deadRelationshipCache referringObjectsForPath: persistentRootPath].count > 0;
+
+        // Dead references to a persistent root whose objects are not loaded yet
+        // can only be fixed once they are loaded, which updates the references
+        if (!faulting && hasDeadReferences && !aPersistentRoot.objectGraphContextLoaded)
+        {
+            [aPersistentRoot objectGraphContext];
+            return;
+        }
         targetObjectGraphs = aPersistentRoot.allObjectGraphContexts;
     }
 
@@ -476,46 +550,61 @@
         const BOOL isTargetFaulting = faulting || target.branch.deleted;
         /* Fix references in all branches that belong to persistent roots
            referencing the deleted persistent root (those are relationship sources) */
-        NSMutableSet *sourceObjectGraphs = [NSMutableSet new];
-
-        // Quickly lookup the COObjects that have currently dead references that
-        // should point at `target`.
+        NSMapTable *sourceObjectGraphs =
+            [NSMapTable mapTableWithKeyOptions: NSPointerFunctionsObjectPointerPersonality
+                                  valueOptions: NSPointerFunctionsStrongMemory];
 
-        // TODO: Factor out this object graph context -> COPath conversion.
-        COPath *targetPath;
-        if (target == aPersistentRoot.objectGraphContext)
+        if (isTargetFaulting)
         {
-            targetPath = [COPath pathWithPersistentRoot: target.persistentRoot.UUID];
+            // Quickly lookup COObjects with live references to `target`
+            NSMapTable *referrersWithLiveReferences =
+                target.rootObject.incomingRelationshipCache.sourcePropertiesByReferringObject;
+
+            for (COObject *sourceObject in referrersWithLiveReferences)
+            {
+                addSourceProperties(sourceObjectGraphs,
+                                    sourceObject,
+                                    [referrersWithLiveReferences objectForKey: sourceObject]);
+            }
         }
         else
         {
-            targetPath = [COPath pathWithPersistentRoot: target.persistentRoot.UUID
-                                                 branch: target.branch.UUID];
-        }
+            // Quickly lookup the COObjects that have currently dead references that
+            // should point at `target`.
 
-        NSHashTable *referrersWithDeadReferences = [_deadRelationshipCache referringObjectsForPath: targetPath];
-        for (COObject *sourceObject in referrersWithDeadReferences)
-        {
-            [sourceObjectGraphs addObject: sourceObject.objectGraphContext];
-        }
+            // TODO: Factor out this object graph context -> COPath conversion.
+            COPath *targetPath;
+            if (target == aPersistentRoot.objectGraphContextWithoutUnfaulting)
+            {
+                targetPath = [COPath pathWithPersistentRoot: target.persistentRoot.UUID];
+            }
+            else
+            {
+                targetPath = [COPath pathWithPersistentRoot: target.persistentRoot.UUID
+                                                     branch: target.branch.UUID];
+            }
 
-        // Quickly lookup COObjects with live references to `target`
-        NSSet *referrersWithLiveReferences = [target.rootObject referringObjects];
-        for (COObject *sourceObject in referrersWithLiveReferences)
-        {
-            [sourceObjectGraphs addObject: sourceObject.objectGraphContext];
+            NSHashTable *referrersWithDeadReferences = [_deadRelationshipCache referringObjectsForPath: targetPath];
+            for (COObject *sourceObject in referrersWithDeadReferences)
+            {
+                // Copied, since replacing the dead references updates the cache
+                addSourceProperties(sourceObjectGraphs,
+                                    sourceObject,
+                                    [[_deadRelationshipCache sourcePropertiesOfReferringObject: sourceObject
+                                                                                       forPath: targetPath] copy]);
+            }
         }
 
-        // Fix up the references
+        // Fix up the references, by only visiting the referring objects and
+        // their properties that point to `target`
         for (COObjectGraphContext *source in sourceObjectGraphs)
         {
             if (source.persistentRoot == aPersistentRoot)
                 continue;
 
-            // TODO: We could easily skip traversing all inner objects, since
-            // we already know which ones need fixing up.
             [source replaceObject: (isTargetFaulting ? target.rootObject : nil)
-                       withObject: (isTargetFaulting ? nil : target.rootObject)];
+                       withObject: (isTargetFaulting ? nil : target.rootObject)
+               inReferringObjects: [sourceObjectGraphs objectForKey: source]];
         }
     }
 }
@@ -528,6 +617,7 @@
         return;
 
     [_loadedPersistentRoots removeObjectForKey: aPersistentRoot.UUID];
+    [self didUnloadPersistentRootUUID: aPersistentRoot.UUID];
 
     // For a deleted persistent root, references are fixed in -deletePersistentRoot:
     if (!deleted)
@@ -558,6 +648,175 @@
     [self unloadPersistentRoot: aPersistentRoot isDeleted: aPersistentRoot.deleted force: YES];
 }
 
+#pragma mark Memory Budget -
+
+- (void)setMemoryBudget: (NSUInteger)aBudget
+{
+    const BOOL wasTracking = (_memoryBudget != 0);
+
+    _memoryBudget = aBudget;
+
+    if (aBudget == 0)
+    {
+        _estimatedMemoryUsage = 0;
+        [_estimatedMemoryUsageForPersistentRootUUID removeAllObjects];
+        [_persistentRootUUIDsByRecentUse removeAllObjects];
+        return;
+    }
+    if (wasTracking)
+        return;
+
+    /* Start tracking the persistent roots loaded so far */
+    for (COPersistentRoot *persistentRoot in _loadedPersistentRoots.objectEnumerator)
+    {
+        if (persistentRoot.persistentRootUncommitted)
+            continue;
+
+        [self didLoadPersistentRoot: persistentRoot];
+    }
+}
+
+/**
+ * Marks the persistent root as the most recently used one.
+ */
+- (void)didUsePersistentRoot: (COPersistentRoot *)aPersistentRoot
+{
+    if (_memoryBudget == 0)
+        return;
+
+    ETUUID *persistentRootUUID = aPersistentRoot.UUID;
+
+    if ([_persistentRootUUIDsByRecentUse.lastObject isEqual: persistentRootUUID])
+        return;
+
+    [_persistentRootUUIDsByRecentUse removeObject: persistentRootUUID];
+    [_persistentRootUUIDsByRecentUse addObject: persistentRootUUID];
+}
+
+/**
+ * Updates the memory usage estimate of a persistent root just loaded, 
+ * reloaded or committed, and marks it as the most recently used one.
+ *
+ * Persistent roots pending insertion are not tracked until their first commit.
+ */
+- (void)didLoadPersistentRoot: (COPersistentRoot *)aPersistentRoot
+{
+    if (_memoryBudget == 0)
+        return;
+
+    ETUUID *persistentRootUUID = aPersistentRoot.UUID;
+    const NSUInteger usage = aPersistentRoot.estimatedMemoryUsage;
+
+    _estimatedMemoryUsage -= [_estimatedMemoryUsageForPersistentRootUUID[persistentRootUUID] unsignedIntegerValue];
+    _estimatedMemoryUsage += usage;
+    _estimatedMemoryUsageForPersistentRootUUID[persistentRootUUID] = @(usage);
+
+    if ([_evictedPersistentRootUUIDs containsObject: persistentRootUUID])
+    {
+        [_evictedPersistentRootUUIDs removeObject: persistentRootUUID];
+        _reloadedPersistentRootCount++;
+    }
+    [self didUsePersistentRoot: aPersistentRoot];
+}
+
+- (void)didUnloadPersistentRootUUID: (ETUUID *)aPersistentRootUUID
+{
+    _estimatedMemoryUsage -= [_estimatedMemoryUsageForPersistentRootUUID[aPersistentRootUUID] unsignedIntegerValue];
+    [_estimatedMemoryUsageForPersistentRootUUID removeObjectForKey: aPersistentRootUUID];
+    [_persistentRootUUIDsByRecentUse removeObject: aPersistentRootUUID];
+}
+
+- (BOOL)isPersistentRootUUIDEvictable: (ETUUID *)aPersistentRootUUID
+{
+    return [_evictablePersistentRootUUIDs containsObject: aPersistentRootUUID];
+}
+
+- (void)setEvictable: (BOOL)evictable forPersistentRootUUID: (ETUUID *)aPersistentRootUUID
+{
+    NILARG_EXCEPTION_TEST(aPersistentRootUUID);
+
+    if (evictable)
+    {
+        [_evictablePersistentRootUUIDs addObject: aPersistentRootUUID];
+    }
+    else
+    {
+        [_evictablePersistentRootUUIDs removeObject: aPersistentRootUUID];
+    }
+}
+
+/**
+ * Returns whether the persistent root can be unloaded without losing changes.
+ *
+ * We cannot tell whether the application still holds the persistent root or 
+ * its inner objects, so the application must opt in with 
+ * -[COPersistentRoot setEvictable:].
+ *
+ * Live references from unchanged object graphs can be turned into faults,
+ * but we don't touch object graphs with changes, even if replacing references 
+ * with faults doesn't result in new changes to commit.
+ */
+- (BOOL)isPersistentRootEvictable: (COPersistentRoot *)aPersistentRoot
+{
+    if (!aPersistentRoot.evictable)
+        return NO;
+
+    if (aPersistentRoot.persistentRootUncommitted || aPersistentRoot.hasChanges)
+        return NO;
+
+    if ([_persistentRootsPendingDeletion containsObject: aPersistentRoot]
+        || [_persistentRootsPendingUndeletion containsObject: aPersistentRoot])
+    {
+        return NO;
+    }
+
+    for (COObjectGraphContext *target in aPersistentRoot.allObjectGraphContexts)
+    {
+        for (COObject *referrer in [target.rootObject referringObjects])
+        {
+            COObjectGraphContext *source = referrer.objectGraphContext;
+
+            if (source.persistentRoot != aPersistentRoot && source.hasChanges)
+                return NO;
+        }
+    }
+    return YES;
+}
+
+/**
+ * Unloads the least recently used persistent roots until the estimated memory 
+ * usage fits in the memory budget.
+ *
+ * The most recently used persistent root is never unloaded.
+ */
+- (void)evictPersistentRootsIfNeeded
+{
+    if (_memoryBudget == 0 || _inCommit || _estimatedMemoryUsage <= _memoryBudget)
+        return;
+
+    // Unloading mutates the ordered set, and -array returns a proxy
+    NSArray *persistentRootUUIDs = [_persistentRootUUIDsByRecentUse.array copy];
+    ETUUID *mostRecentlyUsedUUID = persistentRootUUIDs.lastObject;
+
+    for (ETUUID *persistentRootUUID in persistentRootUUIDs)
+    {
+        if (_estimatedMemoryUsage <= _memoryBudget || [persistentRootUUID isEqual: mostRecentlyUsedUUID])
+            break;
+
+        COPersistentRoot *persistentRoot = _loadedPersistentRoots[persistentRootUUID];
+
+        if (![self isPersistentRootEvictable: persistentRoot])
+            continue;
+
+        [self unloadPersistentRoot: persistentRoot];
+
+        [_evictedPersistentRootUUIDs addObject: persistentRootUUID];
+        _evictedPersistentRootCount++;
+        // -persistentRoots must reload the evicted persistent roots
+        _hasLoadedPersistentRootUUIDs = NO;
+    }
+}
+
 #pragma mark Referencing Other Persistent Roots -
 
 - (id)crossPersistentRootReferenceWithPath: (COPath *)aPath shouldLoad: (BOOL)shouldLoad
@@ -569,7 +828,9 @@
 
     if (shouldLoad)
     {
-        persistentRoot = [self persistentRootForUUID: persistentRootUUID];
+        // Unloading persistent roots could discard the objects currently
+        // accessed by the caller
+        persistentRoot = [self persistentRootForUUID: persistentRootUUID evictsIfNeeded: NO];
     }
     else
     {
@@ -634,6 +895,10 @@
 
     NSArray *persistentRootsPendingInsertion = self.persistentRootsPendingInsertion.allObjects;
 
+    for (COPersistentRoot *persistentRoot in persistentRootsPendingInsertion)
+    {
+        [self didUnloadPersistentRootUUID: persistentRoot.UUID];
+    }
     [_loadedPersistentRoots removeObjectsForKeys:
                             (id)[[persistentRootsPendingInsertion mappedCollection] UUID]];
     ETAssert([self.persistentRootsPendingInsertion isEmpty]);
@@ -721,6 +986,11 @@
     for (COPersistentRoot *ctxt in persistentRoots)
     {
         [ctxt didMakeNewCommit];
+
+        if (_loadedPersistentRoots[ctxt.UUID] == ctxt)
+        {
+            [self didLoadPersistentRoot: ctxt];
+        }
     }
 
     for (COPersistentRoot *ctxt in persistentRoots)
@@ -766,6 +1036,8 @@ restrictedToPersistentRoots: (NSArray *)persistentRoots
                     format: @"%@ called recursively", NSStringFromSelector(_cmd)];
     }
 
+    const uint64_t startTime = COStoreMetricsNow();
+
     @try
     {
         _inCommit = YES;
@@ -837,8 +1109,38 @@ restrictedToPersistentRoots: (NSArray *)persistentRoots
             [persistentRoot clearBranchesPendingDeletionAndUndeletion];
         }
 
-        ETAssert([_store commitStoreTransaction: transaction]);
-        COCommandGroup *command = [self recordEndUndoGroupWithUndoTrack: track];
+        /* When the undo track store is hosted in the store, the revisions and
+           the undo command are committed in the same database transaction */
+        const BOOL isSharedTransaction = (_recordingUndo && track.store.hostStore == _store);
+
+        if (isSharedTransaction)
+        {
+            ETAssert([_store beginSharedTransaction]);
+        }
+
+        COCommandGroup *command = nil;
+        BOOL isSharedTransactionEnded = !isSharedTransaction;
+
+        @try
+        {
+            ETAssert([_store commitStoreTransaction: transaction]);
+            command = [self recordEndUndoGroupWithUndoTrack: track];
+
+            if (isSharedTransaction)
+            {
+                const BOOL isCommitted = [_store commitSharedTransaction];
+
+                isSharedTransactionEnded = YES;
+                ETAssert(isCommitted);
+            }
+        }
+        @finally
+        {
+            if (!isSharedTransactionEnded)
+            {
+                [_store rollbackSharedTransaction];
+            }
+        }
 
         /* For a commit triggered by undo/redo on a COUndoTrack, the command is nil */
         [self didCommitWithCommand: command persistentRoots: persistentRoots];
@@ -852,6 +1154,9 @@ restrictedToPersistentRoots: (NSArray *)persistentRoots
     {
         _inCommit = NO;
     }
+
+    [self evictPersistentRootsIfNeeded];
+    [_store.metrics recordDurationSince: startTime forMetric: COStoreMetricEditingContextCommitLatency];
     return YES;
 }
 
@@ -967,6 +1272,7 @@ restrictedToPersistentRoots: (NSArray *)persistentRoots
                    -clearBranchesPendingDeletionAndUndeletion and this point,
                    COBranch.deleted is always NO. */
                 [loaded storePersistentRootDidChange: notif isDistributed: isDistributed];
+                [self didLoadPersistentRoot: loaded];
                 /* When -[COUndoTrack setCurrentNode:] is used or we receive
                    another application commit notification, we must update other
                    persistent root references pointing to the loaded one.
@@ -73,6 +73,15 @@ ETEntityDescription *entityDescriptionForObjectInRepository(id anObject, ETModel
 - (nullable id)serializableValueForStorageKey: (NSString *)key;
 - (void)setValue: (nullable id)value forStorageKey: (NSString *)key;
 - (nullable id)valueForProperty: (NSString *)key shouldLoad: (BOOL)shouldLoad;
+/**
+ * Returns a rough estimate of the bytes used by the receiver and its variable
+ * storage.
+ *
+ * Referenced objects are not included, only the references to them. Values
+ * stored in instance variables declared by subclasses are not included either,
+ * except for the instance variables themselves.
+ */
+@property (nonatomic, readonly) NSUInteger estimatedMemoryUsage;
 
 
 /** @taskunit Mutating Collections */
@@ -133,6 +142,9 @@ ETEntityDescription *entityDescriptionForObjectInRepository(id anObject, ETModel
 
 - (void)replaceReferencesToObjectIdenticalTo: (nullable COObject *)anObject
                                   withObject: (nullable COObject *)aReplacement;
+- (void)replaceReferencesToObjectIdenticalTo: (nullable COObject *)anObject
+                                  withObject: (nullable COObject *)aReplacement
+                               forProperties: (id <NSFastEnumeration>)properties;
 
 @end
 
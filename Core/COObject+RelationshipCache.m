@@ -38,6 +38,7 @@ static inline BOOL isPersistentCoreObjectReferencePropertyDescription(ETProperty
         if (isDeadReference)
         {
             [deadRelationshipCache removeReferringObject: self
+                                          sourceProperty: aProperty.name
                                                  forPath: obj];
         }
         else
@@ -112,6 +113,7 @@ static inline BOOL isPersistentCoreObjectReferencePropertyDescription(ETProperty
         if (isDeadReference)
         {
             [deadRelationshipCache addReferringObject: self
+                                       sourceProperty: aProperty.name
                                               forPath: obj];
         }
         else
@@ -860,6 +860,46 @@ static NSNull *cachedNSNull = nil;
 
 #pragma mark - Direct Access to Property Storage
 
+/**
+ * Returns the estimated bytes used by a value in the variable storage.
+ *
+ * Collection elements are not visited, since enumerating relationship 
+ * collections can be costly, each element is counted as a pointer plus its 
+ * slot in the collection.
+ */
+static NSUInteger COEstimatedMemoryUsageOfValue(id value)
+{
+    static const NSUInteger objectOverhead = 16;
+
+    if (value == nil || [value isKindOfClass: [COObject class]])
+        return 0;
+
+    if ([value isKindOfClass: [NSString class]])
+        return objectOverhead + [value length] * sizeof(unichar);
+
+    if ([value isKindOfClass: [NSData class]])
+        return objectOverhead + [value length];
+
+    if ([value isKindOfClass: [NSArray class]]
+        || [value isKindOfClass: [NSSet class]]
+        || [value isKindOfClass: [NSDictionary class]])
+    {
+        return objectOverhead + [value count] * 2 * sizeof(id);
+    }
+    return objectOverhead;
+}
+
+- (NSUInteger)estimatedMemoryUsage
+{
+    NSUInteger usage = class_getInstanceSize([self class]);
+
+    for (NSString *key in _variableStorage)
+    {
+        usage += 2 * sizeof(id) + COEstimatedMemoryUsageOfValue(_variableStorage[key]);
+    }
+    return usage;
+}
+
 - (BOOL)isIncomingRelationship: (ETPropertyDescription *)propDesc
 {
     if (propDesc.opposite != nil && propDesc.persistent && propDesc.opposite.persistent)
@@ -1931,6 +1971,22 @@ static void validateSingleValueConformsToPropertyDescriptionInRepository(id sing
  */
 - (void)replaceReferencesToObjectIdenticalTo: (COObject *)anObject
                                   withObject: (COObject *)aReplacement
+{
+    [self replaceReferencesToObjectIdenticalTo: anObject
+                                    withObject: aReplacement
+                                 forProperties: self.persistentPropertyNames];
+}
+
+/**
+ * Same as -replaceReferencesToObjectIdenticalTo:withObject:, but only visits
+ * the given properties.
+ *
+ * The caller knows which properties hold the references from the relationship
+ * caches, so the other properties don't need to be checked.
+ */
+- (void)replaceReferencesToObjectIdenticalTo: (COObject *)anObject
+                                  withObject: (COObject *)aReplacement
+                               forProperties: (id <NSFastEnumeration>)properties
 {
     ETAssert(!(anObject == nil && aReplacement == nil));
     id object = anObject;
@@ -1963,7 +2019,16 @@ static void validateSingleValueConformsToPropertyDescriptionInRepository(id sing
         }
     }
 
-    for (NSString *key in self.persistentPropertyNames)
+    [self replaceReferencesToObject: object
+                         withObject: replacement
+                      forProperties: properties];
+}
+
+- (void)replaceReferencesToObject: (id)object
+                       withObject: (id)replacement
+                    forProperties: (id <NSFastEnumeration>)properties
+{
+    for (NSString *key in properties)
     {
         id value = [self serializableValueForStorageKey: key];
         BOOL updated = NO;
@@ -87,12 +87,49 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, readwrite, assign) BOOL ignoresChangeTrackingNotifications;
 @property (nonatomic, readonly, strong) COItemGraph *modifiedItemsSnapshot;
+/**
+ * Returns the items of the changed objects (additional items included) by
+ * UUID.
+ *
+ * Updated objects whose items are equal to the last committed ones (e.g. a 
+ * property was set back to its original value) are skipped.
+ *
+ * Doesn't touch the change tracking, see -discardUnchangedObjectsExceptItems:.
+ */
+- (NSMutableDictionary<ETUUID *, COItem *> *)changedItemsForCommit;
+/**
+ * Removes the updated objects, whose items are not among the given ones, from
+ * the change tracking.
+ *
+ * Must be called with the items returned by -changedItemsForCommit, to forget
+ * the objects whose changes were reverted when no commit is made.
+ */
+- (void)discardUnchangedObjectsExceptItems: (NSDictionary<ETUUID *, COItem *> *)changedItemsByUUID;
+/**
+ * Same as -acceptAllChanges, but records the given items (keyed by UUID) as
+ * the last committed ones, to detect objects whose state goes back to the
+ * committed one later.
+ *
+ * The items must match the current state of the objects.
+ */
+- (void)acceptAllChangesWithCommittedItems: (nullable NSDictionary<ETUUID *, COItem *> *)itemsByUUID;
 
 
 /** @taskunit Cross Persistent Root References */
 
 
 - (void)replaceObject: (nullable COObject *)anObject withObject: (nullable COObject *)aReplacement;
+/**
+ * Same as -replaceObject:withObject:, but only visits the given referring
+ * objects and, for each one, the properties recorded in the map table.
+ *
+ * The map table keys are referring objects, and its values are collections of
+ * property names. Referring objects that don't belong to the receiver are
+ * ignored.
+ */
+- (void)replaceObject: (nullable COObject *)anObject
+           withObject: (nullable COObject *)aReplacement
+   inReferringObjects: (NSMapTable *)sourcePropertiesByReferrer;
 
 @property (nonatomic, readonly, getter=isTrackingSpecificBranch) BOOL trackingSpecificBranch;
 
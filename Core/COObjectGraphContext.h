@@ -186,6 +186,8 @@ extern NSString *const COObjectGraphContextEndBatchChangeNotification;
     NSMutableSet *_insertedObjectUUIDs;
     NSMutableSet *_updatedObjectUUIDs;
     NSMutableDictionary *_updatedPropertiesByUUID;
+    /** Items as last loaded with -setItemGraph: or committed, by UUID */
+    NSMutableDictionary *_committedItemsByUUID;
     /** How many commits have been done since last garbage collection */
     uint64_t _numberOfCommitsSinceLastGC;
     int _ignoresChangeTrackingNotifications;
@@ -334,6 +336,9 @@ extern NSString *const COObjectGraphContextEndBatchChangeNotification;
  * Does the same than -insertOrUpdateItems:, but in addition discards  
  * change tracking (calls -acceptAllChanges).
  *
+ * Objects whose items are equal to the items last loaded with this method (or
+ * committed), and which have no uncommitted changes, are not reloaded.
+ *
  * Only loads objects from aTree reachable from a depth-first search starting 
  * at the root object.
  *
@@ -462,6 +467,20 @@ extern NSString *const COObjectGraphContextEndBatchChangeNotification;
  */
 - (nullable id)loadedObjectForUUID: (ETUUID *)aUUID;
 
+
+/** @taskunit Memory Accounting */
+
+
+/**
+ * Returns a rough estimate of the bytes used by the loaded inner objects.
+ *
+ * The estimate is computed by visiting every loaded object, the cost is
+ * proportional to -loadedObjects.
+ *
+ * See also -[COEditingContext memoryBudget].
+ */
+@property (nonatomic, readonly) NSUInteger estimatedMemoryUsage;
+
 @end
 
 NS_ASSUME_NONNULL_END
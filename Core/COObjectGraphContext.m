@@ -15,11 +15,14 @@
 #import "COMetamodel.h"
 #import "COSerialization.h"
 #import "COPersistentRoot.h"
+#import "COPersistentRoot+Private.h"
 #import "COBranch.h"
 #import "COBranch+Private.h"
 #import "COItem.h"
+#import "COItem+Binary.h"
 #import "CODictionary.h"
 #import "COPath.h"
+#include <objc/runtime.h>
 
 NSString *const COObjectGraphContextObjectsDidChangeNotification = @"COObjectGraphContextObjectsDidChangeNotification";
 
@@ -75,6 +78,7 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
     _insertedObjectUUIDs = [[NSMutableSet alloc] init];
     _updatedObjectUUIDs = [[NSMutableSet alloc] init];
     _updatedPropertiesByUUID = [[NSMutableDictionary alloc] init];
+    _committedItemsByUUID = [[NSMutableDictionary alloc] init];
     _branch = aBranch;
     _persistentRoot = aBranch.persistentRoot;
     _futureBranchUUID = (aBranch == nil ? [ETUUID UUID] : nil);
@@ -192,7 +196,7 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
 
 - (BOOL)isTrackingSpecificBranch
 {
-    return _persistentRoot != nil && self != _persistentRoot.objectGraphContext;
+    return _persistentRoot != nil && self != _persistentRoot.objectGraphContextWithoutUnfaulting;
 }
 
 #pragma mark -
@@ -433,6 +437,40 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
     ETAssert([_objectsByAdditionalItemUUIDs.allKeys containsCollection: [[currentObject additionalStoreItemUUIDs] allValues]]);
 }
 
+/**
+ * Allocates the objects for the items not yet loaded, in a single pass and 
+ * before any item is deserialized.
+ *
+ * This way, -objectReferenceWithUUID: resolves almost all references by a 
+ * simple lookup in the loaded objects, and the entity description is looked up 
+ * once per entity name rather than once per item.
+ *
+ * Objects allocated in this way don't receive -willLoadObjectGraph, so 
+ * -beginLoadingObjectsWithUUIDs: must be called before.
+ */
+- (void)allocateObjectsForItems: (NSSet *)items
+{
+    NSMutableDictionary *entityDescriptionsByName = [NSMutableDictionary new];
+
+    for (COItem *item in items)
+    {
+        if (_loadedObjects[item.UUID] != nil)
+            continue;
+
+        NSString *entityName = item.entityName;
+        ETEntityDescription *entityDesc =
+            (entityName != nil ? entityDescriptionsByName[entityName] : nil);
+
+        if (entityDesc == nil)
+        {
+            entityDesc = [self descriptionForItem: item];
+            entityDescriptionsByName[entityName] = entityDesc;
+        }
+
+        [self objectWithUUID: item.UUID entityDescription: entityDesc];
+    }
+}
+
 /**
  * Caller must handle marking the item as inserted/updated, if desired.
  */
@@ -479,47 +517,140 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
     return items;
 }
 
-- (void)addItemsFromItemGraph: (id <COItemGraph>)itemGraph
-                loadableUUIDs: (NSSet *)itemUUIDs
+/**
+ * Returns whether the item is equal to the committed one.
+ *
+ * Content hashes are cached for immutable items, so they can cheaply tell
+ * the items differ. Equal hashes are confirmed with -isEqual:, to ensure a hash
+ * collision doesn't hide a change.
+ */
+static inline BOOL isEqualToCommittedItem(COItem *item, COItem *committedItem)
+{
+    if (committedItem == nil)
+        return NO;
+
+    const BOOL hasCachedContentHashes = ![item isKindOfClass: [COMutableItem class]]
+        && ![committedItem isKindOfClass: [COMutableItem class]];
+
+    if (hasCachedContentHashes && item.contentHash != committedItem.contentHash)
+        return NO;
+
+    return [item isEqual: committedItem];
+}
+
+/**
+ * Returns whether the item is equal to the last committed one, and whether the
+ * object owning it has no uncommitted changes (the object state matches the 
+ * last committed item).
+ */
+- (BOOL)isUnchangedItem: (COItem *)item
+{
+    ETUUID *UUID = item.UUID;
+    COItem *committedItem = _committedItemsByUUID[UUID];
+
+    if (committedItem == nil)
+        return NO;
+
+    COObject *owner = _loadedObjects[UUID];
+
+    if (owner == nil)
+    {
+        owner = _objectsByAdditionalItemUUIDs[UUID];
+    }
+    ETAssert(owner != nil);
+
+    if ([_updatedObjectUUIDs containsObject: owner.UUID]
+        || [_insertedObjectUUIDs containsObject: owner.UUID])
+    {
+        return NO;
+    }
+    return isEqualToCommittedItem(item, committedItem);
+}
+
+/**
+ * Returns the item graph snapshot from which the items were loaded.
+ *
+ * See -addItemsFromItemGraph:loadableUUIDs:.
+ */
+- (id <COItemGraph>)loadItemsFromItemGraph: (id <COItemGraph>)itemGraph
+                             loadableUUIDs: (NSSet *)itemUUIDs
 {
     NSParameterAssert(itemGraph != nil);
     NSParameterAssert(itemUUIDs != nil);
 
-    // NOTE: To prevent caching the item graph during the loading, a better
-    // approach could be to allocate all the objects before loading them.
-    // We could also change -[COObjectGraphContext itemForUUID:] to search
-    // itemGraph during the loading rather than the loaded objects (but that's
-    // roughly the same than we do currently).
-    _loadingItemGraph = [[COItemGraph alloc] initWithItems: itemGraph.items
-                                              rootItemUUID: itemGraph.rootItemUUID];
+    // NOTE: When the item graph is another object graph context (e.g. when
+    // copying the current branch state into the persistent root object graph),
+    // its items change while we load the objects, so we must take a snapshot.
+    // A COItemGraph (e.g. returned by the store) is not touched during the
+    // loading, and can be used as is.
+    if ([itemGraph isKindOfClass: [COItemGraph class]])
+    {
+        _loadingItemGraph = itemGraph;
+    }
+    else
+    {
+        _loadingItemGraph = [[COItemGraph alloc] initWithItems: itemGraph.items
+                                                  rootItemUUID: itemGraph.rootItemUUID];
+    }
     // TODO: Decide how we update the change tracking in regard to additional items.
 
-    // Update change tracking
+    // Items equal to the last committed ones don't need to be reloaded, this
+    // spares deserialization and KVO notifications. An owner item gets
+    // reloaded if one of its additional items changed.
+    NSMutableSet *changedUUIDs = [NSMutableSet setWithCapacity: itemUUIDs.count];
+
     for (ETUUID *UUID in itemUUIDs)
+    {
+        COItem *item = [_loadingItemGraph itemForUUID: UUID];
+        const BOOL isLoaded = (_loadedObjects[UUID] != nil || _objectsByAdditionalItemUUIDs[UUID] != nil);
+
+        if (isLoaded && item != nil && [self isUnchangedItem: item])
+            continue;
+
+        [changedUUIDs addObject: UUID];
+    }
+
+    // Update change tracking
+    for (ETUUID *UUID in changedUUIDs)
     {
         if (_loadedObjects[UUID] != nil)
         {
-            // TODO: Check it the item is actually different?
             [_updatedObjectUUIDs addObject: UUID];
         }
         else
         {
+            COObject *owner = _objectsByAdditionalItemUUIDs[UUID];
+
+            // The owner item can be unchanged, but the owner is reloaded
+            if (owner != nil)
+            {
+                [_updatedObjectUUIDs addObject: owner.UUID];
+            }
             [_insertedObjectUUIDs addObject: UUID];
         }
     }
 
     NSSet *mainItems = [self mainItemsFromItemGraph: _loadingItemGraph
-                                      loadableUUIDs: itemUUIDs];
+                                      loadableUUIDs: changedUUIDs];
     NSSet *mainItemUUIDs = (id)[[mainItems mappedCollection] UUID];
 
     [self beginLoadingObjectsWithUUIDs: mainItemUUIDs];
+    [self allocateObjectsForItems: mainItems];
     for (COItem *item in mainItems)
     {
         [self addItem: item];
     }
     [self finishLoadingObjectsWithUUIDs: mainItemUUIDs];
 
+    id <COItemGraph> loadedItemGraph = _loadingItemGraph;
     _loadingItemGraph = nil;
+    return loadedItemGraph;
+}
+
+- (void)addItemsFromItemGraph: (id <COItemGraph>)itemGraph
+                loadableUUIDs: (NSSet *)itemUUIDs
+{
+    [self loadItemsFromItemGraph: itemGraph loadableUUIDs: itemUUIDs];
 }
 
 - (void)insertOrUpdateItems: (NSArray *)items
@@ -567,11 +698,22 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
         aTreeReachableUUIDs = [NSSet setWithArray: aTree.itemUUIDs];
     }
 
-    [self addItemsFromItemGraph: aTree
-                  loadableUUIDs: aTreeReachableUUIDs];
+    id <COItemGraph> loadedItemGraph = [self loadItemsFromItemGraph: aTree
+                                                     loadableUUIDs: aTreeReachableUUIDs];
+    NSMutableDictionary *loadedItems = [NSMutableDictionary dictionaryWithCapacity: aTreeReachableUUIDs.count];
+
+    for (ETUUID *UUID in aTreeReachableUUIDs)
+    {
+        COItem *item = [loadedItemGraph itemForUUID: UUID];
+
+        if (item == nil)
+            continue;
+
+        loadedItems[UUID] = item;
+    }
 
     // Clear change tracking
-    [self acceptAllChanges];
+    [self acceptAllChangesWithCommittedItems: loadedItems];
 
     [[NSNotificationCenter defaultCenter] postNotificationName: COObjectGraphContextEndBatchChangeNotification
                                                         object: self];
@@ -724,6 +866,8 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
 
     [_insertedObjectUUIDs removeObject: uuid];
     [_updatedObjectUUIDs removeObject: uuid];
+    [_committedItemsByUUID removeObjectForKey: uuid];
+    [_committedItemsByUUID removeObjectsForKeys: anObject.additionalStoreItemUUIDs.allValues];
 
     // Remove it from the additional item to object lookup table
 
@@ -735,10 +879,28 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
 }
 
 - (void)acceptAllChanges
+{
+    [self acceptAllChangesWithCommittedItems: nil];
+}
+
+- (void)acceptAllChangesWithCommittedItems: (NSDictionary *)itemsByUUID
 {
     NSSet *insertedObjects = [_insertedObjectUUIDs copy];
     NSSet *updatedObjects = [_updatedObjectUUIDs copy];
 
+    // The last committed items don't represent the changed objects anymore
+    for (ETUUID *uuid in [insertedObjects setByAddingObjectsFromSet: updatedObjects])
+    {
+        [_committedItemsByUUID removeObjectForKey: uuid];
+        [_committedItemsByUUID removeObjectsForKeys:
+            [_loadedObjects[uuid] additionalStoreItemUUIDs].allValues];
+    }
+    for (ETUUID *uuid in itemsByUUID)
+    {
+        // A mutable item could be changed by its owner once committed
+        _committedItemsByUUID[uuid] = [itemsByUUID[uuid] copy];
+    }
+
     [_insertedObjectUUIDs removeAllObjects];
     [_updatedObjectUUIDs removeAllObjects];
     [_updatedPropertiesByUUID removeAllObjects];
@@ -804,6 +966,21 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
     return objects;
 }
 
+#pragma mark -
+#pragma mark Memory Accounting
+
+- (NSUInteger)estimatedMemoryUsage
+{
+    NSUInteger usage = class_getInstanceSize([self class]);
+
+    for (COObject *object in _loadedObjects.objectEnumerator)
+    {
+        // Includes the UUID key and the dictionary slot
+        usage += 4 * sizeof(id) + object.estimatedMemoryUsage;
+    }
+    return usage;
+}
+
 #pragma mark -
 #pragma mark Garbage Collection
 
@@ -823,21 +1000,24 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
  * The undeleted object is an outer root object that may be referenced by
  * outgoing relationships of the receiver inner objects.
  *
- * The referring objects are the inner objects that hold a reference to it.
+ * Returns the properties holding a dead reference to it, keyed by referring
+ * inner object.
  *
  * For -updateCrossPersistentRootReferencesToPersistentRoot:branch:isFault:,
  * this method is a bottleneck. To make it even faster, we could access ivars
  * directly and preallocate some COPath objects.
  */
-- (NSSet *)referringObjectsWithDeadReferencesToObject: (COObject *)undeletedObject
+- (NSMapTable *)sourcePropertiesByReferringObjectWithDeadReferencesToObject: (COObject *)undeletedObject
 {
     COObjectGraphContext *undeletedObjectGraphContext = undeletedObject.objectGraphContext;
+    NSMapTable *result = [NSMapTable mapTableWithKeyOptions: NSPointerFunctionsObjectPointerPersonality
+                                               valueOptions: NSPointerFunctionsStrongMemory];
 
     ETAssert(undeletedObjectGraphContext != self);
     ETDebugAssert(undeletedObject == undeletedObjectGraphContext.rootObject);
 
     if (_persistentRoot == nil)
-        return [NSSet set];
+        return result;
 
     COCrossPersistentRootDeadRelationshipCache *deadRelationshipCache =
         _persistentRoot.editingContext.deadRelationshipCache;
@@ -853,7 +1033,17 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
         pathToUndeletedObject = [COPath pathWithPersistentRoot: undeletedObjectGraphContext.persistentRoot.UUID];
     }
 
-    return [deadRelationshipCache referringObjectsForPath: pathToUndeletedObject].setRepresentation;
+    for (COObject *referrer in [deadRelationshipCache referringObjectsForPath: pathToUndeletedObject])
+    {
+        if (referrer.objectGraphContext != self)
+            continue;
+
+        // Copied, since replacing the dead references updates the cache
+        [result setObject: [[deadRelationshipCache sourcePropertiesOfReferringObject: referrer
+                                                                             forPath: pathToUndeletedObject] copy]
+                   forKey: referrer];
+    }
+    return result;
 }
 
 - (BOOL)ignoresChangeTrackingNotifications
@@ -893,30 +1083,83 @@ NSString *const COObjectGraphContextEndBatchChangeNotification = @"COObjectGraph
  */
 - (void)replaceObject: (COObject *)anObject withObject: (COObject *)aReplacement
 {
-    NSSet *referringObjects = nil;
+    NSMapTable *sourcePropertiesByReferrer = nil;
     const BOOL isUndeletion = (anObject == nil);
 
     if (isUndeletion)
     {
-        referringObjects = [self referringObjectsWithDeadReferencesToObject: aReplacement];
+        sourcePropertiesByReferrer =
+            [self sourcePropertiesByReferringObjectWithDeadReferencesToObject: aReplacement];
     }
     else
     {
-        referringObjects = anObject.incomingRelationshipCache.referringObjects;
+        sourcePropertiesByReferrer = anObject.incomingRelationshipCache.sourcePropertiesByReferringObject;
     }
 
+    [self replaceObject: anObject
+             withObject: aReplacement
+     inReferringObjects: sourcePropertiesByReferrer];
+}
+
+- (void)replaceObject: (COObject *)anObject
+           withObject: (COObject *)aReplacement
+   inReferringObjects: (NSMapTable *)sourcePropertiesByReferrer
+{
     self.ignoresChangeTrackingNotifications = YES;
-    for (COObject *referrer in referringObjects)
+    for (COObject *referrer in sourcePropertiesByReferrer)
     {
         if (referrer.objectGraphContext != self)
             continue;
 
         [referrer replaceReferencesToObjectIdenticalTo: anObject
-                                            withObject: aReplacement];
+                                            withObject: aReplacement
+                                         forProperties: [sourcePropertiesByReferrer objectForKey: referrer]];
     }
     self.ignoresChangeTrackingNotifications = NO;
 }
 
+- (NSMutableDictionary *)changedItemsForCommit
+{
+    NSMutableDictionary *itemsByUUID = [NSMutableDictionary new];
+
+    for (ETUUID *uuid in self.changedObjectUUIDs)
+    {
+        COObject *object = _loadedObjects[uuid];
+        COItem *item = object.storeItem;
+        NSMutableDictionary *additionalItems = [NSMutableDictionary new];
+        BOOL isUnchanged = ![_insertedObjectUUIDs containsObject: uuid]
+            && isEqualToCommittedItem(item, _committedItemsByUUID[uuid]);
+
+        for (ETUUID *itemUUID in [object.additionalStoreItemUUIDs objectEnumerator])
+        {
+            COItem *additionalItem = [object additionalStoreItemForUUID: itemUUID];
+
+            additionalItems[itemUUID] = additionalItem;
+            isUnchanged = isUnchanged
+                && isEqualToCommittedItem(additionalItem, _committedItemsByUUID[itemUUID]);
+        }
+
+        if (isUnchanged)
+            continue;
+
+        itemsByUUID[uuid] = item;
+        [itemsByUUID addEntriesFromDictionary: additionalItems];
+    }
+    return itemsByUUID;
+}
+
+- (void)discardUnchangedObjectsExceptItems: (NSDictionary *)changedItemsByUUID
+{
+    for (ETUUID *uuid in [_updatedObjectUUIDs copy])
+    {
+        if (changedItemsByUUID[uuid] != nil)
+            continue;
+
+        [_updatedObjectUUIDs removeObject: uuid];
+        [_updatedPropertiesByUUID removeObjectForKey: uuid];
+    }
+}
+
 - (COItemGraph *)modifiedItemsSnapshot
 {
     NSSet *objectUUIDs = self.changedObjectUUIDs;
@@ -38,6 +38,13 @@ extern NSString *const COPersistentRootName;
 
 @property (nonatomic, readonly, strong) COPersistentRootInfo *persistentRootInfo;
 @property (nonatomic, readonly, getter=isPersistentRootUncommitted) BOOL persistentRootUncommitted;
+/**
+ * Returns -objectGraphContext without loading its objects.
+ *
+ * When -isObjectGraphContextLoaded is NO, the returned object graph context is 
+ * empty.
+ */
+@property (nonatomic, readonly, strong) COObjectGraphContext *objectGraphContextWithoutUnfaulting;
 
 
 /** @taskunit Committing Changes */
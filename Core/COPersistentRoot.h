@@ -186,6 +186,11 @@ extern NSString *const COPersistentRootDidChangeNotification;
     NSDictionary *_metadata;
     BOOL _metadataChanged;
     COObjectGraphContext *_objectGraphContext;
+    /**
+     * Whether _objectGraphContext is empty until the current revision is
+     * loaded on first access.
+     */
+    BOOL _objectGraphContextFaulted;
 }
 
 
@@ -463,17 +468,50 @@ extern NSString *const COPersistentRootDidChangeNotification;
  * contains some changes, a commit must be done, to start making changes to its 
  * counterpart.
  *
+ * A persistent root loaded from the store doesn't load its objects until 
+ * this object graph context or -rootObject is accessed, so enumerating 
+ * persistent roots (e.g. with -[COEditingContext persistentRoots]) is cheap.
+ *
  * See also -allObjectGraphContexts and -rootObject (for cross persistent root 
  * references).
  */
 @property (nonatomic, readonly) COObjectGraphContext *objectGraphContext;
+/**
+ * Returns whether -objectGraphContext has been loaded.
+ *
+ * Accessing -objectGraphContext or -rootObject loads it.
+ */
+@property (nonatomic, readonly, getter=isObjectGraphContextLoaded) BOOL objectGraphContextLoaded;
 /**
  * This method is only exposed to be used internally by CoreObject.
  *
  * Returns the object graphs for the -branches (if they have been instantiated),
- * plus the object graph that dynamically tracks the -currentBranch (see -objectGraphContext).
+ * plus the object graph that dynamically tracks the -currentBranch (see 
+ * -objectGraphContext) if it has been loaded.
  */
 @property (nonatomic, readonly) NSSet<COObjectGraphContext *> *allObjectGraphContexts;
+/**
+ * Returns a rough estimate of the bytes used by the persistent root, its
+ * branches and their object graph contexts (if they have been instantiated),
+ * plus -objectGraphContext.
+ *
+ * Doesn't cause any object graph context to be loaded.
+ *
+ * See also -[COEditingContext memoryBudget].
+ */
+@property (nonatomic, readonly) NSUInteger estimatedMemoryUsage;
+/**
+ * Whether the editing context can unload the persistent root automatically to
+ * stay within -[COEditingContext memoryBudget].
+ *
+ * Only set this to YES if the application doesn't hold the persistent root,
+ * its branches or its inner objects, since unloading invalidates them. The
+ * setting is kept by the editing context, and remains valid when the
+ * persistent root is reloaded.
+ *
+ * By default, returns NO.
+ */
+@property (nonatomic, readwrite, assign, getter=isEvictable) BOOL evictable;
 
 
 /** @taskunit Committing Changes */
@@ -19,6 +19,7 @@
 #import "COEditingContext+Undo.h"
 #import "COEditingContext+Private.h"
 #import "COStoreTransaction.h"
+#include <objc/runtime.h>
 
 NSString *const COPersistentRootDidChangeNotification = @"COPersistentRootDidChangeNotification";
 
@@ -32,7 +33,6 @@ NSString *const COPersistentRootName = @"org.etoile.coreobject.name";
 @synthesize editingContext = _editingContext, UUID = _UUID, persistentRootInfo = _persistentRootInfo;
 @synthesize branchesPendingDeletion = _branchesPendingDeletion;
 @synthesize branchesPendingUndeletion = _branchesPendingUndeletion;
-@synthesize objectGraphContext = _objectGraphContext;
 
 #pragma mark Creating a New Persistent Root -
 
@@ -121,8 +121,8 @@ NSString *const COPersistentRootName = @"org.etoile.coreobject.name";
         [_editingContext setLastTransactionID: _persistentRootInfo.transactionID
                         forPersistentRootUUID: _UUID];
         _metadata = _persistentRootInfo.metadata;
-
-        [self reloadCurrentBranchObjectGraph];
+        // The objects are loaded on the first -objectGraphContext access
+        _objectGraphContextFaulted = YES;
     }
     else
     {
@@ -183,8 +183,9 @@ NSString *const COPersistentRootName = @"org.etoile.coreobject.name";
     if (self.isZombie)
         return @"<zombie persistent root>";
 
+    // Don't load the objects to describe the persistent root
     return [NSString stringWithFormat: @"<%@ %p - %@ - %@>", NSStringFromClass([self class]),
-                                       self, _UUID, [self.rootObject entityDescription].name];
+                                       self, _UUID, [_objectGraphContext.rootObject entityDescription].name];
 }
 
 - (NSString *)detailedDescription
@@ -228,10 +229,48 @@ NSString *const COPersistentRootName = @"org.etoile.coreobject.name";
 
 - (void)reloadCurrentBranchObjectGraph
 {
+    // The current revision will be loaded on the first access
+    if (_objectGraphContextFaulted)
+        return;
+
     [self setCurrentBranchObjectGraphToRevisionUUID: self.currentRevision.UUID
                                  persistentRootUUID: _UUID];
 }
 
+/**
+ * For the interaction with cross persistent root references, see
+ * -setCurrentBranchObjectGraphToRevisionUUID:persistentRootUUID: and 
+ * -[COBranch objectGraphContext] whose unfaulting logic is the same.
+ */
+- (COObjectGraphContext *)objectGraphContext
+{
+    if (_objectGraphContextFaulted)
+    {
+        //NSLog(@"%@: unfaulting object graph context", self);
+
+        _objectGraphContextFaulted = NO;
+        [self reloadCurrentBranchObjectGraph];
+        ETAssert(!_objectGraphContext.hasChanges);
+
+        // Lazy loading support
+        [_editingContext updateCrossPersistentRootReferencesToPersistentRoot: self
+                                                                      branch: nil
+                                                                     isFault: self.deleted];
+        [_editingContext didLoadPersistentRoot: self];
+    }
+    return _objectGraphContext;
+}
+
+- (COObjectGraphContext *)objectGraphContextWithoutUnfaulting
+{
+    return _objectGraphContext;
+}
+
+- (BOOL)isObjectGraphContextLoaded
+{
+    return !_objectGraphContextFaulted;
+}
+
 #pragma mark Persistent Root Properties -
 
 - (NSDictionary *)metadata
@@ -543,7 +582,11 @@ NSString *const COPersistentRootName = @"org.etoile.coreobject.name";
 - (NSSet *)allObjectGraphContexts
 {
     NSMutableSet *objectGraphs = [NSMutableSet setWithCapacity: _branchForUUID.count + 1];
-    [objectGraphs addObject: _objectGraphContext];
+
+    if (!_objectGraphContextFaulted)
+    {
+        [objectGraphs addObject: _objectGraphContext];
+    }
 
     for (COBranch *branch in _branchForUUID.objectEnumerator)
     {
@@ -557,19 +600,40 @@ NSString *const COPersistentRootName = @"org.etoile.coreobject.name";
     return objectGraphs;
 }
 
+- (NSUInteger)estimatedMemoryUsage
+{
+    NSUInteger usage = class_getInstanceSize([self class]) + _objectGraphContext.estimatedMemoryUsage;
+
+    for (COBranch *branch in _branchForUUID.objectEnumerator)
+    {
+        usage += branch.estimatedMemoryUsage;
+    }
+    return usage;
+}
+
+- (BOOL)isEvictable
+{
+    return [_editingContext isPersistentRootUUIDEvictable: _UUID];
+}
+
+- (void)setEvictable: (BOOL)evictable
+{
+    [_editingContext setEvictable: evictable forPersistentRootUUID: _UUID];
+}
+
 - (id)rootObject
 {
-    return _objectGraphContext.rootObject;
+    return self.objectGraphContext.rootObject;
 }
 
 - (void)setRootObject: (COObject *)aRootObject
 {
-    _objectGraphContext.rootObject = aRootObject;
+    self.objectGraphContext.rootObject = aRootObject;
 }
 
 - (COObject *)loadedObjectForUUID: (ETUUID *)uuid
 {
-    return [_objectGraphContext loadedObjectForUUID: uuid];
+    return [self.objectGraphContext loadedObjectForUUID: uuid];
 }
 
 - (CORevision *)currentRevision
@@ -657,10 +721,14 @@ NSString *const COPersistentRootName = @"org.etoile.coreobject.name";
                     format: @"Attempted to commit changes to deleted persistent root %@", self];
     }
     ETAssert(self.currentBranch != nil);
-    ETAssert(self.rootObject != nil);
-    ETAssert([self.rootObject isRoot]);
-    ETAssert(_objectGraphContext.rootObject != nil
-             || self.currentBranch.objectGraphContextWithoutUnfaulting.rootObject != nil);
+    // An object graph context not loaded yet contains no changes to commit
+    if (!_objectGraphContextFaulted)
+    {
+        ETAssert(self.rootObject != nil);
+        ETAssert([self.rootObject isRoot]);
+        ETAssert(_objectGraphContext.rootObject != nil
+                 || self.currentBranch.objectGraphContextWithoutUnfaulting.rootObject != nil);
+    }
 
     if (self.persistentRootUncommitted)
     {
@@ -52,6 +52,13 @@ NS_ASSUME_NONNULL_BEGIN
 - (instancetype)initWithOwner: (COObject *)owner NS_DESIGNATED_INITIALIZER;
 
 @property (nonatomic, readonly) NSSet<__kindof COObject *> *referringObjects;
+/**
+ * Returns the properties holding a reference to the owning COObject, keyed by
+ * referring object.
+ *
+ * The keys are compared by pointer, and the values are NSMutableSet instances.
+ */
+@property (nonatomic, readonly) NSMapTable *sourcePropertiesByReferringObject;
 
 /**
  * Returns an array of COObject which have a reference to the
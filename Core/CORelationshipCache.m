@@ -139,6 +139,29 @@
     return result;
 }
 
+- (NSMapTable *)sourcePropertiesByReferringObject
+{
+    NSMapTable *result = [NSMapTable mapTableWithKeyOptions: NSPointerFunctionsObjectPointerPersonality
+                                               valueOptions: NSPointerFunctionsStrongMemory];
+
+    for (COCachedRelationship *entry in _cachedRelationships)
+    {
+        // See -referringObjects
+        if (entry->_sourceObject == nil)
+            continue;
+
+        NSMutableSet *properties = [result objectForKey: entry->_sourceObject];
+
+        if (properties == nil)
+        {
+            properties = [NSMutableSet new];
+            [result setObject: properties forKey: entry->_sourceObject];
+        }
+        [properties addObject: entry->_sourceProperty];
+    }
+    return result;
+}
+
 - (COObject *)referringObjectForPropertyInTarget: (NSString *)aProperty
 {
     NILARG_EXCEPTION_TEST(aProperty);
@@ -15,6 +15,7 @@
 #import "COPrimitiveCollection.h"
 #import "COAttachmentID.h"
 #import "COPersistentRoot.h"
+#import "COPersistentRoot+Private.h"
 #import "COBranch.h"
 #import "COEditingContext+Private.h"
 #import "CODateSerialization.h"
@@ -151,7 +152,7 @@ static id serializedReferenceInContextForObject(COObjectGraphContext *objectGrap
 
         COPersistentRoot *referencedPersistentRoot = value.persistentRoot;
         COObjectGraphContext *referencedPersistentRootCurrentBranchGraph =
-            referencedPersistentRoot.objectGraphContext;
+            referencedPersistentRoot.objectGraphContextWithoutUnfaulting;
         COObjectGraphContext *referencedObjectGraph = value.objectGraphContext;
         COBranch *referencedBranch = value.branch;
 
@@ -52,6 +52,7 @@
 #import <CoreObject/COType.h>
 #import <CoreObject/COPath.h>
 #import <CoreObject/COAttachmentID.h>
+#import <CoreObject/COInterningTable.h>
 
 /* Store */
 
@@ -62,6 +63,8 @@
 #import <CoreObject/COSearchResult.h>
 #import <CoreObject/COSQLiteStore.h>
 #import <CoreObject/COSQLiteStore+Attachments.h>
+#import <CoreObject/COSharedRevisionCache.h>
+#import <CoreObject/COStoreMetrics.h>
 
 /* Undo */
 
@@ -79,6 +82,8 @@
 #import <CoreObject/COSynchronizerServer.h>
 #import <CoreObject/COSynchronizerJSONClient.h>
 #import <CoreObject/COSynchronizerJSONServer.h>
+#import <CoreObject/COSynchronizerBinaryClient.h>
+#import <CoreObject/COSynchronizerBinaryServer.h>
 
 /* Utilities */
 
@@ -60,6 +60,16 @@ NS_ASSUME_NONNULL_BEGIN
                 algorithmClasses: (NSDictionary<NSString *, Class> *)algorithmClasses
                 sourceIdentifier: (id)aSource;
 - (CODiffManager *)diffByMergingWithDiff: (CODiffManager *)otherDiff;
+/**
+ * Returns whether all the items are diffed with COItemGraphDiff, whose edits
+ * are local to each item.
+ *
+ * When this is the case, diffing only the changed items results in the same
+ * edits than diffing the whole item graphs. Other diff algorithms such as
+ * COAttributedStringDiff can read the items related to the diffed ones.
+ */
++ (BOOL)itemsUseItemGraphDiff: (NSArray<COItem *> *)items
+   modelDescriptionRepository: (ETModelDescriptionRepository *)aRepository;
 
 
 /** @taskunit Accessing Subdiffs */
@@ -59,6 +59,20 @@
     return diffClass;
 }
 
++ (BOOL)itemsUseItemGraphDiff: (NSArray *)items
+   modelDescriptionRepository: (ETModelDescriptionRepository *)aRepository
+{
+    for (COItem *item in items)
+    {
+        Class diffClass = [self diffAlgorithmClassForItem: item
+                               modelDescriptionRepository: aRepository];
+
+        if (diffClass != [COItemGraphDiff class])
+            return NO;
+    }
+    return YES;
+}
+
 + (NSDictionary *)itemUUIDsPartitionedByDiffAlgorithmNameWithFirstItemGraph: (id <COItemGraph>)a
                                                             secondItemGraph: (id <COItemGraph>)b
                                                  modelDescriptionRepository: (ETModelDescriptionRepository *)aRepository
@@ -199,6 +213,13 @@
             resultDict[algorithmName] = [ourSubDiff itemTreeDiffByMergingWithDiff: otherSubDiff];
         }
     }
+    for (NSString *algorithmName in self.subDiffsByAlgorithmName)
+    {
+        if (resultDict[algorithmName] != nil)
+            continue;
+
+        resultDict[algorithmName] = self.subDiffsByAlgorithmName[algorithmName];
+    }
 
     result->subDiffsByAlgorithmName = resultDict;
     return result;
@@ -67,10 +67,9 @@
 
 - (id <COTrackNode>)nodeForRowAtIndexPath: (NSIndexPath *)indexPath
 {
-    NSArray *nodes = self.track.nodes;
-    const NSInteger reversedIndex = nodes.count - 1 - indexPath.row;
+    const NSInteger reversedIndex = self.track.count - 1 - indexPath.row;
 
-    return nodes[reversedIndex];
+    return [self.track nodesInRange: NSMakeRange(reversedIndex, 1)].firstObject;
 }
 
 - (BOOL)isFutureNode: (id <COTrackNode>)aNode
@@ -79,21 +78,11 @@
 
     id <COTrackNode> currentNode = self.track.currentNode;
     ETAssert(currentNode != nil);
-    BOOL isFuture = NO;
+    const NSUInteger nodeIndex = [self.track indexOfNode: aNode];
+    const NSUInteger currentNodeIndex = [self.track indexOfNode: currentNode];
 
-    for (id <COTrackNode> node in self.track.nodes)
-    {
-        if ([aNode isEqual: node])
-        {
-            return isFuture;
-        }
-        if ([node isEqual: currentNode])
-        {
-            isFuture = YES;
-        }
-    }
-    ETAssertUnreachable();
-    return NO;
+    ETAssert(nodeIndex != NSNotFound);
+    return nodeIndex > currentNodeIndex;
 }
 
 
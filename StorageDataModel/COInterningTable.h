@@ -0,0 +1,103 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#include <pthread.h>
+
+@class ETUUID, COPath;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The number of independently locked parts of the table, so threads decoding
+ * items concurrently rarely wait on each other.
+ */
+#define COInterningTableStripeCount 16
+/**
+ * The number of entries in a table part, at which the entries whose UUID or
+ * path was deallocated are removed the first time.
+ */
+#define COInterningTableMinimumPruneCount 64
+
+/**
+ * @group Storage Data Model
+ * @abstract A process-wide table that shares the UUIDs and paths decoded from
+ * serialized items.
+ *
+ * The same cross persistent root references come back over and over when
+ * item graphs are loaded, since many items point to the same few persistent
+ * roots and branches. The binary item reader asks this table for each path it
+ * decodes. While a path is alive, the table returns the same instance for the
+ * same bytes instead of allocating a new one, and paths share their
+ * persistent root and branch UUIDs.
+ *
+ * Item UUIDs and inner references are not interned, since each one is mostly
+ * unique within an item graph, and the lookup would cost more than it saves.
+ *
+ * The table only holds weak references, so the UUIDs and paths are deallocated
+ * as usual once the decoded items are gone. The entries left behind are
+ * removed each time a table part doubles in size.
+ *
+ * Entries are keyed by a UUID prefix. When two UUIDs share the same prefix,
+ * the most recently decoded one replaces the other in the table, and the
+ * other one is just not shared anymore.
+ *
+ * All methods are thread-safe.
+ */
+@interface COInterningTable : NSObject
+{
+@private
+    pthread_mutex_t _UUIDLocks[COInterningTableStripeCount];
+    pthread_mutex_t _pathLocks[COInterningTableStripeCount];
+    NSMapTable *_UUIDsByKey[COInterningTableStripeCount];
+    NSMapTable *_pathsByKey[COInterningTableStripeCount];
+    NSUInteger _UUIDPruneCounts[COInterningTableStripeCount];
+    NSUInteger _pathPruneCounts[COInterningTableStripeCount];
+}
+
+
+/** @taskunit Initialization */
+
+
+/**
+ * Returns the table used by the binary item reader.
+ */
++ (COInterningTable *)sharedTable;
+
+
+/** @taskunit Interning */
+
+
+/**
+ * Returns a UUID for the given 16 bytes, shared with the other callers that
+ * asked for the same bytes while it was alive.
+ */
+- (ETUUID *)UUIDWithBytes: (const unsigned char *)bytes;
+/**
+ * Returns a path for the given persistent root and branch UUID bytes, shared
+ * with the other callers that asked for the same path while it was alive.
+ *
+ * The branch bytes are NULL for a path to the current branch.
+ *
+ * The path persistent root and branch are interned UUIDs.
+ */
+- (COPath *)pathWithPersistentRootBytes: (const unsigned char *)persistentRootBytes
+                            branchBytes: (nullable const unsigned char *)branchBytes;
+
+
+/** @taskunit Debugging */
+
+
+/**
+ * Returns the number of UUID and path entries, including the ones whose UUID
+ * or path was deallocated but which were not removed yet.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,187 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COInterningTable.h"
+#import <EtoileFoundation/Macros.h>
+#import <EtoileFoundation/ETUUID.h>
+#import "COPath.h"
+#include <dispatch/dispatch.h>
+
+static inline uint64_t prefixOfUUIDBytes(const unsigned char *bytes)
+{
+    uint64_t prefix;
+    memcpy(&prefix, bytes, sizeof(prefix));
+    return prefix;
+}
+
+/**
+ * Returns a 48-bit key that fits in a tagged pointer, so building it doesn't
+ * allocate.
+ */
+static inline NSNumber *keyForPrefix(uint64_t aPrefix)
+{
+    return @(aPrefix >> 16);
+}
+
+static inline BOOL UUIDHasBytes(ETUUID *aUUID, const unsigned char *bytes)
+{
+    return memcmp(aUUID.UUIDValue, bytes, 16) == 0;
+}
+
+static NSMapTable *newWeakValueMapTable(void)
+{
+    return [[NSMapTable alloc] initWithKeyOptions: NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality
+                                     valueOptions: NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality
+                                         capacity: 0];
+}
+
+/**
+ * Removes the entries whose value was deallocated, if the table has reached
+ * the given count, and returns the count at which to prune it next.
+ */
+static NSUInteger pruneMapTableIfNeeded(NSMapTable *aTable, NSUInteger aPruneCount)
+{
+    if (aTable.count < aPruneCount)
+        return aPruneCount;
+
+    NSMutableArray *zeroedKeys = [NSMutableArray new];
+
+    for (id key in aTable)
+    {
+        if ([aTable objectForKey: key] == nil)
+        {
+            [zeroedKeys addObject: key];
+        }
+    }
+    for (id key in zeroedKeys)
+    {
+        [aTable removeObjectForKey: key];
+    }
+
+    // When most entries are alive, waiting for the table to double in size
+    // keeps the pruning cost per insertion constant
+    return MAX(COInterningTableMinimumPruneCount, aTable.count * 2);
+}
+
+static inline NSUInteger stripeIndexForPrefix(uint64_t aPrefix)
+{
+    return (NSUInteger)(aPrefix >> 16) % COInterningTableStripeCount;
+}
+
+
+@implementation COInterningTable
+
++ (COInterningTable *)sharedTable
+{
+    static COInterningTable *sharedTable = nil;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^()
+    {
+        sharedTable = [self new];
+    });
+    return sharedTable;
+}
+
+- (instancetype)init
+{
+    SUPERINIT;
+    for (NSUInteger i = 0; i < COInterningTableStripeCount; i++)
+    {
+        pthread_mutex_init(&_UUIDLocks[i], NULL);
+        pthread_mutex_init(&_pathLocks[i], NULL);
+        _UUIDsByKey[i] = newWeakValueMapTable();
+        _pathsByKey[i] = newWeakValueMapTable();
+        _UUIDPruneCounts[i] = COInterningTableMinimumPruneCount;
+        _pathPruneCounts[i] = COInterningTableMinimumPruneCount;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < COInterningTableStripeCount; i++)
+    {
+        pthread_mutex_destroy(&_UUIDLocks[i]);
+        pthread_mutex_destroy(&_pathLocks[i]);
+    }
+}
+
+- (ETUUID *)UUIDWithBytes: (const unsigned char *)bytes
+{
+    NSParameterAssert(bytes != NULL);
+    const uint64_t prefix = prefixOfUUIDBytes(bytes);
+    const NSUInteger stripe = stripeIndexForPrefix(prefix);
+    NSNumber *key = keyForPrefix(prefix);
+
+    pthread_mutex_lock(&_UUIDLocks[stripe]);
+
+    ETUUID *UUID = [_UUIDsByKey[stripe] objectForKey: key];
+
+    if (UUID == nil || !UUIDHasBytes(UUID, bytes))
+    {
+        UUID = [[ETUUID alloc] initWithUUID: bytes];
+        _UUIDPruneCounts[stripe] = pruneMapTableIfNeeded(_UUIDsByKey[stripe], _UUIDPruneCounts[stripe]);
+        [_UUIDsByKey[stripe] setObject: UUID forKey: key];
+    }
+
+    pthread_mutex_unlock(&_UUIDLocks[stripe]);
+    return UUID;
+}
+
+- (COPath *)pathWithPersistentRootBytes: (const unsigned char *)persistentRootBytes
+                            branchBytes: (const unsigned char *)branchBytes
+{
+    NSParameterAssert(persistentRootBytes != NULL);
+    const uint64_t branchPrefix = (branchBytes != NULL ? prefixOfUUIDBytes(branchBytes) : 0);
+    // Rotate the branch prefix, so the two prefixes don't cancel out
+    const uint64_t prefix = prefixOfUUIDBytes(persistentRootBytes) ^ (branchPrefix << 32 | branchPrefix >> 32);
+    const NSUInteger stripe = stripeIndexForPrefix(prefix);
+    NSNumber *key = keyForPrefix(prefix);
+
+    pthread_mutex_lock(&_pathLocks[stripe]);
+
+    COPath *path = [_pathsByKey[stripe] objectForKey: key];
+    const BOOL isSamePath = (path != nil
+        && UUIDHasBytes(path.persistentRoot, persistentRootBytes)
+        && (branchBytes == NULL ? path.branch == nil
+                                : path.branch != nil && UUIDHasBytes(path.branch, branchBytes)));
+
+    if (!isSamePath)
+    {
+        // The UUID locks are never held while taking a path lock, so this
+        // can't deadlock
+        ETUUID *branch = (branchBytes != NULL ? [self UUIDWithBytes: branchBytes] : nil);
+
+        path = [COPath pathWithPersistentRoot: [self UUIDWithBytes: persistentRootBytes]
+                                       branch: branch];
+        _pathPruneCounts[stripe] = pruneMapTableIfNeeded(_pathsByKey[stripe], _pathPruneCounts[stripe]);
+        [_pathsByKey[stripe] setObject: path forKey: key];
+    }
+
+    pthread_mutex_unlock(&_pathLocks[stripe]);
+    return path;
+}
+
+- (NSUInteger)count
+{
+    NSUInteger count = 0;
+
+    for (NSUInteger i = 0; i < COInterningTableStripeCount; i++)
+    {
+        pthread_mutex_lock(&_UUIDLocks[i]);
+        count += _UUIDsByKey[i].count;
+        pthread_mutex_unlock(&_UUIDLocks[i]);
+
+        pthread_mutex_lock(&_pathLocks[i]);
+        count += _pathsByKey[i].count;
+        pthread_mutex_unlock(&_pathLocks[i]);
+    }
+    return count;
+}
+
+@end
@@ -43,6 +43,19 @@ extern NSString *const kCOItemIsSharedProperty;
 {
 @package
     ETUUID *uuid;
+    /**
+     * The bytes returned by -[COItem(Binary) dataValue], retained manually 
+     * since it is set at most once, possibly while other threads read it.
+     *
+     * Always NULL for a COMutableItem.
+     */
+    void *_data;
+    /**
+     * The hash returned by -[COItem(Binary) contentHash], valid once
+     * _hasContentHash is set.
+     */
+    uint64_t _contentHash;
+    BOOL _hasContentHash;
 @protected
     NSMutableDictionary *types;
     NSMutableDictionary *values;
@@ -85,6 +85,14 @@ static NSDictionary *copyValueDictionary(NSDictionary *input, BOOL mutable)
     return [self initWithUUID: nil typesForAttributes: nil valuesForAttributes: nil];
 }
 
+- (void)dealloc
+{
+    if (_data != NULL)
+    {
+        (void)(__bridge_transfer NSData *)_data;
+    }
+}
+
 + (COItem *)itemWithTypesForAttributes: (NSDictionary *)typesForAttributes
                    valuesForAttributes: (NSDictionary *)valuesForAttributes
 {
@@ -127,6 +135,14 @@ static NSDictionary *copyValueDictionary(NSDictionary *input, BOOL mutable)
     COItem *otherItem = (COItem *)object;
 
     if (![otherItem->uuid isEqual: uuid]) return NO;
+    // The serialization is canonical, so the same bytes mean the same contents
+    if (_data != NULL && otherItem->_data != NULL
+        && [(__bridge NSData *)_data isEqualToData: (__bridge NSData *)otherItem->_data]) return YES;
+    // Computed by -[COItem(Binary) contentHash], but not worth computing for a
+    // single comparison
+    if (__atomic_load_n(&_hasContentHash, __ATOMIC_ACQUIRE)
+        && __atomic_load_n(&otherItem->_hasContentHash, __ATOMIC_ACQUIRE)
+        && _contentHash != otherItem->_contentHash) return NO;
     if (![otherItem->types isEqual: types]) return NO;
     if (![otherItem->values isEqual: values]) return NO;
     return YES;
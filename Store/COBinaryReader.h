@@ -7,7 +7,7 @@
 
 #import <Foundation/Foundation.h>
 
-@class ETUUID;
+@class ETUUID, COPath;
 
 typedef struct
 {
@@ -21,13 +21,33 @@ typedef struct
     void (*co_read_begin_array)(void *);
     void (*co_read_end_array)(void *);
     void (*co_read_null)(void *);
+    /**
+     * Can be NULL when the tokens contain no paths, reading a path raises an
+     * exception then.
+     */
+    void (*co_read_path)(void *, COPath *);
 } co_reader_callback_t;
 
+/**
+ * Reads the tokens and calls the matching callback for each one.
+ *
+ * The paths passed to the callbacks are interned with
+ * +[COInterningTable sharedTable].
+ */
 void co_reader_read(const unsigned char *bytes,
                     size_t length,
                     void *context,
                     co_reader_callback_t callbacks);
 
+/**
+ * Returns whether the bytes only contain known tokens that fit within the
+ * given length, with balanced objects and arrays.
+ *
+ * co_reader_read() doesn't check bounds, so bytes received from untrusted
+ * sources must be validated with this function first.
+ */
+BOOL co_reader_validate(const unsigned char *bytes, size_t length);
+
 /**
  * given a pointer to the start of a token, returns the length of that token
  * in bytes.
@@ -7,6 +7,7 @@
 
 #import "COBinaryReader.h"
 #import <EtoileFoundation/ETUUID.h>
+#import "COInterningTable.h"
 
 static inline uint8_t readUint8(const unsigned char *bytes)
 {
@@ -58,7 +59,10 @@ size_t co_reader_length_of_token(const unsigned char *bytes)
         case 'D':
             return 5 + readUint32(&bytes[1]);
         case '#':
+        case 'p':
             return 17;
+        case 'P':
+            return 33;
         case '{':
         case '}':
         case '[':
@@ -72,11 +76,80 @@ size_t co_reader_length_of_token(const unsigned char *bytes)
     return 0;
 }
 
+BOOL co_reader_validate(const unsigned char *bytes, size_t length)
+{
+    NSUInteger objectDepth = 0;
+    NSUInteger arrayDepth = 0;
+    size_t pos = 0;
+
+    while (pos < length)
+    {
+        const char type = bytes[pos];
+        size_t tokenLength;
+
+        switch (type)
+        {
+            case 's':
+            case 'd':
+                if (length - pos < 2)
+                    return NO;
+                tokenLength = 2 + readUint8(&bytes[pos + 1]);
+                break;
+            case 'S':
+            case 'D':
+                if (length - pos < 5)
+                    return NO;
+                tokenLength = 5 + (size_t)readUint32(&bytes[pos + 1]);
+                break;
+            case 'B':
+            case 'i':
+            case 'I':
+            case 'L':
+            case 'F':
+            case '#':
+            case 'p':
+            case 'P':
+            case '0':
+                tokenLength = co_reader_length_of_token(bytes + pos);
+                break;
+            case '{':
+                objectDepth++;
+                tokenLength = 1;
+                break;
+            case '}':
+                if (objectDepth == 0)
+                    return NO;
+                objectDepth--;
+                tokenLength = 1;
+                break;
+            case '[':
+                arrayDepth++;
+                tokenLength = 1;
+                break;
+            case ']':
+                if (arrayDepth == 0)
+                    return NO;
+                arrayDepth--;
+                tokenLength = 1;
+                break;
+            default:
+                return NO;
+        }
+
+        if (length - pos < tokenLength)
+            return NO;
+
+        pos += tokenLength;
+    }
+    return objectDepth == 0 && arrayDepth == 0;
+}
+
 void co_reader_read(const unsigned char *bytes,
                     size_t length,
                     void *context,
                     co_reader_callback_t callbacks)
 {
+    COInterningTable *internedValues = [COInterningTable sharedTable];
     size_t pos = 0;
 
     while (pos < length)
@@ -158,6 +231,22 @@ void co_reader_read(const unsigned char *bytes,
                 pos += 16;
                 break;
             }
+            case 'p':
+            case 'P':
+            {
+                if (callbacks.co_read_path == NULL)
+                {
+                    [NSException raise: NSGenericException
+                                format: @"unexpected path at offset %lu", (unsigned long)pos - 1];
+                }
+
+                const unsigned char *branchBytes = (type == 'P' ? bytes + pos + 16 : NULL);
+                COPath *path = [internedValues pathWithPersistentRootBytes: bytes + pos
+                                                               branchBytes: branchBytes];
+                callbacks.co_read_path(context, path);
+                pos += (type == 'P' ? 32 : 16);
+                break;
+            }
             case '{':
                 callbacks.co_read_begin_object(context);
                 break;
@@ -37,6 +37,14 @@ co_buffer_clear(co_buffer_t *dest)
     dest->length = 0;
 }
 
+static inline
+void
+co_buffer_truncate(co_buffer_t *dest, size_t length)
+{
+    assert(length <= dest->length);
+    dest->length = length;
+}
+
 static inline
 void
 co_buffer_free(co_buffer_t *dest)
@@ -65,7 +73,12 @@ co_buffer_ensure_available(co_buffer_t *dest, size_t len)
     const size_t currlength = dest->length;
     if (currlength + len > dest->allocated_length)
     {
-        dest->allocated_length = currlength + len + CO_BUFFER_INITIAL_LENGTH;
+        // Grow geometrically, so a buffer reused to write a large item graph
+        // token by token isn't reallocated every few kilobytes
+        const size_t doubledLength = 2 * dest->allocated_length;
+        const size_t requiredLength = currlength + len + CO_BUFFER_INITIAL_LENGTH;
+
+        dest->allocated_length = MAX(doubledLength, requiredLength);
         dest->data = realloc(dest->data, dest->allocated_length);
     }
 }
@@ -280,6 +293,27 @@ co_buffer_store_uuid(co_buffer_t *dest, ETUUID *uuid)
     co_buffer_write(dest, [uuid UUIDValue], 16);
 }
 
+/**
+ * Writes a cross persistent root reference as one or two UUIDs, the branch
+ * being nil for a reference to the current branch.
+ */
+static inline
+void
+co_buffer_store_path(co_buffer_t *dest, ETUUID *persistentRoot, ETUUID *branch)
+{
+    if (branch == nil)
+    {
+        WRTITE_TYPE("p");
+        co_buffer_write(dest, [persistentRoot UUIDValue], 16);
+    }
+    else
+    {
+        WRTITE_TYPE("P");
+        co_buffer_write(dest, [persistentRoot UUIDValue], 16);
+        co_buffer_write(dest, [branch UUIDValue], 16);
+    }
+}
+
 static inline
 void
 co_buffer_begin_object(co_buffer_t *dest)
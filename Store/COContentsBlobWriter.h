@@ -0,0 +1,42 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreObject/COItemGraph.h>
+#import "COBinaryWriter.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @group Store
+ * @abstract Serializes item graphs into revision contents.
+ *
+ * The writer streams every item directly into a single buffer, which is kept 
+ * and reused for the next item graph. The contents format is the one returned 
+ * by contentsBLOBWithItemTree().
+ *
+ * COSQLiteStore owns one writer used by all its backing stores. A writer is 
+ * not thread-safe.
+ */
+@interface COContentsBlobWriter : NSObject
+{
+    co_buffer_t _buffer;
+    co_buffer_t _temp;
+    NSMutableDictionary *_sortedAttributeNames;
+}
+
+/**
+ * Returns the revision contents for the item graph.
+ *
+ * The returned data doesn't copy the writer buffer, so it must not be used
+ * after the next call or once the writer is deallocated.
+ */
+- (NSData *)contentsBlobWithItemGraph: (id <COItemGraph>)anItemGraph;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,125 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COContentsBlobWriter.h"
+#import "COItem+Binary.h"
+#import "COSQLiteStorePersistentRootBackingStore.h"
+#import <EtoileFoundation/Macros.h>
+#import <EtoileFoundation/ETUUID.h>
+
+@implementation COContentsBlobWriter
+
+- (instancetype)init
+{
+    SUPERINIT;
+    co_buffer_init(&_buffer);
+    co_buffer_init(&_temp);
+    _sortedAttributeNames = [NSMutableDictionary new];
+    return self;
+}
+
+- (void)dealloc
+{
+    co_buffer_free(&_buffer);
+    co_buffer_free(&_temp);
+}
+
+static NSInteger compareUUIDs(id uuid1, id uuid2, void *context)
+{
+    const int result = memcmp([uuid1 UUIDValue], [uuid2 UUIDValue], 16);
+
+    return (result < 0)
+        ? NSOrderedAscending
+        : ((result == 0)
+            ? NSOrderedSame
+            : NSOrderedDescending);
+}
+
+/**
+ * Writes the revision contents for the item graph to dest.
+ */
+static void writeContentsBlob(co_buffer_t *dest,
+                              co_buffer_t *temp,
+                              NSMutableDictionary *sortedAttributeNames,
+                              id <COItemGraph> anItemGraph)
+{
+    NSArray *sortedUUIDs = [anItemGraph.itemUUIDs sortedArrayUsingFunction: compareUUIDs
+                                                                   context: NULL];
+
+    for (ETUUID *uuid in sortedUUIDs)
+    {
+        COItem *item = [anItemGraph itemForUUID: uuid];
+        const size_t lengthOffset = co_buffer_get_length(dest);
+
+        // Reserve the item length, then write the item in place
+        co_buffer_store_uint32(dest, 0);
+        [item writeToBuffer: dest
+            temporaryBuffer: temp
+       sortedAttributeNames: sortedAttributeNames];
+
+        const size_t length = co_buffer_get_length(dest) - lengthOffset - 4;
+
+        if (length > UINT32_MAX)
+        {
+            [NSException raise: NSInvalidArgumentException
+                        format: @"Can't write item data larger than 2^32-1 bytes"];
+        }
+        const uint32_t swappedLength = NSSwapHostIntToLittle((uint32_t)length);
+
+        memcpy(dest->data + lengthOffset, &swappedLength, 4);
+    }
+}
+
+- (NSData *)contentsBlobWithItemGraph: (id <COItemGraph>)anItemGraph
+{
+    co_buffer_clear(&_buffer);
+    writeContentsBlob(&_buffer, &_temp, _sortedAttributeNames, anItemGraph);
+
+    return [NSData dataWithBytesNoCopy: _buffer.data
+                                length: co_buffer_get_length(&_buffer)
+                          freeWhenDone: NO];
+}
+
+@end
+
+
+NSData *contentsBLOBWithItemTree(id <COItemGraph> itemGraph)
+{
+    co_buffer_t buffer;
+    co_buffer_t temp;
+
+    co_buffer_init(&buffer);
+    co_buffer_init(&temp);
+
+    @try
+    {
+        writeContentsBlob(&buffer, &temp, nil, itemGraph);
+    }
+    @catch (NSException *exception)
+    {
+        co_buffer_free(&buffer);
+        @throw;
+    }
+    @finally
+    {
+        co_buffer_free(&temp);
+    }
+
+    const size_t length = co_buffer_get_length(&buffer);
+
+    if (length == 0)
+    {
+        co_buffer_free(&buffer);
+        return [NSData data];
+    }
+
+    // Hand over the buffer to the data rather than copying it, once trimmed
+    // to the written length
+    return [NSData dataWithBytesNoCopy: realloc(buffer.data, length)
+                                length: length
+                          freeWhenDone: YES];
+}
@@ -7,11 +7,65 @@
 
 #import <Foundation/Foundation.h>
 #import "COItem.h"
+#import "COBinaryWriter.h"
 
 @interface COItem (Binary)
 
 @property (nonatomic, readonly) NSData *dataValue;
+/**
+ * Returns a 64-bit hash of -dataValue.
+ *
+ * Equal items always have the same content hash, so items whose content
+ * hashes differ are not equal. Items that are not equal have the same content
+ * hash with a small probability, so equal content hashes must be confirmed
+ * with -isEqual:.
+ *
+ * Unlike -hash, the content hash takes in account every byte of every value
+ * (collection elements included), but is more costly to compute. It is
+ * computed on first use and cached, except for COMutableItem where it is
+ * recomputed on each call (-isEqual: is cheaper for mutable items).
+ */
+@property (nonatomic, readonly) uint64_t contentHash;
 
+/**
+ * Initializes an item from bytes returned by -dataValue.
+ *
+ * The item keeps the data and returns it from -dataValue, so the data must own
+ * its bytes rather than pointing into a buffer freed later (e.g. data
+ * created with -initWithBytesNoCopy:length:freeWhenDone: and NO).
+ */
 - (instancetype)initWithData: (NSData *)aData;
+/**
+ * Initializes an item from bytes received from an untrusted source (e.g. a
+ * synchronizer peer).
+ *
+ * Unlike -initWithData:, checks the bytes are well formed and the values
+ * match their types. As -initWithData: does, keeps the data. Returns nil and sets the error (with the code
+ * kCOCorruptedDataError) if they don't.
+ */
+- (instancetype)initWithData: (NSData *)aData error: (NSError **)anError;
+
+/**
+ * Returns the receiver serialized with cross persistent root paths written
+ * as strings, the way it was done before the store format version 3.
+ *
+ * Older readers raise an exception on the binary path tokens written by
+ * -dataValue, but can read these bytes.
+ */
+@property (nonatomic, readonly) NSData *dataValueWithPathsWrittenAsStrings;
+
+/**
+ * Appends the same bytes than -dataValue to the buffer.
+ *
+ * temp is used as scratch space while sorting set values.
+ *
+ * If not nil, sortedAttributeNames caches the attribute names sorted in the
+ * serialization order per entity name. Items that share an entity name
+ * usually have the same attributes, so the attribute names are sorted once
+ * per entity rather than once per item.
+ */
+- (void)writeToBuffer: (co_buffer_t *)dest
+      temporaryBuffer: (co_buffer_t *)temp
+ sortedAttributeNames: (NSMutableDictionary *)sortedAttributeNames;
 
 @end
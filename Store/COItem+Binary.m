@@ -10,6 +10,7 @@
 #import "COBinaryReader.h"
 #import "COPath.h"
 #import "COAttachmentID.h"
+#import "COError.h"
 #import <EtoileFoundation/Macros.h>
 
 typedef NS_ENUM(unsigned int, reader_state)
@@ -61,7 +62,7 @@ static NSNull *NSNullCached;
     }
 }
 
-static inline void writePrimitiveValue(co_buffer_t *dest, id aValue, COType aType)
+static inline void writePrimitiveValue(co_buffer_t *dest, id aValue, COType aType, BOOL pathsAsStrings)
 {
     if (aValue == NSNullCached)
     {
@@ -89,7 +90,18 @@ static inline void writePrimitiveValue(co_buffer_t *dest, id aValue, COType aTyp
         case kCOTypeReference:
             if ([aValue isKindOfClass: [COPath class]])
             {
-                co_buffer_store_string(dest, ((COPath *)aValue).stringValue);
+                COPath *path = aValue;
+
+                // A broken path has no UUIDs, and is written as a string like
+                // the paths written by older versions
+                if (path.broken || pathsAsStrings)
+                {
+                    co_buffer_store_string(dest, path.stringValue);
+                }
+                else
+                {
+                    co_buffer_store_path(dest, path.persistentRoot, path.branch);
+                }
             }
             else
             {
@@ -142,20 +154,25 @@ static int comparePointersToBinaryWriterTokens(void *pointer, const void *offset
 static inline void writeArrayContents(co_buffer_t *dest,
                                       NSArray *anArray,
                                       COType aType,
-                                      co_buffer_t *temp)
+                                      co_buffer_t *temp,
+                                      BOOL pathsAsStrings)
 {
     assert([anArray isKindOfClass: [NSArray class]]);
 
     for (id obj in anArray)
     {
-        writePrimitiveValue(dest, obj, aType);
+        writePrimitiveValue(dest, obj, aType, pathsAsStrings);
     }
 }
 
 // We use pointer offsets to reference tokens in order to prevent pointers to become invalid, when
 // token buffer is resized, see -[TestItem testLargetSet] and
 // https://github.com/etoile/CoreObject/pull/83#issuecomment-1979878040.
-static inline void writeSetContents(co_buffer_t *dest, NSSet *aSet, COType aType, co_buffer_t *temp)
+static inline void writeSetContents(co_buffer_t *dest,
+                                    NSSet *aSet,
+                                    COType aType,
+                                    co_buffer_t *temp,
+                                    BOOL pathsAsStrings)
 {
     assert([aSet isKindOfClass: [NSSet class]]);
     const size_t setCount = aSet.count;
@@ -175,7 +192,7 @@ static inline void writeSetContents(co_buffer_t *dest, NSSet *aSet, COType aType
         for (id obj in aSet)
         {
             tokenPointerOffsets[i++] = co_buffer_get_length(temp);
-            writePrimitiveValue(temp, obj, aType);
+            writePrimitiveValue(temp, obj, aType, pathsAsStrings);
         }
     }
 
@@ -203,11 +220,15 @@ static inline void writeSetContents(co_buffer_t *dest, NSSet *aSet, COType aType
 }
 
 
-static inline void writeValue(co_buffer_t *dest, id aValue, COType aType, co_buffer_t *temp)
+static inline void writeValue(co_buffer_t *dest,
+                              id aValue,
+                              COType aType,
+                              co_buffer_t *temp,
+                              BOOL pathsAsStrings)
 {
     if (COTypeIsUnivalued(aType))
     {
-        return writePrimitiveValue(dest, aValue, aType);
+        return writePrimitiveValue(dest, aValue, aType, pathsAsStrings);
     }
     else
     {
@@ -215,51 +236,205 @@ static inline void writeValue(co_buffer_t *dest, id aValue, COType aType, co_buf
 
         if (COTypeIsOrdered(aType))
         {
-            writeArrayContents(dest, aValue, aType, temp);
+            writeArrayContents(dest, aValue, aType, temp, pathsAsStrings);
         }
         else
         {
-            writeSetContents(dest, aValue, aType, temp);
+            writeSetContents(dest, aValue, aType, temp, pathsAsStrings);
         }
 
         co_buffer_end_array(dest);
     }
 }
 
+/**
+ * Writes the attributes in the given order, or returns NO without writing all
+ * of them if the names don't match the receiver attributes.
+ */
+- (BOOL)writeAttributesNamed: (NSArray *)names
+                    toBuffer: (co_buffer_t *)dest
+             temporaryBuffer: (co_buffer_t *)temp
+              pathsAsStrings: (BOOL)pathsAsStrings
+{
+    if (names.count != types.count)
+        return NO;
+
+    for (NSString *prop in names)
+    {
+        COType type = [self typeForAttribute: prop];
+
+        if (type == 0)
+            return NO;
+
+        id val = [self valueForAttribute: prop];
+
+        co_buffer_store_string(dest, prop);
+        co_buffer_store_integer(dest, type);
+        writeValue(dest, val, type, temp, pathsAsStrings);
+    }
+    return YES;
+}
+
+- (void)writeToBuffer: (co_buffer_t *)dest
+      temporaryBuffer: (co_buffer_t *)temp
+ sortedAttributeNames: (NSMutableDictionary *)sortedAttributeNames
+       pathsAsStrings: (BOOL)pathsAsStrings
+{
+    co_buffer_store_uuid(dest, self.UUID);
+    co_buffer_begin_object(dest);
+
+    const size_t attributesOffset = co_buffer_get_length(dest);
+    NSString *entityName = self.entityName;
+    NSArray *cachedNames = (entityName != nil ? sortedAttributeNames[entityName] : nil);
+
+    if (cachedNames == nil || ![self writeAttributesNamed: cachedNames
+                                                 toBuffer: dest
+                                          temporaryBuffer: temp
+                                           pathsAsStrings: pathsAsStrings])
+    {
+        co_buffer_truncate(dest, attributesOffset);
+
+        // TODO: For safety we should probaly serialize the attribute names to UTF-8 and compare
+        // them there. Although, I believe compare: should be the same as comparing Unicode character numbers
+        // which is the same as comparing UTF-8 byte sequences (mentiomed in the RFC.)
+        NSArray *propsSorted = [self.attributeNames sortedArrayUsingSelector: @selector(compare:)];
+        BOOL written = [self writeAttributesNamed: propsSorted
+                                         toBuffer: dest
+                                  temporaryBuffer: temp
+                                   pathsAsStrings: pathsAsStrings];
+
+        ETAssert(written);
+        if (entityName != nil)
+        {
+            sortedAttributeNames[entityName] = propsSorted;
+        }
+    }
+
+    co_buffer_end_object(dest);
+}
+
+- (void)writeToBuffer: (co_buffer_t *)dest
+      temporaryBuffer: (co_buffer_t *)temp
+ sortedAttributeNames: (NSMutableDictionary *)sortedAttributeNames
+{
+    if (_data != NULL)
+    {
+        NSData *data = (__bridge NSData *)_data;
+
+        co_buffer_write(dest, data.bytes, data.length);
+        return;
+    }
+
+    [self writeToBuffer: dest
+        temporaryBuffer: temp
+   sortedAttributeNames: sortedAttributeNames
+         pathsAsStrings: NO];
+}
+
+/**
+ * Keeps the serialized bytes of an immutable item, so -dataValue and
+ * -writeToBuffer:temporaryBuffer:sortedAttributeNames: don't serialize it
+ * again, and -isEqual: can compare the bytes.
+ *
+ * If another thread kept the bytes in the meantime, they are left untouched.
+ */
+static inline void keepDataOfItem(COItem *anItem, NSData *data)
+{
+    if ([anItem isKindOfClass: [COMutableItem class]])
+        return;
+
+    void *retainedData = (__bridge_retained void *)data;
+
+    if (!__sync_bool_compare_and_swap(&anItem->_data, NULL, retainedData))
+    {
+        (void)(__bridge_transfer NSData *)retainedData;
+    }
+}
+
+/**
+ * Returns the bytes written to the buffer, and frees the buffer.
+ */
+static NSData *dataWithBuffer(co_buffer_t *buf)
+{
+    // Hand over the buffer to the data rather than copying it, once trimmed
+    // to the written length
+    const size_t length = co_buffer_get_length(buf);
+
+    return [NSData dataWithBytesNoCopy: realloc(buf->data, length)
+                                length: length
+                          freeWhenDone: YES];
+}
+
 - (NSData *)dataValue
 {
+    if (_data != NULL)
+        return (__bridge NSData *)_data;
+
     /** Parts of the serialization process need temporary storage */
     co_buffer_t temp;
     co_buffer_init(&temp);
 
     co_buffer_t buf;
     co_buffer_init(&buf);
-    co_buffer_store_uuid(&buf, self.UUID);
-    co_buffer_begin_object(&buf);
 
-    // TODO: For safety we should probaly serialize the attribute names to UTF-8 and compare
-    // them there. Although, I believe compare: should be the same as comparing Unicode character numbers
-    // which is the same as comparing UTF-8 byte sequences (mentiomed in the RFC.)
-    NSArray *propsSorted = [self.attributeNames sortedArrayUsingSelector: @selector(compare:)];
+    [self writeToBuffer: &buf temporaryBuffer: &temp sortedAttributeNames: nil];
+
+    co_buffer_free(&temp);
+
+    NSData *data = dataWithBuffer(&buf);
+
+    keepDataOfItem(self, data);
+    return data;
+}
 
-    for (NSString *prop in propsSorted)
+/**
+ * Returns a 64-bit FNV-1a hash of the bytes.
+ */
+static uint64_t contentHashOfBytes(const unsigned char *bytes, size_t length)
+{
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+
+    for (size_t i = 0; i < length; i++)
     {
-        COType type = [self typeForAttribute: prop];
-        id val = [self valueForAttribute: prop];
+        hash = (hash ^ bytes[i]) * UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
 
-        co_buffer_store_string(&buf, prop);
-        co_buffer_store_integer(&buf, type);
-        writeValue(&buf, val, type, &temp);
+- (uint64_t)contentHash
+{
+    if (__atomic_load_n(&_hasContentHash, __ATOMIC_ACQUIRE))
+        return _contentHash;
+
+    // The serialization is canonical, and unlike -[NSString hash] or
+    // -[NSData hash], the hash covers every byte of every value
+    NSData *data = self.dataValue;
+    const uint64_t hash = contentHashOfBytes(data.bytes, data.length);
+
+    // A mutable item keeps no bytes, and can change once the hash is computed.
+    // Computing the hash concurrently in several threads is harmless, but
+    // another thread must not see the flag before the hash.
+    if (_data != NULL)
+    {
+        _contentHash = hash;
+        __atomic_store_n(&_hasContentHash, YES, __ATOMIC_RELEASE);
     }
+    return hash;
+}
 
-    co_buffer_free(&temp);
+- (NSData *)dataValueWithPathsWrittenAsStrings
+{
+    co_buffer_t temp;
+    co_buffer_init(&temp);
+
+    co_buffer_t buf;
+    co_buffer_init(&buf);
+
+    [self writeToBuffer: &buf temporaryBuffer: &temp sortedAttributeNames: nil pathsAsStrings: YES];
 
-    co_buffer_end_object(&buf);
+    co_buffer_free(&temp);
 
-    NSData *result = [NSData dataWithBytes: co_buffer_get_data(&buf)
-                                    length: co_buffer_get_length(&buf)];
-    co_buffer_free(&buf);
-    return result;
+    return dataWithBuffer(&buf);
 }
 
 // Read
@@ -286,6 +461,11 @@ static void co_read_int64(void *ctx, int64_t val)
             co_read_object_value(state, @(val));
             break;
         case co_reader_expect_type:
+            if (!COTypeIsValid((COType)val))
+            {
+                state->state = co_reader_error;
+                break;
+            }
             state->currentType = (COType)val;
             state->types[state->currentProperty] = @(val);
             state->state = co_reader_expect_value;
@@ -313,9 +493,18 @@ static void co_read_double(void *ctx, double val)
 static void co_read_string(void *ctx, NSString *val)
 {
     COReaderState *state = (__bridge COReaderState *)ctx;
+
+    // Invalid UTF-8
+    if (val == nil)
+    {
+        state->state = co_reader_error;
+        return;
+    }
+
     switch (state->state)
     {
         case co_reader_expect_value:
+            // Paths written by older versions
             if (COTypePrimitivePart(state->currentType) == kCOTypeReference)
             {
                 co_read_object_value(state, [COPath pathWithString: val]);
@@ -357,6 +546,27 @@ static void co_read_uuid(void *ctx, ETUUID *uuid)
     }
 }
 
+static void co_read_path(void *ctx, COPath *path)
+{
+    COReaderState *state = (__bridge COReaderState *)ctx;
+    switch (state->state)
+    {
+        case co_reader_expect_value:
+            if (COTypePrimitivePart(state->currentType) == kCOTypeReference)
+            {
+                co_read_object_value(state, path);
+            }
+            else
+            {
+                state->state = co_reader_error;
+            }
+            break;
+        default:
+            state->state = co_reader_error;
+            break;
+    }
+}
+
 static void co_read_bytes(void *ctx, const unsigned char *val, size_t size)
 {
     COReaderState *state = (__bridge COReaderState *)ctx;
@@ -392,9 +602,15 @@ static void co_read_end_object(void *ctx)
 static void co_read_begin_array(void *ctx)
 {
     COReaderState *state = (__bridge COReaderState *)ctx;
-    state->isReadingMultivalue = YES;
 
-    assert(COTypeIsMultivalued(state->currentType));
+    if (state->state != co_reader_expect_value
+        || state->isReadingMultivalue
+        || !COTypeIsMultivalued(state->currentType))
+    {
+        state->state = co_reader_error;
+        return;
+    }
+    state->isReadingMultivalue = YES;
 
     if (COTypeIsOrdered(state->currentType))
     {
@@ -409,6 +625,12 @@ static void co_read_begin_array(void *ctx)
 static void co_read_end_array(void *ctx)
 {
     COReaderState *state = (__bridge COReaderState *)ctx;
+
+    if (state->state == co_reader_error || !state->isReadingMultivalue)
+    {
+        state->state = co_reader_error;
+        return;
+    }
     state->isReadingMultivalue = NO;
 
     // Save the value
@@ -434,11 +656,16 @@ static void co_read_null(void *ctx)
 }
 
 // Migrate internal DNS prefixed keys (old format) to underscore prefixed keys (new format)
-static void migrateInternalKeysFromOldToNewFormat(NSMutableDictionary *values, NSMutableDictionary *types) {
+// Returns whether the keys were migrated.
+static BOOL migrateInternalKeysFromOldToNewFormat(NSMutableDictionary *values, NSMutableDictionary *types) {
     if (values[kCOItemEntityNameProperty] != nil)
     {
-        return;
+        return NO;
     }
+    const BOOL migrated = (values[kCOItemDeprecatedEntityNameProperty] != nil
+                           || values[kCOItemDeprecatedPackageNameProperty] != nil
+                           || values[kCOItemDeprecatedPackageVersionProperty] != nil);
+
     values[kCOItemEntityNameProperty] = values[kCOItemDeprecatedEntityNameProperty];
     values[kCOItemPackageNameProperty] = values[kCOItemDeprecatedPackageNameProperty];
     values[kCOItemPackageVersionProperty] = values[kCOItemDeprecatedPackageVersionProperty];
@@ -454,12 +681,13 @@ static void migrateInternalKeysFromOldToNewFormat(NSMutableDictionary *values, N
     [types removeObjectForKey: kCOItemDeprecatedEntityNameProperty];
     [types removeObjectForKey: kCOItemDeprecatedPackageNameProperty];
     [types removeObjectForKey: kCOItemDeprecatedPackageVersionProperty];
+    return migrated;
 }
 
 /* Initializers in categories cannot be marked with NS_DESIGNATED_INITIALIZER */
 #pragma clang diagnostic ignored "-Wobjc-designated-initializers"
 
-- (instancetype)initWithData: (NSData *)aData
+static COReaderState *readerStateWithData(NSData *aData)
 {
     COReaderState *state = [[COReaderState alloc] init];
 
@@ -473,21 +701,77 @@ static void migrateInternalKeysFromOldToNewFormat(NSMutableDictionary *values, N
         co_read_end_object,
         co_read_begin_array,
         co_read_end_array,
-        co_read_null
+        co_read_null,
+        co_read_path
     };
     co_reader_read(aData.bytes,
                    aData.length,
                    (__bridge void *)state,
                    cb);
+    return state;
+}
+
+static BOOL isValidReaderState(COReaderState *state)
+{
+    if (state->state != co_reader_expect_property || state->uuid == nil)
+        return NO;
+
+    for (NSString *attribute in state->values)
+    {
+        NSNumber *type = state->types[attribute];
+        id value = state->values[attribute];
 
+        if (type == nil)
+            return NO;
+
+        if (value != NSNullCached && !COTypeValidateObject((COType)type.unsignedIntValue, value))
+            return NO;
+    }
+    return YES;
+}
+
+- (instancetype)initWithReaderState: (COReaderState *)state data: (NSData *)aData
+{
     SUPERINIT;
     uuid = state->uuid;
     types = state->types;
     values = state->values;
     
-    migrateInternalKeysFromOldToNewFormat(values, types);
-    
+    // The item can only be serialized to the same bytes if no keys changed.
+    // -copy doesn't copy immutable data, so decoding spares a copy of the bytes.
+    if (!migrateInternalKeysFromOldToNewFormat(values, types))
+    {
+        keepDataOfItem(self, [aData copy]);
+    }
     return self;
 }
 
+- (instancetype)initWithData: (NSData *)aData
+{
+    return [self initWithReaderState: readerStateWithData(aData) data: aData];
+}
+
+- (instancetype)initWithData: (NSData *)aData error: (NSError **)anError
+{
+    NILARG_EXCEPTION_TEST(aData);
+    COReaderState *state = nil;
+
+    if (co_reader_validate(aData.bytes, aData.length))
+    {
+        state = readerStateWithData(aData);
+    }
+
+    if (state == nil || !isValidReaderState(state))
+    {
+        if (anError != NULL)
+        {
+            *anError = [NSError errorWithDomain: kCOCoreObjectErrorDomain
+                                           code: kCOCorruptedDataError
+                                       userInfo: @{ NSLocalizedDescriptionKey: @"Malformed item data" }];
+        }
+        return nil;
+    }
+    return [self initWithReaderState: state data: aData];
+}
+
 @end
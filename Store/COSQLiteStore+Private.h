@@ -8,7 +8,7 @@
 #import "COSQLiteStore.h"
 #import "FMDatabase.h"
 
-@class COSQLiteStorePersistentRootBackingStore;
+@class COSQLiteStorePersistentRootBackingStore, COContentsBlobWriter;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -19,6 +19,14 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, readonly, strong) FMDatabase *database;
 @property (nonatomic, readwrite, assign) NSUInteger maxNumberOfDeltaCommits;
+/**
+ * The length in bytes from which blob attribute values are stored once in a
+ * content-addressed table, and referenced from the revision contents, rather 
+ * than being copied into each full snapshot.
+ *
+ * The default value is 32 KB.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger outOfLineBlobThreshold;
 
 - (BOOL)writeRevisionWithModifiedItems: (COItemGraph *)anItemTree
                           revisionUUID: (ETUUID *)aRevisionUUID
@@ -32,6 +40,62 @@ NS_ASSUME_NONNULL_BEGIN
                                                             createIfNotPresent: (BOOL)createIfNotPresent;
 - (void)testingRunBlockInStoreQueue: (void (^)(void))aBlock;
 
+/**
+ * The writer that serializes the revision contents for all the backing
+ * stores, reusing the same buffer from one commit to the next.
+ *
+ * Must only be used on -queue.
+ */
+@property (nonatomic, readonly) COContentsBlobWriter *contentsBlobWriter;
+
+/**
+ * The queue serializing the database accesses.
+ *
+ * An undo track store hosted in the receiver runs its queries on this queue.
+ */
+@property (nonatomic, readonly) dispatch_queue_t queue;
+/**
+ * The lock held while committing to the database.
+ *
+ * An undo track store hosted in the receiver uses it as its transaction lock.
+ */
+@property (nonatomic, readonly) dispatch_semaphore_t commitLock;
+/**
+ * Begins a database transaction that spans store transactions and other
+ * writes to -database (e.g. undo track store changes), until
+ * -commitSharedTransaction is called.
+ *
+ * The commit lock is held for the whole transaction. Until it ends,
+ * -commitStoreTransaction: called on the same thread writes to a savepoint,
+ * and the commit notifications are posted once the shared transaction is
+ * committed.
+ *
+ * Shared transactions can be nested on the same thread, only the outermost
+ * one is committed to the database.
+ */
+- (BOOL)beginSharedTransaction;
+/**
+ * Commits the transaction begun with -beginSharedTransaction, then runs the
+ * blocks passed to -performAfterSharedTransaction: (e.g. posting the commit
+ * notifications for the store transactions it contains).
+ *
+ * If the commit fails, the shared transaction is rolled back.
+ */
+- (BOOL)commitSharedTransaction;
+/**
+ * Rolls back the transaction begun with -beginSharedTransaction, whatever
+ * the nesting depth, and releases the commit lock.
+ *
+ * Must be called when an exception is raised inside the shared transaction,
+ * otherwise later commits wait on the commit lock forever.
+ */
+- (void)rollbackSharedTransaction;
+/**
+ * Runs the block once the current shared transaction is committed, or
+ * immediately if there is no shared transaction underway on this thread.
+ */
+- (void)performAfterSharedTransaction: (void (^)(void))aBlock;
+
 @end
 
 NS_ASSUME_NONNULL_END
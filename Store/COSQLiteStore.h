@@ -11,7 +11,7 @@
 @protocol COItemGraph;
 @class ETUUID;
 @class COItem, CORevisionInfo, COItemGraph, COBranchInfo, COPersistentRootInfo;
-@class FMDatabase, COStoreTransaction;
+@class FMDatabase, COStoreTransaction, COSharedRevisionCache, COContentsBlobWriter, COStoreMetrics;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -354,7 +354,17 @@ extern NSString *const COPersistentRootAttributeUsedSize;
 
     dispatch_queue_t queue_;
     dispatch_semaphore_t _commitLock;
+    /** The thread owning the shared transaction (NULL if none), read
+        atomically since any thread can check whether it owns it */
+    void *_sharedTransactionThread;
+    /** Only accessed by the thread owning the shared transaction */
+    NSUInteger _sharedTransactionDepth;
+    NSMutableArray *_sharedTransactionCompletionBlocks;
     NSUInteger _maxNumberOfDeltaCommits;
+    NSUInteger _outOfLineBlobThreshold;
+    COSharedRevisionCache *_revisionCache;
+    COContentsBlobWriter *_contentsBlobWriter;
+    COStoreMetrics *_metrics;
 }
 
 /**
@@ -390,6 +400,15 @@ extern NSString *const COPersistentRootAttributeUsedSize;
  * By default, returns NO and allows to write revisions with higher schema versions than the store.
  */
 @property (nonatomic, readwrite) BOOL enforcesSchemaVersion;
+/**
+ * The cache where revision infos and item graphs read from the store are kept.
+ *
+ * By default, returns +[COSharedRevisionCache sharedCache], so all the store
+ * objects opened on the same store share the same cached revisions.
+ *
+ * Setting nil disables caching. Should be set before reading revisions.
+ */
+@property (nonatomic, readwrite, strong, nullable) COSharedRevisionCache *revisionCache;
 
 
 /** @taskunit Revision Reading */
@@ -399,9 +418,7 @@ extern NSString *const COPersistentRootAttributeUsedSize;
  * Read revision metadata for a given revision ID.
  *
  * This data in the store is immutable (except for the case that the revision becomes unreachable and is garbage collected
- * by a call to -finalizeDeletionsForPersistentRoot), and so it could be cached in memory by COSQLiteStore (though isn't currently)
- * 
- * Adding an in-memory cache for this will probably imporant.
+ * by a call to -finalizeDeletionsForPersistentRoot), and so it is cached in memory in -revisionCache.
  */
 - (nullable CORevisionInfo *)revisionInfoForRevisionUUID: (ETUUID *)aRevision
                                       persistentRootUUID: (ETUUID *)aPersistentRoot;
@@ -430,17 +447,31 @@ extern NSString *const COPersistentRootAttributeUsedSize;
  *
  * This is only useful if the caller has the state of baseRevid in memory.
  * 
- * In the future if we add an internal in-memory revision cache to COSQLiteStore, this may
- * no longer be of much use.
+ * Partial item graphs are not cached in -revisionCache, unlike the item graphs returned by
+ * -itemGraphForRevisionUUID:persistentRoot:.
  */
 - (nullable COItemGraph *)partialItemGraphFromRevisionUUID: (ETUUID *)baseRevid
                                             toRevisionUUID: (ETUUID *)finalRevid
                                             persistentRoot: (ETUUID *)aPersistentRoot;
 /**
  * Returns the state the inner object graph at a given revision.
+ *
+ * The returned item graph is a new copy, that the caller can mutate.
  */
 - (nullable COItemGraph *)itemGraphForRevisionUUID: (ETUUID *)aRevisionUUID
                                     persistentRoot: (ETUUID *)aPersistentRoot;
+/**
+ * Returns the state of the given inner objects at a given revision.
+ *
+ * Inner objects that don't exist at this revision are omitted.
+ *
+ * Combined with -partialItemGraphFromRevisionUUID:toRevisionUUID:persistentRoot:,
+ * this can be used to compare two revisions without loading the whole graphs.
+ * The returned item graph is not cached in -revisionCache.
+ */
+- (nullable COItemGraph *)itemGraphForRevisionUUID: (ETUUID *)aRevisionUUID
+                                    persistentRoot: (ETUUID *)aPersistentRoot
+                               restrictToItemUUIDs: (NSSet<ETUUID *> *)itemUUIDs;
 /**
  * Returns the UUID of the root object of the given persistent root.
  */
@@ -455,6 +486,13 @@ extern NSString *const COPersistentRootAttributeUsedSize;
  */
 @property (nonatomic, readonly) NSArray<ETUUID *> *persistentRootUUIDs;
 @property (nonatomic, readonly) NSArray<ETUUID *> *deletedPersistentRootUUIDs;
+/**
+ * Returns a snapshot of the state of every non-deleted persistent root.
+ *
+ * Unlike calling -persistentRootInfoForUUID: for each -persistentRootUUIDs, 
+ * all the persistent roots and branches are read with a single query.
+ */
+@property (nonatomic, readonly) NSArray<COPersistentRootInfo *> *persistentRootInfos;
 
 /**
  * @return  a snapshot of the state of a persistent root, or nil if
@@ -587,6 +625,21 @@ extern NSString *const COPersistentRootAttributeUsedSize;
 @property (nonatomic, readonly) NSDictionary *pageStatistics;
 
 
+/** @taskunit Performance Metrics */
+
+
+/**
+ * The commit and load metrics recorded by the receiver, its backing stores,
+ * and the undo track stores and editing contexts using it.
+ *
+ * Unlike -pageStatistics, these metrics are kept in memory and are not shared
+ * with other store objects opened on the same database.
+ *
+ * See COStoreMetrics.
+ */
+@property (nonatomic, readonly) COStoreMetrics *metrics;
+
+
 /** @taskunit Transactions */
 
 
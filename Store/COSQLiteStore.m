@@ -9,6 +9,9 @@
 #import "COSQLiteStore+Private.h"
 #import "COSQLiteStorePersistentRootBackingStore.h"
 #import "CORevisionInfo.h"
+#import "COSharedRevisionCache.h"
+#import "COContentsBlobWriter.h"
+#import "COStoreMetrics.h"
 #import <EtoileFoundation/Macros.h>
 
 #import "COItem.h"
@@ -39,7 +42,13 @@ NSString *const kCOStoreURL = @"COStoreURL";
 NSString *const COPersistentRootAttributeExportSize = @"COPersistentRootAttributeExportSize";
 NSString *const COPersistentRootAttributeUsedSize = @"COPersistentRootAttributeUsedSize";
 
-const int64_t currentVersion = 2;
+/**
+ * Version 2 adds the schema version, version 3 writes cross persistent
+ * root paths as binary tokens in the revision contents (see
+ * co_buffer_store_path()), and version 4 stores large blob attributes out of 
+ * line, replaced with references in the revision contents.
+ */
+const int64_t currentVersion = 4;
 
 
 @interface COSQLiteStore (AttachmentsPrivate)
@@ -53,7 +62,11 @@ const int64_t currentVersion = 2;
 
 @synthesize UUID = _uuid;
 @synthesize maxNumberOfDeltaCommits = _maxNumberOfDeltaCommits;
+@synthesize outOfLineBlobThreshold = _outOfLineBlobThreshold;
 @synthesize enforcesSchemaVersion = _enforcesSchemaVersion;
+@synthesize revisionCache = _revisionCache;
+@synthesize contentsBlobWriter = _contentsBlobWriter;
+@synthesize metrics = _metrics;
 
 - (instancetype)initWithURL: (NSURL *)aURL
 {
@@ -73,7 +86,12 @@ const int64_t currentVersion = 2;
     backingStores_ = [[NSMutableDictionary alloc] init];
     backingStoreUUIDForPersistentRootUUID_ = [[NSMutableDictionary alloc] init];
     _commitLock = dispatch_semaphore_create(1);
+    _sharedTransactionCompletionBlocks = [NSMutableArray new];
     _maxNumberOfDeltaCommits = 50;
+    _outOfLineBlobThreshold = 32 * 1024;
+    _revisionCache = [COSharedRevisionCache sharedCache];
+    _contentsBlobWriter = [COContentsBlobWriter new];
+    _metrics = [COStoreMetrics new];
 
     __block BOOL ok = YES;
 
@@ -261,6 +279,21 @@ const int64_t currentVersion = 2;
                                                                    fromVersion: version];
             }
         }
+        else if (version == 2)
+        {
+            // The paths written as strings in the existing revisions remain
+            // readable, so only the version changes. Older versions refuse to
+            // open the store, instead of raising on the first binary path.
+            [db_ executeUpdate: @"UPDATE storeMetadata SET format_version = 3"];
+        }
+        else if (version == 3)
+        {
+            // The backing stores create their blob tables when opened, and
+            // existing revisions contain no blob references, so only the
+            // version changes. Older versions refuse to open the store, instead
+            // of returning blob references as item data.
+            [db_ executeUpdate: @"UPDATE storeMetadata SET format_version = 4"];
+        }
     }
     ETAssert([db_ intForQuery: @"SELECT format_version FROM storeMetadata"] == currentVersion);
 }
@@ -285,144 +318,326 @@ const int64_t currentVersion = 2;
 
 - (void)beginCommit
 {
+    const uint64_t waitStartTime = COStoreMetricsNow();
     dispatch_semaphore_wait(_commitLock, DISPATCH_TIME_FOREVER);
+    [_metrics recordDurationSince: waitStartTime forMetric: COStoreMetricCommitLockWaitTime];
 }
 
 - (void)endCommit {
     dispatch_semaphore_signal(_commitLock);
 }
 
-- (BOOL)commitStoreTransaction: (COStoreTransaction *)aTransaction
+- (BOOL)isInSharedTransaction
+{
+    return __atomic_load_n(&_sharedTransactionThread, __ATOMIC_ACQUIRE)
+        == (__bridge void *)[NSThread currentThread];
+}
+
+- (void)endSharedTransaction
+{
+    _sharedTransactionDepth = 0;
+    __atomic_store_n(&_sharedTransactionThread, NULL, __ATOMIC_RELEASE);
+}
+
+- (BOOL)beginSharedTransaction
 {
     dispatch_assert_queue_not(queue_);
 
+    if ([self isInSharedTransaction])
+    {
+        _sharedTransactionDepth++;
+        return YES;
+    }
+
     [self beginCommit];
 
-    NSMutableDictionary *txnIDForPersistentRoot = [[NSMutableDictionary alloc] init];
-    NSMutableArray *insertedUUIDs = [[NSMutableArray alloc] init];
-    NSMutableArray *deletedUUIDs = [[NSMutableArray alloc] init];
-    __block BOOL ok = YES;
+    __block BOOL ok = NO;
 
     dispatch_sync(queue_, ^()
     {
-        [db_ beginTransaction];
-        
-        if (_enforcesSchemaVersion && ![aTransaction matchesSchemaVersion: self.schemaVersion]) {
-            ok = NO;
+        ok = [db_ beginTransaction];
+    });
+
+    if (!ok)
+    {
+        [self endCommit];
+        return NO;
+    }
+    _sharedTransactionDepth = 1;
+    __atomic_store_n(&_sharedTransactionThread, (__bridge void *)[NSThread currentThread], __ATOMIC_RELEASE);
+    return YES;
+}
+
+- (BOOL)commitSharedTransaction
+{
+    dispatch_assert_queue_not(queue_);
+    ETAssert([self isInSharedTransaction]);
+
+    _sharedTransactionDepth--;
+
+    if (_sharedTransactionDepth > 0)
+        return YES;
+
+    __block BOOL ok = NO;
+
+    dispatch_sync(queue_, ^()
+    {
+        ok = [db_ commit];
+
+        if (!ok)
+        {
             [db_ rollback];
-            return;
         }
+    });
+
+    [self endSharedTransaction];
 
-        // update the last transaction field before we commit.
+    NSArray *completionBlocks = [_sharedTransactionCompletionBlocks copy];
 
-        // setup
+    [_sharedTransactionCompletionBlocks removeAllObjects];
 
-        for (ETUUID *modifiedUUID in aTransaction.persistentRootUUIDs)
+    if (ok)
+    {
+        for (void (^completion)(void) in completionBlocks)
         {
-            const BOOL isPresent = [db_ boolForQuery: @"SELECT COUNT(*) > 0 FROM persistentroots WHERE uuid = ?",
-                                                      [modifiedUUID dataValue]];
-            const BOOL modifiesMutableState = [aTransaction touchesMutableStateForPersistentRootUUID: modifiedUUID];
-            int64_t currentValue = [db_ int64ForQuery: @"SELECT transactionid FROM persistentroots WHERE uuid = ?",
-                                                       [modifiedUUID dataValue]];
-            int64_t clientValue = [aTransaction oldTransactionIDForPersistentRoot: modifiedUUID];
-            const BOOL wasLoaded = [aTransaction hasOldTransactionIDForPersistentRoot: modifiedUUID];
-
-            if (!modifiesMutableState)
-                continue;
+            completion();
+        }
+    }
+    else
+    {
+        NSLog(@"Shared transaction commit failed");
+    }
 
-            // Sort of a hack: we allow committing without providing a transaction ID. (if wasLoaded is NO)
-            if (!wasLoaded)
-            {
-                clientValue = currentValue;
-            }
+    [self endCommit];
+    return ok;
+}
 
-            if (clientValue != currentValue && isPresent)
-            {
+- (void)rollbackSharedTransaction
+{
+    dispatch_assert_queue_not(queue_);
+    ETAssert([self isInSharedTransaction]);
+
+    dispatch_sync(queue_, ^()
+    {
+        [db_ rollback];
+    });
+
+    [self endSharedTransaction];
+    [_sharedTransactionCompletionBlocks removeAllObjects];
+    [self endCommit];
+}
+
+- (void)performAfterSharedTransaction: (void (^)(void))aBlock
+{
+    if ([self isInSharedTransaction])
+    {
+        [_sharedTransactionCompletionBlocks addObject: aBlock];
+    }
+    else
+    {
+        aBlock();
+    }
+}
+
+/**
+ * Inside a shared transaction, a store transaction is written as a savepoint
+ * and becomes durable with -commitSharedTransaction.
+ */
+- (BOOL)beginStoreTransactionNested: (BOOL)isNested
+{
+    dispatch_assert_queue(queue_);
+    return (isNested ? [db_ savepoint: @"storeTransaction"] : [db_ beginTransaction]);
+}
+
+- (BOOL)commitStoreTransactionNested: (BOOL)isNested
+{
+    dispatch_assert_queue(queue_);
+    return (isNested ? [db_ releaseSavepoint: @"storeTransaction"] : [db_ commit]);
+}
+
+- (void)rollbackStoreTransactionNested: (BOOL)isNested
+{
+    dispatch_assert_queue(queue_);
+
+    if (isNested)
+    {
+        [db_ rollbackToSavepoint: @"storeTransaction"];
+        [db_ releaseSavepoint: @"storeTransaction"];
+    }
+    else
+    {
+        [db_ rollback];
+    }
+}
+
+- (BOOL)commitStoreTransaction: (COStoreTransaction *)aTransaction
+{
+    dispatch_assert_queue_not(queue_);
+
+    const uint64_t startTime = COStoreMetricsNow();
+    // The commit lock is already held by the shared transaction
+    const BOOL isNested = [self isInSharedTransaction];
+
+    if (!isNested)
+    {
+        [self beginCommit];
+    }
+
+    NSMutableDictionary *txnIDForPersistentRoot = [[NSMutableDictionary alloc] init];
+    NSMutableArray *insertedUUIDs = [[NSMutableArray alloc] init];
+    NSMutableArray *deletedUUIDs = [[NSMutableArray alloc] init];
+    __block BOOL ok = YES;
+    __block NSException *exception = nil;
+    const uint64_t waitStartTime = COStoreMetricsNow();
+
+    dispatch_sync(queue_, ^()
+    {
+        [_metrics recordDurationSince: waitStartTime forMetric: COStoreMetricQueueWaitTime];
+        [self beginStoreTransactionNested: isNested];
+
+        @try
+        {
+            if (_enforcesSchemaVersion && ![aTransaction matchesSchemaVersion: self.schemaVersion]) {
                 ok = NO;
-                NSLog(@"Transaction id mismatch for %@. DB had %d, transaction had %d",
-                      modifiedUUID, (int)currentValue, (int)clientValue);
-                [db_ rollback];
+                [self rollbackStoreTransactionNested: isNested];
                 return;
             }
 
-            if (!isPresent)
-                [insertedUUIDs addObject: modifiedUUID];
-
-            const int64_t newValue = clientValue + 1;
+            // update the last transaction field before we commit.
 
-            [db_ executeUpdate: @"UPDATE persistentroots SET transactionid = ? WHERE uuid = ?",
-                                @(newValue), [modifiedUUID dataValue]];
+            // setup
 
-            txnIDForPersistentRoot[modifiedUUID] = @(newValue);
-        }
+            for (ETUUID *modifiedUUID in aTransaction.persistentRootUUIDs)
+            {
+                const BOOL isPresent = [db_ boolForQuery: @"SELECT COUNT(*) > 0 FROM persistentroots WHERE uuid = ?",
+                                                          [modifiedUUID dataValue]];
+                const BOOL modifiesMutableState = [aTransaction touchesMutableStateForPersistentRootUUID: modifiedUUID];
+                int64_t currentValue = [db_ int64ForQuery: @"SELECT transactionid FROM persistentroots WHERE uuid = ?",
+                                                           [modifiedUUID dataValue]];
+                int64_t clientValue = [aTransaction oldTransactionIDForPersistentRoot: modifiedUUID];
+                const BOOL wasLoaded = [aTransaction hasOldTransactionIDForPersistentRoot: modifiedUUID];
+
+                if (!modifiesMutableState)
+                    continue;
+
+                // Sort of a hack: we allow committing without providing a transaction ID. (if wasLoaded is NO)
+                if (!wasLoaded)
+                {
+                    clientValue = currentValue;
+                }
+
+                if (clientValue != currentValue && isPresent)
+                {
+                    ok = NO;
+                    NSLog(@"Transaction id mismatch for %@. DB had %d, transaction had %d",
+                          modifiedUUID, (int)currentValue, (int)clientValue);
+                    [self rollbackStoreTransactionNested: isNested];
+                    return;
+                }
+
+                if (!isPresent)
+                    [insertedUUIDs addObject: modifiedUUID];
+
+                const int64_t newValue = clientValue + 1;
+
+                [db_ executeUpdate: @"UPDATE persistentroots SET transactionid = ? WHERE uuid = ?",
+                                    @(newValue), [modifiedUUID dataValue]];
+
+                txnIDForPersistentRoot[modifiedUUID] = @(newValue);
+            }
 
-        // perform actions
+            // perform actions
 
-        for (id <COStoreAction> op in aTransaction.operations)
-        {
-            BOOL opOk = [op execute: self inTransaction: aTransaction];
-            if (!opOk)
+            for (id <COStoreAction> op in aTransaction.operations)
             {
-                NSLog(@"store action failed: %@", op);
-                ok = NO;
-                break;
+                BOOL opOk = [op execute: self inTransaction: aTransaction];
+                if (!opOk)
+                {
+                    NSLog(@"store action failed: %@", op);
+                    ok = NO;
+                    break;
+                }
+                ok = ok && opOk;
             }
-            ok = ok && opOk;
-        }
 
-        // gather deleted persistent root UUIDs
+            // gather deleted persistent root UUIDs
 
-        /* Since we don't allow committing to a deleted persistent root, this 
-           means these deleted UUIDs won't include persistent roots deleted in 
-           a previous commit. */
-        for (ETUUID *modifiedUUID in aTransaction.persistentRootUUIDs)
-        {
-            const BOOL isPresent = [db_ boolForQuery: @"SELECT COUNT(*) > 0 FROM persistentroots WHERE uuid = ? AND deleted = 1",
-                                                      [modifiedUUID dataValue]];
+            /* Since we don't allow committing to a deleted persistent root, this 
+               means these deleted UUIDs won't include persistent roots deleted in 
+               a previous commit. */
+            for (ETUUID *modifiedUUID in aTransaction.persistentRootUUIDs)
+            {
+                const BOOL isPresent = [db_ boolForQuery: @"SELECT COUNT(*) > 0 FROM persistentroots WHERE uuid = ? AND deleted = 1",
+                                                          [modifiedUUID dataValue]];
 
-            if (isPresent)
-                [deletedUUIDs addObject: modifiedUUID];
-        }
+                if (isPresent)
+                    [deletedUUIDs addObject: modifiedUUID];
+            }
 
-        // TODO: Turn on if we decide to write history compaction changes with
-        // this method.
+            // TODO: Turn on if we decide to write history compaction changes with
+            // this method.
 #if 0
-        // gather finalized persistent root UUIDs
+            // gather finalized persistent root UUIDs
 
-        for (ETUUID *modifiedUUID in aTransaction.persistentRootUUIDs)
-        {
-            const BOOL isPresent = [db_ boolForQuery: @"SELECT COUNT(*) > 0 FROM persistentroots WHERE uuid = ?", [modifiedUUID dataValue]];
-            
-            if (!isPresent)
-                [finalizedUUIDs addObject: modifiedUUID];
-        }
+            for (ETUUID *modifiedUUID in aTransaction.persistentRootUUIDs)
+            {
+                const BOOL isPresent = [db_ boolForQuery: @"SELECT COUNT(*) > 0 FROM persistentroots WHERE uuid = ?", [modifiedUUID dataValue]];
+
+                if (!isPresent)
+                    [finalizedUUIDs addObject: modifiedUUID];
+            }
 #endif
 
-        if (!ok)
-        {
-            [db_ rollback];
-            ok = NO;
+            if (!ok)
+            {
+                [self rollbackStoreTransactionNested: isNested];
+                ok = NO;
+            }
+            else
+            {
+                ok = [self commitStoreTransactionNested: isNested];
+            }
         }
-        else
+        @catch (NSException *e)
         {
-            ok = [db_ commit];
+            // Don't leave the transaction or the savepoint open
+            [self rollbackStoreTransactionNested: isNested];
+            exception = e;
         }
     });
 
+    if (exception != nil)
+    {
+        if (!isNested)
+        {
+            [self endCommit];
+        }
+        @throw exception;
+    }
+
     if (ok)
     {
-        [self postCommitNotificationsWithTransactionIDForPersistentRootUUID: txnIDForPersistentRoot
-                                                    insertedPersistentRoots: insertedUUIDs
-                                                     deletedPersistentRoots: deletedUUIDs
-                                                   compactedPersistentRoots: @[]
-                                                   finalizedPersistentRoots: @[]];
+        // Inside a shared transaction, other processes must not be notified
+        // before the transaction is durable
+        [self performAfterSharedTransaction: ^()
+        {
+            [self postCommitNotificationsWithTransactionIDForPersistentRootUUID: txnIDForPersistentRoot
+                                                        insertedPersistentRoots: insertedUUIDs
+                                                         deletedPersistentRoots: deletedUUIDs
+                                                       compactedPersistentRoots: @[]
+                                                       finalizedPersistentRoots: @[]];
+        }];
     }
     else
     {
         NSLog(@"Commit failed");
     }
 
-    [self endCommit];
+    if (!isNested)
+    {
+        [self endCommit];
+    }
+    [_metrics recordDurationSince: startTime forMetric: COStoreMetricCommitLatency];
     return ok;
 }
 
@@ -599,8 +814,14 @@ const int64_t currentVersion = 2;
 - (void)deleteBackingStoreWithUUID: (ETUUID *)aUUID
 {
 #if BACKING_STORES_SHARE_SAME_SQLITE_DB == 1
+    // Discard the statements prepared for the tables we drop
+    [backingStores_[aUUID] close];
+    [backingStores_ removeObjectForKey: aUUID];
+
     [db_ executeUpdate: [NSString stringWithFormat: @"DROP TABLE IF EXISTS `commits-%@`", aUUID]];
     [db_ executeUpdate: [NSString stringWithFormat: @"DROP TABLE IF EXISTS `metadata-%@`", aUUID]];
+    [db_ executeUpdate: [NSString stringWithFormat: @"DROP TABLE IF EXISTS `blobs-%@`", aUUID]];
+    [db_ executeUpdate: [NSString stringWithFormat: @"DROP TABLE IF EXISTS `blob_refs-%@`", aUUID]];
 #else
 
     // FIXME: Test this
@@ -627,17 +848,35 @@ const int64_t currentVersion = 2;
     NSParameterAssert(aRevision != nil);
     NSParameterAssert(aPersistentRoot != nil);
 
-    __block CORevisionInfo *result = nil;
+    COSharedRevisionCache *cache = _revisionCache;
+    __block CORevisionInfo *result = [cache revisionInfoForRevisionUUID: aRevision
+                                                              storeUUID: _uuid];
+
+    if (result != nil)
+    {
+        [_metrics incrementCounter: COStoreCounterRevisionCacheHits];
+        return result;
+    }
+    if (cache != nil)
+    {
+        [_metrics incrementCounter: COStoreCounterRevisionCacheMisses];
+    }
 
     dispatch_assert_queue_not(queue_);
+    const uint64_t waitStartTime = COStoreMetricsNow();
 
     dispatch_sync(queue_, ^()
     {
+        [_metrics recordDurationSince: waitStartTime forMetric: COStoreMetricQueueWaitTime];
         COSQLiteStorePersistentRootBackingStore *backing = [self backingStoreForPersistentRootUUID: aPersistentRoot
                                                                                 createIfNotPresent: YES];
         result = [backing revisionInfoForRevisionUUID: aRevision];
     });
 
+    if (result != nil)
+    {
+        [cache setRevisionInfo: result storeUUID: _uuid];
+    }
     return result;
 }
 
@@ -671,6 +910,48 @@ const int64_t currentVersion = 2;
     NSParameterAssert(aRevisionUUID != nil);
     NSParameterAssert(aPersistentRoot != nil);
 
+    COSharedRevisionCache *cache = _revisionCache;
+    __block COItemGraph *result = [cache itemGraphForRevisionUUID: aRevisionUUID
+                                                        storeUUID: _uuid];
+    __block NSUInteger byteCount = 0;
+
+    if (result != nil)
+    {
+        [_metrics incrementCounter: COStoreCounterRevisionCacheHits];
+        return result;
+    }
+    if (cache != nil)
+    {
+        [_metrics incrementCounter: COStoreCounterRevisionCacheMisses];
+    }
+
+    dispatch_assert_queue_not(queue_);
+    const uint64_t waitStartTime = COStoreMetricsNow();
+
+    dispatch_sync(queue_, ^()
+    {
+        [_metrics recordDurationSince: waitStartTime forMetric: COStoreMetricQueueWaitTime];
+        COSQLiteStorePersistentRootBackingStore *backing = [self backingStoreForPersistentRootUUID: aPersistentRoot
+                                                                                createIfNotPresent: YES];
+        result = [backing itemGraphForRevid: [backing revidForUUID: aRevisionUUID]
+                                  byteCount: &byteCount];
+    });
+
+    if (result != nil)
+    {
+        [cache setItemGraph: result cost: byteCount forRevisionUUID: aRevisionUUID storeUUID: _uuid];
+    }
+    return result;
+}
+
+- (COItemGraph *)itemGraphForRevisionUUID: (ETUUID *)aRevisionUUID
+                           persistentRoot: (ETUUID *)aPersistentRoot
+                      restrictToItemUUIDs: (NSSet *)itemUUIDs
+{
+    NSParameterAssert(aRevisionUUID != nil);
+    NSParameterAssert(aPersistentRoot != nil);
+    NSParameterAssert(itemUUIDs != nil);
+
     __block COItemGraph *result = nil;
 
     dispatch_assert_queue_not(queue_);
@@ -679,8 +960,10 @@ const int64_t currentVersion = 2;
     {
         COSQLiteStorePersistentRootBackingStore *backing = [self backingStoreForPersistentRootUUID: aPersistentRoot
                                                                                 createIfNotPresent: YES];
-        result = [backing itemGraphForRevid: [backing revidForUUID: aRevisionUUID]];
+        result = [backing itemGraphForRevid: [backing revidForUUID: aRevisionUUID]
+                        restrictToItemUUIDs: itemUUIDs];
     });
+
     return result;
 }
 
@@ -717,6 +1000,7 @@ const int64_t currentVersion = 2;
 {
     dispatch_assert_queue(queue_);
 
+    const uint64_t startTime = COStoreMetricsNow();
     [db_ savepoint: @"updateSearchIndexesForItemUUIDs"];
 
     ETUUID *backingStoreUUID = [self backingUUIDForPersistentRootUUID: aPersistentRoot
@@ -763,6 +1047,7 @@ const int64_t currentVersion = 2;
                         allItemsFtsContent];
 
     [db_ releaseSavepoint: @"updateSearchIndexesForItemUUIDs"];
+    [_metrics recordDurationSince: startTime forMetric: COStoreMetricFTSIndexingTime];
 
     //NSLog(@"Index text '%@' at revision id %@", allItemsFtsContent, aRevision);
 
@@ -889,6 +1174,87 @@ const int64_t currentVersion = 2;
     return result;
 }
 
+/**
+ * Reads the columns uuid, current_revid, head_revid, metadata, deleted and 
+ * parentbranch of the branches table, starting at the given column index.
+ */
+- (COBranchInfo *)branchInfoFromResultSet: (FMResultSet *)rs
+                              columnIndex: (int)index
+                       persistentRootUUID: (ETUUID *)aUUID
+{
+    COBranchInfo *state = [[COBranchInfo alloc] init];
+    state.UUID = [ETUUID UUIDWithData: [rs dataForColumnIndex: index]];
+    state.persistentRootUUID = aUUID;
+    state.currentRevisionUUID = [ETUUID UUIDWithData: [rs dataForColumnIndex: index + 1]];
+    state.headRevisionUUID = [ETUUID UUIDWithData: [rs dataForColumnIndex: index + 2]];
+    state.metadata = [self readMetadata: [rs dataForColumnIndex: index + 3]];
+    state.deleted = [rs boolForColumnIndex: index + 4];
+    state.parentBranchUUID = [rs dataForColumnIndex: index + 5] != nil
+        ? [ETUUID UUIDWithData: [rs dataForColumnIndex: index + 5]]
+        : nil;
+    return state;
+}
+
+- (NSArray *)persistentRootInfos
+{
+    NSMutableArray *result = [NSMutableArray array];
+
+    dispatch_assert_queue_not(queue_);
+
+    dispatch_sync(queue_, ^()
+    {
+        FMResultSet *rs = [db_ executeQuery: @"SELECT p.uuid, p.currentbranch, p.transactionid, p.metadata, "
+                                              "b.uuid, b.current_revid, b.head_revid, b.metadata, b.deleted, b.parentbranch "
+                                              "FROM persistentroots AS p "
+                                              "LEFT OUTER JOIN branches AS b ON b.proot = p.uuid "
+                                              "WHERE p.deleted = 0 "
+                                              "ORDER BY p.uuid"];
+        NSMutableArray *branchDicts = [NSMutableArray array];
+        COPersistentRootInfo *info = nil;
+        NSMutableDictionary *branchDict = nil;
+
+        while ([rs next])
+        {
+            NSData *uuidData = [rs dataForColumnIndex: 0];
+
+            // The rows for the same persistent root are contiguous
+            if (![info.UUID.dataValue isEqualToData: uuidData])
+            {
+                info = [[COPersistentRootInfo alloc] init];
+                info.UUID = [ETUUID UUIDWithData: uuidData];
+                info.currentBranchUUID = [rs dataForColumnIndex: 1] != nil
+                    ? [ETUUID UUIDWithData: [rs dataForColumnIndex: 1]]
+                    : nil;
+                info.deleted = NO;
+                info.transactionID = [rs int64ForColumnIndex: 2];
+                info.metadata = [self readMetadata: [rs dataForColumnIndex: 3]];
+                branchDict = [NSMutableDictionary dictionary];
+
+                [result addObject: info];
+                [branchDicts addObject: branchDict];
+            }
+
+            // No branch row (LEFT OUTER JOIN)
+            if ([rs dataForColumnIndex: 4] == nil)
+                continue;
+
+            COBranchInfo *state = [self branchInfoFromResultSet: rs
+                                                    columnIndex: 4
+                                             persistentRootUUID: info.UUID];
+
+            branchDict[state.UUID] = state;
+        }
+        [rs close];
+
+        // -branchForUUID is a copy property
+        [result enumerateObjectsUsingBlock: ^(COPersistentRootInfo *anInfo, NSUInteger i, BOOL *stop)
+        {
+            anInfo.branchForUUID = branchDicts[i];
+        }];
+    });
+    return result;
+}
+
 - (COPersistentRootInfo *)persistentRootInfoForUUID: (ETUUID *)aUUID
 {
     if (aUUID == nil)
@@ -937,23 +1303,11 @@ const int64_t currentVersion = 2;
                                                  [aUUID dataValue]];
             while ([rs next])
             {
-                ETUUID *branch = [ETUUID UUIDWithData: [rs dataForColumnIndex: 0]];
-                ETUUID *currentRevid = [ETUUID UUIDWithData: [rs dataForColumnIndex: 1]];
-                ETUUID *headRevid = [ETUUID UUIDWithData: [rs dataForColumnIndex: 2]];
-                id branchMeta = [self readMetadata: [rs dataForColumnIndex: 3]];
-
-                COBranchInfo *state = [[COBranchInfo alloc] init];
-                state.UUID = branch;
-                state.persistentRootUUID = aUUID;
-                state.currentRevisionUUID = currentRevid;
-                state.headRevisionUUID = headRevid;
-                state.metadata = branchMeta;
-                state.deleted = [rs boolForColumnIndex: 4];
-                state.parentBranchUUID = [rs dataForColumnIndex: 5] != nil
-                    ? [ETUUID UUIDWithData: [rs dataForColumnIndex: 5]]
-                    : nil;
+                COBranchInfo *state = [self branchInfoFromResultSet: rs
+                                                        columnIndex: 0
+                                                 persistentRootUUID: aUUID];
 
-                branchDict[branch] = state;
+                branchDict[state.UUID] = state;
             }
             [rs close];
         }
@@ -1013,6 +1367,9 @@ const int64_t currentVersion = 2;
             
             result = [backingStore migrateRevisionsToVersion: newVersion withHandler: handler];
 
+            // Even if the migration fails, some revisions could have been rewritten
+            [_revisionCache removeAllRevisionsForStoreUUID: _uuid];
+
             if (!result)
             {
                 return;
@@ -1224,6 +1581,16 @@ const int64_t currentVersion = 2;
     return db_;
 }
 
+- (dispatch_queue_t)queue
+{
+    return queue_;
+}
+
+- (dispatch_semaphore_t)commitLock
+{
+    return _commitLock;
+}
+
 - (NSString *)description
 {
     return [NSString stringWithFormat: @"<%@ %p - %@ (%@)>",
@@ -1307,8 +1674,10 @@ const int64_t currentVersion = 2;
         [db_ executeUpdate: @"DROP TABLE IF EXISTS storeMetadata"];
         [db_ commit];
 
+        [backingStores_.allValues makeObjectsPerformSelector: @selector(close)];
         [backingStores_ removeAllObjects];
         [backingStoreUUIDForPersistentRootUUID_ removeAllObjects];
+        [_revisionCache removeAllRevisionsForStoreUUID: _uuid];
 
         [self setUpStore];
     });
@@ -31,6 +31,10 @@ NS_ASSUME_NONNULL_BEGIN
      * Can be cached after being read for the first time, since it can never change
      */
     ETUUID *_rootObjectUUID;
+    /**
+     * The SQL statements built by -SQL:, keyed by template
+     */
+    NSMutableDictionary *_SQLForTemplate;
 }
 
 + (void)migrateForBackingUUID: (ETUUID *)uuid
@@ -58,6 +62,10 @@ NS_ASSUME_NONNULL_BEGIN
 - (BOOL)hasRevid: (int64_t)revid;
 - (COItemGraph *)itemGraphForRevid: (int64_t)revid;
 - (COItemGraph *)itemGraphForRevid: (int64_t)revid restrictToItemUUIDs: (nullable NSSet<ETUUID *> *)itemSet;
+/**
+ * Returns the item graph and the size of its serialized items in byteCount.
+ */
+- (COItemGraph *)itemGraphForRevid: (int64_t)revid byteCount: (nullable NSUInteger *)byteCount;
 /**
  * baseRevid must be < finalRevid.
  * returns nil if baseRevid or finalRevid are not valid revisions.
@@ -66,6 +74,10 @@ NS_ASSUME_NONNULL_BEGIN
 - (COItemGraph *)partialItemGraphFromRevid: (int64_t)baseRevid
                                    toRevid: (int64_t)revid
                        restrictToItemUUIDs: (nullable NSSet<ETUUID *> *)itemSet;
+- (COItemGraph *)partialItemGraphFromRevid: (int64_t)baseRevid
+                                   toRevid: (int64_t)revid
+                       restrictToItemUUIDs: (nullable NSSet<ETUUID *> *)itemSet
+                                 byteCount: (nullable NSUInteger *)byteCount;
 - (BOOL)writeItemGraph: (COItemGraph *)anItemTree
           revisionUUID: (ETUUID *)aRevisionUUID
           withMetadata: (nullable NSDictionary<NSString *, id> *)metadata
@@ -108,6 +120,13 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+/**
+ * Returns the revision contents for the item graph.
+ *
+ * Unlike -[COContentsBlobWriter contentsBlobWithItemGraph:], the returned
+ * data owns its bytes and can be kept. The bytes are written to a buffer
+ * handed over to the data, without copying them.
+ */
 NSData *contentsBLOBWithItemTree(id <COItemGraph> itemGraph);
 
 NS_ASSUME_NONNULL_END
@@ -15,6 +15,8 @@
 #import "FMDatabaseAdditions.h"
 #import "COSQLiteStorePersistentRootBackingStoreBinaryFormats.h"
 #import "COItem+Binary.h"
+#import "COContentsBlobWriter.h"
+#import "COStoreMetrics.h"
 #import "CORevisionInfo.h"
 #import "COSQLiteStore+Private.h"
 #import "CODateSerialization.h"
@@ -44,6 +46,15 @@
 
 @end
 
+static NSData *Sha1Data(NSData *data, COStoreMetrics *metrics)
+{
+    const uint64_t startTime = COStoreMetricsNow();
+    unsigned char buffer[20];
+    SHA1(data.bytes, data.length, buffer);
+    [metrics recordDurationSince: startTime forMetric: COStoreMetricSHA1Time];
+    return [NSData dataWithBytes: buffer length: 20];
+}
+
 
 @implementation COSQLiteStorePersistentRootBackingStore
 
@@ -71,6 +82,79 @@
     }
 }
 
+- (NSString *)blobTableName
+{
+    if (_shareDB)
+    {
+        return [NSString stringWithFormat: @"`blobs-%@`", _uuid];
+    }
+    else
+    {
+        return @"blobs";
+    }
+}
+
+- (NSString *)blobRefTableName
+{
+    if (_shareDB)
+    {
+        return [NSString stringWithFormat: @"`blob_refs-%@`", _uuid];
+    }
+    else
+    {
+        return @"blob_refs";
+    }
+}
+
+- (NSString *)blobRefIndexName
+{
+    if (_shareDB)
+    {
+        return [NSString stringWithFormat: @"`blob_refs_hash-%@`", _uuid];
+    }
+    else
+    {
+        return @"blob_refs_hash";
+    }
+}
+
+/**
+ * Returns the SQL statement where the {commits}, {metadata}, {blobs},
+ * {blob_refs} and {blob_refs_hash} placeholders are replaced by the receiver
+ * table and index names.
+ *
+ * Each statement is built once per backing store, then the same string is
+ * returned. When the backing stores share the store database, the table
+ * names are per backing store, so each backing store has its own prepared
+ * statements in the FMDB cache, which -close removes.
+ */
+- (NSString *)SQL: (NSString *)aTemplate
+{
+    NSString *SQL = _SQLForTemplate[aTemplate];
+
+    if (SQL != nil)
+        return SQL;
+
+    NSDictionary *namesByPlaceholder = @{ @"{commits}" : [self tableName],
+                                          @"{metadata}" : [self metadataTableName],
+                                          @"{blobs}" : [self blobTableName],
+                                          @"{blob_refs}" : [self blobRefTableName],
+                                          @"{blob_refs_hash}" : [self blobRefIndexName] };
+    NSMutableString *result = [aTemplate mutableCopy];
+
+    [namesByPlaceholder enumerateKeysAndObjectsUsingBlock: ^(NSString *placeholder, NSString *name, BOOL *stop)
+    {
+        [result replaceOccurrencesOfString: placeholder
+                                withString: name
+                                   options: 0
+                                     range: NSMakeRange(0, result.length)];
+    }];
+
+    SQL = [result copy];
+    _SQLForTemplate[aTemplate] = SQL;
+    return SQL;
+}
+
 - (instancetype)initWithPersistentRootUUID: (ETUUID *)aUUID
                                      store: (COSQLiteStore *)store
                                 useStoreDB: (BOOL)share
@@ -83,6 +167,7 @@
     _shareDB = share;
     _store = store;
     _uuid = aUUID;
+    _SQLForTemplate = [NSMutableDictionary new];
 
     if (_shareDB)
     {
@@ -118,16 +203,24 @@
     [self beginTransaction];
 
     // N.B. UNIQUE constraint on uuid gives it an index automatically.
-    [db_ executeUpdate: [NSString stringWithFormat:
-        @"CREATE TABLE IF NOT EXISTS %@ (revid INTEGER PRIMARY KEY ASC, "
+    [db_ executeUpdate: [self SQL:
+        @"CREATE TABLE IF NOT EXISTS {commits} (revid INTEGER PRIMARY KEY ASC, "
             "contents BLOB, hash BLOB, metadata BLOB, timestamp INTEGER, parent INTEGER, mergeparent INTEGER, branchuuid BLOB, persistentrootuuid BLOB, deltabase INTEGER, "
-            "bytesInDeltaRun INTEGER, garbage BOOLEAN, uuid BLOB NOT NULL UNIQUE, version INTEGER DEFAULT 0)",
-        [self tableName]]];
+            "bytesInDeltaRun INTEGER, garbage BOOLEAN, uuid BLOB NOT NULL UNIQUE, version INTEGER DEFAULT 0)"]];
 
     // This table always contains exactly one row
-    [db_ executeUpdate: [NSString stringWithFormat:
-        @"CREATE TABLE IF NOT EXISTS %@ (root BLOB NOT NULL CHECK (length(root) = 16))",
-        [self metadataTableName]]];
+    [db_ executeUpdate: [self SQL:
+        @"CREATE TABLE IF NOT EXISTS {metadata} (root BLOB NOT NULL CHECK (length(root) = 16))"]];
+
+    // Blobs stored out of line, keyed by their SHA-1 hash
+    [db_ executeUpdate: [self SQL:
+        @"CREATE TABLE IF NOT EXISTS {blobs} (hash BLOB PRIMARY KEY, contents BLOB NOT NULL)"]];
+
+    // Blobs referenced by each revision, to delete unused blobs on compaction
+    [db_ executeUpdate: [self SQL:
+        @"CREATE TABLE IF NOT EXISTS {blob_refs} (revid INTEGER NOT NULL, hash BLOB NOT NULL, PRIMARY KEY (revid, hash))"]];
+    [db_ executeUpdate: [self SQL:
+        @"CREATE INDEX IF NOT EXISTS {blob_refs_hash} ON {blob_refs} (hash)"]];
 
     [self commit];
 
@@ -167,8 +260,10 @@
 - (void)clearBackingStore
 {
     [self beginTransaction];
-    [db_ executeUpdate: [NSString stringWithFormat: @"DELETE FROM %@", [self tableName]]];
-    [db_ executeUpdate: [NSString stringWithFormat: @"DELETE FROM %@", [self metadataTableName]]];
+    [db_ executeUpdate: [self SQL: @"DELETE FROM {commits}"]];
+    [db_ executeUpdate: [self SQL: @"DELETE FROM {metadata}"]];
+    [db_ executeUpdate: [self SQL: @"DELETE FROM {blobs}"]];
+    [db_ executeUpdate: [self SQL: @"DELETE FROM {blob_refs}"]];
     ETAssert([self commit]);
 }
 
@@ -185,6 +280,9 @@
     }
     else
     {
+        // The store database outlives the receiver
+        [db_ clearCachedStatementsForQueries: _SQLForTemplate.allValues];
+        [_SQLForTemplate removeAllObjects];
         return YES;
     }
 }
@@ -235,7 +333,7 @@
 - (ETUUID *)revisionUUIDForRevid: (int64_t)aRevid
 {
     NSData *revUUID = [db_ dataForQuery:
-        [NSString stringWithFormat: @"SELECT uuid FROM %@ WHERE revid = ?", [self tableName]],
+        [self SQL: @"SELECT uuid FROM {commits} WHERE revid = ?"],
         @(aRevid)];
 
     if (revUUID != nil)
@@ -251,9 +349,9 @@
 - (CORevisionInfo *)revisionInfoForRevisionUUID: (ETUUID *)aRevisionUUID
 {
     CORevisionInfo *result = nil;
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat:
+    FMResultSet *rs = [db_ executeQuery: [self SQL:
         @"SELECT parent, mergeparent, branchuuid, persistentrootuuid, metadata, timestamp, version "
-        "FROM %@ WHERE uuid = ?", [self tableName]],
+        "FROM {commits} WHERE uuid = ?"],
         [aRevisionUUID dataValue]];
 
     if ([rs next])
@@ -284,7 +382,7 @@
 - (int64_t)revidForUUID: (ETUUID *)aUUID
 {
     NSNumber *revid = [db_ numberForQuery:
-        [NSString stringWithFormat: @"SELECT revid FROM %@ WHERE uuid = ?", [self tableName]],
+        [self SQL: @"SELECT revid FROM {commits} WHERE uuid = ?"],
         [aUUID dataValue]];
     if (revid == nil)
     {
@@ -297,8 +395,8 @@
 {
     NSSet *UUIDDataValues = (id)[[[NSSet setWithArray: UUIDs] mappedCollection] dataValue];
     NSMutableIndexSet *revids = [NSMutableIndexSet new];
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat:
-        @"SELECT revid, uuid FROM %@", [self tableName]]];
+    FMResultSet *rs = [db_ executeQuery: [self SQL:
+        @"SELECT revid, uuid FROM {commits}"]];
 
     while ([rs next])
     {
@@ -316,8 +414,7 @@
 {
     if (_rootObjectUUID == nil)
     {
-        FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat: @"SELECT root FROM %@",
-                                                                         [self metadataTableName]]];
+        FMResultSet *rs = [db_ executeQuery: [self SQL: @"SELECT root FROM {metadata}"]];
         if ([rs next])
         {
             _rootObjectUUID = [ETUUID UUIDWithData: [rs dataForColumnIndex: 0]];
@@ -330,30 +427,82 @@
 
 - (BOOL)hasRevid: (int64_t)revid
 {
-    return [db_ boolForQuery: [NSString stringWithFormat: @"SELECT 1 FROM %@ WHERE revid = ?",
-                                                          [self tableName]],
+    return [db_ boolForQuery: [self SQL: @"SELECT 1 FROM {commits} WHERE revid = ?"],
                               @(revid)];
 }
 
+/**
+ * Below this item count, decoding the items on the current thread is faster
+ * than dispatching the work to other cores.
+ */
+#define CO_CONCURRENT_ITEM_DECODING_THRESHOLD 256
+
+/**
+ * Converts dataForUUID to a UUID -> COItem mapping.
+ *
+ * Each item is decoded independently from the others, so large item graphs
+ * are decoded concurrently with dispatch_apply(). Item decoding doesn't touch
+ * any shared mutable state (no object graph context or store is involved),
+ * except the cross persistent root paths that go through the striped
+ * COInterningTable, so the returned items can be used on the calling thread
+ * right away.
+ */
+static NSDictionary *COItemsByDecodingItemDataForUUIDs(NSDictionary *dataForUUID)
+{
+    const NSUInteger count = dataForUUID.count;
+    NSMutableDictionary *result = [NSMutableDictionary dictionaryWithCapacity: count];
+
+    if (count < CO_CONCURRENT_ITEM_DECODING_THRESHOLD)
+    {
+        for (ETUUID *uuid in dataForUUID)
+        {
+            result[uuid] = [[COItem alloc] initWithData: dataForUUID[uuid]];
+        }
+        return result;
+    }
+
+    NSArray *uuids = dataForUUID.allKeys;
+    NSArray *datas = [dataForUUID objectsForKeys: uuids notFoundMarker: [NSNull null]];
+    __strong COItem **items = (__strong COItem **)calloc(count, sizeof(COItem *));
+
+    dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i)
+    {
+        items[i] = [[COItem alloc] initWithData: datas[i]];
+    });
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        result[uuids[i]] = items[i];
+        items[i] = nil;
+    }
+    free(items);
+
+    return result;
+}
+
 /**
  * Returns the item tree 
  */
 - (COItemGraph *)partialItemGraphFromRevid: (int64_t)baseRevid
                                    toRevid: (int64_t)revid
                        restrictToItemUUIDs: (NSSet *)itemSet
+                                 byteCount: (NSUInteger *)byteCount
 {
     NSNumber *revidObj = @(revid);
 
     NSMutableDictionary *dataForUUID = [NSMutableDictionary dictionary];
 
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat:
+    FMResultSet *rs = [db_ executeQuery: [self SQL:
         @"SELECT revid, contents, hash, parent, deltabase "
-            "FROM %@ "
-            "WHERE revid <= ? AND revid >= (SELECT deltabase FROM %@ WHERE revid = ?) "
-            "ORDER BY revid DESC", [self tableName], [self tableName]],
+            "FROM {commits} "
+            "WHERE revid <= ? AND revid >= (SELECT deltabase FROM {commits} WHERE revid = ?) "
+            "ORDER BY revid DESC"],
                                          revidObj, revidObj];
 
     int64_t nextRevId = -1;
+    uint64_t rowCount = 0;
+    uint64_t rowByteCount = 0;
+    uint64_t deltaChainLength = 0;
 
     BOOL wasEmpty = YES;
     while ([rs next])
@@ -366,9 +515,14 @@
         const int64_t parent = [rs longLongIntForColumnIndex: 3];
         const int64_t deltabase = [rs boolForColumnIndex: 4];
 
+        rowCount++;
+        rowByteCount += contentsData.length;
+
         if (revid == nextRevId || nextRevId == -1)
         {
-            NSData *actualHash = Sha1Data(contentsData);
+            deltaChainLength++;
+
+            NSData *actualHash = Sha1Data(contentsData, _store.metrics);
             ETAssert([hashData isEqual: actualHash]);
 
             ParseCombinedCommitDataInToUUIDToItemDataDictionary(dataForUUID,
@@ -404,17 +558,36 @@
         return nil;
     }
 
-    ETUUID *root = self.rootUUID;
+    COStoreMetrics *metrics = _store.metrics;
+
+    [metrics recordValue: rowCount forMetric: COStoreMetricReconstructionRowCount];
+    [metrics recordValue: rowByteCount forMetric: COStoreMetricReconstructionByteCount];
+    [metrics recordValue: deltaChainLength forMetric: COStoreMetricDeltaChainLength];
+
+    if (byteCount != NULL)
+    {
+        NSUInteger count = 0;
+
+        for (NSData *data in dataForUUID.objectEnumerator)
+        {
+            count += data.length;
+        }
+        *byteCount = count;
+    }
 
-    // Convert dataForUUID to a UUID -> COItem mapping.
+    ETUUID *root = self.rootUUID;
     // TODO: Eliminate this by giving COItem to be created with a serialized NSData of itself,
     // and lazily deserializing itself.
-    NSMutableDictionary *resultDict = [NSMutableDictionary dictionary];
-    for (ETUUID *uuid in dataForUUID)
+    NSUInteger blobByteCount = 0;
+    NSDictionary *resultDict = [self itemsByLoadingBlobsOfItems: COItemsByDecodingItemDataForUUIDs(dataForUUID)
+                                                      byteCount: &blobByteCount];
+
+    if (resultDict == nil)
+        return nil;
+
+    if (byteCount != NULL)
     {
-        NSData *data = dataForUUID[uuid];
-        COItem *item = [[COItem alloc] initWithData: data];
-        resultDict[uuid] = item;
+        *byteCount += blobByteCount;
     }
 
     COItemGraph *result = [[COItemGraph alloc] initWithItemForUUID: resultDict
@@ -422,16 +595,32 @@
     return result;
 }
 
+- (COItemGraph *)partialItemGraphFromRevid: (int64_t)baseRevid
+                                   toRevid: (int64_t)revid
+                       restrictToItemUUIDs: (NSSet *)itemSet
+{
+    return [self partialItemGraphFromRevid: baseRevid
+                                   toRevid: revid
+                       restrictToItemUUIDs: itemSet
+                                 byteCount: NULL];
+}
+
 - (COItemGraph *)partialItemGraphFromRevid: (int64_t)baseRevid toRevid: (int64_t)revid
 {
     return [self partialItemGraphFromRevid: baseRevid toRevid: revid restrictToItemUUIDs: nil];
 }
 
 - (COItemGraph *)itemGraphForRevid: (int64_t)revid
+{
+    return [self itemGraphForRevid: revid byteCount: NULL];
+}
+
+- (COItemGraph *)itemGraphForRevid: (int64_t)revid byteCount: (NSUInteger *)byteCount
 {
     COItemGraph *result = [self partialItemGraphFromRevid: -1
                                                   toRevid: revid
-                                      restrictToItemUUIDs: nil];
+                                      restrictToItemUUIDs: nil
+                                                byteCount: byteCount];
 
 #ifdef VALIDATE_ITEM_GRAPHS
     if (result != nil)
@@ -448,38 +637,10 @@
     return [self partialItemGraphFromRevid: -1 toRevid: revid restrictToItemUUIDs: itemSet];
 }
 
-NSData *contentsBLOBWithItemTree(id <COItemGraph> itemGraph)
-{
-    NSMutableData *result = [NSMutableData dataWithCapacity: 64536];
-
-    NSArray *sortedUUIDs = [itemGraph.itemUUIDs sortedArrayUsingComparator: ^(id obj1, id obj2)
-    {
-        ETUUID *uuid1 = (ETUUID *)obj1;
-        ETUUID *uuid2 = (ETUUID *)obj2;
-        int result = memcmp([uuid1 UUIDValue], [uuid2 UUIDValue], 16);
-        return (result < 0)
-            ? NSOrderedAscending
-            : ((result == 0)
-                ? NSOrderedSame
-                : NSOrderedDescending);
-    }];
-
-    for (ETUUID *uuid in sortedUUIDs)
-    {
-        COItem *item = [itemGraph itemForUUID: uuid];
-        NSData *itemData = item.dataValue;
-
-        AddCommitUUIDAndDataToCombinedCommitData(result, uuid, itemData);
-    }
-
-    return result;
-}
-
 - (int64_t)nextRowid
 {
     int64_t result = 0;
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat: @"SELECT MAX(rowid) FROM %@",
-                                                                     [self tableName]]];
+    FMResultSet *rs = [db_ executeQuery: [self SQL: @"SELECT MAX(rowid) FROM {commits}"]];
     if ([rs next])
     {
         if (![rs columnIndexIsNull: 0])
@@ -496,8 +657,7 @@ NSData *contentsBLOBWithItemTree(id <COItemGraph> itemGraph)
 {
     int64_t deltabase = -1;
 
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat: @"SELECT deltabase FROM %@ WHERE rowid = ?",
-                                                                     [self tableName]],
+    FMResultSet *rs = [db_ executeQuery: [self SQL: @"SELECT deltabase FROM {commits} WHERE rowid = ?"],
                                          @(aRowid)];
     if ([rs next])
     {
@@ -512,8 +672,7 @@ NSData *contentsBLOBWithItemTree(id <COItemGraph> itemGraph)
 {
     int64_t bytesInDeltaRun = 0;
 
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat: @"SELECT bytesInDeltaRun FROM %@ WHERE rowid = ?",
-                                                                     [self tableName]],
+    FMResultSet *rs = [db_ executeQuery: [self SQL: @"SELECT bytesInDeltaRun FROM {commits} WHERE rowid = ?"],
                                          @(aRowid)];
     if ([rs next])
     {
@@ -524,11 +683,273 @@ NSData *contentsBLOBWithItemTree(id <COItemGraph> itemGraph)
     return bytesInDeltaRun;
 }
 
-static NSData *Sha1Data(NSData *data)
+/**
+ * In the revision contents, a blob stored out of line is replaced by a 
+ * reference made of this prefix followed by the blob SHA-1 hash.
+ */
+static const char COBlobReferencePrefix[] = "COBlobRef";
+static const NSUInteger COBlobReferencePrefixLength = sizeof(COBlobReferencePrefix) - 1;
+static const NSUInteger COBlobReferenceLength = sizeof(COBlobReferencePrefix) - 1 + 20;
+
+static BOOL COIsBlobReference(id aValue)
 {
-    unsigned char buffer[20];
-    SHA1(data.bytes, data.length, buffer);
-    return [NSData dataWithBytes: buffer length: 20];
+    if (![aValue isKindOfClass: [NSData class]] || [aValue length] != COBlobReferenceLength)
+        return NO;
+
+    return memcmp([aValue bytes], COBlobReferencePrefix, COBlobReferencePrefixLength) == 0;
+}
+
+static NSData *COBlobReferenceWithHash(NSData *aHash)
+{
+    NSMutableData *reference = [NSMutableData dataWithCapacity: COBlobReferenceLength];
+
+    [reference appendBytes: COBlobReferencePrefix length: COBlobReferencePrefixLength];
+    [reference appendData: aHash];
+    return reference;
+}
+
+static NSData *COHashOfBlobReference(NSData *aReference)
+{
+    return [aReference subdataWithRange: NSMakeRange(COBlobReferencePrefixLength, 20)];
+}
+
+/**
+ * Returns a blob reference if the value is a large blob, otherwise the value
+ * itself.
+ *
+ * A blob which looks like a blob reference is always stored out of line, so
+ * blob references read back can't be confused with blob values.
+ */
+- (id)blobReferenceForValue: (id)aValue hashes: (NSMutableSet *)hashes
+{
+    if (![aValue isKindOfClass: [NSData class]])
+        return aValue;
+
+    if ([aValue length] < _store.outOfLineBlobThreshold && !COIsBlobReference(aValue))
+        return aValue;
+
+    NSData *hash = Sha1Data(aValue, _store.metrics);
+
+    if (![hashes containsObject: hash])
+    {
+        [db_ executeUpdate: [self SQL: @"INSERT OR IGNORE INTO {blobs} (hash, contents) VALUES (?, ?)"],
+                            hash, aValue];
+        [hashes addObject: hash];
+    }
+    return COBlobReferenceWithHash(hash);
+}
+
+/**
+ * Returns the item with large blobs replaced by blob references, or the item
+ * itself when it contains no large blobs.
+ */
+- (COItem *)itemByStoringLargeBlobsOfItem: (COItem *)anItem hashes: (NSMutableSet *)hashes
+{
+    NSMutableDictionary *values = nil;
+
+    for (NSString *attribute in anItem.attributeNames)
+    {
+        const COType type = [anItem typeForAttribute: attribute];
+
+        if (COTypePrimitivePart(type) != kCOTypeBlob)
+            continue;
+
+        id value = [anItem valueForAttribute: attribute];
+        id newValue = nil;
+
+        if (COTypeIsUnivalued(type))
+        {
+            newValue = [self blobReferenceForValue: value hashes: hashes];
+        }
+        else
+        {
+            newValue = [value mappedCollectionWithBlock: ^(id element)
+            {
+                return [self blobReferenceForValue: element hashes: hashes];
+            }];
+        }
+
+        if ([newValue isEqual: value])
+            continue;
+
+        if (values == nil)
+        {
+            values = [NSMutableDictionary new];
+            for (NSString *attr in anItem.attributeNames)
+            {
+                values[attr] = [anItem valueForAttribute: attr];
+            }
+        }
+        values[attribute] = newValue;
+    }
+
+    if (values == nil)
+        return anItem;
+
+    NSMutableDictionary *types = [NSMutableDictionary new];
+
+    for (NSString *attribute in anItem.attributeNames)
+    {
+        types[attribute] = @([anItem typeForAttribute: attribute]);
+    }
+    return [[COItem alloc] initWithUUID: anItem.UUID
+                     typesForAttributes: types
+                    valuesForAttributes: values];
+}
+
+/**
+ * Returns the revision contents for the item graph, where the large blobs are
+ * stored in the blob table and replaced by blob references.
+ *
+ * The contents are only valid until the next call, see
+ * -[COContentsBlobWriter contentsBlobWithItemGraph:].
+ *
+ * The hashes of the blobs referenced by the contents are added to hashes.
+ */
+- (NSData *)contentsBlobWithItemGraph: (id <COItemGraph>)anItemGraph blobHashes: (NSMutableSet *)hashes
+{
+    NSMutableDictionary *itemsByUUID = [NSMutableDictionary dictionaryWithCapacity: anItemGraph.itemUUIDs.count];
+
+    for (ETUUID *uuid in anItemGraph.itemUUIDs)
+    {
+        itemsByUUID[uuid] = [self itemByStoringLargeBlobsOfItem: [anItemGraph itemForUUID: uuid]
+                                                         hashes: hashes];
+    }
+
+    COItemGraph *itemGraph = [[COItemGraph alloc] initWithItemForUUID: itemsByUUID
+                                                         rootItemUUID: anItemGraph.rootItemUUID];
+    return [_store.contentsBlobWriter contentsBlobWithItemGraph: itemGraph];
+}
+
+- (BOOL)setBlobHashes: (NSSet *)hashes forRevid: (int64_t)revid
+{
+    BOOL ok = [db_ executeUpdate: [self SQL: @"DELETE FROM {blob_refs} WHERE revid = ?"],
+                                  @(revid)];
+
+    for (NSData *hash in hashes)
+    {
+        ok = ok && [db_ executeUpdate: [self SQL: @"INSERT INTO {blob_refs} (revid, hash) VALUES (?, ?)"],
+                                       @(revid), hash];
+    }
+    return ok;
+}
+
+- (NSData *)blobForHash: (NSData *)aHash
+{
+    return [db_ dataForQuery: [self SQL: @"SELECT contents FROM {blobs} WHERE hash = ?"],
+                              aHash];
+}
+
+/**
+ * Returns the blob for a blob reference, or nil if the blob is missing.
+ *
+ * Other values are returned unchanged.
+ */
+- (id)valueByLoadingBlobReference: (id)aValue
+                     blobsByHash: (NSMutableDictionary *)blobsByHash
+                       byteCount: (NSUInteger *)byteCount
+{
+    if (!COIsBlobReference(aValue))
+        return aValue;
+
+    NSData *hash = COHashOfBlobReference(aValue);
+    NSData *blob = blobsByHash[hash];
+
+    if (blob == nil)
+    {
+        blob = [self blobForHash: hash];
+
+        if (blob == nil)
+        {
+            NSLog(@"Error, missing blob %@ referenced by %@", hash, _store.URL);
+            return nil;
+        }
+        blobsByHash[hash] = blob;
+    }
+    *byteCount += blob.length;
+    return blob;
+}
+
+/**
+ * Replaces the blob references in the decoded items with the blobs read from
+ * the blob table, and returns the total length of these blobs in byteCount.
+ *
+ * This is done once the delta run has been parsed, so only the blobs belonging
+ * to the returned items are read, and each blob is read once.
+ *
+ * Returns nil if a referenced blob is missing from the blob table (a corrupted
+ * store).
+ */
+- (NSDictionary *)itemsByLoadingBlobsOfItems: (NSDictionary *)itemsByUUID byteCount: (NSUInteger *)byteCount
+{
+    NSMutableDictionary *result = nil;
+    NSMutableDictionary *blobsByHash = [NSMutableDictionary new];
+
+    *byteCount = 0;
+
+    for (ETUUID *uuid in itemsByUUID)
+    {
+        COItem *item = itemsByUUID[uuid];
+        COMutableItem *newItem = nil;
+
+        for (NSString *attribute in item.attributeNames)
+        {
+            const COType type = [item typeForAttribute: attribute];
+
+            if (COTypePrimitivePart(type) != kCOTypeBlob)
+                continue;
+
+            id value = [item valueForAttribute: attribute];
+            id newValue = nil;
+            __block BOOL isMissingBlob = NO;
+
+            if (COTypeIsUnivalued(type))
+            {
+                newValue = [self valueByLoadingBlobReference: value
+                                                 blobsByHash: blobsByHash
+                                                   byteCount: byteCount];
+                isMissingBlob = (newValue == nil && value != nil);
+            }
+            else
+            {
+                newValue = [value mappedCollectionWithBlock: ^(id element)
+                {
+                    id blob = [self valueByLoadingBlobReference: element
+                                                    blobsByHash: blobsByHash
+                                                      byteCount: byteCount];
+
+                    if (blob == nil)
+                    {
+                        isMissingBlob = YES;
+                        return element;
+                    }
+                    return blob;
+                }];
+            }
+
+            if (isMissingBlob)
+                return nil;
+
+            if (newValue == value || [newValue isEqual: value])
+                continue;
+
+            if (newItem == nil)
+            {
+                newItem = [item mutableCopy];
+            }
+            [newItem setValue: newValue forAttribute: attribute type: type];
+        }
+
+        if (newItem == nil)
+            continue;
+
+        if (result == nil)
+        {
+            result = [itemsByUUID mutableCopy];
+        }
+        result[uuid] = [newItem copy];
+    }
+    return (result != nil ? result : itemsByUUID);
 }
 
 /**
@@ -572,6 +993,7 @@ static NSData *Sha1Data(NSData *data)
     const int64_t lastBytesInDeltaRun = [self bytesInDeltaRunForRowid: rowid - 1];
     int64_t deltabase;
     NSData *contentsBlob;
+    NSMutableSet *blobHashes = [NSMutableSet new];
     int64_t bytesInDeltaRun;
 
     // Limit delta runs to 50 commits
@@ -582,7 +1004,7 @@ static NSData *Sha1Data(NSData *data)
     if (delta)
     {
         deltabase = parent_deltabase;
-        contentsBlob = contentsBLOBWithItemTree(anItemTree);
+        contentsBlob = [self contentsBlobWithItemGraph: anItemTree blobHashes: blobHashes];
         bytesInDeltaRun = lastBytesInDeltaRun + contentsBlob.length;
     }
     else
@@ -610,7 +1032,7 @@ static NSData *Sha1Data(NSData *data)
         // GC before doing a full save so garbage isn't written to the snapshot
         [combinedGraph removeUnreachableItems];
 
-        contentsBlob = contentsBLOBWithItemTree(combinedGraph);
+        contentsBlob = [self contentsBlobWithItemGraph: combinedGraph blobHashes: blobHashes];
         bytesInDeltaRun = contentsBlob.length;
     }
 
@@ -620,13 +1042,13 @@ static NSData *Sha1Data(NSData *data)
         metadataBlob = CODataWithJSONObject(metadata, NULL);
     }
 
-    BOOL ok = [db_ executeUpdate: [NSString stringWithFormat: 
-        @"INSERT INTO %@ (revid, contents, hash, metadata, timestamp, parent, mergeparent, "
+    BOOL ok = [db_ executeUpdate: [self SQL:
+        @"INSERT INTO {commits} (revid, contents, hash, metadata, timestamp, parent, mergeparent, "
         "branchuuid, persistentrootuuid, deltabase, bytesInDeltaRun, garbage, uuid, version) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, 0, ?, ?)", [self tableName]],
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, 0, ?, ?)"],
         @(rowid),
         contentsBlob,
-        Sha1Data(contentsBlob),
+        Sha1Data(contentsBlob, _store.metrics),
         metadataBlob,
         CODateToJavaTimestamp([NSDate date]),
         @(aParent),
@@ -637,6 +1059,7 @@ static NSData *Sha1Data(NSData *data)
         @(bytesInDeltaRun),
         [aRevisionUUID dataValue],
         @(aVersion)];
+    ok = ok && [self setBlobHashes: blobHashes forRevid: rowid];
 
 
     // Update the root object UUID
@@ -644,8 +1067,7 @@ static NSData *Sha1Data(NSData *data)
 
     if (currentRoot == nil)
     {
-        ok = ok && [db_ executeUpdate: [NSString stringWithFormat: @"INSERT INTO %@ (root) VALUES (?)",
-                                                                   [self metadataTableName]],
+        ok = ok && [db_ executeUpdate: [self SQL: @"INSERT INTO {metadata} (root) VALUES (?)"],
                                        [anItemTree.rootItemUUID dataValue]];
     }
     else if (![currentRoot isEqual: anItemTree.rootItemUUID])
@@ -675,6 +1097,7 @@ static NSData *Sha1Data(NSData *data)
     const int64_t parentDeltabase = [self deltabaseForRowid: parent];
     const BOOL delta = parentDeltabase != -1 && deltabase == parentDeltabase;
     NSData *contentsBlob = nil;
+    NSMutableSet *blobHashes = [NSMutableSet new];
     
     if (delta)
     {
@@ -687,17 +1110,17 @@ static NSData *Sha1Data(NSData *data)
             [[COItemGraph alloc] initWithItems: partialItems.allObjects
                                   rootItemUUID: newItemGraph.rootItemUUID];
         
-        contentsBlob = contentsBLOBWithItemTree(partialItemGraph);
+        contentsBlob = [self contentsBlobWithItemGraph: partialItemGraph blobHashes: blobHashes];
     }
     else
     {
-        contentsBlob = contentsBLOBWithItemTree(newItemGraph);
+        contentsBlob = [self contentsBlobWithItemGraph: newItemGraph blobHashes: blobHashes];
     }
     
-    BOOL ok = [db_ executeUpdate: [NSString stringWithFormat:
-        @"UPDATE %@ SET contents = ?, hash = ?, version = ? WHERE revid = ?",
-        [self tableName]],
-        contentsBlob, Sha1Data(contentsBlob), @(newVersion), @(revid)];
+    BOOL ok = [db_ executeUpdate: [self SQL:
+        @"UPDATE {commits} SET contents = ?, hash = ?, version = ? WHERE revid = ?"],
+        contentsBlob, Sha1Data(contentsBlob, _store.metrics), @(newVersion), @(revid)];
+    ok = ok && [self setBlobHashes: blobHashes forRevid: revid];
     
     if (!ok)
     {
@@ -711,7 +1134,7 @@ static NSData *Sha1Data(NSData *data)
 - (int64_t)schemaVersionForRevid: (int64_t)revid
 {
     NSNumber *version = [db_ numberForQuery:
-        [NSString stringWithFormat: @"SELECT version FROM %@ WHERE revid = ?", [self tableName]],
+        [self SQL: @"SELECT version FROM {commits} WHERE revid = ?"],
         @(revid)];
     if (version == nil)
     {
@@ -730,7 +1153,7 @@ static NSData *Sha1Data(NSData *data)
 
     [revids enumerateIndexesWithOptions: NSEnumerationReverse usingBlock: ^(NSUInteger revid, BOOL * _Nonnull stop) {
         FMResultSet *rs = [db_ executeQuery:
-            [NSString stringWithFormat: @"SELECT parent, deltabase FROM %@ WHERE revid = ?", [self tableName]],
+            [self SQL: @"SELECT parent, deltabase FROM {commits} WHERE revid = ?"],
             @(revid)];
         int64_t parent = -1;
         int64_t deltabase = 1;
@@ -794,11 +1217,11 @@ static NSData *Sha1Data(NSData *data)
 
     NSMutableIndexSet *result = [NSMutableIndexSet indexSet];
 
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat:
+    FMResultSet *rs = [db_ executeQuery: [self SQL:
         @"SELECT revid, parent "
-            "FROM %@ "
+            "FROM {commits} "
             "WHERE revid <= ? AND revid >= ? "
-            "ORDER BY revid DESC", [self tableName]],
+            "ORDER BY revid DESC"],
                                          @(revid),
                                          @(baseRevid)];
 
@@ -838,8 +1261,7 @@ static NSData *Sha1Data(NSData *data)
 
     for (NSUInteger i = revids.firstIndex; i != NSNotFound; i = [revids indexGreaterThanIndex: i])
     {
-        [db_ executeUpdate: [NSString stringWithFormat: @"UPDATE %@ SET garbage = 1 WHERE revid = ?",
-                                                        [self tableName]],
+        [db_ executeUpdate: [self SQL: @"UPDATE {commits} SET garbage = 1 WHERE revid = ?"],
                             @(i)];
     }
 
@@ -878,14 +1300,12 @@ static NSData *Sha1Data(NSData *data)
 
     // Gather the set of revids that need to be rebuilt
     NSMutableIndexSet *rebuildRevids = [NSMutableIndexSet indexSet];
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat:
+    FMResultSet *rs = [db_ executeQuery: [self SQL:
         @"SELECT revid "
-            "FROM %@ "
-            "LEFT OUTER JOIN (SELECT garbage AS parentgarbage, revid AS parentrevid FROM %@) "
+            "FROM {commits} "
+            "LEFT OUTER JOIN (SELECT garbage AS parentgarbage, revid AS parentrevid FROM {commits}) "
             "ON (parent = parentrevid) "
-            "WHERE garbage = 0 AND parentgarbage = 1 AND deltabase != revid",
-        [self tableName],
-        [self tableName]]];
+            "WHERE garbage = 0 AND parentgarbage = 1 AND deltabase != revid"]];
     while ([rs next])
     {
         [rebuildRevids addIndex: [rs longLongIntForColumnIndex: 0]];
@@ -900,17 +1320,18 @@ static NSData *Sha1Data(NSData *data)
         // GC unreachable items in graph
         [graph removeUnreachableItems];
 
-        NSData *contentsBlob = contentsBLOBWithItemTree(graph);
+        NSMutableSet *blobHashes = [NSMutableSet new];
+        NSData *contentsBlob = [self contentsBlobWithItemGraph: graph blobHashes: blobHashes];
         NSNumber *deltabase = @(revid);
         NSNumber *bytesInDeltaRun = @(contentsBlob.length);
 
-        BOOL ok = [db_ executeUpdate: [NSString stringWithFormat: @"UPDATE %@ SET contents = ?, hash = ?, deltabase = ?, bytesInDeltaRun = ? WHERE revid = ?",
-                                                                  [self tableName]],
+        BOOL ok = [db_ executeUpdate: [self SQL: @"UPDATE {commits} SET contents = ?, hash = ?, deltabase = ?, bytesInDeltaRun = ? WHERE revid = ?"],
                                       contentsBlob,
-                                      Sha1Data(contentsBlob),
+                                      Sha1Data(contentsBlob, _store.metrics),
                                       deltabase,
                                       bytesInDeltaRun,
                                       @(revid)];
+        ok = ok && [self setBlobHashes: blobHashes forRevid: revid];
 
         if (!ok)
         {
@@ -919,9 +1340,10 @@ static NSData *Sha1Data(NSData *data)
         }
     }];
 
-    // Delete _all_ revisions marked as garbage.
-    [db_ executeUpdate: [NSString stringWithFormat: @"DELETE FROM %@ WHERE garbage = 1",
-                                                    [self tableName]]];
+    // Delete _all_ revisions marked as garbage, and the blobs only used by them.
+    [db_ executeUpdate: [self SQL: @"DELETE FROM {blob_refs} WHERE revid IN (SELECT revid FROM {commits} WHERE garbage = 1)"]];
+    [db_ executeUpdate: [self SQL: @"DELETE FROM {commits} WHERE garbage = 1"]];
+    [db_ executeUpdate: [self SQL: @"DELETE FROM {blobs} WHERE hash NOT IN (SELECT hash FROM {blob_refs})"]];
 
     [self commit];
 
@@ -932,10 +1354,8 @@ static NSData *Sha1Data(NSData *data)
 {
     // NOTE: For performance, we use two distinct queries, see
     // http://stackoverflow.com/questions/11515165/sqlite3-select-min-max-together-is-much-slower-than-select-them-separately
-    NSNumber *min = [db_ numberForQuery: [NSString stringWithFormat: @"SELECT MIN(rowid) FROM %@",
-                                                                     [self tableName]]];
-    NSNumber *max = [db_ numberForQuery: [NSString stringWithFormat: @"SELECT MAX(rowid) FROM %@",
-                                                                     [self tableName]]];
+    NSNumber *min = [db_ numberForQuery: [self SQL: @"SELECT MIN(rowid) FROM {commits}"]];
+    NSNumber *max = [db_ numberForQuery: [self SQL: @"SELECT MAX(rowid) FROM {commits}"]];
 
     if (min == nil && max == nil)
     {
@@ -1006,20 +1426,19 @@ static NSData *Sha1Data(NSData *data)
 
     if (options & COBranchRevisionReadingDivergentRevisions)
     {
-        rs = [db_ executeQuery: [NSString stringWithFormat:
+        rs = [db_ executeQuery: [self SQL:
             @"SELECT revid, parent, branchuuid, persistentrootuuid, metadata, timestamp, mergeparent, uuid, version "
-                "FROM %@ WHERE revid BETWEEN 0 AND (SELECT MAX(revid) FROM %@ WHERE branchuuid = ?) "
-                "ORDER BY revid DESC", [self tableName], [self tableName]],
+                "FROM {commits} WHERE revid BETWEEN 0 AND (SELECT MAX(revid) FROM {commits} WHERE branchuuid = ?) "
+                "ORDER BY revid DESC"],
                                 [aBranchUUID dataValue]];
     }
     else
     {
         int64_t headRevid = [self revidForUUID: aHeadRevUUID];
 
-        rs = [db_ executeQuery: [NSString stringWithFormat:
+        rs = [db_ executeQuery: [self SQL:
             @"SELECT revid, parent, branchuuid, persistentrootuuid, metadata, timestamp, mergeparent, uuid, version "
-                "FROM %@ WHERE revid BETWEEN 0 AND ? ORDER BY revid DESC",
-            [self tableName]], @(headRevid)];
+                "FROM {commits} WHERE revid BETWEEN 0 AND ? ORDER BY revid DESC"], @(headRevid)];
     }
 
     NSUInteger suggestedMaxRevCount = 50000;
@@ -1065,10 +1484,9 @@ static NSData *Sha1Data(NSData *data)
 
 - (NSArray *)revisionInfos
 {
-    FMResultSet *rs = [db_ executeQuery: [NSString stringWithFormat:
+    FMResultSet *rs = [db_ executeQuery: [self SQL:
         @"SELECT revid, parent, branchuuid, persistentrootuuid, metadata, timestamp, mergeparent, uuid, version "
-        "FROM %@ ORDER BY revid DESC",
-        [self tableName]]];
+        "FROM {commits} ORDER BY revid DESC"]];
 
     NSUInteger suggestedMaxRevCount = 50000;
     NSMutableArray *revInfos = [NSMutableArray arrayWithCapacity: suggestedMaxRevCount];
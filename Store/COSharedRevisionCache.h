@@ -0,0 +1,160 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#include <dispatch/dispatch.h>
+
+@class ETUUID;
+@class COItemGraph, CORevisionInfo;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The default byte budget of +[COSharedRevisionCache sharedCache].
+ */
+extern const NSUInteger COSharedRevisionCacheDefaultMaxCost;
+
+/**
+ * @group Store
+ * @abstract A process-wide in-memory cache for immutable revision contents.
+ *
+ * COSQLiteStore keeps item graphs and revision infos read from the store
+ * in this cache, keyed by store UUID and revision UUID. Since revisions are
+ * immutable, several store objects opened on the same store (e.g. one per
+ * editing context) share the same cached revisions.
+ *
+ * The cache is bounded by -maxCost in bytes. The least recently used
+ * revisions are evicted first. For item graphs, the cost is the size of their
+ * serialized items.
+ *
+ * A revision can only change or disappear when history compaction or schema
+ * migration run. All the revisions cached for a store are discarded when a
+ * COStorePersistentRootsDidChangeNotification reports compacted or finalized
+ * persistent roots (from the current process or another one). Revisions can
+ * be shared by multiple persistent roots (cheap copies), so we don't attempt
+ * to discard only the revisions belonging to the compacted persistent roots.
+ *
+ * All methods are thread-safe.
+ */
+@interface COSharedRevisionCache : NSObject
+{
+@private
+    dispatch_queue_t _queue;
+    NSMutableDictionary *_entriesByStoreUUID;
+    // Entries are retained by _entriesByStoreUUID, the LRU list is unretained
+    id __unsafe_unretained _leastRecentlyUsedEntry;
+    id __unsafe_unretained _mostRecentlyUsedEntry;
+    NSUInteger _maxCost;
+    NSUInteger _totalCost;
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+    NSUInteger _evictionCount;
+}
+
+
+/** @taskunit Initialization */
+
+
+/**
+ * Returns the cache used by all COSQLiteStore instances by default.
+ */
++ (COSharedRevisionCache *)sharedCache;
+/**
+ * <init />
+ * Initializes a cache evicting revisions beyond the given byte budget.
+ */
+- (instancetype)initWithMaxCost: (NSUInteger)maxCost NS_DESIGNATED_INITIALIZER;
+
+
+/** @taskunit Cache Policy */
+
+
+/**
+ * The byte budget beyond which the least recently used revisions are evicted.
+ *
+ * Setting a lower value evicts revisions immediately.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger maxCost;
+/**
+ * The estimated bytes used by the cached revisions.
+ */
+@property (nonatomic, readonly) NSUInteger totalCost;
+
+
+/** @taskunit Statistics */
+
+
+/**
+ * The number of lookups that found a cached item graph or revision info.
+ */
+@property (nonatomic, readonly) NSUInteger hitCount;
+/**
+ * The number of lookups that found nothing in the cache.
+ */
+@property (nonatomic, readonly) NSUInteger missCount;
+/**
+ * The number of revisions evicted to stay within -maxCost.
+ */
+@property (nonatomic, readonly) NSUInteger evictionCount;
+/**
+ * Resets -hitCount, -missCount and -evictionCount to zero.
+ */
+- (void)resetStatistics;
+
+
+/** @taskunit Accessing Cached Revisions */
+
+
+/**
+ * Returns a new item graph containing the cached items for the revision, or
+ * nil if the revision item graph isn't cached.
+ *
+ * The returned item graph can be mutated by the caller, but its items are
+ * immutable COItem instances shared with the cache. To change an item, the
+ * caller must replace it with a mutable copy (e.g. with
+ * -[COItemGraph insertOrUpdateItems:]).
+ */
+- (nullable COItemGraph *)itemGraphForRevisionUUID: (ETUUID *)aRevision
+                                         storeUUID: (ETUUID *)aStore;
+/**
+ * Caches a complete item graph for the revision.
+ *
+ * The cost is the estimated size in bytes of the item graph. The cache keeps
+ * its own copy, with immutable copies of the COMutableItem instances, so the
+ * caller can mutate the given item graph and its items afterwards.
+ */
+- (void)setItemGraph: (COItemGraph *)anItemGraph
+                cost: (NSUInteger)aCost
+     forRevisionUUID: (ETUUID *)aRevision
+           storeUUID: (ETUUID *)aStore;
+/**
+ * Returns the cached revision info, or nil if the revision info isn't cached.
+ */
+- (nullable CORevisionInfo *)revisionInfoForRevisionUUID: (ETUUID *)aRevision
+                                               storeUUID: (ETUUID *)aStore;
+/**
+ * Caches the revision info.
+ */
+- (void)setRevisionInfo: (CORevisionInfo *)aRevisionInfo
+              storeUUID: (ETUUID *)aStore;
+
+
+/** @taskunit Invalidation */
+
+
+/**
+ * Discards all the revisions cached for the given store.
+ */
+- (void)removeAllRevisionsForStoreUUID: (ETUUID *)aStore;
+/**
+ * Discards all the cached revisions.
+ */
+- (void)removeAllRevisions;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,470 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COSharedRevisionCache.h"
+#import <EtoileFoundation/Macros.h>
+#import <EtoileFoundation/ETUUID.h>
+#import "COItemGraph.h"
+#import "CORevisionInfo.h"
+#import "COSQLiteStore.h"
+#import "CODistributedNotificationCenter.h"
+
+const NSUInteger COSharedRevisionCacheDefaultMaxCost = 64 * 1024 * 1024;
+
+/**
+ * Revision infos are small, their cost is a rough estimate that includes
+ * the metadata dictionary.
+ */
+static const NSUInteger CORevisionInfoCost = 512;
+
+@interface COSharedRevisionCacheEntry : NSObject
+{
+@public
+    ETUUID *storeUUID;
+    ETUUID *revisionUUID;
+    COItemGraph *itemGraph;
+    NSUInteger itemGraphCost;
+    CORevisionInfo *revisionInfo;
+    /* Toward the least recently used entry */
+    COSharedRevisionCacheEntry *__unsafe_unretained previous;
+    /* Toward the most recently used entry */
+    COSharedRevisionCacheEntry *__unsafe_unretained next;
+}
+
+@property (nonatomic, readonly) NSUInteger cost;
+
+@end
+
+
+@implementation COSharedRevisionCacheEntry
+
+- (NSUInteger)cost
+{
+    return itemGraphCost + (revisionInfo != nil ? CORevisionInfoCost : 0);
+}
+
+@end
+
+
+@implementation COSharedRevisionCache
+
++ (COSharedRevisionCache *)sharedCache
+{
+    static COSharedRevisionCache *sharedCache = nil;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^()
+    {
+        sharedCache = [[self alloc] initWithMaxCost: COSharedRevisionCacheDefaultMaxCost];
+    });
+    return sharedCache;
+}
+
+- (instancetype)initWithMaxCost: (NSUInteger)maxCost
+{
+    SUPERINIT;
+    _queue = dispatch_queue_create([[NSString stringWithFormat: @"COSharedRevisionCache-%p",
+                                                                self] UTF8String], NULL);
+    _entriesByStoreUUID = [NSMutableDictionary new];
+    _maxCost = maxCost;
+
+    // The local notification is posted synchronously, so a compaction in the
+    // current process never leaves stale revisions behind
+    [[NSNotificationCenter defaultCenter] addObserver: self
+                                             selector: @selector(storePersistentRootsDidChange:)
+                                                 name: COStorePersistentRootsDidChangeNotification
+                                               object: nil];
+    [[CODistributedNotificationCenter defaultCenter] addObserver: self
+                                                        selector: @selector(storePersistentRootsDidChange:)
+                                                            name: COStorePersistentRootsDidChangeNotification
+                                                          object: nil];
+    return self;
+}
+
+- (instancetype)init
+{
+    return [self initWithMaxCost: COSharedRevisionCacheDefaultMaxCost];
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver: self];
+    [[CODistributedNotificationCenter defaultCenter] removeObserver: self];
+
+#ifdef GNUSTEP
+    // For GNUstep, ARC doesn't manage libdispatch objects since libobjc2 doesn't support it
+    // currently (we compile CoreObject with -DOS_OBJECT_USE_OBJC=0).
+    dispatch_release(_queue);
+#endif
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat: @"<%@ %p - cost: %lu/%lu, hits: %lu, misses: %lu, evictions: %lu>",
+                                       NSStringFromClass([self class]), self,
+                                       (unsigned long)self.totalCost, (unsigned long)self.maxCost,
+                                       (unsigned long)self.hitCount, (unsigned long)self.missCount,
+                                       (unsigned long)self.evictionCount];
+}
+
+#pragma mark Cache Policy -
+
+- (NSUInteger)maxCost
+{
+    __block NSUInteger result = 0;
+
+    dispatch_sync(_queue, ^()
+    {
+        result = _maxCost;
+    });
+    return result;
+}
+
+- (void)setMaxCost: (NSUInteger)maxCost
+{
+    dispatch_sync(_queue, ^()
+    {
+        _maxCost = maxCost;
+        [self evictEntriesIfNeeded];
+    });
+}
+
+- (NSUInteger)totalCost
+{
+    __block NSUInteger result = 0;
+
+    dispatch_sync(_queue, ^()
+    {
+        result = _totalCost;
+    });
+    return result;
+}
+
+#pragma mark Statistics -
+
+- (NSUInteger)hitCount
+{
+    __block NSUInteger result = 0;
+
+    dispatch_sync(_queue, ^()
+    {
+        result = _hitCount;
+    });
+    return result;
+}
+
+- (NSUInteger)missCount
+{
+    __block NSUInteger result = 0;
+
+    dispatch_sync(_queue, ^()
+    {
+        result = _missCount;
+    });
+    return result;
+}
+
+- (NSUInteger)evictionCount
+{
+    __block NSUInteger result = 0;
+
+    dispatch_sync(_queue, ^()
+    {
+        result = _evictionCount;
+    });
+    return result;
+}
+
+- (void)resetStatistics
+{
+    dispatch_sync(_queue, ^()
+    {
+        _hitCount = 0;
+        _missCount = 0;
+        _evictionCount = 0;
+    });
+}
+
+#pragma mark LRU List -
+
+- (void)unlinkEntry: (COSharedRevisionCacheEntry *)entry
+{
+    if (entry->previous != nil)
+    {
+        entry->previous->next = entry->next;
+    }
+    else
+    {
+        _leastRecentlyUsedEntry = entry->next;
+    }
+
+    if (entry->next != nil)
+    {
+        entry->next->previous = entry->previous;
+    }
+    else
+    {
+        _mostRecentlyUsedEntry = entry->previous;
+    }
+
+    entry->previous = nil;
+    entry->next = nil;
+}
+
+- (void)linkEntryAsMostRecentlyUsed: (COSharedRevisionCacheEntry *)entry
+{
+    COSharedRevisionCacheEntry *mostRecentlyUsedEntry = _mostRecentlyUsedEntry;
+
+    entry->previous = mostRecentlyUsedEntry;
+    entry->next = nil;
+
+    if (mostRecentlyUsedEntry != nil)
+    {
+        mostRecentlyUsedEntry->next = entry;
+    }
+    else
+    {
+        _leastRecentlyUsedEntry = entry;
+    }
+    _mostRecentlyUsedEntry = entry;
+}
+
+- (void)touchEntry: (COSharedRevisionCacheEntry *)entry
+{
+    if (entry == _mostRecentlyUsedEntry)
+        return;
+
+    [self unlinkEntry: entry];
+    [self linkEntryAsMostRecentlyUsed: entry];
+}
+
+#pragma mark Entries -
+
+- (COSharedRevisionCacheEntry *)entryForRevisionUUID: (ETUUID *)aRevision
+                                           storeUUID: (ETUUID *)aStore
+{
+    return _entriesByStoreUUID[aStore][aRevision];
+}
+
+- (COSharedRevisionCacheEntry *)insertedEntryForRevisionUUID: (ETUUID *)aRevision
+                                                   storeUUID: (ETUUID *)aStore
+{
+    COSharedRevisionCacheEntry *entry = [self entryForRevisionUUID: aRevision storeUUID: aStore];
+
+    if (entry != nil)
+    {
+        [self touchEntry: entry];
+        return entry;
+    }
+
+    NSMutableDictionary *entries = _entriesByStoreUUID[aStore];
+
+    if (entries == nil)
+    {
+        entries = [NSMutableDictionary new];
+        _entriesByStoreUUID[aStore] = entries;
+    }
+
+    entry = [COSharedRevisionCacheEntry new];
+    entry->storeUUID = aStore;
+    entry->revisionUUID = aRevision;
+
+    entries[aRevision] = entry;
+    [self linkEntryAsMostRecentlyUsed: entry];
+
+    return entry;
+}
+
+- (void)removeEntry: (COSharedRevisionCacheEntry *)entry
+{
+    ETUUID *storeUUID = entry->storeUUID;
+    NSMutableDictionary *entries = _entriesByStoreUUID[storeUUID];
+
+    _totalCost -= entry.cost;
+    [self unlinkEntry: entry];
+
+    // Releases the entry, which must not be used past this point
+    [entries removeObjectForKey: entry->revisionUUID];
+    if (entries.count == 0)
+    {
+        [_entriesByStoreUUID removeObjectForKey: storeUUID];
+    }
+}
+
+- (void)evictEntriesIfNeeded
+{
+    while (_totalCost > _maxCost && _leastRecentlyUsedEntry != nil)
+    {
+        [self removeEntry: _leastRecentlyUsedEntry];
+        _evictionCount++;
+    }
+}
+
+#pragma mark Accessing Cached Revisions -
+
+- (COItemGraph *)itemGraphForRevisionUUID: (ETUUID *)aRevision
+                                storeUUID: (ETUUID *)aStore
+{
+    NILARG_EXCEPTION_TEST(aRevision);
+    NILARG_EXCEPTION_TEST(aStore);
+    __block COItemGraph *cachedGraph = nil;
+
+    dispatch_sync(_queue, ^()
+    {
+        COSharedRevisionCacheEntry *entry = [self entryForRevisionUUID: aRevision
+                                                             storeUUID: aStore];
+
+        cachedGraph = (entry != nil ? entry->itemGraph : nil);
+
+        if (cachedGraph == nil)
+        {
+            _missCount++;
+            return;
+        }
+
+        _hitCount++;
+        [self touchEntry: entry];
+    });
+
+    if (cachedGraph == nil)
+        return nil;
+
+    // The cached graph and its items are never mutated, copying it outside the
+    // queue is safe
+    return [[COItemGraph alloc] initWithItemGraph: cachedGraph];
+}
+
+- (void)setItemGraph: (COItemGraph *)anItemGraph
+                cost: (NSUInteger)aCost
+     forRevisionUUID: (ETUUID *)aRevision
+           storeUUID: (ETUUID *)aStore
+{
+    NILARG_EXCEPTION_TEST(anItemGraph);
+    NILARG_EXCEPTION_TEST(aRevision);
+    NILARG_EXCEPTION_TEST(aStore);
+    NSMutableArray *items = [NSMutableArray arrayWithCapacity: anItemGraph.itemUUIDs.count];
+
+    // Mutable items would be shared with the caller and the graphs we return,
+    // so we keep immutable copies (-copy returns the receiver for COItem)
+    for (ETUUID *itemUUID in anItemGraph.itemUUIDs)
+    {
+        [items addObject: [[anItemGraph itemForUUID: itemUUID] copy]];
+    }
+
+    COItemGraph *cachedGraph = [[COItemGraph alloc] initWithItems: items
+                                                     rootItemUUID: anItemGraph.rootItemUUID];
+
+    dispatch_sync(_queue, ^()
+    {
+        if (aCost > _maxCost)
+            return;
+
+        COSharedRevisionCacheEntry *entry = [self insertedEntryForRevisionUUID: aRevision
+                                                                     storeUUID: aStore];
+
+        _totalCost -= entry->itemGraphCost;
+        entry->itemGraph = cachedGraph;
+        entry->itemGraphCost = aCost;
+        _totalCost += aCost;
+
+        [self evictEntriesIfNeeded];
+    });
+}
+
+- (CORevisionInfo *)revisionInfoForRevisionUUID: (ETUUID *)aRevision
+                                      storeUUID: (ETUUID *)aStore
+{
+    NILARG_EXCEPTION_TEST(aRevision);
+    NILARG_EXCEPTION_TEST(aStore);
+    __block CORevisionInfo *result = nil;
+
+    dispatch_sync(_queue, ^()
+    {
+        COSharedRevisionCacheEntry *entry = [self entryForRevisionUUID: aRevision
+                                                             storeUUID: aStore];
+
+        result = (entry != nil ? entry->revisionInfo : nil);
+
+        if (result == nil)
+        {
+            _missCount++;
+            return;
+        }
+
+        _hitCount++;
+        [self touchEntry: entry];
+    });
+    return result;
+}
+
+- (void)setRevisionInfo: (CORevisionInfo *)aRevisionInfo
+              storeUUID: (ETUUID *)aStore
+{
+    NILARG_EXCEPTION_TEST(aRevisionInfo);
+    NILARG_EXCEPTION_TEST(aStore);
+
+    dispatch_sync(_queue, ^()
+    {
+        COSharedRevisionCacheEntry *entry = [self insertedEntryForRevisionUUID: aRevisionInfo.revisionUUID
+                                                                     storeUUID: aStore];
+
+        if (entry->revisionInfo == nil)
+        {
+            _totalCost += CORevisionInfoCost;
+        }
+        entry->revisionInfo = aRevisionInfo;
+
+        [self evictEntriesIfNeeded];
+    });
+}
+
+#pragma mark Invalidation -
+
+- (void)removeAllRevisionsForStoreUUID: (ETUUID *)aStore
+{
+    NILARG_EXCEPTION_TEST(aStore);
+
+    dispatch_sync(_queue, ^()
+    {
+        for (COSharedRevisionCacheEntry *entry in [_entriesByStoreUUID[aStore] allValues])
+        {
+            [self removeEntry: entry];
+        }
+        ETAssert(_entriesByStoreUUID[aStore] == nil);
+    });
+}
+
+- (void)removeAllRevisions
+{
+    dispatch_sync(_queue, ^()
+    {
+        _leastRecentlyUsedEntry = nil;
+        _mostRecentlyUsedEntry = nil;
+        _totalCost = 0;
+        [_entriesByStoreUUID removeAllObjects];
+    });
+}
+
+/**
+ * Revisions are deleted by history compaction, this is the only case where
+ * a cached revision can become invalid (besides schema migration, which
+ * COSQLiteStore handles explicitly).
+ */
+- (void)storePersistentRootsDidChange: (NSNotification *)notif
+{
+    NSDictionary *userInfo = notif.userInfo;
+    NSString *storeUUIDString = userInfo[kCOStoreUUID];
+    const BOOL hasCompactedRevisions = [userInfo[kCOStoreCompactedPersistentRoots] count] > 0
+        || [userInfo[kCOStoreFinalizedPersistentRoots] count] > 0;
+
+    if (storeUUIDString == nil || !hasCompactedRevisions)
+        return;
+
+    [self removeAllRevisionsForStoreUUID: [ETUUID UUIDWithString: storeUUIDString]];
+}
+
+@end
@@ -0,0 +1,209 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#include <dispatch/dispatch.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The values recorded in a histogram by COStoreMetrics.
+ *
+ * Durations are in nanoseconds.
+ */
+typedef NS_ENUM(NSUInteger, COStoreMetric)
+{
+    /** Duration of -[COSQLiteStore commitStoreTransaction:], lock wait included */
+    COStoreMetricCommitLatency,
+    /** Time spent waiting for the COSQLiteStore queue on commits and loads */
+    COStoreMetricQueueWaitTime,
+    /** Time spent waiting for the commit lock, shared by a hosted undo track
+        store */
+    COStoreMetricCommitLockWaitTime,
+    /** Rows read from a backing store to reconstruct an item graph */
+    COStoreMetricReconstructionRowCount,
+    /** Revision content bytes read to reconstruct an item graph */
+    COStoreMetricReconstructionByteCount,
+    /** Revisions applied to reconstruct an item graph (1 for a full
+        snapshot) */
+    COStoreMetricDeltaChainLength,
+    /** Duration of a SHA-1 computation on revision contents or blobs */
+    COStoreMetricSHA1Time,
+    /** Duration of the full text search and reference indexing for a
+        revision */
+    COStoreMetricFTSIndexingTime,
+    /** Duration of an undo track store commit */
+    COStoreMetricUndoCommitLatency,
+    /** Duration of a COEditingContext commit, validation and undo recording
+        included */
+    COStoreMetricEditingContextCommitLatency,
+    /** Duration of a COEditingContext persistent root load */
+    COStoreMetricEditingContextLoadLatency,
+    COStoreMetricCount
+};
+
+/**
+ * The events counted by COStoreMetrics.
+ */
+typedef NS_ENUM(NSUInteger, COStoreCounter)
+{
+    /** Revisions infos and item graphs found in the revision cache */
+    COStoreCounterRevisionCacheHits,
+    /** Revisions infos and item graphs read from the database because they
+        were not cached */
+    COStoreCounterRevisionCacheMisses,
+    /** Durations exceeding -[COStoreMetrics slowOperationThreshold] */
+    COStoreCounterSlowOperations,
+    COStoreCounterCount
+};
+
+/**
+ * Returns the name used for the metric in -[COStoreMetrics statistics] and in
+ * trace events (e.g. "commitLatency").
+ */
+NSString *COStoreMetricName(COStoreMetric aMetric);
+/**
+ * Returns the name used for the counter in -[COStoreMetrics statistics] (e.g.
+ * "revisionCacheHits").
+ */
+NSString *COStoreCounterName(COStoreCounter aCounter);
+/**
+ * Returns a monotonic time in nanoseconds, to be passed to
+ * -[COStoreMetrics recordDurationSince:forMetric:].
+ */
+uint64_t COStoreMetricsNow(void);
+
+/**
+ * @group Store
+ * @abstract Performance counters, histograms and traces for a CoreObject store.
+ *
+ * COSQLiteStore, its backing stores, COUndoTrackStore and COEditingContext
+ * record their commit and load timings, reconstruction costs and cache hits
+ * into the metrics of the store they use (see -[COSQLiteStore metrics]).
+ *
+ * Recording a value or a counter is lock-free, so instrumentation is always
+ * turned on. For each metric, a histogram keeps the count, sum, min, max and
+ * powers of two buckets from which -statistics estimates percentiles.
+ *
+ * Durations that exceed -slowOperationThreshold are recorded as trace events,
+ * so slow operations in production can be diagnosed without a profiler. When
+ * -recordsTraceEvents is YES, all durations are recorded as trace events. The
+ * trace can be exported with -writeTraceToURL:error: and opened with the
+ * Chrome trace viewer (chrome://tracing) or Perfetto.
+ *
+ * All methods are thread-safe.
+ */
+@interface COStoreMetrics : NSObject
+{
+@private
+    struct COStoreHistogram *_histograms;
+    uint64_t _counters[COStoreCounterCount];
+    uint64_t _startTime;
+    uint64_t _slowOperationThreshold;
+    BOOL _recordsTraceEvents;
+    NSUInteger _maxTraceEventCount;
+    dispatch_queue_t _traceQueue;
+    NSMutableArray *_traceEvents;
+}
+
+
+/** @taskunit Recording */
+
+
+/**
+ * Adds a value to the metric histogram.
+ */
+- (void)recordValue: (uint64_t)aValue forMetric: (COStoreMetric)aMetric;
+/**
+ * Adds the nanoseconds elapsed since the given COStoreMetricsNow() time to
+ * the metric histogram, and records a trace event if the duration exceeds
+ * -slowOperationThreshold or -recordsTraceEvents is YES.
+ */
+- (void)recordDurationSince: (uint64_t)aStartTime forMetric: (COStoreMetric)aMetric;
+/**
+ * Increments the counter by one.
+ */
+- (void)incrementCounter: (COStoreCounter)aCounter;
+
+
+/** @taskunit Statistics */
+
+
+/**
+ * Returns the current value of the counter.
+ */
+- (uint64_t)valueForCounter: (COStoreCounter)aCounter;
+/**
+ * Returns the number of values recorded for the metric.
+ */
+- (uint64_t)countForMetric: (COStoreMetric)aMetric;
+/**
+ * Returns a dictionary summarizing the values recorded for the metric.
+ *
+ * The returned dictionary includes the keys <em>count</em>, <em>sum</em>,
+ * <em>min</em>, <em>max</em>, <em>mean</em>, <em>p50</em>, <em>p90</em> and
+ * <em>p99</em>. Percentiles are upper bounds rounded to the next power of two
+ * (and capped by the max).
+ */
+- (NSDictionary *)statisticsForMetric: (COStoreMetric)aMetric;
+/**
+ * Returns the statistics of all the metrics with at least one value, and all
+ * the counters, keyed by COStoreMetricName() and COStoreCounterName().
+ *
+ * When the revision cache was used, also includes the
+ * <em>revisionCacheHitRate</em> key.
+ */
+@property (nonatomic, readonly) NSDictionary *statistics;
+/**
+ * Resets all the histograms, counters and trace events.
+ */
+- (void)reset;
+
+
+/** @taskunit Tracing */
+
+
+/**
+ * The duration in nanoseconds beyond which an operation is recorded as a
+ * trace event and counted as COStoreCounterSlowOperations.
+ *
+ * By default, returns one second.
+ */
+@property (nonatomic, readwrite, assign) uint64_t slowOperationThreshold;
+/**
+ * Whether all durations are recorded as trace events, and not just the slow
+ * ones.
+ *
+ * By default, returns NO.
+ */
+@property (nonatomic, readwrite, assign) BOOL recordsTraceEvents;
+/**
+ * The maximum number of trace events kept. Beyond it, the oldest ones are
+ * discarded.
+ *
+ * By default, returns 10000.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger maxTraceEventCount;
+/**
+ * The recorded trace events, in the Chrome trace event format (complete
+ * events with 'X' as phase and timestamps in microseconds).
+ */
+@property (nonatomic, readonly) NSArray<NSDictionary *> *traceEvents;
+/**
+ * Returns the recorded trace events as a Chrome trace JSON document.
+ */
+@property (nonatomic, readonly) NSData *traceData;
+/**
+ * Writes -traceData to the given file URL.
+ *
+ * For a nil URL, raises a NSInvalidArgumentException.
+ */
+- (BOOL)writeTraceToURL: (NSURL *)aURL error: (NSError **)anError;
+
+@end
+
+NS_ASSUME_NONNULL_END
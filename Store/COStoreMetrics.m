@@ -0,0 +1,371 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COStoreMetrics.h"
+#import <EtoileFoundation/Macros.h>
+#import "COJSONSerialization.h"
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Bucket 0 counts zero values, bucket i counts values in [2^(i-1), 2^i).
+ */
+#define COStoreHistogramBucketCount 64
+
+struct COStoreHistogram
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[COStoreHistogramBucketCount];
+};
+
+static const uint64_t COStoreMetricsDefaultSlowOperationThreshold = 1000000000;
+static const NSUInteger COStoreMetricsDefaultMaxTraceEventCount = 10000;
+
+NSString *COStoreMetricName(COStoreMetric aMetric)
+{
+    switch (aMetric)
+    {
+        case COStoreMetricCommitLatency:
+            return @"commitLatency";
+        case COStoreMetricQueueWaitTime:
+            return @"queueWaitTime";
+        case COStoreMetricCommitLockWaitTime:
+            return @"commitLockWaitTime";
+        case COStoreMetricReconstructionRowCount:
+            return @"reconstructionRowCount";
+        case COStoreMetricReconstructionByteCount:
+            return @"reconstructionByteCount";
+        case COStoreMetricDeltaChainLength:
+            return @"deltaChainLength";
+        case COStoreMetricSHA1Time:
+            return @"SHA1Time";
+        case COStoreMetricFTSIndexingTime:
+            return @"FTSIndexingTime";
+        case COStoreMetricUndoCommitLatency:
+            return @"undoCommitLatency";
+        case COStoreMetricEditingContextCommitLatency:
+            return @"editingContextCommitLatency";
+        case COStoreMetricEditingContextLoadLatency:
+            return @"editingContextLoadLatency";
+        default:
+            [NSException raise: NSInvalidArgumentException
+                        format: @"Unknown store metric %lu", (unsigned long)aMetric];
+            return nil;
+    }
+}
+
+NSString *COStoreCounterName(COStoreCounter aCounter)
+{
+    switch (aCounter)
+    {
+        case COStoreCounterRevisionCacheHits:
+            return @"revisionCacheHits";
+        case COStoreCounterRevisionCacheMisses:
+            return @"revisionCacheMisses";
+        case COStoreCounterSlowOperations:
+            return @"slowOperations";
+        default:
+            [NSException raise: NSInvalidArgumentException
+                        format: @"Unknown store counter %lu", (unsigned long)aCounter];
+            return nil;
+    }
+}
+
+uint64_t COStoreMetricsNow(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+static inline NSUInteger bucketIndexForValue(uint64_t aValue)
+{
+    if (aValue == 0)
+        return 0;
+
+    return MIN(64 - __builtin_clzll(aValue), COStoreHistogramBucketCount - 1);
+}
+
+static inline uint64_t upperBoundForBucketIndex(NSUInteger anIndex)
+{
+    return (anIndex == 0 ? 0 : (UINT64_C(1) << anIndex) - 1);
+}
+
+static inline void atomicMin(uint64_t *dest, uint64_t aValue)
+{
+    uint64_t current = *dest;
+
+    while (aValue < current && !__sync_bool_compare_and_swap(dest, current, aValue))
+    {
+        current = *dest;
+    }
+}
+
+static inline void atomicMax(uint64_t *dest, uint64_t aValue)
+{
+    uint64_t current = *dest;
+
+    while (aValue > current && !__sync_bool_compare_and_swap(dest, current, aValue))
+    {
+        current = *dest;
+    }
+}
+
+static void resetHistogram(struct COStoreHistogram *aHistogram)
+{
+    memset(aHistogram, 0, sizeof(struct COStoreHistogram));
+    aHistogram->min = UINT64_MAX;
+}
+
+/**
+ * Returns the upper bound of the bucket containing the given percentile.
+ */
+static uint64_t percentileOfHistogram(const struct COStoreHistogram *aHistogram, double aPercentile)
+{
+    const uint64_t rank = (uint64_t)ceil(aHistogram->count * aPercentile);
+    uint64_t cumulativeCount = 0;
+
+    for (NSUInteger i = 0; i < COStoreHistogramBucketCount; i++)
+    {
+        cumulativeCount += aHistogram->buckets[i];
+
+        if (cumulativeCount >= rank)
+            return MIN(upperBoundForBucketIndex(i), aHistogram->max);
+    }
+    return aHistogram->max;
+}
+
+
+@implementation COStoreMetrics
+
+@synthesize slowOperationThreshold = _slowOperationThreshold;
+@synthesize recordsTraceEvents = _recordsTraceEvents;
+
+- (instancetype)init
+{
+    SUPERINIT;
+    _histograms = calloc(COStoreMetricCount, sizeof(struct COStoreHistogram));
+    for (NSUInteger i = 0; i < COStoreMetricCount; i++)
+    {
+        resetHistogram(&_histograms[i]);
+    }
+    _startTime = COStoreMetricsNow();
+    _slowOperationThreshold = COStoreMetricsDefaultSlowOperationThreshold;
+    _maxTraceEventCount = COStoreMetricsDefaultMaxTraceEventCount;
+    _traceQueue = dispatch_queue_create([[NSString stringWithFormat: @"COStoreMetrics-%p",
+                                                                     self] UTF8String], NULL);
+    _traceEvents = [NSMutableArray new];
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_histograms);
+
+#ifdef GNUSTEP
+    // For GNUstep, ARC doesn't manage libdispatch objects since libobjc2 doesn't support it
+    // currently (we compile CoreObject with -DOS_OBJECT_USE_OBJC=0).
+    dispatch_release(_traceQueue);
+#endif
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat: @"<%@ %p - %@>", NSStringFromClass([self class]), self, self.statistics];
+}
+
+#pragma mark Recording -
+
+- (void)recordValue: (uint64_t)aValue forMetric: (COStoreMetric)aMetric
+{
+    NSParameterAssert(aMetric < COStoreMetricCount);
+    struct COStoreHistogram *histogram = &_histograms[aMetric];
+
+    __sync_fetch_and_add(&histogram->count, 1);
+    __sync_fetch_and_add(&histogram->sum, aValue);
+    __sync_fetch_and_add(&histogram->buckets[bucketIndexForValue(aValue)], 1);
+    atomicMin(&histogram->min, aValue);
+    atomicMax(&histogram->max, aValue);
+}
+
+- (void)recordDurationSince: (uint64_t)aStartTime forMetric: (COStoreMetric)aMetric
+{
+    const uint64_t duration = COStoreMetricsNow() - aStartTime;
+    const BOOL isSlow = (duration >= _slowOperationThreshold);
+
+    [self recordValue: duration forMetric: aMetric];
+
+    if (isSlow)
+    {
+        [self incrementCounter: COStoreCounterSlowOperations];
+    }
+    if (isSlow || _recordsTraceEvents)
+    {
+        [self addTraceEventForMetric: aMetric startTime: aStartTime duration: duration];
+    }
+}
+
+- (void)incrementCounter: (COStoreCounter)aCounter
+{
+    NSParameterAssert(aCounter < COStoreCounterCount);
+    __sync_fetch_and_add(&_counters[aCounter], 1);
+}
+
+#pragma mark Statistics -
+
+- (uint64_t)valueForCounter: (COStoreCounter)aCounter
+{
+    NSParameterAssert(aCounter < COStoreCounterCount);
+    return _counters[aCounter];
+}
+
+- (uint64_t)countForMetric: (COStoreMetric)aMetric
+{
+    NSParameterAssert(aMetric < COStoreMetricCount);
+    return _histograms[aMetric].count;
+}
+
+- (NSDictionary *)statisticsForMetric: (COStoreMetric)aMetric
+{
+    NSParameterAssert(aMetric < COStoreMetricCount);
+    // Values recorded while we read the histogram can be partially included
+    struct COStoreHistogram histogram = _histograms[aMetric];
+
+    if (histogram.count == 0)
+    {
+        return @{ @"count" : @0 };
+    }
+    return @{ @"count" : @(histogram.count),
+              @"sum" : @(histogram.sum),
+              @"min" : @(histogram.min),
+              @"max" : @(histogram.max),
+              @"mean" : @((double)histogram.sum / histogram.count),
+              @"p50" : @(percentileOfHistogram(&histogram, 0.5)),
+              @"p90" : @(percentileOfHistogram(&histogram, 0.9)),
+              @"p99" : @(percentileOfHistogram(&histogram, 0.99)) };
+}
+
+- (NSDictionary *)statistics
+{
+    NSMutableDictionary *statistics = [NSMutableDictionary new];
+
+    for (COStoreMetric metric = 0; metric < COStoreMetricCount; metric++)
+    {
+        if ([self countForMetric: metric] > 0)
+        {
+            statistics[COStoreMetricName(metric)] = [self statisticsForMetric: metric];
+        }
+    }
+    for (COStoreCounter counter = 0; counter < COStoreCounterCount; counter++)
+    {
+        statistics[COStoreCounterName(counter)] = @([self valueForCounter: counter]);
+    }
+
+    const uint64_t hitCount = [self valueForCounter: COStoreCounterRevisionCacheHits];
+    const uint64_t lookupCount = hitCount + [self valueForCounter: COStoreCounterRevisionCacheMisses];
+
+    if (lookupCount > 0)
+    {
+        statistics[@"revisionCacheHitRate"] = @((double)hitCount / lookupCount);
+    }
+    return statistics;
+}
+
+- (void)reset
+{
+    for (NSUInteger i = 0; i < COStoreMetricCount; i++)
+    {
+        resetHistogram(&_histograms[i]);
+    }
+    for (NSUInteger i = 0; i < COStoreCounterCount; i++)
+    {
+        _counters[i] = 0;
+    }
+    dispatch_sync(_traceQueue, ^()
+    {
+        [_traceEvents removeAllObjects];
+    });
+}
+
+#pragma mark Tracing -
+
+- (void)addTraceEventForMetric: (COStoreMetric)aMetric
+                     startTime: (uint64_t)aStartTime
+                      duration: (uint64_t)aDuration
+{
+    NSDictionary *event = @{ @"name" : COStoreMetricName(aMetric),
+                             @"cat" : @"CoreObject",
+                             @"ph" : @"X",
+                             @"ts" : @((int64_t)(aStartTime - _startTime) / 1000.0),
+                             @"dur" : @(aDuration / 1000.0),
+                             @"pid" : @(getpid()),
+                             @"tid" : @((uint64_t)(uintptr_t)pthread_self()) };
+
+    dispatch_async(_traceQueue, ^()
+    {
+        [_traceEvents addObject: event];
+        [self discardOldTraceEvents];
+    });
+}
+
+- (void)discardOldTraceEvents
+{
+    if (_traceEvents.count <= _maxTraceEventCount)
+        return;
+
+    [_traceEvents removeObjectsInRange: NSMakeRange(0, _traceEvents.count - _maxTraceEventCount)];
+}
+
+- (NSUInteger)maxTraceEventCount
+{
+    __block NSUInteger count = 0;
+
+    dispatch_sync(_traceQueue, ^()
+    {
+        count = _maxTraceEventCount;
+    });
+    return count;
+}
+
+- (void)setMaxTraceEventCount: (NSUInteger)aCount
+{
+    dispatch_sync(_traceQueue, ^()
+    {
+        _maxTraceEventCount = aCount;
+        [self discardOldTraceEvents];
+    });
+}
+
+- (NSArray *)traceEvents
+{
+    __block NSArray *events = nil;
+
+    dispatch_sync(_traceQueue, ^()
+    {
+        events = [_traceEvents copy];
+    });
+    return events;
+}
+
+- (NSData *)traceData
+{
+    return CODataWithJSONObject(@{ @"traceEvents" : self.traceEvents,
+                                   @"displayTimeUnit" : @"ms" }, NULL);
+}
+
+- (BOOL)writeTraceToURL: (NSURL *)aURL error: (NSError **)anError
+{
+    NILARG_EXCEPTION_TEST(aURL);
+    return [self.traceData writeToURL: aURL options: NSDataWritingAtomic error: anError];
+}
+
+@end
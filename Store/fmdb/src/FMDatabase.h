@@ -33,6 +33,7 @@
 - (BOOL)close;
 - (BOOL)goodConnection;
 - (void)clearCachedStatements;
+- (void)clearCachedStatementsForQueries: (NSArray *)queries;
 
 // encryption methods.  You need to have purchased the sqlite encryption extensions for these to work.
 - (BOOL)setKey: (NSString *)key;
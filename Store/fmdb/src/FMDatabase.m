@@ -188,6 +188,15 @@ static int debug_total_connections_opened;
     [cachedStatements removeAllObjects];
 }
 
+- (void)clearCachedStatementsForQueries: (NSArray *)queries
+{
+    for (NSString *query in queries)
+    {
+        [[cachedStatements objectForKey: query] close];
+        [cachedStatements removeObjectForKey: query];
+    }
+}
+
 - (FMStatement *)cachedStatementForQuery: (NSString *)query
 {
     return [cachedStatements objectForKey: query];
@@ -301,6 +310,18 @@ static int debug_total_connections_opened;
 }
 
 - (void)bindObject: (id)obj toColumn: (int)idx inStatement: (sqlite3_stmt *)pStmt
+{
+    [self bindObject: obj toColumn: idx inStatement: pStmt copyingData: YES];
+}
+
+/**
+ * When copyingData is NO, SQLite reads the NSData bytes in place, so the
+ * data must outlive the statement execution.
+ */
+- (void)bindObject: (id)obj
+          toColumn: (int)idx
+       inStatement: (sqlite3_stmt *)pStmt
+       copyingData: (BOOL)copyingData
 {
 
     if ((!obj) || ((NSNull *)obj == [NSNull null]))
@@ -311,7 +332,8 @@ static int debug_total_connections_opened;
         // FIXME - someday check the return codes on these binds.
     else if ([obj isKindOfClass: [NSData class]])
     {
-        sqlite3_bind_blob(pStmt, idx, [obj bytes], (int)[obj length], SQLITE_TRANSIENT);
+        sqlite3_bind_blob(pStmt, idx, [obj bytes], (int)[obj length],
+                          (copyingData ? SQLITE_TRANSIENT : SQLITE_STATIC));
     }
     else if ([obj isKindOfClass: [NSDate class]])
     {
@@ -618,7 +640,10 @@ static int debug_total_connections_opened;
 
         idx++;
 
-        [self bindObject: obj toColumn: idx inStatement: pStmt];
+        // The arguments are retained by the caller until we return, and the
+        // statement is reset or finalized before, so the blobs don't need to
+        // be copied (e.g. large revision contents)
+        [self bindObject: obj toColumn: idx inStatement: pStmt copyingData: NO];
     }
 
     if (idx != queryCount)
@@ -693,6 +718,8 @@ static int debug_total_connections_opened;
     {
         cachedStmt.useCount = cachedStmt.useCount + 1;
         rc = sqlite3_reset(pStmt);
+        // Don't keep pointers to the blobs bound without copying them
+        sqlite3_clear_bindings(pStmt);
     }
     else
     {
@@ -46,11 +46,18 @@ static ETUUID *RevisionUUIDFromString(NSString *aRevisionUUID)
     return nil;
 }
 
+/**
+ * The revisions are deltas against their parent, so the parent must be 
+ * inserted first.
+ *
+ * store is nil if the persistent root doesn't exist in the store yet.
+ */
 static void DFSInsertRevisions(NSMutableSet *revisionUUIDsToHandle,
                                ETUUID *revisionUUID,
                                NSDictionary *revisionsPlist,
                                COStoreTransaction *txn,
-                               ETUUID *persistentRoot)
+                               ETUUID *persistentRoot,
+                               COSQLiteStore *store)
 {
     if (![revisionUUIDsToHandle containsObject: revisionUUID])
     {
@@ -60,6 +67,13 @@ static void DFSInsertRevisions(NSMutableSet *revisionUUIDsToHandle,
 
     [revisionUUIDsToHandle removeObject: revisionUUID];
 
+    // The server can send revisions we have already (see RevisionsClientLacks())
+    if (store != nil && [store revisionInfoForRevisionUUID: revisionUUID
+                                        persistentRootUUID: persistentRoot] != nil)
+    {
+        return;
+    }
+
     // Make sure the parents are inserted
 
     NSDictionary *revDict = revisionsPlist[[revisionUUID stringValue]];
@@ -73,7 +87,8 @@ static void DFSInsertRevisions(NSMutableSet *revisionUUIDsToHandle,
                            [ETUUID UUIDWithString: parentString],
                            revisionsPlist,
                            txn,
-                           persistentRoot);
+                           persistentRoot,
+                           store);
     }
     if (mergeParentString != nil)
     {
@@ -81,7 +96,8 @@ static void DFSInsertRevisions(NSMutableSet *revisionUUIDsToHandle,
                            [ETUUID UUIDWithString: mergeParentString],
                            revisionsPlist,
                            txn,
-                           persistentRoot);
+                           persistentRoot,
+                           store);
     }
 
     // Now both parents are inserted, or were already in our store.
@@ -106,7 +122,8 @@ static void DFSInsertRevisions(NSMutableSet *revisionUUIDsToHandle,
 
 static void InsertRevisions(NSDictionary *revisionsPlist,
                             COStoreTransaction *txn,
-                            ETUUID *persistentRoot)
+                            ETUUID *persistentRoot,
+                            COSQLiteStore *store)
 {
     NSMutableSet *revisionUUIDsToHandle = [NSMutableSet set];
     for (NSString *revisionUUIDString in revisionsPlist)
@@ -122,7 +139,7 @@ static void InsertRevisions(NSDictionary *revisionsPlist,
     while (![revisionUUIDsToHandle isEmpty])
     {
         DFSInsertRevisions(revisionUUIDsToHandle, [revisionUUIDsToHandle anyObject],
-                           revisionsPlist, txn, persistentRoot);
+                           revisionsPlist, txn, persistentRoot, store);
     }
 }
 
@@ -137,6 +154,8 @@ static void InsertRevisions(NSDictionary *revisionsPlist,
     // 1. Do we have this persistent root?
 
     COPersistentRootInfo *info = [aStore persistentRootInfoForUUID: persistentRoot];
+    const BOOL isNewPersistentRoot = (info == nil);
+
     if (info == nil)
     {
         // No: create it
@@ -149,7 +168,7 @@ static void InsertRevisions(NSDictionary *revisionsPlist,
 
     // Insert the revisions the server sent us.
 
-    InsertRevisions(aResponse[@"revisions"], txn, persistentRoot);
+    InsertRevisions(aResponse[@"revisions"], txn, persistentRoot, isNewPersistentRoot ? nil : aStore);
 
     ETUUID *currentBranchUUID = [ETUUID UUIDWithString: aResponse[@"currentBranchUUID"]];
     ETUUID *replicatedServerCurrentRevision = nil;
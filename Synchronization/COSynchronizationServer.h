@@ -11,6 +11,10 @@
 
 @interface COSynchronizationServer : NSObject
 
+/**
+ * Returns the response with the revisions the client lacks, or nil if the
+ * store history is corrupted.
+ */
 - (NSDictionary *)handleUpdateRequest: (NSDictionary *)aRequest
                                 store: (COSQLiteStore *)aStore;
 
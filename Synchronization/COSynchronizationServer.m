@@ -9,37 +9,157 @@
 
 @implementation COSynchronizationServer
 
-static void FindAllParents(NSMutableSet *resultSet,
-                           ETUUID *rev,
-                           ETUUID *persistentRootUUID,
-                           COSQLiteStore *store,
-                           NSSet *stopSet)
+/**
+ * Inserts the revision in the queue sorted from the newest to the oldest
+ * revision, unless it was queued previously.
+ *
+ * For equal dates, the revisions the client has come first, so their parents
+ * are marked before being reached from the server heads.
+ */
+static void QueueRevision(NSMutableArray *queue,
+                          NSMutableSet *queuedRevs,
+                          ETUUID *rev,
+                          NSSet *revsClientHas,
+                          NSMutableDictionary *infos,
+                          ETUUID *persistentRootUUID,
+                          COSQLiteStore *store)
 {
-    if ([resultSet containsObject: rev])
+    if ([queuedRevs containsObject: rev])
         return;
 
-    if (stopSet != nil && [stopSet containsObject: rev])
-        return;
+    CORevisionInfo *revInfo = infos[rev];
+
+    if (revInfo == nil)
+    {
+        revInfo = [store revisionInfoForRevisionUUID: rev persistentRootUUID: persistentRootUUID];
+        // A client head unknown to us
+        if (revInfo == nil)
+            return;
+
+        infos[rev] = revInfo;
+    }
+    [queuedRevs addObject: rev];
+
+    NSUInteger index = [queue indexOfObject: rev
+                              inSortedRange: NSMakeRange(0, queue.count)
+                                    options: NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual
+                            usingComparator: ^(ETUUID *revA, ETUUID *revB)
+    {
+        NSComparisonResult result = [[infos[revB] date] compare: [infos[revA] date]];
+
+        if (result != NSOrderedSame)
+            return result;
+
+        const BOOL clientHasA = [revsClientHas containsObject: revA];
+        const BOOL clientHasB = [revsClientHas containsObject: revB];
+
+        if (clientHasA == clientHasB)
+            return NSOrderedSame;
 
-    [resultSet addObject: rev];
+        return (clientHasA ? NSOrderedAscending : NSOrderedDescending);
+    }];
 
-    // Recursively search the parent(s)
+    [queue insertObject: rev atIndex: index];
+}
 
-    CORevisionInfo *revision = [store revisionInfoForRevisionUUID: rev
-                                               persistentRootUUID: persistentRootUUID];
+/**
+ * Returns the revisions reachable from our heads, but not from the client 
+ * heads.
+ *
+ * Rather than collecting the entire ancestry of the client heads, the history
+ * is walked from both our heads and the client heads at the same time, from 
+ * the newest to the oldest revision. A revision reached from a client head is
+ * known to the client, and so are its parents. The walk stops once all the 
+ * remaining revisions to visit are known to the client, so only the history 
+ * more recent than the common ancestors is visited.
+ *
+ * If the revision dates are skewed, a revision the client has can be returned.
+ * -[COSynchronizationClient handleUpdateResponse:store:] ignores it.
+ *
+ * Returns nil if the store is corrupted (a parent revision can't be read).
+ */
+static NSSet *RevisionsClientLacks(NSSet *serverHeads,
+                                   NSSet *clientHeads,
+                                   ETUUID *persistentRootUUID,
+                                   COSQLiteStore *store)
+{
+    NSMutableSet *revsClientLacks = [NSMutableSet set];
+    NSMutableSet *revsClientHas = [NSMutableSet set];
+    NSMutableDictionary *infos = [NSMutableDictionary dictionary];
+    NSMutableArray *queue = [NSMutableArray array];
+    NSMutableSet *queuedRevs = [NSMutableSet set];
+    // The queued revisions not known to be in the client yet
+    NSMutableSet *pendingRevs = [NSMutableSet set];
 
-    if (revision.parentRevisionUUID != nil)
+    for (ETUUID *rev in clientHeads)
     {
-        FindAllParents(resultSet, revision.parentRevisionUUID, persistentRootUUID, store, stopSet);
+        [revsClientHas addObject: rev];
+        QueueRevision(queue, queuedRevs, rev, revsClientHas, infos, persistentRootUUID, store);
     }
-    if (revision.mergeParentRevisionUUID != nil)
+    for (ETUUID *rev in serverHeads)
     {
-        FindAllParents(resultSet,
-                       revision.mergeParentRevisionUUID,
-                       persistentRootUUID,
-                       store,
-                       stopSet);
+        if ([revsClientHas containsObject: rev])
+            continue;
+
+        QueueRevision(queue, queuedRevs, rev, revsClientHas, infos, persistentRootUUID, store);
+        if ([queuedRevs containsObject: rev])
+        {
+            [pendingRevs addObject: rev];
+        }
+    }
+
+    while (pendingRevs.count > 0)
+    {
+        // Every pending revision is queued, unless the walk went wrong
+        if (queue.count == 0)
+        {
+            NSLog(@"Error, revisions %@ of persistent root %@ can't be visited", pendingRevs, persistentRootUUID);
+            return nil;
+        }
+
+        ETUUID *rev = queue.firstObject;
+        CORevisionInfo *revInfo = infos[rev];
+        const BOOL clientHasRev = [revsClientHas containsObject: rev];
+
+        [queue removeObjectAtIndex: 0];
+        [pendingRevs removeObject: rev];
+
+        if (!clientHasRev)
+        {
+            [revsClientLacks addObject: rev];
+        }
+
+        for (ETUUID *parentRev in @[revInfo.parentRevisionUUID ?: [NSNull null],
+                                    revInfo.mergeParentRevisionUUID ?: [NSNull null]])
+        {
+            if ([parentRev isEqual: [NSNull null]])
+                continue;
+
+            if (clientHasRev)
+            {
+                [revsClientHas addObject: parentRev];
+                [pendingRevs removeObject: parentRev];
+            }
+
+            const BOOL wasQueued = [queuedRevs containsObject: parentRev];
+
+            QueueRevision(queue, queuedRevs, parentRev, revsClientHas, infos, persistentRootUUID, store);
+
+            // Unlike a client head, a parent revision must exist in the store
+            if (![queuedRevs containsObject: parentRev])
+            {
+                NSLog(@"Error, missing parent revision %@ of %@ in persistent root %@",
+                      parentRev, rev, persistentRootUUID);
+                return nil;
+            }
+
+            if (!wasQueued && !clientHasRev && ![revsClientHas containsObject: parentRev])
+            {
+                [pendingRevs addObject: parentRev];
+            }
+        }
     }
+    return revsClientLacks;
 }
 
 - (BOOL)shouldSendBranch: (COBranchInfo *)branch
@@ -57,9 +177,10 @@ For each branch the client tells us about:
 Do we have the revision they report as being their latest? if not, assume they
 are ahead of us for that branch, and ignore it
 
-Next, start depth-first searches rooted at the latest revisions on each of our branches.
-stop a branch of the search when we hit one of their revisions. This should collect the
-set of revisions we want to send to the client.
+Next, walk the history back from the latest revisions on each of our branches and
+from their revisions at the same time (see RevisionsClientLacks()). This collects
+the set of revisions we want to send to the client, each one as a delta against
+its parent.
  
 The client has to tell us all of its branches, but we don't need to sync everything down to them.
 For now we do.
@@ -71,28 +192,26 @@ For now we do.
     ETUUID *persistentRoot = [ETUUID UUIDWithString: aRequest[@"persistentRoot"]];
     COPersistentRootInfo *serverInfo = [aStore persistentRootInfoForUUID: persistentRoot];
 
-    // 1. Calculate the set of revision ETUUID the client has
-    NSMutableSet *revisionsClientHas = [NSMutableSet set];
+    // 1. Collect the client heads (the newest revision of each client branch)
+    NSMutableSet *clientHeads = [NSMutableSet set];
     for (NSString *revisionUUIDString in [aRequest[@"clientNewestRevisionIDForBranchUUID"] allValues])
     {
-        ETUUID *revid = [ETUUID UUIDWithString: revisionUUIDString];
-
-        FindAllParents(revisionsClientHas, revid, persistentRoot, aStore, nil);
+        [clientHeads addObject: [ETUUID UUIDWithString: revisionUUIDString]];
     }
 
-    // 2. Calculate the set of CORevisionID that the client lacks
-    NSMutableSet *revisionsClientLacks = [NSMutableSet set];
+    // 2. Calculate the set of revision UUIDs that the client lacks
+    NSMutableSet *serverHeads = [NSMutableSet set];
     for (COBranchInfo *branch in serverInfo.branches)
     {
         if ([self shouldSendBranch: branch])
         {
-            FindAllParents(revisionsClientLacks,
-                           branch.currentRevisionUUID,
-                           persistentRoot,
-                           aStore,
-                           revisionsClientHas);
+            [serverHeads addObject: branch.currentRevisionUUID];
         }
     }
+    NSSet *revisionsClientLacks = RevisionsClientLacks(serverHeads, clientHeads, persistentRoot, aStore);
+
+    if (revisionsClientLacks == nil)
+        return nil;
 
     // Now prepare the property list output
 
@@ -114,13 +233,26 @@ For now we do.
         branches[[branch.UUID stringValue]] = branchPlist;
     }
 
+    // Each revision is sent as a delta against its parent, that the client
+    // either has or receives in the same response.
     NSMutableDictionary *contentsForRevisionID = [NSMutableDictionary dictionary];
     for (ETUUID *revid in revisionsClientLacks)
     {
-        id <COItemGraph> graph = [aStore itemGraphForRevisionUUID: revid
-                                                   persistentRoot: persistentRoot];
         CORevisionInfo *revInfo = [aStore revisionInfoForRevisionUUID: revid
                                                    persistentRootUUID: persistentRoot];
+        id <COItemGraph> graph = nil;
+
+        if (revInfo.parentRevisionUUID != nil)
+        {
+            graph = [aStore partialItemGraphFromRevisionUUID: revInfo.parentRevisionUUID
+                                              toRevisionUUID: revid
+                                              persistentRoot: persistentRoot];
+        }
+        else
+        {
+            graph = [aStore itemGraphForRevisionUUID: revid
+                                      persistentRoot: persistentRoot];
+        }
 
         NSMutableDictionary *revInfoPlist = [NSMutableDictionary dictionary];
         if (revInfo.parentRevisionUUID != nil)
@@ -136,6 +268,7 @@ For now we do.
             revInfoPlist[@"metadata"] = revInfo.metadata;
         }
         revInfoPlist[@"branchUUID"] = [revInfo.branchUUID stringValue];
+        revInfoPlist[@"schemaVersion"] = @(revInfo.schemaVersion);
 
         id graphPlist = COItemGraphToJSONPropertyList(graph);
 
@@ -0,0 +1,49 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <CoreObject/CoreObject.h>
+
+@class COSynchronizerBinaryClient;
+
+@protocol COSynchronizerBinaryClientDelegate <NSObject>
+
+- (void)binaryClient: (COSynchronizerBinaryClient *)client sendDataToServer: (NSData *)data;
+- (void)binaryClient: (COSynchronizerBinaryClient *)client didStartSharingOnBranch: (COBranch *)aBranch;
+
+@end
+
+
+/**
+ * @group Synchronization
+ * @abstract Binary counterpart of COSynchronizerJSONClient.
+ *
+ * Messages are encoded with COSynchronizerBinaryUtils. The data passed to
+ * -receiveDataFromServer: doesn't need to match message boundaries, frames
+ * are reassembled from the received bytes.
+ */
+@interface COSynchronizerBinaryClient : NSObject <COSynchronizerClientDelegate>
+{
+    NSMutableArray *queuedMessages;
+    NSMutableData *receivedData;
+    BOOL paused;
+    BOOL compressesMessages;
+}
+
+@property (nonatomic, readwrite, strong) id <COSynchronizerBinaryClientDelegate> delegate;
+@property (nonatomic, readwrite, weak) COSynchronizerClient *client;
+
+- (void)receiveDataFromServer: (NSData *)data;
+
+@property (nonatomic, readwrite, assign, getter=isPaused) BOOL paused;
+/**
+ * Whether large messages sent to the server are compressed.
+ *
+ * By default, returns NO.
+ */
+@property (nonatomic, readwrite, assign) BOOL compressesMessages;
+
+@end
@@ -0,0 +1,122 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COSynchronizerBinaryClient.h"
+#import "COSynchronizerBinaryUtils.h"
+
+#import "COSynchronizerRevision.h"
+#import "COSynchronizerPushedRevisionsToClientMessage.h"
+#import "COSynchronizerPushedRevisionsFromClientMessage.h"
+#import "COSynchronizerResponseToClientForSentRevisionsMessage.h"
+#import "COSynchronizerPersistentRootInfoToClientMessage.h"
+
+@implementation COSynchronizerBinaryClient
+
+@synthesize delegate, client, paused, compressesMessages;
+
+- (instancetype)init
+{
+    SUPERINIT;
+    queuedMessages = [NSMutableArray new];
+    receivedData = [NSMutableData new];
+    return self;
+}
+
+- (void)sendMessageToServer: (id)aMessage
+{
+    NSData *frame = [COSynchronizerBinaryUtils frameWithMessage: aMessage
+                                                     compressed: compressesMessages];
+    if (paused)
+    {
+        [queuedMessages addObject: @{@"frame": frame, @"type": @"outgoing"}];
+    }
+    else
+    {
+        [delegate binaryClient: self sendDataToServer: frame];
+    }
+}
+
+- (void)sendPushToServer: (COSynchronizerPushedRevisionsFromClientMessage *)message
+{
+    [self sendMessageToServer: message];
+}
+
+- (void)receiveDataFromServer: (NSData *)data
+{
+    [COSynchronizerBinaryUtils readFramesFromData: data
+                                           buffer: receivedData
+                                       usingBlock: ^(NSData *frame)
+    {
+        if (paused)
+        {
+            [queuedMessages addObject: @{@"frame": frame, @"type": @"incoming"}];
+        }
+        else
+        {
+            [self processIncomingFrame: frame];
+        }
+    }];
+}
+
+- (void)processIncomingFrame: (NSData *)frame
+{
+    NSError *error = nil;
+    id message = [COSynchronizerBinaryUtils messageWithFrame: frame error: &error];
+
+    if ([message isKindOfClass: [COSynchronizerResponseToClientForSentRevisionsMessage class]])
+    {
+        [client handleResponseMessage: message];
+    }
+    else if ([message isKindOfClass: [COSynchronizerPushedRevisionsToClientMessage class]])
+    {
+        [client handlePushMessage: message];
+    }
+    else if ([message isKindOfClass: [COSynchronizerPersistentRootInfoToClientMessage class]])
+    {
+        [client handleSetupMessage: message];
+
+        ETAssert(client.branch != nil);
+        [self.delegate binaryClient: self didStartSharingOnBranch: client.branch];
+    }
+    else
+    {
+        NSLog(@"COSynchronizerBinaryClient: unknown or corrupted message: %@", (message != nil ? message : error));
+    }
+}
+
+- (void)processOutgoingFrame: (NSData *)frame
+{
+    [delegate binaryClient: self sendDataToServer: frame];
+}
+
+- (void)processQueuedMessages
+{
+    NSArray *messages = [NSArray arrayWithArray: queuedMessages];
+    [queuedMessages removeAllObjects];
+    for (NSDictionary *msg in messages)
+    {
+        if ([msg[@"type"] isEqualToString: @"incoming"])
+        {
+            [self processIncomingFrame: msg[@"frame"]];
+        }
+        else
+        {
+            [self processOutgoingFrame: msg[@"frame"]];
+        }
+    }
+}
+
+- (void)setPaused: (BOOL)flag
+{
+    paused = flag;
+    if (!paused)
+    {
+        [self processQueuedMessages];
+    }
+}
+
+@end
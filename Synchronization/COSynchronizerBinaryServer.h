@@ -0,0 +1,50 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <CoreObject/CoreObject.h>
+
+@class COSynchronizerBinaryServer;
+
+@protocol COSynchronizerBinaryServerDelegate <NSObject>
+
+- (void)binaryServer: (COSynchronizerBinaryServer *)server
+            sendData: (NSData *)data
+            toClient: (NSString *)client;
+
+@end
+
+
+/**
+ * @group Synchronization
+ * @abstract Binary counterpart of COSynchronizerJSONServer.
+ *
+ * Messages are encoded with COSynchronizerBinaryUtils. The data passed to
+ * -receiveData:fromClient: doesn't need to match message boundaries, frames
+ * are reassembled per client from the received bytes.
+ */
+@interface COSynchronizerBinaryServer : NSObject <COSynchronizerServerDelegate>
+{
+    NSMutableArray *queuedMessages;
+    NSMutableDictionary *receivedDataByClient;
+    BOOL paused;
+    BOOL compressesMessages;
+}
+
+@property (nonatomic, readwrite, strong) id <COSynchronizerBinaryServerDelegate> delegate;
+@property (nonatomic, readwrite, weak) COSynchronizerServer *server;
+
+- (void)receiveData: (NSData *)data fromClient: (NSString *)aClient;
+
+@property (nonatomic, readwrite, assign, getter=isPaused) BOOL paused;
+/**
+ * Whether large messages sent to the clients are compressed.
+ *
+ * By default, returns NO.
+ */
+@property (nonatomic, readwrite, assign) BOOL compressesMessages;
+
+@end
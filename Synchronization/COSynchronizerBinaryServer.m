@@ -0,0 +1,133 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COSynchronizerBinaryServer.h"
+#import "COSynchronizerBinaryUtils.h"
+
+#import "COSynchronizerRevision.h"
+#import "COSynchronizerPushedRevisionsToClientMessage.h"
+#import "COSynchronizerPushedRevisionsFromClientMessage.h"
+#import "COSynchronizerResponseToClientForSentRevisionsMessage.h"
+#import "COSynchronizerPersistentRootInfoToClientMessage.h"
+
+@implementation COSynchronizerBinaryServer
+
+@synthesize delegate, server, paused, compressesMessages;
+
+- (instancetype)init
+{
+    SUPERINIT;
+    queuedMessages = [NSMutableArray new];
+    receivedDataByClient = [NSMutableDictionary new];
+    return self;
+}
+
+- (void)sendFrame: (NSData *)frame toClient: (NSString *)aClient
+{
+    if (paused)
+    {
+        [queuedMessages addObject: @{@"frame": frame, @"type": @"outgoing", @"client": aClient}];
+    }
+    else
+    {
+        [delegate binaryServer: self sendData: frame toClient: aClient];
+    }
+}
+
+- (void)sendResponseMessage: (COSynchronizerResponseToClientForSentRevisionsMessage *)message
+                   toClient: (NSString *)aClient
+{
+    [self sendFrame: [COSynchronizerBinaryUtils frameWithMessage: message compressed: compressesMessages]
+           toClient: aClient];
+}
+
+- (void)sendPushedRevisions: (COSynchronizerPushedRevisionsToClientMessage *)message
+                  toClients: (NSArray *)clients
+{
+    // The same frame is sent to every client
+    NSData *frame = [COSynchronizerBinaryUtils frameWithMessage: message compressed: compressesMessages];
+
+    for (NSString *client in clients)
+    {
+        [self sendFrame: frame toClient: client];
+    }
+}
+
+- (void)sendPersistentRootInfoMessage: (COSynchronizerPersistentRootInfoToClientMessage *)message
+                             toClient: (NSString *)aClient
+{
+    [self sendFrame: [COSynchronizerBinaryUtils frameWithMessage: message compressed: compressesMessages]
+           toClient: aClient];
+}
+
+- (void)receiveData: (NSData *)data fromClient: (NSString *)aClient
+{
+    NSMutableData *receivedData = receivedDataByClient[aClient];
+
+    if (receivedData == nil)
+    {
+        receivedData = [NSMutableData new];
+        receivedDataByClient[aClient] = receivedData;
+    }
+
+    [COSynchronizerBinaryUtils readFramesFromData: data
+                                           buffer: receivedData
+                                       usingBlock: ^(NSData *frame)
+    {
+        if (paused)
+        {
+            [queuedMessages addObject: @{@"frame": frame, @"type": @"incoming", @"client": aClient}];
+        }
+        else
+        {
+            [self processIncomingFrame: frame];
+        }
+    }];
+}
+
+- (void)processIncomingFrame: (NSData *)frame
+{
+    NSError *error = nil;
+    id message = [COSynchronizerBinaryUtils messageWithFrame: frame error: &error];
+
+    if ([message isKindOfClass: [COSynchronizerPushedRevisionsFromClientMessage class]])
+    {
+        [server handlePushedRevisionsFromClient: message];
+    }
+    else
+    {
+        NSLog(@"COSynchronizerBinaryServer: unknown or corrupted message: %@", (message != nil ? message : error));
+    }
+}
+
+- (void)processQueuedMessages
+{
+    NSArray *messages = [NSArray arrayWithArray: queuedMessages];
+    [queuedMessages removeAllObjects];
+    for (NSDictionary *msg in messages)
+    {
+        if ([msg[@"type"] isEqualToString: @"incoming"])
+        {
+            [self processIncomingFrame: msg[@"frame"]];
+        }
+        else
+        {
+            [delegate binaryServer: self sendData: msg[@"frame"] toClient: msg[@"client"]];
+        }
+    }
+}
+
+- (void)setPaused: (BOOL)flag
+{
+    paused = flag;
+    if (!paused)
+    {
+        [self processQueuedMessages];
+    }
+}
+
+@end
@@ -0,0 +1,118 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <CoreObject/CoreObject.h>
+
+/**
+ * The number of bytes in the length prefix that starts every binary frame.
+ */
+extern const NSUInteger COSynchronizerBinaryFrameLengthPrefixSize;
+/**
+ * The binary protocol version written by +frameWithMessage:compressed:.
+ *
+ * In version 1, the paths in the embedded items are written as strings. In
+ * version 2, they are written as binary tokens, which version 1 peers can't
+ * read.
+ */
+extern const NSUInteger COSynchronizerBinaryProtocolVersion;
+/**
+ * The largest uncompressed payload accepted by +messageWithFrame:error:.
+ *
+ * Compressed frames announcing a larger payload are rejected before
+ * allocating the decompression buffer.
+ */
+extern const NSUInteger COSynchronizerBinaryMaxPayloadLength;
+
+/**
+ * @group Synchronization
+ * @abstract Binary encoding of the synchronizer messages.
+ *
+ * This is a compact alternative to COSynchronizerJSONUtils. Each message is
+ * encoded as a single frame:
+ *
+ * <list>
+ * <item>a 32-bit big-endian length of the rest of the frame</item>
+ * <item>a flags byte (whether the payload is compressed, and whether the
+ * items contain binary paths)</item>
+ * <item>for a compressed payload, its 32-bit big-endian uncompressed length</item>
+ * <item>the payload: a message type byte followed by the message fields</item>
+ * </list>
+ *
+ * The payload uses the same tokens as COItem+Binary. UUIDs are written as
+ * 16 raw bytes, and the items of each revision are embedded as they are
+ * serialized by -[COItem dataValue].
+ *
+ * Each peer reads frames of the current and older protocol versions, and
+ * rejects frames with flags it doesn't know. When a peer still runs protocol
+ * version 1, the other peers must send it frames written with
+ * +frameWithMessage:compressed:protocolVersion: and this version, since
+ * version 1 peers can't detect the binary paths and raise an exception.
+ *
+ * Compression uses zlib. A payload is only compressed when it is large enough
+ * and compression makes it smaller.
+ *
+ * Decoding reads the fields directly from the frame bytes. The only buffer
+ * allocated is the one receiving a decompressed payload.
+ */
+@interface COSynchronizerBinaryUtils : NSObject
+
+/**
+ * Returns a frame encoding one of the COSynchronizer*Message classes.
+ *
+ * If compressed is YES, the payload is compressed when it is worth it.
+ */
++ (NSData *)frameWithMessage: (id)aMessage compressed: (BOOL)compressed;
+/**
+ * Returns a frame encoding one of the COSynchronizer*Message classes, that a
+ * peer running the given protocol version can read.
+ *
+ * For an unknown protocol version, raises an NSInvalidArgumentException.
+ *
+ * See also COSynchronizerBinaryProtocolVersion.
+ */
++ (NSData *)frameWithMessage: (id)aMessage
+                  compressed: (BOOL)compressed
+             protocolVersion: (NSUInteger)aVersion;
+/**
+ * Returns the message decoded from the frame at the start of the given data,
+ * or nil if the frame is corrupted, or the flags or message type are unknown.
+ *
+ * See -messageWithFrame:error:.
+ */
++ (id)messageWithFrame: (NSData *)aFrame;
+/**
+ * Returns the message decoded from the frame at the start of the given data.
+ *
+ * Frames come from peers, so nothing in them is trusted. The lengths are
+ * checked, the uncompressed payload length is bounded by
+ * COSynchronizerBinaryMaxPayloadLength, and the embedded items are decoded
+ * with -[COItem initWithData:error:].
+ *
+ * Returns nil and sets the error (with the code kCOCorruptedDataError) if the
+ * frame is corrupted, or the flags or message type are unknown.
+ */
++ (id)messageWithFrame: (NSData *)aFrame error: (NSError **)anError;
+/**
+ * Returns the length of the complete frame at the start of the given buffer
+ * (including the length prefix), or 0 if the buffer doesn't contain a
+ * complete frame yet.
+ *
+ * Can be used to split a byte stream into frames.
+ */
++ (NSUInteger)lengthOfFrameInBytes: (const unsigned char *)bytes length: (NSUInteger)length;
+/**
+ * Passes each complete frame in the bytes received so far to the block.
+ *
+ * The bytes that don't form a complete frame yet are kept in the buffer until
+ * the next call. Each frame is removed from the buffer before calling the
+ * block, so the block can receive more data for the same buffer.
+ */
++ (void)readFramesFromData: (NSData *)data
+                    buffer: (NSMutableData *)aBuffer
+                usingBlock: (void (^)(NSData *frame))aBlock;
+
+@end
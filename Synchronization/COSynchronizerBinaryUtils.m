@@ -0,0 +1,699 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COSynchronizerBinaryUtils.h"
+#import "COSynchronizerRevision.h"
+#import "COSynchronizerPushedRevisionsToClientMessage.h"
+#import "COSynchronizerPushedRevisionsFromClientMessage.h"
+#import "COSynchronizerResponseToClientForSentRevisionsMessage.h"
+#import "COSynchronizerPersistentRootInfoToClientMessage.h"
+#import "COItem+Binary.h"
+#import "COBinaryWriter.h"
+#import "COJSONSerialization.h"
+#import "CODateSerialization.h"
+#import "COError.h"
+#include <zlib.h>
+
+const NSUInteger COSynchronizerBinaryFrameLengthPrefixSize = 4;
+const NSUInteger COSynchronizerBinaryProtocolVersion = 2;
+const NSUInteger COSynchronizerBinaryMaxPayloadLength = 256 * 1024 * 1024;
+
+/**
+ * Payloads smaller than this are not worth compressing.
+ */
+static const NSUInteger COSynchronizerBinaryCompressionThreshold = 512;
+/**
+ * The best ratio zlib can achieve, an uncompressed length announced beyond it
+ * is a lie.
+ */
+static const NSUInteger COSynchronizerBinaryMaxCompressionRatio = 1032;
+
+typedef NS_ENUM(uint8_t, COSynchronizerBinaryFrameFlags)
+{
+    COSynchronizerBinaryFrameCompressed = 1,
+    /** The items can contain binary paths (protocol version 2). */
+    COSynchronizerBinaryFrameBinaryPaths = 2,
+    COSynchronizerBinaryFrameKnownFlags = COSynchronizerBinaryFrameCompressed
+                                        | COSynchronizerBinaryFrameBinaryPaths
+};
+
+typedef NS_ENUM(uint8_t, COSynchronizerBinaryMessageType)
+{
+    COSynchronizerBinaryMessagePushedRevisionsFromClient = 1,
+    COSynchronizerBinaryMessageResponseToClientForSentRevisions = 2,
+    COSynchronizerBinaryMessagePushedRevisionsToClient = 3,
+    COSynchronizerBinaryMessagePersistentRootInfoToClient = 4
+};
+
+static inline uint32_t readUint32(const unsigned char *bytes)
+{
+    uint32_t unswapped;
+    memcpy(&unswapped, bytes, 4);
+    return NSSwapBigIntToHost(unswapped);
+}
+
+static inline void writeUint32(unsigned char *bytes, uint32_t value)
+{
+    uint32_t swapped = NSSwapHostIntToBig(value);
+    memcpy(bytes, &swapped, 4);
+}
+
+// Writing
+
+static void writeDictionary(co_buffer_t *dest, NSDictionary *aDictionary)
+{
+    if (aDictionary == nil)
+    {
+        co_buffer_store_null(dest);
+        return;
+    }
+
+    NSData *data = CODataWithJSONObject(aDictionary, NULL);
+    co_buffer_store_bytes(dest, data.bytes, data.length);
+}
+
+static void writeItemGraph(co_buffer_t *dest, COItemGraph *anItemGraph, NSUInteger aVersion)
+{
+    co_buffer_store_uuid(dest, anItemGraph.rootItemUUID);
+    co_buffer_begin_array(dest);
+    for (ETUUID *uuid in anItemGraph.itemUUIDs)
+    {
+        COItem *item = [anItemGraph itemForUUID: uuid];
+        NSData *data = (aVersion >= 2 ? item.dataValue : item.dataValueWithPathsWrittenAsStrings);
+        co_buffer_store_bytes(dest, data.bytes, data.length);
+    }
+    co_buffer_end_array(dest);
+}
+
+static void writeRevisionContents(co_buffer_t *dest, COSynchronizerRevision *aRevision, NSUInteger aVersion)
+{
+    co_buffer_begin_object(dest);
+    co_buffer_store_uuid(dest, aRevision.revisionUUID);
+    co_buffer_store_uuid(dest, aRevision.parentRevisionUUID);
+    co_buffer_store_integer(dest, aRevision.schemaVersion);
+    co_buffer_store_integer(dest, CODateToJavaTimestamp(aRevision.date).longLongValue);
+    writeDictionary(dest, aRevision.metadata);
+    writeItemGraph(dest, aRevision.modifiedItems, aVersion);
+    co_buffer_end_object(dest);
+}
+
+/**
+ * A revision sent to multiple clients is encoded once per protocol version.
+ */
+static void writeRevision(co_buffer_t *dest, COSynchronizerRevision *aRevision, NSUInteger aVersion)
+{
+    NSString *key = (aVersion >= 2 ? @"COSynchronizerBinary" : @"COSynchronizerBinaryVersion1");
+    NSData *data = [aRevision encodedRepresentationForKey: key usingBlock: ^()
+    {
+        co_buffer_t revisionBuffer;
+        co_buffer_init(&revisionBuffer);
+
+        writeRevisionContents(&revisionBuffer, aRevision, aVersion);
+
+        NSData *revisionData = [NSData dataWithBytes: co_buffer_get_data(&revisionBuffer)
+                                              length: co_buffer_get_length(&revisionBuffer)];
+        co_buffer_free(&revisionBuffer);
+        return revisionData;
+    }];
+
+    co_buffer_write(dest, data.bytes, data.length);
+}
+
+static void writeRevisions(co_buffer_t *dest, NSArray *revisions, NSUInteger aVersion)
+{
+    co_buffer_begin_array(dest);
+    for (COSynchronizerRevision *revision in revisions)
+    {
+        writeRevision(dest, revision, aVersion);
+    }
+    co_buffer_end_array(dest);
+}
+
+static void writeMessage(co_buffer_t *dest, id aMessage, NSUInteger aVersion)
+{
+    if ([aMessage isKindOfClass: [COSynchronizerPushedRevisionsFromClientMessage class]])
+    {
+        COSynchronizerPushedRevisionsFromClientMessage *message = aMessage;
+
+        co_buffer_store_uint8(dest, COSynchronizerBinaryMessagePushedRevisionsFromClient);
+        co_buffer_store_string(dest, message.clientID);
+        co_buffer_store_uuid(dest, message.lastRevisionUUIDSentByServer);
+        writeRevisions(dest, message.revisions, aVersion);
+    }
+    else if ([aMessage isKindOfClass: [COSynchronizerResponseToClientForSentRevisionsMessage class]])
+    {
+        COSynchronizerResponseToClientForSentRevisionsMessage *message = aMessage;
+
+        co_buffer_store_uint8(dest, COSynchronizerBinaryMessageResponseToClientForSentRevisions);
+        co_buffer_store_uuid(dest, message.lastRevisionUUIDSentByClient);
+        writeRevisions(dest, message.revisions, aVersion);
+    }
+    else if ([aMessage isKindOfClass: [COSynchronizerPushedRevisionsToClientMessage class]])
+    {
+        COSynchronizerPushedRevisionsToClientMessage *message = aMessage;
+
+        co_buffer_store_uint8(dest, COSynchronizerBinaryMessagePushedRevisionsToClient);
+        writeRevisions(dest, message.revisions, aVersion);
+    }
+    else if ([aMessage isKindOfClass: [COSynchronizerPersistentRootInfoToClientMessage class]])
+    {
+        COSynchronizerPersistentRootInfoToClientMessage *message = aMessage;
+
+        co_buffer_store_uint8(dest, COSynchronizerBinaryMessagePersistentRootInfoToClient);
+        co_buffer_store_uuid(dest, message.persistentRootUUID);
+        writeDictionary(dest, message.persistentRootMetadata);
+        co_buffer_store_uuid(dest, message.branchUUID);
+        writeDictionary(dest, message.branchMetadata);
+        writeRevision(dest, message.currentRevision, aVersion);
+    }
+    else
+    {
+        [NSException raise: NSInvalidArgumentException
+                    format: @"Unsupported synchronizer message class: %@", [aMessage class]];
+    }
+}
+
+static NSData *uncompressedFrameWithPayload(const unsigned char *payload, size_t length, uint8_t flags)
+{
+    NSMutableData *frame = [NSMutableData dataWithLength: COSynchronizerBinaryFrameLengthPrefixSize + 1 + length];
+    unsigned char *bytes = frame.mutableBytes;
+
+    writeUint32(bytes, (uint32_t)(1 + length));
+    bytes[COSynchronizerBinaryFrameLengthPrefixSize] = flags;
+    memcpy(bytes + COSynchronizerBinaryFrameLengthPrefixSize + 1, payload, length);
+
+    return frame;
+}
+
+/**
+ * Returns nil when compression doesn't make the payload smaller.
+ */
+static NSData *compressedFrameWithPayload(const unsigned char *payload, size_t length, uint8_t flags)
+{
+    const size_t headerLength = COSynchronizerBinaryFrameLengthPrefixSize + 1 + 4;
+    uLongf compressedLength = compressBound(length);
+    NSMutableData *frame = [NSMutableData dataWithLength: headerLength + compressedLength];
+    unsigned char *bytes = frame.mutableBytes;
+
+    if (compress2(bytes + headerLength, &compressedLength, payload, length, Z_DEFAULT_COMPRESSION) != Z_OK
+        || compressedLength >= length)
+    {
+        return nil;
+    }
+
+    writeUint32(bytes, (uint32_t)(1 + 4 + compressedLength));
+    bytes[COSynchronizerBinaryFrameLengthPrefixSize] = flags | COSynchronizerBinaryFrameCompressed;
+    writeUint32(bytes + COSynchronizerBinaryFrameLengthPrefixSize + 1, (uint32_t)length);
+    frame.length = headerLength + compressedLength;
+
+    return frame;
+}
+
+// Reading
+
+typedef struct
+{
+    const unsigned char *bytes;
+    size_t length;
+    size_t pos;
+    BOOL failed;
+} co_message_reader_t;
+
+static inline BOOL canRead(co_message_reader_t *reader, size_t length)
+{
+    if (reader->failed || reader->length - reader->pos < length)
+    {
+        reader->failed = YES;
+        return NO;
+    }
+    return YES;
+}
+
+static inline char peekType(co_message_reader_t *reader)
+{
+    if (!canRead(reader, 1))
+        return '\0';
+
+    return (char)reader->bytes[reader->pos];
+}
+
+static inline char readType(co_message_reader_t *reader)
+{
+    const char type = peekType(reader);
+    if (!reader->failed)
+    {
+        reader->pos++;
+    }
+    return type;
+}
+
+static inline void expectType(co_message_reader_t *reader, char expectedType)
+{
+    if (readType(reader) != expectedType)
+    {
+        reader->failed = YES;
+    }
+}
+
+static uint32_t readLength(co_message_reader_t *reader, BOOL isLong)
+{
+    const size_t size = isLong ? 4 : 1;
+    if (!canRead(reader, size))
+        return 0;
+
+    const uint32_t length = isLong ? readUint32(reader->bytes + reader->pos) : reader->bytes[reader->pos];
+    reader->pos += size;
+    return length;
+}
+
+static int64_t readInteger(co_message_reader_t *reader)
+{
+    const char type = readType(reader);
+    const unsigned char *bytes = reader->bytes + reader->pos;
+    int64_t value = 0;
+
+    switch (type)
+    {
+        case 'B':
+            if (!canRead(reader, 1))
+                return 0;
+            value = (int8_t)bytes[0];
+            reader->pos += 1;
+            break;
+        case 'i':
+        {
+            if (!canRead(reader, 2))
+                return 0;
+            uint16_t unswapped;
+            memcpy(&unswapped, bytes, 2);
+            value = (int16_t)NSSwapBigShortToHost(unswapped);
+            reader->pos += 2;
+            break;
+        }
+        case 'I':
+            if (!canRead(reader, 4))
+                return 0;
+            value = (int32_t)readUint32(bytes);
+            reader->pos += 4;
+            break;
+        case 'L':
+        {
+            if (!canRead(reader, 8))
+                return 0;
+            uint64_t unswapped;
+            memcpy(&unswapped, bytes, 8);
+            value = (int64_t)NSSwapBigLongLongToHost(unswapped);
+            reader->pos += 8;
+            break;
+        }
+        default:
+            reader->failed = YES;
+            break;
+    }
+    return value;
+}
+
+static ETUUID *readUUID(co_message_reader_t *reader)
+{
+    const char type = readType(reader);
+
+    if (type == '0')
+        return nil;
+
+    if (type != '#' || !canRead(reader, 16))
+    {
+        reader->failed = YES;
+        return nil;
+    }
+
+    ETUUID *uuid = [[ETUUID alloc] initWithUUID: reader->bytes + reader->pos];
+    reader->pos += 16;
+    return uuid;
+}
+
+static NSString *readString(co_message_reader_t *reader)
+{
+    const char type = readType(reader);
+
+    if (type == '0')
+        return nil;
+
+    if (type != 's' && type != 'S')
+    {
+        reader->failed = YES;
+        return nil;
+    }
+
+    const uint32_t length = readLength(reader, type == 'S');
+    if (!canRead(reader, length))
+        return nil;
+
+    NSString *string = [[NSString alloc] initWithBytes: reader->bytes + reader->pos
+                                                length: length
+                                              encoding: NSUTF8StringEncoding];
+    reader->pos += length;
+    return string;
+}
+
+/**
+ * Returns data pointing into the message bytes, without copying them.
+ *
+ * The returned data must not outlive the message bytes.
+ */
+static NSData *readBytesNoCopy(co_message_reader_t *reader)
+{
+    const char type = readType(reader);
+
+    if (type == '0')
+        return nil;
+
+    if (type != 'd' && type != 'D')
+    {
+        reader->failed = YES;
+        return nil;
+    }
+
+    const uint32_t length = readLength(reader, type == 'D');
+    if (!canRead(reader, length))
+        return nil;
+
+    NSData *data = [[NSData alloc] initWithBytesNoCopy: (void *)(reader->bytes + reader->pos)
+                                                length: length
+                                          freeWhenDone: NO];
+    reader->pos += length;
+    return data;
+}
+
+static NSDictionary *readDictionary(co_message_reader_t *reader)
+{
+    NSData *data = readBytesNoCopy(reader);
+
+    if (data == nil)
+        return nil;
+
+    NSDictionary *dictionary = COJSONObjectWithData(data, NULL);
+    if (![dictionary isKindOfClass: [NSDictionary class]])
+    {
+        reader->failed = YES;
+        return nil;
+    }
+    return dictionary;
+}
+
+static COItemGraph *readItemGraph(co_message_reader_t *reader)
+{
+    ETUUID *rootItemUUID = readUUID(reader);
+    NSMutableDictionary *itemsByUUID = [NSMutableDictionary new];
+
+    expectType(reader, '[');
+    while (!reader->failed && peekType(reader) != ']')
+    {
+        NSData *frameData = readBytesNoCopy(reader);
+
+        if (frameData == nil)
+        {
+            reader->failed = YES;
+            break;
+        }
+
+        // The item keeps its data, which must outlive the message frame. The
+        // bytes come from a peer, so we don't trust them.
+        NSData *data = [NSData dataWithBytes: frameData.bytes length: frameData.length];
+        COItem *item = [[COItem alloc] initWithData: data error: NULL];
+        if (item == nil)
+        {
+            reader->failed = YES;
+            break;
+        }
+        itemsByUUID[item.UUID] = item;
+    }
+    expectType(reader, ']');
+
+    if (reader->failed)
+        return nil;
+
+    return [[COItemGraph alloc] initWithItemForUUID: itemsByUUID rootItemUUID: rootItemUUID];
+}
+
+static COSynchronizerRevision *readRevision(co_message_reader_t *reader)
+{
+    expectType(reader, '{');
+    ETUUID *revisionUUID = readUUID(reader);
+    ETUUID *parentRevisionUUID = readUUID(reader);
+    const int64_t schemaVersion = readInteger(reader);
+    const int64_t timestamp = readInteger(reader);
+    NSDictionary *metadata = readDictionary(reader);
+    COItemGraph *modifiedItems = readItemGraph(reader);
+    expectType(reader, '}');
+
+    if (reader->failed || revisionUUID == nil)
+    {
+        reader->failed = YES;
+        return nil;
+    }
+
+    return [[COSynchronizerRevision alloc] initWithModifiedItems: modifiedItems
+                                                    revisionUUID: revisionUUID
+                                              parentRevisionUUID: parentRevisionUUID
+                                                   schemaVersion: schemaVersion
+                                                        metadata: metadata
+                                                            date: CODateFromJavaTimestamp(@(timestamp))];
+}
+
+static NSArray *readRevisions(co_message_reader_t *reader)
+{
+    NSMutableArray *revisions = [NSMutableArray new];
+
+    expectType(reader, '[');
+    while (!reader->failed && peekType(reader) != ']')
+    {
+        COSynchronizerRevision *revision = readRevision(reader);
+
+        if (revision != nil)
+        {
+            [revisions addObject: revision];
+        }
+    }
+    expectType(reader, ']');
+
+    return revisions;
+}
+
+static id readMessage(co_message_reader_t *reader)
+{
+    if (!canRead(reader, 1))
+        return nil;
+
+    const uint8_t type = reader->bytes[reader->pos];
+    reader->pos++;
+
+    switch (type)
+    {
+        case COSynchronizerBinaryMessagePushedRevisionsFromClient:
+        {
+            COSynchronizerPushedRevisionsFromClientMessage *message = [COSynchronizerPushedRevisionsFromClientMessage new];
+            message.clientID = readString(reader);
+            message.lastRevisionUUIDSentByServer = readUUID(reader);
+            message.revisions = readRevisions(reader);
+            return message;
+        }
+        case COSynchronizerBinaryMessageResponseToClientForSentRevisions:
+        {
+            COSynchronizerResponseToClientForSentRevisionsMessage *message = [COSynchronizerResponseToClientForSentRevisionsMessage new];
+            message.lastRevisionUUIDSentByClient = readUUID(reader);
+            message.revisions = readRevisions(reader);
+            return message;
+        }
+        case COSynchronizerBinaryMessagePushedRevisionsToClient:
+        {
+            COSynchronizerPushedRevisionsToClientMessage *message = [COSynchronizerPushedRevisionsToClientMessage new];
+            message.revisions = readRevisions(reader);
+            return message;
+        }
+        case COSynchronizerBinaryMessagePersistentRootInfoToClient:
+        {
+            COSynchronizerPersistentRootInfoToClientMessage *message = [COSynchronizerPersistentRootInfoToClientMessage new];
+            message.persistentRootUUID = readUUID(reader);
+            message.persistentRootMetadata = readDictionary(reader);
+            message.branchUUID = readUUID(reader);
+            message.branchMetadata = readDictionary(reader);
+            message.currentRevision = readRevision(reader);
+            return message;
+        }
+        default:
+            reader->failed = YES;
+            return nil;
+    }
+}
+
+@implementation COSynchronizerBinaryUtils
+
++ (NSData *)frameWithMessage: (id)aMessage compressed: (BOOL)compressed
+{
+    return [self frameWithMessage: aMessage
+                       compressed: compressed
+                  protocolVersion: COSynchronizerBinaryProtocolVersion];
+}
+
++ (NSData *)frameWithMessage: (id)aMessage
+                  compressed: (BOOL)compressed
+             protocolVersion: (NSUInteger)aVersion
+{
+    NILARG_EXCEPTION_TEST(aMessage);
+    INVALIDARG_EXCEPTION_TEST(aVersion, aVersion >= 1 && aVersion <= COSynchronizerBinaryProtocolVersion);
+
+    // Version 1 peers don't know the flag, and must not receive it
+    const uint8_t flags = (aVersion >= 2 ? COSynchronizerBinaryFrameBinaryPaths : 0);
+
+    co_buffer_t payload;
+    co_buffer_init(&payload);
+
+    NSData *frame = nil;
+
+    @try
+    {
+        writeMessage(&payload, aMessage, aVersion);
+
+        const unsigned char *bytes = co_buffer_get_data(&payload);
+        const size_t length = co_buffer_get_length(&payload);
+
+        if (compressed && length >= COSynchronizerBinaryCompressionThreshold)
+        {
+            frame = compressedFrameWithPayload(bytes, length, flags);
+        }
+        if (frame == nil)
+        {
+            frame = uncompressedFrameWithPayload(bytes, length, flags);
+        }
+    }
+    @finally
+    {
+        co_buffer_free(&payload);
+    }
+
+    return frame;
+}
+
++ (NSUInteger)lengthOfFrameInBytes: (const unsigned char *)bytes length: (NSUInteger)length
+{
+    if (length < COSynchronizerBinaryFrameLengthPrefixSize)
+        return 0;
+
+    const NSUInteger frameLength = COSynchronizerBinaryFrameLengthPrefixSize + readUint32(bytes);
+    return frameLength <= length ? frameLength : 0;
+}
+
++ (void)readFramesFromData: (NSData *)data
+                    buffer: (NSMutableData *)aBuffer
+                usingBlock: (void (^)(NSData *frame))aBlock
+{
+    NILARG_EXCEPTION_TEST(data);
+    NILARG_EXCEPTION_TEST(aBuffer);
+
+    // Common case: a single frame received at once doesn't need to be copied
+    if (aBuffer.length == 0)
+    {
+        const NSUInteger frameLength = [self lengthOfFrameInBytes: data.bytes length: data.length];
+
+        if (frameLength > 0 && frameLength == data.length)
+        {
+            aBlock(data);
+            return;
+        }
+    }
+
+    [aBuffer appendData: data];
+
+    NSUInteger frameLength;
+    while ((frameLength = [self lengthOfFrameInBytes: aBuffer.bytes length: aBuffer.length]) > 0)
+    {
+        NSData *frame = [aBuffer subdataWithRange: NSMakeRange(0, frameLength)];
+
+        [aBuffer replaceBytesInRange: NSMakeRange(0, frameLength) withBytes: NULL length: 0];
+        aBlock(frame);
+    }
+}
+
+/**
+ * Sets the error if not NULL, and returns nil.
+ */
+static id corruptedFrame(NSError **anError, NSString *aReason)
+{
+    if (anError != NULL)
+    {
+        *anError = [NSError errorWithDomain: kCOCoreObjectErrorDomain
+                                       code: kCOCorruptedDataError
+                                   userInfo: @{ NSLocalizedDescriptionKey: aReason }];
+    }
+    return nil;
+}
+
++ (id)messageWithFrame: (NSData *)aFrame
+{
+    return [self messageWithFrame: aFrame error: NULL];
+}
+
++ (id)messageWithFrame: (NSData *)aFrame error: (NSError **)anError
+{
+    NILARG_EXCEPTION_TEST(aFrame);
+
+    const unsigned char *bytes = aFrame.bytes;
+    const NSUInteger frameLength = [self lengthOfFrameInBytes: bytes length: aFrame.length];
+    const NSUInteger headerLength = COSynchronizerBinaryFrameLengthPrefixSize + 1;
+
+    if (frameLength < headerLength)
+        return corruptedFrame(anError, @"Incomplete frame");
+
+    const uint8_t flags = bytes[COSynchronizerBinaryFrameLengthPrefixSize];
+    NSMutableData *decompressedPayload = nil;
+    co_message_reader_t reader;
+
+    // Frames written by a newer protocol version
+    if (flags & ~COSynchronizerBinaryFrameKnownFlags)
+        return corruptedFrame(anError, @"Unknown frame flags");
+
+    if (flags & COSynchronizerBinaryFrameCompressed)
+    {
+        if (frameLength < headerLength + 4)
+            return corruptedFrame(anError, @"Incomplete frame");
+
+        const NSUInteger compressedLength = frameLength - headerLength - 4;
+        uLongf length = readUint32(bytes + headerLength);
+
+        // Don't let a peer make us allocate an arbitrary amount of memory
+        if (length > COSynchronizerBinaryMaxPayloadLength
+            || length / COSynchronizerBinaryMaxCompressionRatio > compressedLength)
+        {
+            return corruptedFrame(anError, @"Uncompressed payload length too large");
+        }
+
+        decompressedPayload = [NSMutableData dataWithLength: length];
+
+        if (uncompress(decompressedPayload.mutableBytes,
+                       &length,
+                       bytes + headerLength + 4,
+                       compressedLength) != Z_OK
+            || length != decompressedPayload.length)
+        {
+            return corruptedFrame(anError, @"Corrupted compressed payload");
+        }
+        reader = (co_message_reader_t){ decompressedPayload.bytes, length, 0, NO };
+    }
+    else
+    {
+        reader = (co_message_reader_t){ bytes + headerLength, frameLength - headerLength, 0, NO };
+    }
+
+    id message = readMessage(&reader);
+
+    if (reader.failed || reader.pos != reader.length)
+        return corruptedFrame(anError, @"Malformed message or item data");
+
+    return message;
+}
+
+@end
@@ -27,8 +27,11 @@
 
 - (void)sendPropertyList: (id)aPropertyList toClient: (NSString *)aClient
 {
-    NSString *text = [COSynchronizerJSONUtils serializePropertyList: aPropertyList];
+    [self sendText: [COSynchronizerJSONUtils serializePropertyList: aPropertyList] toClient: aClient];
+}
 
+- (void)sendText: (NSString *)text toClient: (NSString *)aClient
+{
     if (paused)
     {
         [queuedMessages addObject: @{@"text": text, @"type": @"outgoing", @"client": aClient}];
@@ -52,12 +55,16 @@
 - (void)sendPushedRevisions: (COSynchronizerPushedRevisionsToClientMessage *)message
                   toClients: (NSArray *)clients
 {
+    id plist = [NSMutableDictionary new];
+    plist[@"revisions"] = [COSynchronizerJSONUtils propertyListForRevisionsArray: message.revisions];
+    plist[@"class"] = @"COSynchronizerPushedRevisionsToClientMessage";
+
+    // The same text is sent to every client
+    NSString *text = [COSynchronizerJSONUtils serializePropertyList: plist];
+
     for (NSString *client in clients)
     {
-        id plist = [NSMutableDictionary new];
-        plist[@"revisions"] = [COSynchronizerJSONUtils propertyListForRevisionsArray: message.revisions];
-        plist[@"class"] = @"COSynchronizerPushedRevisionsToClientMessage";
-        [self sendPropertyList: plist toClient: client];
+        [self sendText: text toClient: client];
     }
 }
 
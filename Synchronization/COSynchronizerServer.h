@@ -39,6 +39,12 @@
     // COSynchronizerServer where one calls the other via a commit notification
     ETUUID *currentlyHandlingLastSentRevision;
     NSString *currentlyRespondingToClient;
+    /**
+     * Revisions sent recently, shared by the messages to all the clients
+     */
+    NSMutableDictionary *revisionForUUID;
+    NSMutableArray *cachedRevisionUUIDs;
+    NSUInteger maxCachedRevisions;
 }
 
 - (instancetype)initWithBranch: (COBranch *)aBranch NS_DESIGNATED_INITIALIZER;
@@ -46,6 +52,19 @@
 @property (nonatomic, readonly, strong) COPersistentRoot *persistentRoot;
 @property (nonatomic, readonly, strong) COBranch *branch;
 @property (nonatomic, readwrite, weak) id <COSynchronizerServerDelegate> delegate;
+/**
+ * The maximum number of revisions kept in memory to be sent to the clients.
+ *
+ * Each revision is loaded once as a delta against its parent, then reused in
+ * the messages to every client (along with its encoding, see
+ * -[COSynchronizerRevision encodedRepresentationForKey:usingBlock:]). Clients
+ * at the same revision receive the same push message.
+ *
+ * When the limit is reached, the revisions cached first are discarded.
+ *
+ * By default, returns 256.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger maxCachedRevisions;
 
 - (void)handlePushedRevisionsFromClient: (COSynchronizerPushedRevisionsFromClientMessage *)aMessage;
 - (void)addClientID: (NSString *)clientID;
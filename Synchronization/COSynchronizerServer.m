@@ -20,7 +20,7 @@
 
 @implementation COSynchronizerServer
 
-@synthesize delegate, branch = branch;
+@synthesize delegate, branch = branch, maxCachedRevisions;
 
 - (COPersistentRoot *)persistentRoot
 {
@@ -34,6 +34,9 @@
     branch = aBranch;
     branch.supportsRevert = NO;
     lastSentRevisionForClientID = [NSMutableDictionary new];
+    revisionForUUID = [NSMutableDictionary new];
+    cachedRevisionUUIDs = [NSMutableArray new];
+    maxCachedRevisions = 256;
     [[NSNotificationCenter defaultCenter] addObserver: self
                                              selector: @selector(persistentRootDidChange:)
                                                  name: COPersistentRootDidChangeNotification
@@ -60,9 +63,33 @@
         return;
     }
 
+    // Clients at the same revision share a push message, so the delegate can
+    // encode it once
+    NSMutableDictionary *clientIDsByLastSentRevision = [NSMutableDictionary new];
+
     for (NSString *clientID in self.clientIDs)
     {
-        [self sendPushToClient: clientID];
+        if (currentlyHandlingLastSentRevision != nil
+            && [currentlyRespondingToClient isEqualToString: clientID])
+        {
+            [self sendPushToClients: @[clientID]];
+            continue;
+        }
+
+        ETUUID *lastSentRevision = lastSentRevisionForClientID[clientID];
+        NSMutableArray *clientIDs = clientIDsByLastSentRevision[lastSentRevision];
+
+        if (clientIDs == nil)
+        {
+            clientIDs = [NSMutableArray new];
+            clientIDsByLastSentRevision[lastSentRevision] = clientIDs;
+        }
+        [clientIDs addObject: clientID];
+    }
+
+    for (NSArray *clientIDs in clientIDsByLastSentRevision.allValues)
+    {
+        [self sendPushToClients: clientIDs];
     }
 }
 
@@ -117,7 +144,7 @@
                                                                                                     persistentRootUUID: self.persistentRoot.UUID]];
     }
 
-    // Set the following ivars so -sendPushToClient: sends a response message
+    // Set the following ivars so -sendPushToClients: sends a response message
     // instead of a regular push message.
 
     ETAssert(clientID != nil);
@@ -163,19 +190,68 @@
     [self handleRevisions: aMessage.revisions fromClient: aMessage.clientID];
 }
 
-- (void)sendPushToClient: (NSString *)clientID
+- (void)setMaxCachedRevisions: (NSUInteger)aLimit
+{
+    maxCachedRevisions = aLimit;
+    [self discardRevisionsBeyondLimit];
+}
+
+- (void)discardRevisionsBeyondLimit
+{
+    while (cachedRevisionUUIDs.count > maxCachedRevisions)
+    {
+        [revisionForUUID removeObjectForKey: cachedRevisionUUIDs[0]];
+        [cachedRevisionUUIDs removeObjectAtIndex: 0];
+    }
+}
+
+/**
+ * Returns the revision as a delta against its parent.
+ *
+ * Revisions are immutable, so the same revision object can be sent to every
+ * client.
+ */
+- (COSynchronizerRevision *)revisionForUUID: (ETUUID *)aRevisionUUID
+{
+    COSynchronizerRevision *rev = revisionForUUID[aRevisionUUID];
+
+    if (rev != nil)
+        return rev;
+
+    rev = [[COSynchronizerRevision alloc] initWithUUID: aRevisionUUID
+                                        persistentRoot: self.persistentRoot.UUID
+                                                 store: self.persistentRoot.store
+                            recordAsDeltaAgainstParent: YES];
+
+    if (maxCachedRevisions > 0)
+    {
+        revisionForUUID[aRevisionUUID] = rev;
+        [cachedRevisionUUIDs addObject: aRevisionUUID];
+        [self discardRevisionsBeyondLimit];
+    }
+    return rev;
+}
+
+/**
+ * All the given clients must have been sent the same last revision.
+ */
+- (void)sendPushToClients: (NSArray *)clientIDs
 {
-    ETUUID *lastConfirmedForClient = lastSentRevisionForClientID[clientID];
-    if ([lastConfirmedForClient isEqual: branch.currentRevision.UUID])
+    ETUUID *lastConfirmedForClients = lastSentRevisionForClientID[clientIDs.firstObject];
+    if ([lastConfirmedForClients isEqual: branch.currentRevision.UUID])
     {
         return;
     }
-    lastSentRevisionForClientID[clientID] = branch.currentRevision.UUID;
+    for (NSString *clientID in clientIDs)
+    {
+        ETAssert([lastSentRevisionForClientID[clientID] isEqual: lastConfirmedForClients]);
+        lastSentRevisionForClientID[clientID] = branch.currentRevision.UUID;
+    }
 
     NSMutableArray *revs = [[NSMutableArray alloc] init];
 
     ETAssert(branch.editingContext != nil);
-    NSArray *revUUIDs = CORevisionsUUIDsFromExclusiveToInclusive(lastConfirmedForClient,
+    NSArray *revUUIDs = CORevisionsUUIDsFromExclusiveToInclusive(lastConfirmedForClients,
                                                                  self.branch.currentRevision.UUID,
                                                                  self.persistentRoot.UUID,
                                                                  branch.editingContext);
@@ -189,11 +265,7 @@
 
     for (ETUUID *revUUID in revUUIDs)
     {
-        COSynchronizerRevision *rev = [[COSynchronizerRevision alloc] initWithUUID: revUUID
-                                                                    persistentRoot: self.persistentRoot.UUID
-                                                                             store: self.persistentRoot.store
-                                                        recordAsDeltaAgainstParent: YES];
-        [revs addObject: rev];
+        [revs addObject: [self revisionForUUID: revUUID]];
     }
 
     if ([revs isEmpty])
@@ -203,7 +275,8 @@
     }
 
     if (currentlyHandlingLastSentRevision != nil
-        && [currentlyRespondingToClient isEqualToString: clientID])
+        && clientIDs.count == 1
+        && [currentlyRespondingToClient isEqualToString: clientIDs.firstObject])
     {
         ETAssert(currentlyRespondingToClient != nil);
 
@@ -211,7 +284,7 @@
         message.revisions = revs;
         message.lastRevisionUUIDSentByClient = currentlyHandlingLastSentRevision;
 
-        [self.delegate sendResponseMessage: message toClient: clientID];
+        [self.delegate sendResponseMessage: message toClient: clientIDs.firstObject];
 
         currentlyHandlingLastSentRevision = nil;
         currentlyRespondingToClient = nil;
@@ -220,7 +293,7 @@
     {
         COSynchronizerPushedRevisionsToClientMessage *message = [[COSynchronizerPushedRevisionsToClientMessage alloc] init];
         message.revisions = revs;
-        [self.delegate sendPushedRevisions: message toClients: @[clientID]];
+        [self.delegate sendPushedRevisions: message toClients: clientIDs];
     }
 }
 
@@ -15,6 +15,10 @@
  *
  * The revisions must be already committed.
  *
+ * Each source revision is merged from its delta into a working graph carried
+ * forward, so only the items it touches are diffed and written in the rebased
+ * revision.
+ *
  * Returns an array of the new revision UUIDs.
  */
 + (NSArray *)rebaseRevision: (ETUUID *)source
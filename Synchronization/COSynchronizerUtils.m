@@ -8,15 +8,24 @@
 #import "COSynchronizerUtils.h"
 #import "COStoreTransaction.h"
 
+
+/**
+ * The maximum number of item graphs kept by COGraphCache.
+ */
+#define COGraphCacheMaxCount 16
+
 @interface COGraphCache : NSObject
 {
     COSQLiteStore *store;
     ETUUID *persistentRoot;
     NSMutableDictionary *cache;
+    NSMutableArray *cachedRevisions;
+    NSUInteger maxCount;
 }
 
 - (instancetype)initWithPersistentRootUUID: (ETUUID *)aUUID
-                                     store: (COSQLiteStore *)aStore NS_DESIGNATED_INITIALIZER;
+                                     store: (COSQLiteStore *)aStore
+                                  maxCount: (NSUInteger)aCount NS_DESIGNATED_INITIALIZER;
 /**
  * Don't modify the returned graph
  */
@@ -27,7 +36,9 @@
 
 @implementation COGraphCache
 
-- (instancetype)initWithPersistentRootUUID: (ETUUID *)aUUID store: (COSQLiteStore *)aStore
+- (instancetype)initWithPersistentRootUUID: (ETUUID *)aUUID
+                                     store: (COSQLiteStore *)aStore
+                                  maxCount: (NSUInteger)aCount
 {
     NILARG_EXCEPTION_TEST(aUUID);
     NILARG_EXCEPTION_TEST(aStore)
@@ -35,12 +46,14 @@
     persistentRoot = aUUID;
     store = aStore;
     cache = [NSMutableDictionary new];
+    cachedRevisions = [NSMutableArray new];
+    maxCount = aCount;
     return self;
 }
 
 - (instancetype)init
 {
-    return [self initWithPersistentRootUUID: nil store: nil];
+    return [self initWithPersistentRootUUID: nil store: nil maxCount: 0];
 }
 
 - (COItemGraph *)graphForUUID: (ETUUID *)aRevision
@@ -49,19 +62,79 @@
     if (result == nil)
     {
         result = [store itemGraphForRevisionUUID: aRevision persistentRoot: persistentRoot];
-        cache[aRevision] = result;
+        [self setGraph: result forUUID: aRevision];
     }
     return result;
 }
 
+/**
+ * When the cache is full, discards the graph cached first.
+ */
 - (void)setGraph: (COItemGraph *)aGraph forUUID: (ETUUID *)aRevision
 {
+    if (cache[aRevision] == nil)
+    {
+        [cachedRevisions addObject: aRevision];
+    }
     cache[aRevision] = aGraph;
+
+    while (cachedRevisions.count > maxCount)
+    {
+        [cache removeObjectForKey: cachedRevisions[0]];
+        [cachedRevisions removeObjectAtIndex: 0];
+    }
 }
 
 @end
 
 
+static CODiffManager *COMergedDiff(id <COItemGraph> baseGraph,
+                                   id <COItemGraph> sourceGraph,
+                                   id <COItemGraph> destGraph,
+                                   ETModelDescriptionRepository *repo)
+{
+    CODiffManager *sourceBranchDiff = [CODiffManager diffItemGraph: baseGraph
+                                                     withItemGraph: sourceGraph
+                                        modelDescriptionRepository: repo
+                                                  sourceIdentifier: @"source"];
+    CODiffManager *destBranchDiff = [CODiffManager diffItemGraph: baseGraph
+                                                   withItemGraph: destGraph
+                                      modelDescriptionRepository: repo
+                                                sourceIdentifier: @"dest"];
+
+    CODiffManager *mergedDiff = [destBranchDiff diffByMergingWithDiff: sourceBranchDiff];
+
+    if (mergedDiff.hasConflicts)
+    {
+        NSLog(@"Attempting to auto-resolve conflicts favouring the other user...");
+        [mergedDiff resolveConflictsFavoringSourceIdentifier: @"source"]; // FIXME: Hardcoded
+    }
+
+    //NSLog(@"Applying diff %@", diff);
+
+    return mergedDiff;
+}
+
+/**
+ * Returns the items of the graph for the given UUIDs, skipping missing items.
+ */
+static COItemGraph *COItemGraphRestrictedToUUIDs(COItemGraph *aGraph, NSArray *UUIDs)
+{
+    NSMutableArray *items = [NSMutableArray arrayWithCapacity: UUIDs.count];
+
+    for (ETUUID *uuid in UUIDs)
+    {
+        COItem *item = [aGraph itemForUUID: uuid];
+
+        if (item != nil)
+        {
+            [items addObject: item];
+        }
+    }
+    return [[COItemGraph alloc] initWithItems: items rootItemUUID: aGraph.rootItemUUID];
+}
+
+
 @implementation COSynchronizerUtils
 
 + (NSArray *)rebaseRevision: (ETUUID *)source
@@ -84,57 +157,90 @@
     ETAssert(sourceRevs != nil);
     ETAssert(sourceRevs.count > 0);
 
+    CORevisionInfo *sourceRevInfo = [store revisionInfoForRevisionUUID: source
+                                                    persistentRootUUID: persistentRoot];
+    CORevisionInfo *destRevInfo = [store revisionInfoForRevisionUUID: dest
+                                                  persistentRootUUID: persistentRoot];
+    CORevisionInfo *lcaRevInfo = [store revisionInfoForRevisionUUID: lca
+                                                 persistentRootUUID: persistentRoot];
+
+    // NOTE: If we want to support schema migration on-demand when loading item graphs, then
+    // the migration code must be called before diffing/merging item graphs below.
+    NSAssert(sourceRevInfo.schemaVersion == destRevInfo.schemaVersion
+          && sourceRevInfo.schemaVersion == lcaRevInfo.schemaVersion,
+             @"Mismatched schema versions between merged revisions for rebase");
+
     NSMutableArray *newRevids = [[NSMutableArray alloc] init];
 
     COGraphCache *cache = [[COGraphCache alloc] initWithPersistentRootUUID: persistentRoot
-                                                                     store: store];
+                                                                     store: store
+                                                                  maxCount: COGraphCacheMaxCount];
+
+    // We carry forward two working graphs: the last rebased source revision
+    // (initially the LCA) and the last rebased revision (initially 'dest').
+    //
+    // Each source revision is merged from its delta. The items it doesn't
+    // touch are the same in the LCA and source graphs, so the merge keeps
+    // their dest version, and we only diff the touched items.
+    COItemGraph *currentLCAGraph = [[COItemGraph alloc] initWithItemGraph: [cache graphForUUID: lca]];
+    COItemGraph *currentDestGraph = [[COItemGraph alloc] initWithItemGraph: [cache graphForUUID: dest]];
 
     ETUUID *currentLCA = lca;
     ETUUID *currentDest = dest;
     for (ETUUID *sourceRev in sourceRevs)
     {
-        CORevisionInfo *sourceRevInfo = [store revisionInfoForRevisionUUID: source
-                                                        persistentRootUUID: persistentRoot];
-        CORevisionInfo *destRevInfo = [store revisionInfoForRevisionUUID: dest
-                                                      persistentRootUUID: persistentRoot];
-        CORevisionInfo *lcaRevInfo = [store revisionInfoForRevisionUUID: lca
-                                                     persistentRootUUID: persistentRoot];
-        
-        // NOTE: If we want to support schema migration on-demand when loading item graphs, then
-        // the migration code must be called before diffing/merging item graphs below.
-        NSAssert(sourceRevInfo.schemaVersion == destRevInfo.schemaVersion
-              && sourceRevInfo.schemaVersion == lcaRevInfo.schemaVersion,
-                 @"Mismatched schema versions between merged revisions for rebase");
-        
-        id <COItemGraph> currentSourceGraph = [cache graphForUUID: sourceRev];
-        id <COItemGraph> currentDestGraph = [cache graphForUUID: currentDest];
-        id <COItemGraph> currentLCAGraph = [cache graphForUUID: currentLCA];
-
-        CODiffManager *sourceBranchDiff = [CODiffManager diffItemGraph: currentLCAGraph
-                                                         withItemGraph: currentSourceGraph
-                                            modelDescriptionRepository: repo
-                                                      sourceIdentifier: @"source"];
-        CODiffManager *destBranchDiff = [CODiffManager diffItemGraph: currentLCAGraph
-                                                       withItemGraph: currentDestGraph
-                                          modelDescriptionRepository: repo
-                                                    sourceIdentifier: @"dest"];
-
-        CODiffManager *mergedDiff = [destBranchDiff diffByMergingWithDiff: sourceBranchDiff];
-
-        if (mergedDiff.hasConflicts)
+        COItemGraph *sourceDelta = [store partialItemGraphFromRevisionUUID: currentLCA
+                                                            toRevisionUUID: sourceRev
+                                                            persistentRoot: persistentRoot];
+        NSArray *deltaItems = sourceDelta.items;
+        COItemGraph *modifiedItems = nil;
+
+        if ([CODiffManager itemsUseItemGraphDiff: deltaItems modelDescriptionRepository: repo])
         {
-            NSLog(@"Attempting to auto-resolve conflicts favouring the other user...");
-            [mergedDiff resolveConflictsFavoringSourceIdentifier: @"source"]; // FIXME: Hardcoded
+            NSArray *touchedUUIDs = sourceDelta.itemUUIDs;
+            COItemGraph *touchedLCAGraph = COItemGraphRestrictedToUUIDs(currentLCAGraph, touchedUUIDs);
+            COItemGraph *touchedDestGraph = COItemGraphRestrictedToUUIDs(currentDestGraph, touchedUUIDs);
+            COItemGraph *touchedSourceGraph = [[COItemGraph alloc] initWithItems: deltaItems
+                                                                    rootItemUUID: currentLCAGraph.rootItemUUID];
+
+            CODiffManager *mergedDiff =
+                COMergedDiff(touchedLCAGraph, touchedSourceGraph, touchedDestGraph, repo);
+            COItemGraph *mergeResult = [[COItemGraph alloc] initWithItemGraph: touchedLCAGraph];
+            [mergedDiff applyTo: mergeResult];
+
+            // Write only the items that differ from the parent revision
+            NSMutableArray *changedItems = [NSMutableArray array];
+            for (COItem *item in mergeResult.items)
+            {
+                if (![item isEqual: [currentDestGraph itemForUUID: item.UUID]])
+                {
+                    [changedItems addObject: item];
+                }
+            }
+            modifiedItems = [[COItemGraph alloc] initWithItems: changedItems
+                                                  rootItemUUID: currentDestGraph.rootItemUUID];
+
+            [currentDestGraph insertOrUpdateItems: changedItems];
+            [currentLCAGraph insertOrUpdateItems: deltaItems];
         }
+        else
+        {
+            COItemGraph *currentSourceGraph = [[COItemGraph alloc] initWithItemGraph: currentLCAGraph];
+            [currentSourceGraph insertOrUpdateItems: deltaItems];
 
-        //NSLog(@"Applying diff %@", diff);
+            CODiffManager *mergedDiff =
+                COMergedDiff(currentLCAGraph, currentSourceGraph, currentDestGraph, repo);
+            COItemGraph *mergeResult = [[COItemGraph alloc] initWithItemGraph: currentLCAGraph];
+            [mergedDiff applyTo: mergeResult];
 
-        COItemGraph *mergeResult = [[COItemGraph alloc] initWithItemGraph: currentLCAGraph];
-        [mergedDiff applyTo: mergeResult];
+            modifiedItems = mergeResult;
+            currentDestGraph = mergeResult;
+            currentLCAGraph = currentSourceGraph;
+        }
 
         ETUUID *nextRev = [ETUUID UUID];
         [newRevids addObject: nextRev];
-        [txn writeRevisionWithModifiedItems: mergeResult
+        [txn writeRevisionWithModifiedItems: modifiedItems
                                revisionUUID: nextRev
                                    metadata: sourceRevInfo.metadata
                            parentRevisionID: currentDest
@@ -143,7 +249,6 @@
                                  branchUUID: branch
                               schemaVersion: sourceRevInfo.schemaVersion];
 
-        [cache setGraph: mergeResult forUUID: nextRev];
         currentDest = nextRev;
         currentLCA = sourceRev;
     }
@@ -16,6 +16,10 @@
  * protocol.
  */
 @interface COSynchronizerRevision : NSObject
+{
+@private
+    NSMutableDictionary *_encodedRepresentations;
+}
 
 @property (nonatomic, readwrite, strong) COItemGraph *modifiedItems;
 @property (nonatomic, readwrite, copy) ETUUID *revisionUUID;
@@ -32,8 +36,31 @@
               persistentRoot: (ETUUID *)aPersistentRoot
                        store: (COSQLiteStore *)store
   recordAsDeltaAgainstParent: (BOOL)delta NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithModifiedItems: (COItemGraph *)items
+                         revisionUUID: (ETUUID *)aUUID
+                   parentRevisionUUID: (ETUUID *)aParentUUID
+                        schemaVersion: (int64_t)aVersion
+                             metadata: (NSDictionary *)aMetadata
+                                 date: (NSDate *)aDate NS_DESIGNATED_INITIALIZER;
 
+/**
+ * Returns the JSON property list representing the revision.
+ *
+ * The property list is cached (see -encodedRepresentationForKey:usingBlock:)
+ * and shared by all the callers, so it is immutable, nested collections
+ * included. Callers that need to change it must make a mutable copy.
+ */
 @property (nonatomic, readonly, strong) id propertyList;
+/**
+ * Returns the representation cached for the given key, or calls the block to
+ * compute it and caches the result.
+ *
+ * Transports use this method to encode a revision once, when the revision is
+ * sent to multiple clients.
+ *
+ * Cached representations are discarded when a property of the revision is set.
+ */
+- (id)encodedRepresentationForKey: (NSString *)aKey usingBlock: (id (^)(void))aBlock;
 
 - (instancetype)initWithPropertyList: (id)aPropertyList NS_DESIGNATED_INITIALIZER;
 
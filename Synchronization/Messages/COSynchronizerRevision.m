@@ -59,7 +59,116 @@
     return self;
 }
 
+- (instancetype)initWithModifiedItems: (COItemGraph *)items
+                         revisionUUID: (ETUUID *)aUUID
+                   parentRevisionUUID: (ETUUID *)aParentUUID
+                        schemaVersion: (int64_t)aVersion
+                             metadata: (NSDictionary *)aMetadata
+                                 date: (NSDate *)aDate
+{
+    NILARG_EXCEPTION_TEST(aUUID);
+    SUPERINIT;
+    self.modifiedItems = items;
+    self.revisionUUID = aUUID;
+    self.parentRevisionUUID = aParentUUID;
+    self.schemaVersion = aVersion;
+    self.metadata = aMetadata;
+    self.date = aDate;
+    return self;
+}
+
+- (void)setModifiedItems: (COItemGraph *)items
+{
+    modifiedItems = items;
+    [_encodedRepresentations removeAllObjects];
+}
+
+- (void)setRevisionUUID: (ETUUID *)aUUID
+{
+    revisionUUID = [aUUID copy];
+    [_encodedRepresentations removeAllObjects];
+}
+
+- (void)setParentRevisionUUID: (ETUUID *)aUUID
+{
+    parentRevisionUUID = [aUUID copy];
+    [_encodedRepresentations removeAllObjects];
+}
+
+- (void)setSchemaVersion: (int64_t)aVersion
+{
+    schemaVersion = aVersion;
+    [_encodedRepresentations removeAllObjects];
+}
+
+- (void)setMetadata: (NSDictionary *)aMetadata
+{
+    metadata = [aMetadata copy];
+    [_encodedRepresentations removeAllObjects];
+}
+
+- (void)setDate: (NSDate *)aDate
+{
+    date = [aDate copy];
+    [_encodedRepresentations removeAllObjects];
+}
+
+- (id)encodedRepresentationForKey: (NSString *)aKey usingBlock: (id (^)(void))aBlock
+{
+    id representation = _encodedRepresentations[aKey];
+
+    if (representation != nil)
+        return representation;
+
+    representation = aBlock();
+
+    if (_encodedRepresentations == nil)
+    {
+        _encodedRepresentations = [NSMutableDictionary new];
+    }
+    _encodedRepresentations[aKey] = representation;
+    return representation;
+}
+
+/**
+ * Returns an immutable copy of the property list and its nested collections.
+ */
+static id immutableCopyOfPropertyList(id aPropertyList)
+{
+    if ([aPropertyList isKindOfClass: [NSDictionary class]])
+    {
+        NSMutableDictionary *result = [NSMutableDictionary dictionaryWithCapacity: [aPropertyList count]];
+
+        [aPropertyList enumerateKeysAndObjectsUsingBlock: ^(id key, id value, BOOL *stop)
+        {
+            result[key] = immutableCopyOfPropertyList(value);
+        }];
+        return [result copy];
+    }
+    else if ([aPropertyList isKindOfClass: [NSArray class]])
+    {
+        NSMutableArray *result = [NSMutableArray arrayWithCapacity: [aPropertyList count]];
+
+        for (id element in aPropertyList)
+        {
+            [result addObject: immutableCopyOfPropertyList(element)];
+        }
+        return [result copy];
+    }
+    return [aPropertyList copy];
+}
+
 - (id)propertyList
+{
+    // The cached property list is shared by all the clients the revision is
+    // sent to, so none of them must be able to mutate it
+    return [self encodedRepresentationForKey: @"JSON" usingBlock: ^()
+    {
+        return immutableCopyOfPropertyList([self uncachedPropertyList]);
+    }];
+}
+
+- (id)uncachedPropertyList
 {
     NSMutableDictionary *result = [NSMutableDictionary dictionary];
     result[@"modifiedItems"] = COItemGraphToJSONPropertyList(self.modifiedItems);
@@ -6,6 +6,7 @@
  */
 
 #import "TestCommon.h"
+#import "BenchmarkHarness.h"
 
 @interface NSString (RandomStringGeneration)
 + (NSString *)defaultAlphabet;
@@ -110,151 +111,85 @@
     [ctx commit];
 }
 
-- (void)testSingleItem
+/**
+ * Measures committing NUM_PERSISTENT_ROOTS persistent roots, then
+ * NUM_COMMITS - 1 commits to each one, and rewriting all their revisions.
+ */
+- (void)measureRevisionRewritingWithName: (NSString *)aName
+                     initialStudentCount: (int)initialStudentCount
+                   studentCountPerCommit: (NSInteger)studentCountPerCommit
 {
-    ctx.recordingUndo = NO;
-
-    NSDate *startDate = [NSDate date];
-    NSArray *proots = [self commitPersistentRootsWithEntityName: @"Person"
-                                                          count: NUM_PERSISTENT_ROOTS
-                                                   studentCount: 0];
+    BenchmarkHarness *harness = [BenchmarkHarness sharedHarness];
+    __block NSArray *proots = nil;
 
-    NSTimeInterval creationTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to commit %d new persistent roots: %0.2fs", NUM_PERSISTENT_ROOTS, creationTime);
-    startDate = [NSDate date];
+    ctx.recordingUndo = NO;
 
-    for (int commit = 0; commit < (NUM_COMMITS - 1); commit++)
+    [harness measureOnce: [aName stringByAppendingString: @": persistent root creation"]
+              operations: NUM_PERSISTENT_ROOTS
+                   block: ^()
     {
-        [self makeCommitToPersistentRoots: proots studentCount: 0];
-    }
-
-    NSTimeInterval commitTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to make %d commits: %0.2fs", (NUM_COMMITS - 1), commitTime);
-    startDate = [NSDate date];
-    
-    NSInteger __block migrationCounter = 0;
-
-    [ctx.store migrateRevisionsToVersion: 1
-                             withHandler: ^COItemGraph *(COItemGraph *oldItemGraph, int64_t oldVersion, int64_t newVersion)
-     {
-        NSMutableArray *newItems = [NSMutableArray array];
-
-        for (COItem *oldItem in oldItemGraph.items)
+        proots = [self commitPersistentRootsWithEntityName: @"Person"
+                                                     count: NUM_PERSISTENT_ROOTS
+                                              studentCount: initialStudentCount];
+    }];
+    [harness measureOnce: [aName stringByAppendingString: @": commit"]
+              operations: NUM_COMMITS - 1
+                   block: ^()
+    {
+        for (int commit = 0; commit < (NUM_COMMITS - 1); commit++)
         {
-            ETAssert(oldVersion == oldItem.packageVersion);
-            COMutableItem *newItem = [oldItem mutableCopy];
-            newItem.packageVersion = newVersion;
-            [newItems addObject: newItem];
+            [self makeCommitToPersistentRoots: proots studentCount: studentCountPerCommit];
         }
-        migrationCounter += 1;
+    }];
+
+    NSInteger __block migrationCounter = 0;
 
-        return [[COItemGraph alloc] initWithItems: newItems
-                                     rootItemUUID: oldItemGraph.rootItemUUID];
+    [harness measureOnce: [aName stringByAppendingString: @": revision rewriting"]
+              operations: NUM_PERSISTENT_ROOTS * NUM_COMMITS
+                   block: ^()
+    {
+        [ctx.store migrateRevisionsToVersion: 1
+                                 withHandler: ^COItemGraph *(COItemGraph *oldItemGraph, int64_t oldVersion, int64_t newVersion)
+         {
+            NSMutableArray *newItems = [NSMutableArray array];
+
+            for (COItem *oldItem in oldItemGraph.items)
+            {
+                ETAssert(oldVersion == oldItem.packageVersion);
+                COMutableItem *newItem = [oldItem mutableCopy];
+                newItem.packageVersion = newVersion;
+                [newItems addObject: newItem];
+            }
+            migrationCounter += 1;
+
+            return [[COItemGraph alloc] initWithItems: newItems
+                                         rootItemUUID: oldItemGraph.rootItemUUID];
+        }];
     }];
-    
+
     UKIntsEqual(NUM_PERSISTENT_ROOTS * NUM_COMMITS, revCounter);
     UKIntsEqual(revCounter, migrationCounter);
+}
 
-    const NSTimeInterval rewriteTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to rewrite %d store revisions: %0.2fs", revCounter, rewriteTime);
+- (void)testSingleItem
+{
+    [self measureRevisionRewritingWithName: @"Single item revision rewriting"
+                       initialStudentCount: 0
+                     studentCountPerCommit: 0];
 }
 
 - (void)testFixedItemCount
 {
-    ctx.recordingUndo = NO;
-
-    NSDate *startDate = [NSDate date];
-    NSArray *proots = [self commitPersistentRootsWithEntityName: @"Person"
-                                                          count: NUM_PERSISTENT_ROOTS
-                                                   studentCount: 50];
-
-    NSTimeInterval creationTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to commit %d new persistent roots: %0.2fs", NUM_PERSISTENT_ROOTS, creationTime);
-    startDate = [NSDate date];
-
-    for (int commit = 0; commit < (NUM_COMMITS - 1); commit++)
-    {
-        [self makeCommitToPersistentRoots: proots studentCount: 0];
-    }
-
-    NSTimeInterval commitTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to make %d commits: %0.2fs", (NUM_COMMITS - 1), commitTime);
-    startDate = [NSDate date];
-    
-    NSInteger __block migrationCounter = 0;
-
-    [ctx.store migrateRevisionsToVersion: 1
-                             withHandler: ^COItemGraph *(COItemGraph *oldItemGraph, int64_t oldVersion, int64_t newVersion)
-     {
-        NSMutableArray *newItems = [NSMutableArray array];
-
-        for (COItem *oldItem in oldItemGraph.items)
-        {
-            ETAssert(oldVersion == oldItem.packageVersion);
-            COMutableItem *newItem = [oldItem mutableCopy];
-            newItem.packageVersion = newVersion;
-            [newItems addObject: newItem];
-        }
-        migrationCounter += 1;
-
-        return [[COItemGraph alloc] initWithItems: newItems
-                                     rootItemUUID: oldItemGraph.rootItemUUID];
-    }];
-    
-    UKIntsEqual(NUM_PERSISTENT_ROOTS * NUM_COMMITS, revCounter);
-    UKIntsEqual(revCounter, migrationCounter);
-
-    const NSTimeInterval rewriteTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to rewrite %d store revisions: %0.2fs", revCounter, rewriteTime);
+    [self measureRevisionRewritingWithName: @"Fixed item count revision rewriting"
+                       initialStudentCount: 50
+                     studentCountPerCommit: 0];
 }
 
 - (void)testGrowingItemCount
 {
-    ctx.recordingUndo = NO;
-
-    NSDate *startDate = [NSDate date];
-    NSArray *proots = [self commitPersistentRootsWithEntityName: @"Person"
-                                                          count: NUM_PERSISTENT_ROOTS
-                                                   studentCount: 0];
-
-    NSTimeInterval creationTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to commit %d new persistent roots: %0.2fs", NUM_PERSISTENT_ROOTS, creationTime);
-    startDate = [NSDate date];
-
-    for (int commit = 0; commit < (NUM_COMMITS - 1); commit++)
-    {
-        [self makeCommitToPersistentRoots: proots studentCount: 1];
-    }
-
-    NSTimeInterval commitTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to make %d commits: %0.2fs", (NUM_COMMITS - 1), commitTime);
-    startDate = [NSDate date];
-    
-    NSInteger __block migrationCounter = 0;
-
-    [ctx.store migrateRevisionsToVersion: 1
-                             withHandler: ^COItemGraph *(COItemGraph *oldItemGraph, int64_t oldVersion, int64_t newVersion)
-     {
-        NSMutableArray *newItems = [NSMutableArray array];
-
-        for (COItem *oldItem in oldItemGraph.items)
-        {
-            ETAssert(oldVersion == oldItem.packageVersion);
-            COMutableItem *newItem = [oldItem mutableCopy];
-            newItem.packageVersion = newVersion;
-            [newItems addObject: newItem];
-        }
-        migrationCounter += 1;
-
-        return [[COItemGraph alloc] initWithItems: newItems
-                                     rootItemUUID: oldItemGraph.rootItemUUID];
-    }];
-    
-    UKIntsEqual(NUM_PERSISTENT_ROOTS * NUM_COMMITS, revCounter);
-    UKIntsEqual(revCounter, migrationCounter);
-
-    const NSTimeInterval rewriteTime = [[NSDate date] timeIntervalSinceDate: startDate];
-    NSLog(@"Time to rewrite %d store revisions: %0.2fs", revCounter, rewriteTime);
+    [self measureRevisionRewritingWithName: @"Growing item count revision rewriting"
+                       initialStudentCount: 0
+                     studentCountPerCommit: 1];
 }
 
 @end
@@ -974,6 +974,29 @@
        }];
 }
 
+- (void)testRevertedChangesNotCommitted
+{
+    rootObj.label = @"Groceries";
+    [ctx commit];
+
+    CORevision *revision = originalBranch.currentRevision;
+
+    rootObj.label = @"Shopping";
+    rootObj.label = @"Groceries";
+
+    UKTrue(persistentRoot.objectGraphContext.hasChanges);
+
+    [ctx commit];
+
+    UKObjectsEqual(revision, originalBranch.currentRevision);
+    UKFalse(persistentRoot.objectGraphContext.hasChanges);
+
+    rootObj.label = @"Shopping";
+    [ctx commit];
+
+    UKObjectsEqual(revision, originalBranch.currentRevision.parentRevision);
+}
+
 - (void)testCommitOnMultipleBranchesSimultaneously
 {
     [altBranch.rootObject setLabel: @"change1"];
@@ -627,6 +627,32 @@
     [ctx commit];
 }
 
+- (void)testDeadReferencePropertiesTrackedForPersistentRootDeletion
+{
+    COPersistentRoot *photo1 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    [photo1.rootObject setLabel: @"photo1"];
+    COPersistentRoot *library1 = [ctx insertNewPersistentRootWithEntityName: @"Tag"];
+    [library1.rootObject addObject: photo1.rootObject];
+    [ctx commit];
+
+    COPath *photo1Path = [COPath pathWithPersistentRoot: photo1.UUID];
+
+    photo1.deleted = YES;
+
+    UKObjectsEqual(A(library1.rootObject),
+                   [[ctx.deadRelationshipCache referringObjectsForPath: photo1Path] allObjects]);
+    UKObjectsEqual(S(@"contents"),
+                   [ctx.deadRelationshipCache sourcePropertiesOfReferringObject: library1.rootObject
+                                                                        forPath: photo1Path]);
+
+    photo1.deleted = NO;
+
+    UKObjectsEqual(S(@"photo1"), [library1.rootObject valueForKeyPath: @"contents.label"]);
+    UKNil([ctx.deadRelationshipCache referringObjectsForPath: photo1Path]);
+    UKNil([ctx.deadRelationshipCache sourcePropertiesOfReferringObject: library1.rootObject
+                                                               forPath: photo1Path]);
+}
+
 - (void)testLibraryPersistentRootDeletion
 {
     // library1 <<persistent root>>
@@ -265,6 +265,81 @@
     UKNil([ctx persistentRootForUUID: uuid]);
 }
 
+- (void)testMemoryBudgetUnloadsLeastRecentlyUsedPersistentRoots
+{
+    COPersistentRoot *persistentRoot1 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    COPersistentRoot *persistentRoot2 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    COPersistentRoot *persistentRoot3 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    ETUUID *uuid2 = persistentRoot2.UUID;
+
+    [ctx commit];
+
+    persistentRoot1.evictable = YES;
+    persistentRoot2.evictable = YES;
+    persistentRoot3.evictable = YES;
+    ctx.memoryBudget = 1;
+
+    UKTrue(ctx.estimatedMemoryUsage > 0);
+    UKObjectsEqual(S(persistentRoot1, persistentRoot2, persistentRoot3), ctx.loadedPersistentRoots);
+
+    [persistentRoot1.rootObject setLabel: @"test"];
+    [ctx commit];
+
+    UKObjectsEqual(S(persistentRoot1), ctx.loadedPersistentRoots);
+    UKIntsEqual(2, ctx.evictedPersistentRootCount);
+    UKIntsEqual(persistentRoot1.estimatedMemoryUsage, ctx.estimatedMemoryUsage);
+
+    // Triggers reload
+    COPersistentRoot *reloadedPersistentRoot2 = [ctx persistentRootForUUID: uuid2];
+
+    UKObjectsEqual(S(reloadedPersistentRoot2), ctx.loadedPersistentRoots);
+    UKIntsEqual(1, ctx.reloadedPersistentRootCount);
+    UKIntsEqual(3, ctx.evictedPersistentRootCount);
+    UKIntsEqual(3, ctx.persistentRoots.count);
+}
+
+- (void)testMemoryBudgetKeepsPersistentRootsWithChanges
+{
+    COPersistentRoot *persistentRoot1 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    COPersistentRoot *persistentRoot2 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    ETUUID *uuid2 = persistentRoot2.UUID;
+
+    [ctx commit];
+    persistentRoot1.evictable = YES;
+    persistentRoot2.evictable = YES;
+    [ctx unloadPersistentRoot: persistentRoot2];
+
+    ctx.memoryBudget = 1;
+    [persistentRoot1.rootObject setLabel: @"test"];
+
+    COPersistentRoot *reloadedPersistentRoot2 = [ctx persistentRootForUUID: uuid2];
+
+    UKObjectsEqual(S(persistentRoot1, reloadedPersistentRoot2), ctx.loadedPersistentRoots);
+    UKIntsEqual(0, ctx.evictedPersistentRootCount);
+    UKTrue(ctx.hasChanges);
+}
+
+- (void)testMemoryBudgetKeepsPersistentRootsNotMarkedAsEvictable
+{
+    COPersistentRoot *persistentRoot1 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    COPersistentRoot *persistentRoot2 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    COPersistentRoot *persistentRoot3 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+
+    [ctx commit];
+
+    UKFalse(persistentRoot2.evictable);
+
+    persistentRoot3.evictable = YES;
+    ctx.memoryBudget = 1;
+
+    [persistentRoot1.rootObject setLabel: @"test"];
+    [ctx commit];
+
+    UKObjectsEqual(S(persistentRoot1, persistentRoot2), ctx.loadedPersistentRoots);
+    UKIntsEqual(1, ctx.evictedPersistentRootCount);
+    UKNotNil(persistentRoot2.rootObject);
+}
+
 /**
  * Try to test all of the requirements of -persistentRoots and the other accessors
  */
@@ -484,6 +559,58 @@
     UKObjectsEqual(persistentRoot.UUID, [ctx2persistentRoots.anyObject UUID]);
 }
 
+- (void)testPersistentRootsObjectGraphContextsLoadedLazily
+{
+    COPersistentRoot *persistentRoot1 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    COPersistentRoot *persistentRoot2 = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    [persistentRoot1.rootObject setLabel: @"one"];
+    [persistentRoot2.rootObject setLabel: @"two"];
+    [ctx commit];
+
+    COEditingContext *ctx2 = [self newContext];
+
+    UKIntsEqual(2, ctx2.persistentRoots.count);
+
+    COPersistentRoot *ctx2PersistentRoot1 = [ctx2 persistentRootForUUID: persistentRoot1.UUID];
+    COPersistentRoot *ctx2PersistentRoot2 = [ctx2 persistentRootForUUID: persistentRoot2.UUID];
+
+    UKFalse(ctx2PersistentRoot1.objectGraphContextLoaded);
+    UKFalse(ctx2PersistentRoot2.objectGraphContextLoaded);
+    UKObjectsEqual(persistentRoot1.currentRevision.UUID, ctx2PersistentRoot1.currentRevision.UUID);
+    UKFalse(ctx2.hasChanges);
+
+    UKObjectsEqual(@"one", [ctx2PersistentRoot1.rootObject label]);
+    UKTrue(ctx2PersistentRoot1.objectGraphContextLoaded);
+    UKFalse(ctx2PersistentRoot2.objectGraphContextLoaded);
+
+    [ctx2PersistentRoot1.rootObject setLabel: @"one changed"];
+    [ctx2 commit];
+
+    UKFalse(ctx2PersistentRoot2.objectGraphContextLoaded);
+    UKObjectsEqual(@"two", [ctx2PersistentRoot2.rootObject label]);
+}
+
+- (void)testCrossPersistentRootReferenceToObjectGraphContextNotLoaded
+{
+    COPersistentRoot *source = [ctx insertNewPersistentRootWithEntityName: @"UnorderedGroupNoOpposite"];
+    COPersistentRoot *target = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    [target.rootObject setLabel: @"target"];
+    [source.rootObject setContents: S(target.rootObject)];
+    [ctx commit];
+
+    COEditingContext *ctx2 = [self newContext];
+    COPersistentRoot *ctx2Target = [ctx2 persistentRootForUUID: target.UUID];
+
+    UKFalse(ctx2Target.objectGraphContextLoaded);
+
+    COPersistentRoot *ctx2Source = [ctx2 persistentRootForUUID: source.UUID];
+    OutlineItem *ctx2TargetRootObject = [[ctx2Source.rootObject contents] anyObject];
+
+    UKTrue(ctx2Target.objectGraphContextLoaded);
+    UKObjectsSame(ctx2Target.rootObject, ctx2TargetRootObject);
+    UKObjectsEqual(@"target", ctx2TargetRootObject.label);
+}
+
 - (void)testDeletedPersistentRootsPropertyNotLazy
 {
     COPersistentRoot *persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
@@ -312,6 +312,22 @@
     UKObjectsEqual(A(r0, r1, r2, r4, r11), branch2A.nodes);
 }
 
+- (void)testBranchNodesInRangeAndIndexOfNode
+{
+    UKObjectsEqual((@[r3, r6]), [branch1B nodesInRange: NSMakeRange(2, 2)]);
+    UKIntsEqual(5, branch1B.count);
+    UKIntsEqual(3, [branch1B indexOfNode: r6]);
+    UKIntsEqual(NSNotFound, [branch1B indexOfNode: r2]);
+    UKObjectsEqual(r8, [branch1B nextNodeOnTrackFrom: r6 backwards: NO]);
+
+    [branch2A.rootObject setLabel: @"11"];
+    [ctx commit];
+    CORevision *r11 = branch2A.currentRevision;
+
+    UKIntsEqual(4, [branch2A indexOfNode: r11]);
+    UKObjectsEqual(r4, [branch2A nextNodeOnTrackFrom: r11 backwards: YES]);
+}
+
 // TODO: Test these things when reloading from a store
 
 /**
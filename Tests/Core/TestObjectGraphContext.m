@@ -699,6 +699,28 @@ doesNotPostNotification: COObjectGraphContextObjectsDidChangeNotification];
 #endif
 }
 
+- (void)testAddUnchangedItemAfterSetItemGraph
+{
+    COObjectGraphContext *ctx2 = [COObjectGraphContext new];
+
+    [ctx2 setItemGraph: ctx1];
+    UKFalse(ctx2.hasChanges);
+
+    COItem *rootItem = [ctx2 itemForUUID: ctx2.rootItemUUID];
+
+    [ctx2 insertOrUpdateItems: @[rootItem]];
+
+    UKFalse(ctx2.hasChanges);
+
+    COMutableItem *changedRootItem = [rootItem mutableCopy];
+    [changedRootItem setValue: @"changed" forAttribute: @"label" type: kCOTypeString];
+
+    [ctx2 insertOrUpdateItems: @[changedRootItem]];
+
+    UKObjectsEqual(S(ctx2.rootItemUUID), ctx2.updatedObjectUUIDs);
+    UKObjectsEqual(@"changed", [ctx2.rootObject valueForProperty: @"label"]);
+}
+
 - (void)testCrossContextReferenceSerializedAsNull
 {
     COObjectGraphContext *ctx2 = [COObjectGraphContext new];
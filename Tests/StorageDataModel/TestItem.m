@@ -7,6 +7,7 @@
 
 #import "TestCommon.h"
 #import "COItem+Binary.h"
+#import "COBinaryWriter.h"
 #import "COItem+JSON.h"
 #import "COJSONSerialization.h"
 
@@ -37,6 +38,7 @@ extern NSString *const kCOJSONDeprecatedFormatProperty;
     NSData *data = item.dataValue;
     COItem *roundTrip = [[COItem alloc] initWithData: data];
     UKObjectsEqual(item, roundTrip);
+    UKObjectsEqual(item, [[COItem alloc] initWithData: data error: NULL]);
 }
 
 - (void)validateRoundTrips: (COItem *)item
@@ -199,6 +201,38 @@ extern NSString *const kCOJSONDeprecatedFormatProperty;
     [self validateRoundTrips: item];
 }
 
+- (void)testReferenceWrittenAsString
+{
+    ETUUID *itemUUID = [ETUUID UUID];
+    COPath *branchPath = [COPath pathWithPersistentRoot: [ETUUID UUID] branch: [ETUUID UUID]];
+
+    // Paths written by older versions
+    co_buffer_t buf;
+    co_buffer_init(&buf);
+    co_buffer_store_uuid(&buf, itemUUID);
+    co_buffer_begin_object(&buf);
+    co_buffer_store_string(&buf, @"branchPath");
+    co_buffer_store_integer(&buf, kCOTypeReference);
+    co_buffer_store_string(&buf, branchPath.stringValue);
+    co_buffer_end_object(&buf);
+
+    NSData *data = [NSData dataWithBytes: co_buffer_get_data(&buf) length: co_buffer_get_length(&buf)];
+    COItem *item = [[COItem alloc] initWithData: data];
+
+    co_buffer_free(&buf);
+
+    UKObjectsEqual(itemUUID, item.UUID);
+    UKObjectsEqual(branchPath, [item valueForAttribute: @"branchPath"]);
+    UKIntsEqual(kCOTypeReference, [item typeForAttribute: @"branchPath"]);
+
+    // Written back as UUIDs once modified
+    COMutableItem *mutableItem = [item mutableCopy];
+    [mutableItem setValue: branchPath forAttribute: @"branchPath" type: kCOTypeReference];
+
+    UKTrue(mutableItem.dataValue.length < data.length);
+    UKObjectsEqual(item, [[COItem alloc] initWithData: mutableItem.dataValue]);
+}
+
 - (void)testCompositeReference
 {
     ETUUID *rootObject = [ETUUID UUID];
@@ -296,6 +330,37 @@ extern NSString *const kCOJSONDeprecatedFormatProperty;
     UKObjectsNotEqual(immutable, mutable);
 }
 
+- (void)testDataValueKeptByImmutableItem
+{
+    COMutableItem *mutable = [COMutableItem item];
+    [mutable setValue: @"my name" forAttribute: @"name" type: kCOTypeString];
+    COItem *immutable = [mutable copy];
+
+    UKObjectsSame(immutable.dataValue, immutable.dataValue);
+
+    NSData *data = immutable.dataValue;
+    COItem *roundTrip = [[COItem alloc] initWithData: data];
+
+    UKObjectsSame(data, roundTrip.dataValue);
+    UKObjectsEqual(immutable, roundTrip);
+    UKObjectsEqual(roundTrip, immutable);
+}
+
+- (void)testDataValueNotKeptByMutableItem
+{
+    COMutableItem *mutable = [COMutableItem item];
+    [mutable setValue: @"my name" forAttribute: @"name" type: kCOTypeString];
+    NSData *data = mutable.dataValue;
+    COMutableItem *roundTrip = [[COMutableItem alloc] initWithData: data];
+
+    [mutable setValue: @"name 2" forAttribute: @"name"];
+    [roundTrip setValue: @"name 2" forAttribute: @"name"];
+
+    UKObjectsNotEqual(data, mutable.dataValue);
+    UKObjectsNotEqual(data, roundTrip.dataValue);
+    UKObjectsEqual(mutable.dataValue, roundTrip.dataValue);
+}
+
 - (void)testEmptySet
 {
     COMutableItem *item1 = [COMutableItem item];
@@ -343,6 +408,34 @@ extern NSString *const kCOJSONDeprecatedFormatProperty;
     [self validateRoundTrips: item];
 }
 
+- (void)testMalformedData
+{
+    COMutableItem *item = [COMutableItem item];
+    [item setValue: @"Hello" forAttribute: @"name" type: kCOTypeString];
+    [item setValue: A(@1, @2) forAttribute: @"numbers" type: kCOTypeArray | kCOTypeInt64];
+
+    NSData *data = item.dataValue;
+    NSData *truncatedData = [data subdataWithRange: NSMakeRange(0, data.length - 1)];
+    NSMutableData *unknownTokenData = [data mutableCopy];
+    NSMutableData *invalidUTF8Data = [data mutableCopy];
+    NSError *error = nil;
+
+    ((unsigned char *)unknownTokenData.mutableBytes)[0] = 'X';
+    [invalidUTF8Data replaceBytesInRange: [data rangeOfData: [@"Hello" dataUsingEncoding: NSUTF8StringEncoding]
+                                                  options: 0
+                                                    range: NSMakeRange(0, data.length)]
+                             withBytes: "\xFF\xFF\xFF\xFF\xFF"];
+
+    UKNil([[COItem alloc] initWithData: truncatedData error: &error]);
+    UKIntsEqual(kCOCorruptedDataError, error.code);
+    error = nil;
+    UKNil([[COItem alloc] initWithData: unknownTokenData error: &error]);
+    UKIntsEqual(kCOCorruptedDataError, error.code);
+    error = nil;
+    UKNil([[COItem alloc] initWithData: invalidUTF8Data error: &error]);
+    UKIntsEqual(kCOCorruptedDataError, error.code);
+}
+
 - (void)testDeprecatedInternalKeys
 {
     NSDictionary *values = @{
@@ -367,6 +460,8 @@ extern NSString *const kCOJSONDeprecatedFormatProperty;
     UKStringsEqual(@"Untitled", roundTrip.entityName);
     UKStringsEqual(@"None", roundTrip.packageName);
     UKIntsEqual(1, roundTrip.packageVersion);
+    // The migrated keys are serialized with the new names
+    UKObjectsNotEqual(data, roundTrip.dataValue);
 
     // JSON roundtrip using old JSON internal keys
 
@@ -383,6 +478,8 @@ extern NSString *const kCOJSONDeprecatedFormatProperty;
     UKStringsEqual(@"Untitled", roundTrip.entityName);
     UKStringsEqual(@"None", roundTrip.packageName);
     UKIntsEqual(1, roundTrip.packageVersion);
+    // The migrated keys are serialized with the new names
+    UKObjectsNotEqual(data, roundTrip.dataValue);
     UKObjectsEqual(item.UUID, roundTrip.UUID);
 }
 
@@ -8,6 +8,7 @@
 #import "TestCommon.h"
 #import "COBinaryReader.h"
 #import "COBinaryWriter.h"
+#import "COInterningTable.h"
 
 @interface TestBinaryReadWrite : NSObject <UKTest>
 {
@@ -79,6 +80,11 @@ static void test_read_null(void *ctx)
     [((__bridge TestBinaryReadWrite *)ctx) readObject: [NSNull null]];
 }
 
+static void test_read_path(void *ctx, COPath *path)
+{
+    [((__bridge TestBinaryReadWrite *)ctx) readObject: path];
+}
+
 - (instancetype)init
 {
     SUPERINIT;
@@ -144,7 +150,8 @@ static void test_read_null(void *ctx)
         test_read_end_object,
         test_read_begin_array,
         test_read_end_array,
-        test_read_null
+        test_read_null,
+        test_read_path
     };
 
     co_reader_read(co_buffer_get_data(&buf),
@@ -156,6 +163,101 @@ static void test_read_null(void *ctx)
     co_buffer_free(&buf);
 }
 
+- (void)testPath
+{
+    ETUUID *persistentRoot = [ETUUID UUID];
+    ETUUID *branch = [ETUUID UUID];
+    COPath *persistentRootPath = [COPath pathWithPersistentRoot: persistentRoot];
+    COPath *branchPath = [COPath pathWithPersistentRoot: persistentRoot branch: branch];
+
+    co_buffer_t buf;
+    co_buffer_init(&buf);
+    co_buffer_store_path(&buf, persistentRoot, nil);
+    UKIntsEqual(17, co_buffer_get_length(&buf));
+    UKIntsEqual(17, co_reader_length_of_token(co_buffer_get_data(&buf)));
+    co_buffer_store_path(&buf, persistentRoot, branch);
+    UKIntsEqual(33, co_reader_length_of_token(co_buffer_get_data(&buf) + 17));
+    co_buffer_store_path(&buf, persistentRoot, branch);
+
+    co_reader_callback_t cb = {
+        test_read_int64,
+        test_read_double,
+        test_read_string,
+        test_read_uuid,
+        test_read_bytes,
+        test_read_begin_object,
+        test_read_end_object,
+        test_read_begin_array,
+        test_read_end_array,
+        test_read_null,
+        test_read_path
+    };
+
+    co_reader_read(co_buffer_get_data(&buf),
+                   co_buffer_get_length(&buf),
+                   (__bridge void *)(self),
+                   cb);
+    UKObjectsEqual(A(persistentRootPath, branchPath, branchPath), readObjects);
+    // The two branch paths are interned, and share their persistent root UUID
+    // with the first path
+    UKObjectsSame(readObjects[1], readObjects[2]);
+    UKObjectsSame([readObjects[0] persistentRoot], [readObjects[1] persistentRoot]);
+
+    cb.co_read_path = NULL;
+    UKRaisesException(co_reader_read(co_buffer_get_data(&buf),
+                                     co_buffer_get_length(&buf),
+                                     (__bridge void *)(self),
+                                     cb));
+
+    co_buffer_free(&buf);
+}
+
+- (void)testInternedUUIDs
+{
+    COInterningTable *table = [COInterningTable sharedTable];
+    ETUUID *uuid = [ETUUID UUID];
+    ETUUID *otherUUID = [ETUUID UUID];
+    ETUUID *internedUUID = [table UUIDWithBytes: uuid.UUIDValue];
+
+    UKObjectsEqual(uuid, internedUUID);
+    UKObjectsNotSame(uuid, internedUUID);
+    UKObjectsSame(internedUUID, [table UUIDWithBytes: uuid.UUIDValue]);
+    UKObjectsEqual(otherUUID, [table UUIDWithBytes: otherUUID.UUIDValue]);
+
+    COPath *path = [table pathWithPersistentRootBytes: uuid.UUIDValue branchBytes: NULL];
+    COPath *branchPath = [table pathWithPersistentRootBytes: uuid.UUIDValue
+                                                branchBytes: otherUUID.UUIDValue];
+
+    UKObjectsEqual([COPath pathWithPersistentRoot: uuid], path);
+    UKObjectsEqual([COPath pathWithPersistentRoot: uuid branch: otherUUID], branchPath);
+    UKObjectsSame(internedUUID, path.persistentRoot);
+    UKObjectsSame(internedUUID, branchPath.persistentRoot);
+    UKObjectsSame(path, [table pathWithPersistentRootBytes: uuid.UUIDValue branchBytes: NULL]);
+    UKObjectsSame(branchPath, [table pathWithPersistentRootBytes: uuid.UUIDValue
+                                                     branchBytes: otherUUID.UUIDValue]);
+}
+
+- (void)testInterningTableShrinksOnceUUIDsAreReleased
+{
+    COInterningTable *table = [COInterningTable new];
+    const NSUInteger count = 100 * COInterningTableStripeCount * COInterningTableMinimumPruneCount;
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        @autoreleasepool
+        {
+            ETUUID *uuid = [ETUUID UUID];
+
+            [table UUIDWithBytes: uuid.UUIDValue];
+            [table pathWithPersistentRootBytes: uuid.UUIDValue branchBytes: NULL];
+        }
+    }
+
+    // Each table part is pruned once it reaches the minimum prune count, and
+    // nothing is alive at this point
+    UKTrue(table.count <= 2 * COInterningTableStripeCount * COInterningTableMinimumPruneCount);
+}
+
 static volatile char dest[2048];
 
 - (void)testWritePerf
@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "COContentsBlobWriter.h"
+#import "COItem+Binary.h"
+#import "COSQLiteStorePersistentRootBackingStore.h"
+#import "COSQLiteStorePersistentRootBackingStoreBinaryFormats.h"
+
+@interface TestContentsBlobWriter : NSObject <UKTest>
+{
+    COContentsBlobWriter *writer;
+}
+
+@end
+
+
+@implementation TestContentsBlobWriter
+
+- (instancetype)init
+{
+    SUPERINIT;
+    writer = [COContentsBlobWriter new];
+    return self;
+}
+
+- (COMutableItem *)itemWithEntityName: (NSString *)anEntityName name: (NSString *)aName
+{
+    COMutableItem *item = [COMutableItem item];
+
+    if (anEntityName != nil)
+    {
+        item.entityName = anEntityName;
+    }
+    [item setValue: aName forAttribute: @"name" type: kCOTypeString];
+    [item setValue: S(@"b", @"a", @"c") forAttribute: @"tags" type: COTypeMakeSetOf(kCOTypeString)];
+    return item;
+}
+
+/**
+ * Returns the contents as they were written before COContentsBlobWriter,
+ * from the data value of each item.
+ */
+- (NSData *)expectedContentsBlobWithItemGraph: (COItemGraph *)anItemGraph
+{
+    NSMutableData *result = [NSMutableData data];
+    NSArray *sortedUUIDs = [anItemGraph.itemUUIDs sortedArrayUsingComparator: ^(id uuid1, id uuid2)
+    {
+        int order = memcmp([uuid1 UUIDValue], [uuid2 UUIDValue], 16);
+        return (order < 0) ? NSOrderedAscending : (order == 0 ? NSOrderedSame : NSOrderedDescending);
+    }];
+
+    for (ETUUID *uuid in sortedUUIDs)
+    {
+        AddCommitUUIDAndDataToCombinedCommitData(result, uuid, [anItemGraph itemForUUID: uuid].dataValue);
+    }
+    return result;
+}
+
+- (void)testContentsBlobMatchesItemData
+{
+    COMutableItem *root = [self itemWithEntityName: @"Folder" name: @"root"];
+    NSMutableArray *items = [NSMutableArray arrayWithObject: root];
+
+    for (int i = 0; i < 100; i++)
+    {
+        [items addObject: [self itemWithEntityName: @"Document"
+                                              name: [NSString stringWithFormat: @"document%d", i]]];
+    }
+
+    COItemGraph *graph = [[COItemGraph alloc] initWithItems: items rootItemUUID: root.UUID];
+    NSData *expectedBlob = [self expectedContentsBlobWithItemGraph: graph];
+
+    UKObjectsEqual(expectedBlob, [writer contentsBlobWithItemGraph: graph]);
+    UKObjectsEqual(expectedBlob, contentsBLOBWithItemTree(graph));
+}
+
+- (void)testWriterReuse
+{
+    COMutableItem *root = [self itemWithEntityName: @"Folder" name: @"root"];
+    COItemGraph *largeGraph = [[COItemGraph alloc] initWithItems: @[root,
+                                                                    [self itemWithEntityName: @"Document" name: @"a"],
+                                                                    [self itemWithEntityName: @"Document" name: @"b"]]
+                                                    rootItemUUID: root.UUID];
+    COItemGraph *smallGraph = [[COItemGraph alloc] initWithItems: @[root]
+                                                    rootItemUUID: root.UUID];
+
+    UKObjectsEqual([self expectedContentsBlobWithItemGraph: largeGraph],
+                   [writer contentsBlobWithItemGraph: largeGraph]);
+    UKObjectsEqual([self expectedContentsBlobWithItemGraph: smallGraph],
+                   [writer contentsBlobWithItemGraph: smallGraph]);
+}
+
+- (void)testItemsSharingEntityNameWithDifferentAttributes
+{
+    COMutableItem *root = [self itemWithEntityName: @"Document" name: @"root"];
+    COMutableItem *extraAttribute = [self itemWithEntityName: @"Document" name: @"extra"];
+    COMutableItem *renamedAttribute = [self itemWithEntityName: @"Document" name: @"renamed"];
+    COMutableItem *noEntityName = [self itemWithEntityName: nil name: @"none"];
+
+    [extraAttribute setValue: @"0" forAttribute: @"aaa" type: kCOTypeString];
+    [renamedAttribute removeValueForAttribute: @"tags"];
+    [renamedAttribute setValue: @3 forAttribute: @"count" type: kCOTypeInt64];
+
+    COItemGraph *graph = [[COItemGraph alloc] initWithItems: @[root, extraAttribute, renamedAttribute, noEntityName]
+                                               rootItemUUID: root.UUID];
+
+    // Write twice to use the attribute names sorted for the previous items
+    UKObjectsEqual([self expectedContentsBlobWithItemGraph: graph],
+                   [writer contentsBlobWithItemGraph: graph]);
+    UKObjectsEqual([self expectedContentsBlobWithItemGraph: graph],
+                   [writer contentsBlobWithItemGraph: graph]);
+
+    for (COItem *item in graph.items)
+    {
+        UKObjectsEqual(item, [[COItem alloc] initWithData: item.dataValue]);
+    }
+}
+
+@end
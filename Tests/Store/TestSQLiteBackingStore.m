@@ -14,6 +14,7 @@
 @interface MockStore : NSObject
 
 @property (nonatomic, readwrite, assign) NSUInteger maxNumberOfDeltaCommits;
+@property (nonatomic, readwrite, assign) NSUInteger outOfLineBlobThreshold;
 @property (nonatomic, readwrite, strong) FMDatabase *database;
 
 @end
@@ -21,12 +22,13 @@
 
 @implementation MockStore
 
-@synthesize maxNumberOfDeltaCommits, database;
+@synthesize maxNumberOfDeltaCommits, outOfLineBlobThreshold, database;
 
 - (instancetype)init
 {
     SUPERINIT;
     self.maxNumberOfDeltaCommits = 4;
+    self.outOfLineBlobThreshold = 1024;
     // Create an in-memory DB. See https://www.sqlite.org/c3ref/open.html
     self.database = [FMDatabase databaseWithPath: @":memory:"];
     ETAssert([self.database open]);
@@ -42,6 +44,7 @@
 @interface COSQLiteStorePersistentRootBackingStore (Private)
 
 - (NSString *)tableName;
+- (NSString *)blobTableName;
 
 @end
 
@@ -101,6 +104,40 @@
                                  rootItemUUID: rootitemUUID];
 }
 
+- (COItemGraph *)graphWithParent: (NSString *)name blob: (NSData *)blob
+{
+    COMutableItem *rootitem = [[COMutableItem alloc] initWithUUID: rootitemUUID];
+    [rootitem setValue: name forAttribute: @"name" type: kCOTypeString];
+    [rootitem setValue: blob forAttribute: @"blob" type: kCOTypeBlob];
+
+    return [[COItemGraph alloc] initWithItems: @[rootitem]
+                                 rootItemUUID: rootitemUUID];
+}
+
+- (NSData *)blobWithLength: (NSUInteger)length seed: (unsigned char)seed
+{
+    NSMutableData *blob = [NSMutableData dataWithLength: length];
+    unsigned char *bytes = blob.mutableBytes;
+
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        bytes[i] = (unsigned char)(i * 31 + seed);
+    }
+    return blob;
+}
+
+- (int)blobCount
+{
+    return [store.database intForQuery: [NSString stringWithFormat: @"SELECT COUNT(*) FROM %@",
+                                                                    [backing blobTableName]]];
+}
+
+- (int64_t)maxContentsLength
+{
+    return [store.database longLongForQuery: [NSString stringWithFormat: @"SELECT MAX(length(contents)) FROM %@",
+                                                                         [backing tableName]]];
+}
+
 - (COItemGraph *)graphWithChild: (NSString *)childlabel
 {
     return [[COItemGraph alloc] initWithItems: @[[self childItem: childlabel]]
@@ -238,4 +275,113 @@
     UKNil([[backing itemGraphForRevid: 4] itemForUUID: childitemUUID]);
 }
 
+- (void)testLargeItemGraphRoundTrip
+{
+    // Exceeds the item count above which items are decoded concurrently
+    const NSUInteger childCount = 1000;
+    NSMutableArray *items = [NSMutableArray array];
+    NSMutableArray *childUUIDs = [NSMutableArray array];
+
+    for (NSUInteger i = 0; i < childCount; i++)
+    {
+        COMutableItem *child = [COMutableItem item];
+        [child setValue: [NSString stringWithFormat: @"child%lu", (unsigned long)i]
+           forAttribute: @"name"
+                   type: kCOTypeString];
+        [items addObject: child];
+        [childUUIDs addObject: child.UUID];
+    }
+
+    COMutableItem *rootitem = [[COMutableItem alloc] initWithUUID: rootitemUUID];
+    [rootitem setValue: childUUIDs
+          forAttribute: @"contents"
+                  type: COTypeMakeArrayOf(kCOTypeCompositeReference)];
+    [items addObject: rootitem];
+
+    COItemGraph *graph = [[COItemGraph alloc] initWithItems: items
+                                               rootItemUUID: rootitemUUID];
+
+    [self commitWithGraph: graph parent: -1];
+
+    UKObjectsEqual(graph, [backing itemGraphForRevid: 0]);
+}
+
+- (void)testLargeBlobStoredOutOfLine
+{
+    NSData *blob = [self blobWithLength: 4096 seed: 1];
+    NSMutableArray *graphs = [NSMutableArray array];
+
+    // revid 4 is a full save
+    for (int i = 0; i < 6; i++)
+    {
+        [graphs addObject: [self graphWithParent: [NSString stringWithFormat: @"parent%d", i]
+                                            blob: blob]];
+        [self commitWithGraph: graphs[i] parent: i - 1];
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        UKObjectsEqual(graphs[i], [backing itemGraphForRevid: i]);
+    }
+    UKIntsEqual(1, [self blobCount]);
+    UKTrue([self maxContentsLength] < 1024);
+}
+
+- (void)testSmallBlobStoredInline
+{
+    COItemGraph *graph = [self graphWithParent: @"parent" blob: [self blobWithLength: 512 seed: 1]];
+
+    [self commitWithGraph: graph parent: -1];
+
+    UKObjectsEqual(graph, [backing itemGraphForRevid: 0]);
+    UKIntsEqual(0, [self blobCount]);
+}
+
+- (void)testBlobLookingLikeBlobReferenceRoundTrip
+{
+    NSMutableData *blob = [[@"COBlobRef" dataUsingEncoding: NSUTF8StringEncoding] mutableCopy];
+    [blob appendData: [self blobWithLength: 20 seed: 1]];
+    COItemGraph *graph = [self graphWithParent: @"parent" blob: blob];
+
+    [self commitWithGraph: graph parent: -1];
+
+    UKObjectsEqual(graph, [backing itemGraphForRevid: 0]);
+    UKIntsEqual(1, [self blobCount]);
+}
+
+- (void)testMissingBlobIsReadError
+{
+    [self commitWithGraph: [self graphWithParent: @"parent" blob: [self blobWithLength: 4096 seed: 1]]
+                   parent: -1];
+
+    // Simulate a corrupted store
+    [store.database executeUpdate: [NSString stringWithFormat: @"DELETE FROM %@", [backing blobTableName]]];
+
+    UKIntsEqual(0, [self blobCount]);
+    UKNil([backing itemGraphForRevid: 0]);
+}
+
+- (void)testDeletionRemovesUnusedBlobs
+{
+    COItemGraph *rootgraph = [self graphWithParent: @"parent" blob: [self blobWithLength: 4096 seed: 1]];
+    COItemGraph *branch1 = [self graphWithParent: @"parent 1" blob: [self blobWithLength: 4096 seed: 2]];
+    COItemGraph *branch2 = [self graphWithParent: @"parent 2"];
+
+    [self commitWithGraph: rootgraph parent: -1];   // revid 0
+    [self commitWithGraph: branch1 parent: 0];      // revid 1
+    [self commitWithGraph: branch2 parent: 0];      // revid 2
+
+    UKIntsEqual(2, [self blobCount]);
+
+    [backing deleteRevids: INDEXSET(1)];
+
+    UKIntsEqual(1, [self blobCount]);
+    UKObjectsEqual(rootgraph, [backing itemGraphForRevid: 0]);
+
+    [backing deleteRevids: INDEXSET(0)];
+
+    UKIntsEqual(0, [self blobCount]);
+    UKObjectsEqual(branch2, [backing itemGraphForRevid: 2]);
+}
+
 @end
@@ -703,16 +703,25 @@ static ETUUID *childUUID2;
         {
             const BOOL hasCommitsTable = [store.database tableExists: [NSString stringWithFormat: @"commits-%@", aUUID]];
             const BOOL hasMetadataTable = [store.database tableExists: [NSString stringWithFormat: @"metadata-%@", aUUID]];
+            NSString *commitsTable = [NSString stringWithFormat: @"`commits-%@`", aUUID];
+            BOOL hasCachedStatements = NO;
+
+            for (NSString *query in store.database.cachedStatements)
+            {
+                hasCachedStatements = hasCachedStatements || [query rangeOfString: commitsTable].location != NSNotFound;
+            }
 
             if (flag)
             {
                 UKTrue(hasCommitsTable);
                 UKTrue(hasMetadataTable);
+                UKTrue(hasCachedStatements);
             }
             else
             {
                 UKFalse(hasCommitsTable);
                 UKFalse(hasMetadataTable);
+                UKFalse(hasCachedStatements);
             }
         }];
 #endif
@@ -911,6 +920,49 @@ static ETUUID *childUUID2;
 
 }
 
+- (int)formatVersionOfStore: (COSQLiteStore *)aStore
+{
+    __block int version = 0;
+
+    [aStore testingRunBlockInStoreQueue: ^()
+    {
+        version = [aStore.database intForQuery: @"SELECT format_version FROM storeMetadata"];
+    }];
+    return version;
+}
+
+- (void)testMigrateStoreWithoutBinaryPaths
+{
+    UKIntsEqual(4, [self formatVersionOfStore: store]);
+
+    [store testingRunBlockInStoreQueue: ^()
+    {
+        [store.database executeUpdate: @"UPDATE storeMetadata SET format_version = 2"];
+    }];
+
+    COSQLiteStore *store2 = [[COSQLiteStore alloc] initWithURL: store.URL];
+
+    UKIntsEqual(4, [self formatVersionOfStore: store2]);
+    UKObjectsEqual([self makeInitialItemTree],
+                   [store2 itemGraphForRevisionUUID: [store2 persistentRootInfoForUUID: prootUUID].currentRevisionUUID
+                                     persistentRoot: prootUUID]);
+}
+
+- (void)testMigrateStoreWithoutOutOfLineBlobs
+{
+    [store testingRunBlockInStoreQueue: ^()
+    {
+        [store.database executeUpdate: @"UPDATE storeMetadata SET format_version = 3"];
+    }];
+
+    COSQLiteStore *store2 = [[COSQLiteStore alloc] initWithURL: store.URL];
+
+    UKIntsEqual(4, [self formatVersionOfStore: store2]);
+    UKObjectsEqual([self makeInitialItemTree],
+                   [store2 itemGraphForRevisionUUID: [store2 persistentRootInfoForUUID: prootUUID].currentRevisionUUID
+                                     persistentRoot: prootUUID]);
+}
+
 // The following are some tests ported from CoreObject's TestStore.m
 
 - (void)testPersistentRootInsertion
@@ -993,6 +1045,58 @@ static ETUUID *childUUID2;
     UKNil([store persistentRootInfoForUUID: nil]);
 }
 
+- (void)testPersistentRootInfos
+{
+    ETUUID *cheapCopyUUID = [ETUUID UUID];
+    ETUUID *deletedCopyUUID = [ETUUID UUID];
+
+    COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+    [txn createPersistentRootCopyWithUUID: cheapCopyUUID
+                 parentPersistentRootUUID: prootUUID
+                               branchUUID: [ETUUID UUID]
+                         parentBranchUUID: nil
+                      initialRevisionUUID: branchARevisionUUIDs.lastObject];
+    [txn createPersistentRootCopyWithUUID: deletedCopyUUID
+                 parentPersistentRootUUID: prootUUID
+                               branchUUID: [ETUUID UUID]
+                         parentBranchUUID: nil
+                      initialRevisionUUID: initialRevisionUUID];
+    UKTrue([store commitStoreTransaction: txn]);
+
+    txn = [[COStoreTransaction alloc] init];
+    [txn setOldTransactionID: [store persistentRootInfoForUUID: deletedCopyUUID].transactionID
+           forPersistentRoot: deletedCopyUUID];
+    [txn deletePersistentRoot: deletedCopyUUID];
+    UKTrue([store commitStoreTransaction: txn]);
+
+    NSArray *infos = store.persistentRootInfos;
+
+    UKObjectsEqual(S(prootUUID, cheapCopyUUID), SA((id)[[infos mappedCollection] UUID]));
+
+    for (COPersistentRootInfo *info in infos)
+    {
+        COPersistentRootInfo *expectedInfo = [store persistentRootInfoForUUID: info.UUID];
+
+        UKFalse(info.deleted);
+        UKObjectsEqual(expectedInfo.currentBranchUUID, info.currentBranchUUID);
+        UKIntsEqual(expectedInfo.transactionID, info.transactionID);
+        UKObjectsEqual(expectedInfo.metadata, info.metadata);
+        UKObjectsEqual(expectedInfo.branchUUIDs, info.branchUUIDs);
+
+        for (COBranchInfo *branchInfo in info.branches)
+        {
+            COBranchInfo *expectedBranchInfo = [expectedInfo branchInfoForUUID: branchInfo.UUID];
+
+            UKObjectsEqual(info.UUID, branchInfo.persistentRootUUID);
+            UKObjectsEqual(expectedBranchInfo.currentRevisionUUID, branchInfo.currentRevisionUUID);
+            UKObjectsEqual(expectedBranchInfo.headRevisionUUID, branchInfo.headRevisionUUID);
+            UKObjectsEqual(expectedBranchInfo.parentBranchUUID, branchInfo.parentBranchUUID);
+            UKObjectsEqual(expectedBranchInfo.metadata, branchInfo.metadata);
+            UKIntsEqual(expectedBranchInfo.deleted, branchInfo.deleted);
+        }
+    }
+}
+
 - (void)testDuplicateBranchesDisallowed
 {
     COStoreTransaction *txn = [[COStoreTransaction alloc] init];
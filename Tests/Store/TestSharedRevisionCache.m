@@ -0,0 +1,143 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "COSharedRevisionCache.h"
+
+@interface TestSharedRevisionCache : NSObject <UKTest>
+{
+    COSharedRevisionCache *cache;
+    ETUUID *storeUUID;
+}
+
+@end
+
+
+@implementation TestSharedRevisionCache
+
+- (instancetype)init
+{
+    SUPERINIT;
+    cache = [[COSharedRevisionCache alloc] initWithMaxCost: 1000];
+    storeUUID = [ETUUID UUID];
+    return self;
+}
+
+- (COItemGraph *)itemGraphWithLabel: (NSString *)aLabel
+{
+    COMutableItem *rootItem = [COMutableItem item];
+    [rootItem setValue: aLabel forAttribute: @"label" type: kCOTypeString];
+
+    return [COItemGraph itemGraphWithItemsRootFirst: @[rootItem]];
+}
+
+- (void)testItemGraphCopy
+{
+    ETUUID *revisionUUID = [ETUUID UUID];
+    COItemGraph *graph = [self itemGraphWithLabel: @"a"];
+
+    UKNil([cache itemGraphForRevisionUUID: revisionUUID storeUUID: storeUUID]);
+    UKIntsEqual(1, cache.missCount);
+
+    [cache setItemGraph: graph cost: 100 forRevisionUUID: revisionUUID storeUUID: storeUUID];
+
+    COItemGraph *cachedGraph = [cache itemGraphForRevisionUUID: revisionUUID storeUUID: storeUUID];
+
+    UKObjectsEqual(graph, cachedGraph);
+    UKObjectsNotSame(graph, cachedGraph);
+    UKIntsEqual(1, cache.hitCount);
+    UKIntsEqual(100, cache.totalCost);
+
+    UKFalse([[cachedGraph itemForUUID: cachedGraph.rootItemUUID] isKindOfClass: [COMutableItem class]]);
+
+    COMutableItem *changedItem = [[cachedGraph itemForUUID: cachedGraph.rootItemUUID] mutableCopy];
+    [changedItem setValue: @"b" forAttribute: @"label" type: kCOTypeString];
+    [cachedGraph insertOrUpdateItems: @[changedItem]];
+
+    [[graph itemForUUID: graph.rootItemUUID] setValue: @"c"
+                                         forAttribute: @"label"
+                                                 type: kCOTypeString];
+
+    COItemGraph *unchangedGraph = [cache itemGraphForRevisionUUID: revisionUUID storeUUID: storeUUID];
+
+    UKObjectsEqual(@"a", [[unchangedGraph itemForUUID: unchangedGraph.rootItemUUID] valueForAttribute: @"label"]);
+}
+
+- (void)testLeastRecentlyUsedEviction
+{
+    ETUUID *r1 = [ETUUID UUID];
+    ETUUID *r2 = [ETUUID UUID];
+    ETUUID *r3 = [ETUUID UUID];
+
+    [cache setItemGraph: [self itemGraphWithLabel: @"1"] cost: 400 forRevisionUUID: r1 storeUUID: storeUUID];
+    [cache setItemGraph: [self itemGraphWithLabel: @"2"] cost: 400 forRevisionUUID: r2 storeUUID: storeUUID];
+    UKNotNil([cache itemGraphForRevisionUUID: r1 storeUUID: storeUUID]);
+    [cache setItemGraph: [self itemGraphWithLabel: @"3"] cost: 400 forRevisionUUID: r3 storeUUID: storeUUID];
+
+    UKNotNil([cache itemGraphForRevisionUUID: r1 storeUUID: storeUUID]);
+    UKNil([cache itemGraphForRevisionUUID: r2 storeUUID: storeUUID]);
+    UKNotNil([cache itemGraphForRevisionUUID: r3 storeUUID: storeUUID]);
+    UKIntsEqual(1, cache.evictionCount);
+    UKIntsEqual(800, cache.totalCost);
+
+    cache.maxCost = 500;
+
+    UKNil([cache itemGraphForRevisionUUID: r1 storeUUID: storeUUID]);
+    UKNotNil([cache itemGraphForRevisionUUID: r3 storeUUID: storeUUID]);
+    UKIntsEqual(400, cache.totalCost);
+}
+
+- (void)testItemGraphExceedingMaxCostIsNotCached
+{
+    ETUUID *revisionUUID = [ETUUID UUID];
+
+    [cache setItemGraph: [self itemGraphWithLabel: @"a"]
+                   cost: 2000
+        forRevisionUUID: revisionUUID
+              storeUUID: storeUUID];
+
+    UKNil([cache itemGraphForRevisionUUID: revisionUUID storeUUID: storeUUID]);
+    UKIntsEqual(0, cache.totalCost);
+}
+
+- (void)testRemoveAllRevisionsForStoreUUID
+{
+    ETUUID *otherStoreUUID = [ETUUID UUID];
+    ETUUID *r1 = [ETUUID UUID];
+    ETUUID *r2 = [ETUUID UUID];
+
+    [cache setItemGraph: [self itemGraphWithLabel: @"1"] cost: 100 forRevisionUUID: r1 storeUUID: storeUUID];
+    [cache setItemGraph: [self itemGraphWithLabel: @"2"] cost: 100 forRevisionUUID: r2 storeUUID: otherStoreUUID];
+
+    [cache removeAllRevisionsForStoreUUID: storeUUID];
+
+    UKNil([cache itemGraphForRevisionUUID: r1 storeUUID: storeUUID]);
+    UKNotNil([cache itemGraphForRevisionUUID: r2 storeUUID: otherStoreUUID]);
+    UKIntsEqual(100, cache.totalCost);
+}
+
+- (void)testCompactionNotificationDiscardsStoreRevisions
+{
+    ETUUID *revisionUUID = [ETUUID UUID];
+
+    [cache setItemGraph: [self itemGraphWithLabel: @"a"]
+                   cost: 100
+        forRevisionUUID: revisionUUID
+              storeUUID: storeUUID];
+
+    [[NSNotificationCenter defaultCenter]
+        postNotificationName: COStorePersistentRootsDidChangeNotification
+                      object: nil
+                    userInfo: @{kCOStoreUUID: storeUUID.stringValue,
+                                kCOStoreCompactedPersistentRoots: @[[ETUUID UUID].stringValue],
+                                kCOStoreFinalizedPersistentRoots: @[]}];
+
+    UKNil([cache itemGraphForRevisionUUID: revisionUUID storeUUID: storeUUID]);
+    UKIntsEqual(0, cache.totalCost);
+}
+
+@end
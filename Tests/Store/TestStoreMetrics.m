@@ -0,0 +1,138 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "COStoreMetrics.h"
+#import "COSharedRevisionCache.h"
+#import "COJSONSerialization.h"
+
+@interface TestStoreMetrics : SQLiteStoreTestCase <UKTest>
+{
+    COStoreMetrics *metrics;
+}
+
+@end
+
+
+@implementation TestStoreMetrics
+
+- (instancetype)init
+{
+    SUPERINIT;
+    metrics = [COStoreMetrics new];
+    // Don't share cached revisions with the other tests
+    store.revisionCache = [[COSharedRevisionCache alloc] initWithMaxCost: 1024 * 1024];
+    return self;
+}
+
+- (void)testHistogramStatistics
+{
+    for (uint64_t i = 1; i <= 100; i++)
+    {
+        [metrics recordValue: i forMetric: COStoreMetricDeltaChainLength];
+    }
+
+    NSDictionary *statistics = [metrics statisticsForMetric: COStoreMetricDeltaChainLength];
+
+    UKIntsEqual(100, [metrics countForMetric: COStoreMetricDeltaChainLength]);
+    UKIntsEqual(5050, [statistics[@"sum"] longLongValue]);
+    UKIntsEqual(1, [statistics[@"min"] longLongValue]);
+    UKIntsEqual(100, [statistics[@"max"] longLongValue]);
+    // 50 is in the [32, 63] bucket, 99 in the [64, 127] bucket capped by the max
+    UKIntsEqual(63, [statistics[@"p50"] longLongValue]);
+    UKIntsEqual(100, [statistics[@"p99"] longLongValue]);
+    UKObjectsEqual(@{ @"count" : @0 }, [metrics statisticsForMetric: COStoreMetricCommitLatency]);
+    UKNil(metrics.statistics[COStoreMetricName(COStoreMetricCommitLatency)]);
+}
+
+- (void)testCountersAndHitRate
+{
+    [metrics incrementCounter: COStoreCounterRevisionCacheHits];
+    [metrics incrementCounter: COStoreCounterRevisionCacheHits];
+    [metrics incrementCounter: COStoreCounterRevisionCacheHits];
+    [metrics incrementCounter: COStoreCounterRevisionCacheMisses];
+
+    UKIntsEqual(3, [metrics valueForCounter: COStoreCounterRevisionCacheHits]);
+    UKObjectsEqual(@0.75, metrics.statistics[@"revisionCacheHitRate"]);
+
+    [metrics reset];
+
+    UKIntsEqual(0, [metrics valueForCounter: COStoreCounterRevisionCacheHits]);
+    UKNil(metrics.statistics[@"revisionCacheHitRate"]);
+}
+
+- (void)testSlowOperationsAreTraced
+{
+    [metrics recordDurationSince: COStoreMetricsNow() forMetric: COStoreMetricCommitLatency];
+
+    UKIntsEqual(1, [metrics countForMetric: COStoreMetricCommitLatency]);
+    UKIntsEqual(0, [metrics valueForCounter: COStoreCounterSlowOperations]);
+    UKTrue(metrics.traceEvents.isEmpty);
+
+    metrics.slowOperationThreshold = 0;
+    [metrics recordDurationSince: COStoreMetricsNow() forMetric: COStoreMetricCommitLatency];
+
+    UKIntsEqual(1, [metrics valueForCounter: COStoreCounterSlowOperations]);
+    UKIntsEqual(1, metrics.traceEvents.count);
+    UKObjectsEqual(@"commitLatency", metrics.traceEvents.firstObject[@"name"]);
+    UKObjectsEqual(@"X", metrics.traceEvents.firstObject[@"ph"]);
+}
+
+- (void)testTraceExport
+{
+    metrics.recordsTraceEvents = YES;
+    metrics.maxTraceEventCount = 2;
+
+    [metrics recordDurationSince: COStoreMetricsNow() forMetric: COStoreMetricSHA1Time];
+    [metrics recordDurationSince: COStoreMetricsNow() forMetric: COStoreMetricQueueWaitTime];
+    [metrics recordDurationSince: COStoreMetricsNow() forMetric: COStoreMetricFTSIndexingTime];
+
+    NSURL *traceURL = [[SQLiteStoreTestCase temporaryURLForTestStorage]
+        URLByAppendingPathComponent: @"TestStoreMetrics.json"];
+    UKTrue([metrics writeTraceToURL: traceURL error: NULL]);
+
+    NSDictionary *trace = COJSONObjectWithData([NSData dataWithContentsOfURL: traceURL], NULL);
+    NSArray *eventNames = [trace[@"traceEvents"] valueForKey: @"name"];
+
+    UKObjectsEqual(A(@"queueWaitTime", @"FTSIndexingTime"), eventNames);
+    UKIntsEqual(0, [metrics valueForCounter: COStoreCounterSlowOperations]);
+}
+
+- (void)testStoreCommitAndRead
+{
+    COMutableItem *rootItem = [COMutableItem item];
+    [rootItem setValue: @"hello" forAttribute: @"label" type: kCOTypeString];
+
+    COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+    COPersistentRootInfo *info =
+        [txn createPersistentRootWithInitialItemGraph: [COItemGraph itemGraphWithItemsRootFirst: @[rootItem]]
+                                                 UUID: [ETUUID UUID]
+                                           branchUUID: [ETUUID UUID]
+                                     revisionMetadata: nil
+                                        schemaVersion: 0];
+
+    UKTrue([store commitStoreTransaction: txn]);
+
+    COStoreMetrics *storeMetrics = store.metrics;
+
+    UKIntsEqual(1, [storeMetrics countForMetric: COStoreMetricCommitLatency]);
+    UKIntsEqual(1, [storeMetrics countForMetric: COStoreMetricCommitLockWaitTime]);
+    UKIntsEqual(1, [storeMetrics countForMetric: COStoreMetricFTSIndexingTime]);
+    UKTrue([storeMetrics countForMetric: COStoreMetricSHA1Time] >= 1);
+
+    [store itemGraphForRevisionUUID: info.currentRevisionUUID persistentRoot: info.UUID];
+    [store itemGraphForRevisionUUID: info.currentRevisionUUID persistentRoot: info.UUID];
+
+    UKIntsEqual(1, [storeMetrics valueForCounter: COStoreCounterRevisionCacheMisses]);
+    UKIntsEqual(1, [storeMetrics valueForCounter: COStoreCounterRevisionCacheHits]);
+    UKIntsEqual(1, [storeMetrics countForMetric: COStoreMetricDeltaChainLength]);
+    UKIntsEqual(1, [[storeMetrics statisticsForMetric: COStoreMetricDeltaChainLength][@"max"] longLongValue]);
+    UKIntsEqual(1, [[storeMetrics statisticsForMetric: COStoreMetricReconstructionRowCount][@"max"] longLongValue]);
+    UKTrue([[storeMetrics statisticsForMetric: COStoreMetricReconstructionByteCount][@"sum"] longLongValue] > 0);
+}
+
+@end
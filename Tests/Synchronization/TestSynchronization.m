@@ -235,6 +235,113 @@ static ETUUID *branchBUUID;
                    [self currentItemGraphForBranch: replicatedBranchA.UUID]);
 }
 
+- (ETUUID *)writeServerRevisionWithItemGraph: (COItemGraph *)anItemGraph
+                               parentRevision: (ETUUID *)aParent
+                                       branch: (ETUUID *)aBranch
+{
+    COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+    ETUUID *revisionUUID = [ETUUID UUID];
+
+    [txn writeRevisionWithModifiedItems: anItemGraph
+                           revisionUUID: revisionUUID
+                               metadata: nil
+                       parentRevisionID: aParent
+                  mergeParentRevisionID: nil
+                     persistentRootUUID: persistentRootUUID
+                             branchUUID: aBranch
+                          schemaVersion: 0];
+    [txn setCurrentRevision: revisionUUID
+               headRevision: revisionUUID
+                  forBranch: aBranch
+           ofPersistentRoot: persistentRootUUID];
+    serverChangeCount = [txn setOldTransactionID: serverChangeCount
+                               forPersistentRoot: persistentRootUUID];
+
+    UKTrue([serverStore commitStoreTransaction: txn]);
+    return revisionUUID;
+}
+
+- (void)testPullSendsDeltasForRevisionsClientLacks
+{
+    COSynchronizationClient *client = [[COSynchronizationClient alloc] init];
+    COSynchronizationServer *server = [[COSynchronizationServer alloc] init];
+    COMutableItem *childItem = [COMutableItem item];
+    COMutableItem *rootItem = [[[self itemGraphWithLabel: @"1"] itemForUUID: rootItemUUID] mutableCopy];
+
+    [childItem setValue: @"child" forAttribute: @"label" type: kCOTypeString];
+    [rootItem setValue: @[childItem.UUID] forAttribute: @"contents" type: kCOTypeCompositeReference | kCOTypeArray];
+
+    COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+    COPersistentRootInfo *serverInfo =
+        [txn createPersistentRootWithInitialItemGraph: [COItemGraph itemGraphWithItemsRootFirst: @[rootItem, childItem]]
+                                                 UUID: persistentRootUUID
+                                           branchUUID: branchAUUID
+                                     revisionMetadata: nil
+                                        schemaVersion: 0];
+    serverChangeCount = [txn setOldTransactionID: -1 forPersistentRoot: persistentRootUUID];
+    UKTrue([serverStore commitStoreTransaction: txn]);
+
+    [client handleUpdateResponse: [server handleUpdateRequest: [client updateRequestForPersistentRoot: persistentRootUUID
+                                                                                             serverID: @"server"
+                                                                                                store: store]
+                                                        store: serverStore]
+                           store: store];
+
+    // Server commits rev2 and rev3 on branch A, touching the root item only
+
+    [rootItem setValue: @"2" forAttribute: @"label"];
+    ETUUID *rev2 = [self writeServerRevisionWithItemGraph: [COItemGraph itemGraphWithItemsRootFirst: @[rootItem]]
+                                           parentRevision: serverInfo.currentRevisionUUID
+                                                   branch: branchAUUID];
+    [rootItem setValue: @"3" forAttribute: @"label"];
+    ETUUID *rev3 = [self writeServerRevisionWithItemGraph: [COItemGraph itemGraphWithItemsRootFirst: @[rootItem]]
+                                           parentRevision: rev2
+                                                   branch: branchAUUID];
+
+    id request = [client updateRequestForPersistentRoot: persistentRootUUID
+                                               serverID: @"server"
+                                                  store: store];
+    id response = [server handleUpdateRequest: request store: serverStore];
+
+    UKObjectsEqual(S(rev2.stringValue, rev3.stringValue), SA([response[@"revisions"] allKeys]));
+    UKIntsEqual(1, COItemGraphFromJSONPropertyLisy(response[@"revisions"][rev3.stringValue][@"graph"]).itemUUIDs.count);
+
+    [client handleUpdateResponse: response store: store];
+
+    // Server branches from rev2, which the client has but isn't a client head
+
+    txn = [[COStoreTransaction alloc] init];
+    [txn createBranchWithUUID: branchBUUID
+                 parentBranch: nil
+              initialRevision: rev2
+            forPersistentRoot: persistentRootUUID];
+    serverChangeCount = [txn setOldTransactionID: serverChangeCount
+                               forPersistentRoot: persistentRootUUID];
+    UKTrue([serverStore commitStoreTransaction: txn]);
+
+    [rootItem setValue: @"4" forAttribute: @"label"];
+    ETUUID *rev4 = [self writeServerRevisionWithItemGraph: [COItemGraph itemGraphWithItemsRootFirst: @[rootItem]]
+                                           parentRevision: rev2
+                                                   branch: branchBUUID];
+
+    request = [client updateRequestForPersistentRoot: persistentRootUUID
+                                            serverID: @"server"
+                                               store: store];
+    response = [server handleUpdateRequest: request store: serverStore];
+
+    UKObjectsEqual(S(rev4.stringValue), SA([response[@"revisions"] allKeys]));
+
+    [client handleUpdateResponse: response store: store];
+
+    COPersistentRootInfo *clientInfo = [store persistentRootInfoForUUID: persistentRootUUID];
+    COBranchInfo *replicatedBranchB = [[clientInfo branchInfosWithMetadataValue: [branchBUUID stringValue]
+                                                                         forKey: @"replicatedBranch"] firstObject];
+
+    UKObjectsEqual(rev4, replicatedBranchB.currentRevisionUUID);
+    UKObjectsEqual([COItemGraph itemGraphWithItemsRootFirst: @[rootItem, childItem]],
+                   [self currentItemGraphForBranch: replicatedBranchB.UUID]);
+}
+
 // This test broke when I added the constraint that writing a revision fails if
 // the parent or merge parent is not in the store
 #if 0
@@ -0,0 +1,414 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "COSynchronizerBinaryUtils.h"
+#import "COItem+Binary.h"
+#import "COSynchronizerRevision.h"
+#import "COSynchronizerPushedRevisionsToClientMessage.h"
+
+@interface TestSynchronizerBinaryTransportDelegate : NSObject <COSynchronizerBinaryClientDelegate, COSynchronizerBinaryServerDelegate>
+
+@property (nonatomic, readwrite, weak) COSynchronizerBinaryServer *server;
+@property (nonatomic, readwrite, weak) COSynchronizerBinaryClient *client1;
+@property (nonatomic, readwrite, weak) COSynchronizerBinaryClient *client2;
+/**
+ * When not zero, the data is delivered in chunks of this length to simulate
+ * a stream transport.
+ */
+@property (nonatomic, readwrite, assign) NSUInteger chunkLength;
+
+@end
+
+
+@implementation TestSynchronizerBinaryTransportDelegate
+
+@synthesize server, client1, client2, chunkLength;
+
+- (void)enumerateChunksOfData: (NSData *)data usingBlock: (void (^)(NSData *chunk))aBlock
+{
+    if (chunkLength == 0)
+    {
+        aBlock(data);
+        return;
+    }
+
+    for (NSUInteger i = 0; i < data.length; i += chunkLength)
+    {
+        aBlock([data subdataWithRange: NSMakeRange(i, MIN(chunkLength, data.length - i))]);
+    }
+}
+
+- (void)binaryServer: (COSynchronizerBinaryServer *)server
+            sendData: (NSData *)data
+            toClient: (NSString *)client
+{
+    ETAssert(self.client1 != nil);
+    ETAssert(self.client2 != nil);
+    COSynchronizerBinaryClient *binaryClient = nil;
+
+    if ([client isEqualToString: @"client1"])
+    {
+        binaryClient = self.client1;
+    }
+    else if ([client isEqualToString: @"client2"])
+    {
+        binaryClient = self.client2;
+    }
+    else
+    {
+        ETAssertUnreachable();
+    }
+
+    [self enumerateChunksOfData: data usingBlock: ^(NSData *chunk)
+    {
+        [binaryClient receiveDataFromServer: chunk];
+    }];
+}
+
+- (void)binaryClient: (COSynchronizerBinaryClient *)client sendDataToServer: (NSData *)data
+{
+    ETAssert(self.server != nil);
+    [self enumerateChunksOfData: data usingBlock: ^(NSData *chunk)
+    {
+        [self.server receiveData: chunk fromClient: client.client.clientID];
+    }];
+}
+
+- (void)binaryClient: (COSynchronizerBinaryClient *)client didStartSharingOnBranch: (COBranch *)aBranch
+{
+}
+
+@end
+
+
+@interface TestSynchronizerBinaryTransport : EditingContextTestCase <UKTest>
+{
+    TestSynchronizerBinaryTransportDelegate *transportDelegate;
+    COSynchronizerBinaryServer *binaryServer;
+    COSynchronizerBinaryClient *binaryClient1;
+    COSynchronizerBinaryClient *binaryClient2;
+
+    COSynchronizerServer *server;
+    COSynchronizerClient *client1;
+    COSynchronizerClient *client2;
+
+    COEditingContext *client1Ctx;
+    COEditingContext *client2Ctx;
+}
+
+@end
+
+#define CLIENT1_STORE_URL [[SQLiteStoreTestCase temporaryURLForTestStorage] URLByAppendingPathComponent: @"TestStore2.sqlite"]
+#define CLIENT2_STORE_URL [[SQLiteStoreTestCase temporaryURLForTestStorage] URLByAppendingPathComponent: @"TestStore3.sqlite"]
+
+@implementation TestSynchronizerBinaryTransport
+
+- (instancetype)init
+{
+    SUPERINIT;
+
+    [[[COSQLiteStore alloc] initWithURL: CLIENT1_STORE_URL] clearStore];
+    [[[COSQLiteStore alloc] initWithURL: CLIENT2_STORE_URL] clearStore];
+
+    COPersistentRoot *serverPersistentRoot = [ctx insertNewPersistentRootWithEntityName: @"UnorderedGroupNoOpposite"];
+    [ctx commit];
+
+    server = [[COSynchronizerServer alloc] initWithBranch: serverPersistentRoot.currentBranch];
+
+    client1Ctx = [COEditingContext contextWithURL: CLIENT1_STORE_URL];
+    client1 = [[COSynchronizerClient alloc] initWithClientID: @"client1"
+                                              editingContext: client1Ctx];
+
+    client2Ctx = [COEditingContext contextWithURL: CLIENT2_STORE_URL];
+    client2 = [[COSynchronizerClient alloc] initWithClientID: @"client2"
+                                              editingContext: client2Ctx];
+
+    transportDelegate = [TestSynchronizerBinaryTransportDelegate new];
+    binaryServer = [COSynchronizerBinaryServer new];
+    binaryClient1 = [COSynchronizerBinaryClient new];
+    binaryClient2 = [COSynchronizerBinaryClient new];
+
+    transportDelegate.server = binaryServer;
+    transportDelegate.client1 = binaryClient1;
+    transportDelegate.client2 = binaryClient2;
+
+    binaryServer.delegate = transportDelegate;
+    binaryServer.server = server;
+
+    binaryClient1.delegate = transportDelegate;
+    binaryClient1.client = client1;
+
+    binaryClient2.delegate = transportDelegate;
+    binaryClient2.client = client2;
+
+    server.delegate = binaryServer;
+    client1.delegate = binaryClient1;
+    client2.delegate = binaryClient2;
+
+    [server addClientID: @"client1"];
+    [server addClientID: @"client2"];
+
+    ETAssert(client1.persistentRoot != nil);
+    ETAssert(client2.persistentRoot != nil);
+
+    return self;
+}
+
+- (UnorderedGroupNoOpposite *)addAndCommitServerChild
+{
+    UnorderedGroupNoOpposite *serverChild1 = [server.persistentRoot.objectGraphContext insertObjectWithEntityName: @"UnorderedGroupNoOpposite"];
+    [[server.persistentRoot.rootObject mutableSetValueForKey: @"contents"] addObject: serverChild1];
+    [server.persistentRoot commit];
+    return serverChild1;
+}
+
+- (UnorderedGroupNoOpposite *)addAndCommitClient1Child
+{
+    UnorderedGroupNoOpposite *clientChild1 = [client1.persistentRoot.objectGraphContext insertObjectWithEntityName: @"UnorderedGroupNoOpposite"];
+    [[client1.persistentRoot.rootObject mutableSetValueForKey: @"contents"] addObject: clientChild1];
+    [client1.persistentRoot commit];
+    return clientChild1;
+}
+
+- (void)testServerAndClientEdits
+{
+    UnorderedGroupNoOpposite *serverChild1 = [self addAndCommitServerChild];
+    UnorderedGroupNoOpposite *clientChild1 = [self addAndCommitClient1Child];
+
+    UKObjectsEqual(S(serverChild1.UUID, clientChild1.UUID),
+                   [[server.persistentRoot.rootObject contents] valueForKey: @"UUID"]);
+    UKObjectsEqual(S(serverChild1.UUID, clientChild1.UUID),
+                   [[client1.persistentRoot.rootObject contents] valueForKey: @"UUID"]);
+    UKObjectsEqual(S(serverChild1.UUID, clientChild1.UUID),
+                   [[client2.persistentRoot.rootObject contents] valueForKey: @"UUID"]);
+}
+
+- (void)testCompressedMessagesReceivedInChunks
+{
+    transportDelegate.chunkLength = 7;
+    binaryServer.compressesMessages = YES;
+    binaryClient1.compressesMessages = YES;
+
+    for (NSUInteger i = 0; i < 20; i++)
+    {
+        [self addAndCommitServerChild];
+        [self addAndCommitClient1Child];
+    }
+
+    UKIntsEqual(40, [[server.persistentRoot.rootObject contents] count]);
+    UKIntsEqual(40, [[client1.persistentRoot.rootObject contents] count]);
+    UKIntsEqual(40, [[client2.persistentRoot.rootObject contents] count]);
+}
+
+- (void)testClientEditWhilePausedAndServerReceivingWhilePaused
+{
+    binaryClient1.paused = YES;
+    binaryServer.paused = YES;
+
+    [self addAndCommitClient1Child];
+
+    binaryClient1.paused = NO;
+
+    UKIntsEqual(0, [[server.persistentRoot.rootObject contents] count]);
+
+    binaryServer.paused = NO;
+
+    UKIntsEqual(1, [[server.persistentRoot.rootObject contents] count]);
+}
+
+- (COSynchronizerPushedRevisionsToClientMessage *)pushMessageWithLabelLength: (NSUInteger)aLength
+{
+    COMutableItem *item = [COMutableItem item];
+    NSString *label = [@"" stringByPaddingToLength: aLength withString: @"label " startingAtIndex: 0];
+
+    [item setValue: label forAttribute: @"label" type: kCOTypeString];
+    [item setValue: @(-300) forAttribute: @"count" type: kCOTypeInt64];
+    [item setValue: [COPath pathWithPersistentRoot: [ETUUID UUID] branch: [ETUUID UUID]]
+      forAttribute: @"link"
+              type: kCOTypeReference];
+
+    COSynchronizerRevision *revision =
+        [[COSynchronizerRevision alloc] initWithModifiedItems: [COItemGraph itemGraphWithItemsRootFirst: @[item]]
+                                                 revisionUUID: [ETUUID UUID]
+                                           parentRevisionUUID: [ETUUID UUID]
+                                                schemaVersion: 3
+                                                     metadata: @{@"key": @"value"}
+                                                         date: [NSDate dateWithTimeIntervalSince1970: 1000]];
+    COSynchronizerPushedRevisionsToClientMessage *message = [COSynchronizerPushedRevisionsToClientMessage new];
+    message.revisions = @[revision];
+    return message;
+}
+
+- (void)testFrameRoundTrip
+{
+    COSynchronizerPushedRevisionsToClientMessage *message = [self pushMessageWithLabelLength: 4000];
+    COSynchronizerRevision *revision = message.revisions[0];
+    NSData *frame = [COSynchronizerBinaryUtils frameWithMessage: message compressed: NO];
+    NSData *compressedFrame = [COSynchronizerBinaryUtils frameWithMessage: message compressed: YES];
+
+    UKTrue(compressedFrame.length < frame.length);
+
+    for (NSData *data in @[frame, compressedFrame])
+    {
+        UKIntsEqual(data.length, [COSynchronizerBinaryUtils lengthOfFrameInBytes: data.bytes
+                                                                          length: data.length]);
+
+        COSynchronizerPushedRevisionsToClientMessage *decodedMessage =
+            [COSynchronizerBinaryUtils messageWithFrame: data];
+        COSynchronizerRevision *decodedRevision = decodedMessage.revisions[0];
+
+        UKObjectKindOf(decodedMessage, COSynchronizerPushedRevisionsToClientMessage);
+        UKIntsEqual(1, decodedMessage.revisions.count);
+        UKObjectsEqual(revision.revisionUUID, decodedRevision.revisionUUID);
+        UKObjectsEqual(revision.parentRevisionUUID, decodedRevision.parentRevisionUUID);
+        UKIntsEqual(3, decodedRevision.schemaVersion);
+        UKObjectsEqual(revision.metadata, decodedRevision.metadata);
+        UKObjectsEqual(revision.date, decodedRevision.date);
+        UKObjectsEqual(revision.modifiedItems, decodedRevision.modifiedItems);
+    }
+}
+
+- (void)testDecodedItemsOutliveFrame
+{
+    COSynchronizerPushedRevisionsToClientMessage *message = [self pushMessageWithLabelLength: 4000];
+    COItemGraph *modifiedItems = [message.revisions[0] modifiedItems];
+    NSData *expectedData = [modifiedItems itemForUUID: modifiedItems.rootItemUUID].dataValue;
+    COItem *decodedItem = nil;
+
+    for (NSNumber *compressed in @[@NO, @YES])
+    {
+        @autoreleasepool
+        {
+            NSMutableData *frame = [[COSynchronizerBinaryUtils frameWithMessage: message
+                                                                     compressed: compressed.boolValue] mutableCopy];
+            COSynchronizerPushedRevisionsToClientMessage *decodedMessage =
+                [COSynchronizerBinaryUtils messageWithFrame: frame];
+            COItemGraph *decodedItems = [decodedMessage.revisions[0] modifiedItems];
+
+            decodedItem = [decodedItems itemForUUID: decodedItems.rootItemUUID];
+            // Overwrite the frame before releasing it
+            memset(frame.mutableBytes, 0, frame.length);
+        }
+
+        UKObjectsEqual(expectedData, decodedItem.dataValue);
+        UKObjectsEqual([modifiedItems itemForUUID: modifiedItems.rootItemUUID],
+                       [[COItem alloc] initWithData: decodedItem.dataValue]);
+    }
+}
+
+- (void)testSmallMessageNotCompressed
+{
+    COSynchronizerPushedRevisionsToClientMessage *message = [self pushMessageWithLabelLength: 10];
+
+    UKObjectsEqual([COSynchronizerBinaryUtils frameWithMessage: message compressed: NO],
+                   [COSynchronizerBinaryUtils frameWithMessage: message compressed: YES]);
+}
+
+- (void)testIncompleteOrCorruptedFrame
+{
+    NSData *frame = [COSynchronizerBinaryUtils frameWithMessage: [self pushMessageWithLabelLength: 10]
+                                                     compressed: NO];
+    NSData *truncatedFrame = [frame subdataWithRange: NSMakeRange(0, frame.length - 1)];
+    NSMutableData *corruptedFrame = [frame mutableCopy];
+
+    // Change the message type
+    ((unsigned char *)corruptedFrame.mutableBytes)[COSynchronizerBinaryFrameLengthPrefixSize + 1] = 0xFF;
+
+    UKIntsEqual(0, [COSynchronizerBinaryUtils lengthOfFrameInBytes: truncatedFrame.bytes
+                                                            length: truncatedFrame.length]);
+    UKNil([COSynchronizerBinaryUtils messageWithFrame: truncatedFrame]);
+    UKNil([COSynchronizerBinaryUtils messageWithFrame: corruptedFrame]);
+}
+
+- (void)testFrameWithMalformedItemData
+{
+    COSynchronizerPushedRevisionsToClientMessage *message = [self pushMessageWithLabelLength: 10];
+    COItemGraph *modifiedItems = [message.revisions[0] modifiedItems];
+    NSData *itemData = [modifiedItems itemForUUID: modifiedItems.rootItemUUID].dataValue;
+    NSMutableData *frame = [[COSynchronizerBinaryUtils frameWithMessage: message compressed: NO] mutableCopy];
+    const NSUInteger itemLocation = [frame rangeOfData: itemData
+                                               options: 0
+                                                 range: NSMakeRange(0, frame.length)].location;
+    NSError *error = nil;
+
+    UKIntsNotEqual(NSNotFound, itemLocation);
+    // An unknown token that COItem would raise on
+    ((unsigned char *)frame.mutableBytes)[itemLocation] = 'X';
+
+    UKNil([COSynchronizerBinaryUtils messageWithFrame: frame error: &error]);
+    UKIntsEqual(kCOCorruptedDataError, error.code);
+}
+
+- (void)testCompressedFrameWithOversizedPayloadLength
+{
+    NSMutableData *frame = [[COSynchronizerBinaryUtils frameWithMessage: [self pushMessageWithLabelLength: 4000]
+                                                             compressed: YES] mutableCopy];
+    unsigned char *lengthBytes = (unsigned char *)frame.mutableBytes + COSynchronizerBinaryFrameLengthPrefixSize + 1;
+    NSError *error = nil;
+
+    // Announce a 4 GB uncompressed payload
+    memset(lengthBytes, 0xFF, 4);
+
+    UKNil([COSynchronizerBinaryUtils messageWithFrame: frame error: &error]);
+    UKIntsEqual(kCOCorruptedDataError, error.code);
+}
+
+- (void)testFrameWithUnknownFlags
+{
+    NSMutableData *frame = [[COSynchronizerBinaryUtils frameWithMessage: [self pushMessageWithLabelLength: 10]
+                                                             compressed: NO] mutableCopy];
+
+    // A flag that a newer protocol version could add
+    ((unsigned char *)frame.mutableBytes)[COSynchronizerBinaryFrameLengthPrefixSize] |= 0x80;
+
+    UKNil([COSynchronizerBinaryUtils messageWithFrame: frame]);
+}
+
+- (void)testFrameForProtocolVersion1
+{
+    COSynchronizerPushedRevisionsToClientMessage *message = [self pushMessageWithLabelLength: 10];
+    COItemGraph *modifiedItems = [message.revisions[0] modifiedItems];
+    COItem *item = [modifiedItems itemForUUID: modifiedItems.rootItemUUID];
+    NSData *frame = [COSynchronizerBinaryUtils frameWithMessage: message
+                                                     compressed: NO
+                                                protocolVersion: 1];
+    const NSRange frameRange = NSMakeRange(0, frame.length);
+
+    // Version 1 peers raise on binary paths, and don't know the flag telling
+    // that the items contain some
+    UKIntsEqual(0, ((const unsigned char *)frame.bytes)[COSynchronizerBinaryFrameLengthPrefixSize]);
+    UKIntsEqual(NSNotFound, [frame rangeOfData: item.dataValue options: 0 range: frameRange].location);
+    UKIntsNotEqual(NSNotFound, [frame rangeOfData: item.dataValueWithPathsWrittenAsStrings
+                                          options: 0
+                                            range: frameRange].location);
+
+    COSynchronizerPushedRevisionsToClientMessage *decodedMessage =
+        [COSynchronizerBinaryUtils messageWithFrame: frame];
+
+    UKObjectsEqual(modifiedItems, [decodedMessage.revisions[0] modifiedItems]);
+    UKRaisesException([COSynchronizerBinaryUtils frameWithMessage: message
+                                                       compressed: NO
+                                                  protocolVersion: COSynchronizerBinaryProtocolVersion + 1]);
+}
+
+- (void)testRevisionEncodingDiscardedOnChange
+{
+    COSynchronizerPushedRevisionsToClientMessage *message = [self pushMessageWithLabelLength: 10];
+    COSynchronizerRevision *revision = message.revisions[0];
+
+    [COSynchronizerBinaryUtils frameWithMessage: message compressed: NO];
+    revision.metadata = @{@"key": @"other value"};
+
+    NSData *frame = [COSynchronizerBinaryUtils frameWithMessage: message compressed: NO];
+    COSynchronizerPushedRevisionsToClientMessage *decodedMessage =
+        [COSynchronizerBinaryUtils messageWithFrame: frame];
+
+    UKObjectsEqual(@{@"key": @"other value"}, [decodedMessage.revisions[0] metadata]);
+}
+
+@end
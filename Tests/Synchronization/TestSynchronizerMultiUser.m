@@ -188,5 +188,45 @@
                    SA([client2Branch.rootObject valueForKeyPath: @"contents.UUID"]));
 }
 
-@end
+- (void)testServerEditSentAsOneMessageToClients
+{
+    [self addAndCommitServerChild];
+
+    UKIntsEqual(1, [self client1Messages].count);
+    UKIntsEqual(1, [self client2Messages].count);
+    UKObjectKindOf([self client1Messages][0], COSynchronizerPushedRevisionsToClientMessage);
+    UKObjectsSame([self client1Messages][0], [self client2Messages][0]);
+}
+
+- (void)testResponseAndPushShareRevisions
+{
+    [self addAndCommitClient1Child];
+    [transport deliverMessagesToServer];
+
+    UKIntsEqual(1, [self client1Messages].count);
+    UKIntsEqual(1, [self client2Messages].count);
+
+    COSynchronizerResponseToClientForSentRevisionsMessage *response = [self client1Messages][0];
+    COSynchronizerPushedRevisionsToClientMessage *push = [self client2Messages][0];
 
+    UKObjectKindOf(response, COSynchronizerResponseToClientForSentRevisionsMessage);
+    UKObjectKindOf(push, COSynchronizerPushedRevisionsToClientMessage);
+    UKIntsEqual(1, push.revisions.count);
+    UKObjectsSame(response.revisions.lastObject, push.revisions.lastObject);
+    UKObjectsSame([response.revisions.lastObject propertyList], [push.revisions.lastObject propertyList]);
+}
+
+- (void)testSharedRevisionPropertyListIsImmutable
+{
+    [self addAndCommitClient1Child];
+    [transport deliverMessagesToServer];
+
+    COSynchronizerPushedRevisionsToClientMessage *push = [self client2Messages][0];
+    NSMutableDictionary *propertyList = [push.revisions.lastObject propertyList];
+    NSMutableDictionary *modifiedItems = propertyList[@"modifiedItems"];
+
+    UKRaisesException([propertyList setObject: @"other" forKey: @"revisionUUID"]);
+    UKRaisesException([modifiedItems removeAllObjects]);
+}
+
+@end
@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <UnitKit/UnitKit.h>
+#import <Foundation/Foundation.h>
+#import "TestCommon.h"
+#import "COSynchronizerUtils.h"
+
+@interface TestSynchronizerUtils : EditingContextTestCase <UKTest>
+{
+    COPersistentRoot *persistentRoot;
+    COBranch *sourceBranch;
+    COBranch *destBranch;
+    ETUUID *child1UUID;
+    ETUUID *child2UUID;
+    CORevision *lcaRevision;
+}
+
+@end
+
+
+@implementation TestSynchronizerUtils
+
+/**
+ * Commits the common ancestor, a root containing child1 and child2, then
+ * creates a branch for each side of the rebase.
+ */
+- (instancetype)init
+{
+    SUPERINIT;
+    persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    sourceBranch = persistentRoot.currentBranch;
+
+    OutlineItem *child1 = [[OutlineItem alloc] initWithObjectGraphContext: persistentRoot.objectGraphContext];
+    OutlineItem *child2 = [[OutlineItem alloc] initWithObjectGraphContext: persistentRoot.objectGraphContext];
+    [persistentRoot.rootObject setContents: @[child1, child2]];
+    [ctx commit];
+
+    child1UUID = child1.UUID;
+    child2UUID = child2.UUID;
+    lcaRevision = sourceBranch.currentRevision;
+    destBranch = [sourceBranch makeBranchWithLabel: @"dest"];
+    [ctx commit];
+    return self;
+}
+
+- (OutlineItem *)objectWithUUID: (ETUUID *)aUUID inBranch: (COBranch *)aBranch
+{
+    return (OutlineItem *)[aBranch.objectGraphContext loadedObjectForUUID: aUUID];
+}
+
+- (NSArray *)rebaseSourceBranchOntoDestBranch
+{
+    COStoreTransaction *txn = [[COStoreTransaction alloc] init];
+    NSArray *rebasedRevs = [COSynchronizerUtils rebaseRevision: sourceBranch.currentRevision.UUID
+                                                  ontoRevision: destBranch.currentRevision.UUID
+                                                commonAncestor: lcaRevision.UUID
+                                            persistentRootUUID: persistentRoot.UUID
+                                                    branchUUID: destBranch.UUID
+                                                         store: store
+                                                   transaction: txn
+                                                editingContext: ctx
+                                    modelDescriptionRepository: ctx.modelDescriptionRepository];
+    UKTrue([store commitStoreTransaction: txn]);
+    return rebasedRevs;
+}
+
+- (NSSet *)modifiedItemUUIDsInRevisionUUID: (ETUUID *)aRevision parentRevisionUUID: (ETUUID *)aParent
+{
+    COItemGraph *delta = [store partialItemGraphFromRevisionUUID: aParent
+                                                  toRevisionUUID: aRevision
+                                                  persistentRoot: persistentRoot.UUID];
+    return [NSSet setWithArray: delta.itemUUIDs];
+}
+
+- (void)testRebaseWritesOnlyTouchedItems
+{
+    [self objectWithUUID: child1UUID inBranch: sourceBranch].label = @"source";
+    [ctx commit];
+    [sourceBranch.rootObject setLabel: @"source root"];
+    [ctx commit];
+    OutlineItem *child3 = [[OutlineItem alloc] initWithObjectGraphContext: sourceBranch.objectGraphContext];
+    [[self objectWithUUID: child1UUID inBranch: sourceBranch] setContents: @[child3]];
+    [ctx commit];
+
+    [self objectWithUUID: child2UUID inBranch: destBranch].label = @"dest";
+    [ctx commit];
+    OutlineItem *child4 = [[OutlineItem alloc] initWithObjectGraphContext: destBranch.objectGraphContext];
+    [destBranch.rootObject setContents: [[destBranch.rootObject contents] arrayByAddingObject: child4]];
+    [ctx commit];
+
+    ETUUID *destRevUUID = destBranch.currentRevision.UUID;
+    ETUUID *rootUUID = [destBranch.rootObject UUID];
+    NSArray *rebasedRevs = [self rebaseSourceBranchOntoDestBranch];
+
+    UKIntsEqual(3, rebasedRevs.count);
+    UKObjectsEqual(S(child1UUID),
+                   [self modifiedItemUUIDsInRevisionUUID: rebasedRevs[0] parentRevisionUUID: destRevUUID]);
+    UKObjectsEqual(S(rootUUID),
+                   [self modifiedItemUUIDsInRevisionUUID: rebasedRevs[1] parentRevisionUUID: rebasedRevs[0]]);
+    UKObjectsEqual(S(child1UUID, child3.UUID),
+                   [self modifiedItemUUIDsInRevisionUUID: rebasedRevs[2] parentRevisionUUID: rebasedRevs[1]]);
+
+    COItemGraph *result = [store itemGraphForRevisionUUID: rebasedRevs.lastObject
+                                           persistentRoot: persistentRoot.UUID];
+    COItem *rootItem = [result itemForUUID: rootUUID];
+    COItem *child1Item = [result itemForUUID: child1UUID];
+
+    UKObjectsEqual(@"source root", [rootItem valueForAttribute: @"label"]);
+    UKObjectsEqual(A(child1UUID, child2UUID, child4.UUID), [rootItem valueForAttribute: @"contents"]);
+    UKObjectsEqual(@"source", [child1Item valueForAttribute: @"label"]);
+    UKObjectsEqual(A(child3.UUID), [child1Item valueForAttribute: @"contents"]);
+    UKObjectsEqual(@"dest", [[result itemForUUID: child2UUID] valueForAttribute: @"label"]);
+}
+
+- (void)testRebaseConflictFavoursSource
+{
+    [self objectWithUUID: child1UUID inBranch: sourceBranch].label = @"source";
+    [ctx commit];
+
+    [self objectWithUUID: child1UUID inBranch: destBranch].label = @"dest";
+    [ctx commit];
+
+    NSArray *rebasedRevs = [self rebaseSourceBranchOntoDestBranch];
+    COItemGraph *result = [store itemGraphForRevisionUUID: rebasedRevs.lastObject
+                                           persistentRoot: persistentRoot.UUID];
+
+    UKIntsEqual(1, rebasedRevs.count);
+    UKObjectsEqual(@"source", [[result itemForUUID: child1UUID] valueForAttribute: @"label"]);
+}
+
+@end
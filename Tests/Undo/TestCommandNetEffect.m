@@ -0,0 +1,133 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "COCommandNetEffect.h"
+#import "COCommandDeletePersistentRoot.h"
+#import "COCommandUndeletePersistentRoot.h"
+#import "COCommandSetCurrentVersionForBranch.h"
+
+@interface TestCommandNetEffect : NSObject <UKTest>
+{
+    COCommandNetEffect *netEffect;
+    ETUUID *persistentRootUUID;
+    ETUUID *branchUUID;
+}
+
+@end
+
+
+@implementation TestCommandNetEffect
+
+- (instancetype)init
+{
+    SUPERINIT;
+    netEffect = [COCommandNetEffect new];
+    persistentRootUUID = [ETUUID UUID];
+    branchUUID = [ETUUID UUID];
+    return self;
+}
+
+- (COCommandSetCurrentVersionForBranch *)setVersionFrom: (ETUUID *)oldRevisionUUID
+                                                     to: (ETUUID *)revisionUUID
+                                               inBranch: (ETUUID *)aBranchUUID
+{
+    COCommandSetCurrentVersionForBranch *command = [COCommandSetCurrentVersionForBranch new];
+    command.persistentRootUUID = persistentRootUUID;
+    command.branchUUID = aBranchUUID;
+    command.oldRevisionUUID = oldRevisionUUID;
+    command.revisionUUID = revisionUUID;
+    command.oldHeadRevisionUUID = oldRevisionUUID;
+    command.headRevisionUUID = revisionUUID;
+    return command;
+}
+
+- (COCommand *)persistentRootCommandOfClass: (Class)aClass
+{
+    COCommand *command = [aClass new];
+    command.persistentRootUUID = persistentRootUUID;
+    return command;
+}
+
+- (void)testChainedVersionChangesPerBranch
+{
+    ETUUID *r0 = [ETUUID UUID], *r1 = [ETUUID UUID], *r2 = [ETUUID UUID];
+    ETUUID *s0 = [ETUUID UUID], *s1 = [ETUUID UUID];
+    ETUUID *otherBranchUUID = [ETUUID UUID];
+    COCommandSetCurrentVersionForBranch *first = [self setVersionFrom: r0 to: r1 inBranch: branchUUID];
+
+    [netEffect addCommand: first withRevisionMetadata: @{ @"node" : @1 }];
+    [netEffect addCommand: [self setVersionFrom: s0 to: s1 inBranch: otherBranchUUID]
+     withRevisionMetadata: @{ @"node" : @2 }];
+    [netEffect addCommand: [self setVersionFrom: r1 to: r2 inBranch: branchUUID]
+     withRevisionMetadata: @{ @"node" : @3 }];
+
+    UKIntsEqual(2, netEffect.commands.count);
+
+    COCommandSetCurrentVersionForBranch *composed = netEffect.commands.firstObject;
+
+    UKObjectsEqual(r0, composed.oldRevisionUUID);
+    UKObjectsEqual(r2, composed.revisionUUID);
+    UKObjectsEqual(r2, composed.headRevisionUUID);
+    UKObjectsEqual(r1, first.revisionUUID);
+
+    NSMutableArray *metadata = [NSMutableArray new];
+    [netEffect enumerateCommandsUsingBlock: ^(COCommand *command, NSDictionary *md)
+    {
+        [metadata addObject: md[@"node"]];
+    }];
+    UKObjectsEqual(A(@3, @2), metadata);
+}
+
+- (void)testVersionChangesBackToStartHaveNoEffect
+{
+    ETUUID *r0 = [ETUUID UUID], *r1 = [ETUUID UUID];
+
+    [netEffect addCommand: [self setVersionFrom: r0 to: r1 inBranch: branchUUID] withRevisionMetadata: nil];
+    [netEffect addCommand: [self setVersionFrom: r1 to: r0 inBranch: branchUUID] withRevisionMetadata: nil];
+
+    UKTrue([netEffect.commands isEmpty]);
+}
+
+- (void)testUnchainedVersionChangesAreKept
+{
+    ETUUID *r0 = [ETUUID UUID], *r1 = [ETUUID UUID], *r2 = [ETUUID UUID], *r3 = [ETUUID UUID];
+
+    [netEffect addCommand: [self setVersionFrom: r0 to: r1 inBranch: branchUUID] withRevisionMetadata: nil];
+    [netEffect addCommand: [self setVersionFrom: r2 to: r3 inBranch: branchUUID] withRevisionMetadata: nil];
+
+    UKIntsEqual(2, netEffect.commands.count);
+}
+
+- (void)testDeletionAndUndeletionCancelOut
+{
+    ETUUID *r0 = [ETUUID UUID], *r1 = [ETUUID UUID];
+
+    [netEffect addCommand: [self setVersionFrom: r0 to: r1 inBranch: branchUUID] withRevisionMetadata: nil];
+    [netEffect addCommand: [self persistentRootCommandOfClass: [COCommandDeletePersistentRoot class]]
+     withRevisionMetadata: nil];
+    [netEffect addCommand: [self persistentRootCommandOfClass: [COCommandUndeletePersistentRoot class]]
+     withRevisionMetadata: nil];
+
+    UKIntsEqual(1, netEffect.commands.count);
+    UKTrue([netEffect.commands.firstObject isKindOfClass: [COCommandSetCurrentVersionForBranch class]]);
+}
+
+- (void)testPersistentRootCommandEndsBranchComposition
+{
+    ETUUID *r0 = [ETUUID UUID], *r1 = [ETUUID UUID], *r2 = [ETUUID UUID];
+
+    [netEffect addCommand: [self setVersionFrom: r0 to: r1 inBranch: branchUUID] withRevisionMetadata: nil];
+    [netEffect addCommand: [self persistentRootCommandOfClass: [COCommandUndeletePersistentRoot class]]
+     withRevisionMetadata: nil];
+    [netEffect addCommand: [self setVersionFrom: r1 to: r2 inBranch: branchUUID] withRevisionMetadata: nil];
+
+    UKIntsEqual(3, netEffect.commands.count);
+    UKTrue([netEffect.commands[1] isKindOfClass: [COCommandUndeletePersistentRoot class]]);
+}
+
+@end
@@ -0,0 +1,120 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "FMDatabaseAdditions.h"
+
+@interface TestHostedUndoTrackStore : EditingContextTestCase <UKTest>
+{
+    COUndoTrackStore *_undoStore;
+    COUndoTrack *_track;
+    NSUInteger _storeNotificationCount;
+}
+
+@end
+
+
+@implementation TestHostedUndoTrackStore
+
+- (instancetype)init
+{
+    SUPERINIT;
+    _undoStore = [[COUndoTrackStore alloc] initWithStore: store];
+    [_undoStore clearStore];
+
+    ctx = [[COEditingContext alloc] initWithStore: store
+                       modelDescriptionRepository: [ETModelDescriptionRepository mainRepository]
+                                   undoTrackStore: _undoStore];
+    _track = [COUndoTrack trackForName: @"test" withContext: ctx];
+
+    [[NSNotificationCenter defaultCenter] addObserver: self
+                                             selector: @selector(storeDidChange:)
+                                                 name: COStorePersistentRootsDidChangeNotification
+                                               object: store];
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver: self];
+}
+
+- (void)storeDidChange: (NSNotification *)notif
+{
+    _storeNotificationCount++;
+}
+
+- (NSUInteger)numberOfCommandsInStoreDatabase
+{
+    __block NSUInteger count = 0;
+
+    [store testingRunBlockInStoreQueue: ^()
+    {
+        count = [store.database intForQuery: @"SELECT COUNT(*) FROM commands"];
+    }];
+    return count;
+}
+
+- (void)testUndoTrackTablesInStoreDatabase
+{
+    UKObjectsSame(store, _undoStore.hostStore);
+    UKObjectsEqual(store.URL, _undoStore.URL);
+
+    [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    [ctx commitWithUndoTrack: _track];
+
+    UKIntsEqual(1, [self numberOfCommandsInStoreDatabase]);
+    UKIntsEqual(2, _track.nodes.count);
+    UKObjectsEqual(A(@"test"), _undoStore.trackNames);
+
+    // The CoreObject store metadata is left untouched
+    UKObjectsEqual(store.UUID, [[COSQLiteStore alloc] initWithURL: store.URL].UUID);
+}
+
+- (void)testUndoAndRedo
+{
+    COPersistentRoot *persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    [ctx commitWithUndoTrack: _track];
+
+    [persistentRoot.rootObject setValue: @"hello" forProperty: kCOLabel];
+    [ctx commitWithUndoTrack: _track];
+
+    [_track undo];
+
+    UKNil([persistentRoot.rootObject valueForProperty: kCOLabel]);
+
+    [_track redo];
+
+    UKObjectsEqual(@"hello", [persistentRoot.rootObject valueForProperty: kCOLabel]);
+
+    COUndoTrackStore *reopenedUndoStore = [[COUndoTrackStore alloc] initWithStore: store];
+
+    UKObjectsEqual([_undoStore stateForTrackName: @"test"],
+                   [reopenedUndoStore stateForTrackName: @"test"]);
+}
+
+- (void)testStoreTransactionJoinsUndoTrackStoreTransaction
+{
+    COSQLiteStore *otherStore = [[COSQLiteStore alloc] initWithURL: store.URL];
+    COPersistentRoot *persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+
+    [_undoStore beginTransaction];
+    [ctx commitWithUndoTrack: _track];
+
+    // Neither the revision nor the command are visible to other connections
+    UKNil([otherStore persistentRootInfoForUUID: persistentRoot.UUID]);
+    UKIntsEqual(0, _storeNotificationCount);
+
+    UKTrue([_undoStore commitTransactionWithCompletionHandler: ^() { }]);
+
+    UKNotNil([otherStore persistentRootInfoForUUID: persistentRoot.UUID]);
+    UKIntsEqual(1, _storeNotificationCount);
+    UKObjectsEqual([_undoStore stateForTrackName: @"test"],
+                   [[[COUndoTrackStore alloc] initWithStore: otherStore] stateForTrackName: @"test"]);
+}
+
+@end
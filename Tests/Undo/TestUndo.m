@@ -232,6 +232,85 @@
     }
 }
 
+- (void)testSelectiveUndoWritesOnlyItemsModifiedByCommand
+{
+    COPersistentRoot *persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    COObject *root = persistentRoot.rootObject;
+    NSMutableArray *children = [NSMutableArray new];
+
+    for (int i = 0; i < 10; i++)
+    {
+        COObject *child = [persistentRoot.objectGraphContext insertObjectWithEntityName: @"OutlineItem"];
+        [child setValue: [NSString stringWithFormat: @"%d", i] forProperty: kCOLabel];
+        [children addObject: child];
+    }
+    [root setValue: children forProperty: kCOContents];
+    [ctx commitWithIdentifier: @"insert-item" undoTrack: _setupTrack error: NULL];
+
+    [children[3] setValue: @"three" forProperty: kCOLabel];
+    [ctx commitWithIdentifier: @"rename-item" undoTrack: _childEditTrack error: NULL];
+
+    [root setValue: @"root" forProperty: kCOLabel];
+    [children[5] setValue: @"five" forProperty: kCOLabel];
+    [ctx commitWithIdentifier: @"rename-item" undoTrack: _rootEditTrack error: NULL];
+
+    CORevision *oldRevision = persistentRoot.currentRevision;
+
+    [_childEditTrack undo];
+
+    CORevision *newRevision = persistentRoot.currentRevision;
+    COItemGraph *delta = [store partialItemGraphFromRevisionUUID: oldRevision.UUID
+                                                  toRevisionUUID: newRevision.UUID
+                                                  persistentRoot: persistentRoot.UUID];
+
+    UKObjectsEqual(oldRevision, newRevision.parentRevision);
+    UKObjectsEqual(A([children[3] UUID]), delta.itemUUIDs);
+    UKObjectsEqual(@"3", [children[3] valueForProperty: kCOLabel]);
+    UKObjectsEqual(@"five", [children[5] valueForProperty: kCOLabel]);
+    UKObjectsEqual(@"root", [root valueForProperty: kCOLabel]);
+
+    [_childEditTrack redo];
+
+    UKObjectsEqual(@"three", [children[3] valueForProperty: kCOLabel]);
+    UKObjectsEqual(@"five", [children[5] valueForProperty: kCOLabel]);
+}
+
+/**
+ * The selective undo diffs the whole attributed string, rather than only the
+ * items modified by the undone commit.
+ */
+- (void)testSelectiveUndoOfAttributedStringEdit
+{
+    COPersistentRoot *persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"COAttributedString"];
+    COObjectGraphContext *graph = persistentRoot.objectGraphContext;
+    COAttributedString *string = persistentRoot.rootObject;
+    COAttributedStringChunk *chunkX = [[COAttributedStringChunk alloc] initWithObjectGraphContext: graph];
+    chunkX.text = @"x";
+    string.chunks = @[chunkX];
+    [ctx commit];
+
+    COAttributedStringChunk *chunkY = [[COAttributedStringChunk alloc] initWithObjectGraphContext: graph];
+    chunkY.text = @"y";
+    string.chunks = @[chunkX, chunkY];
+    [ctx commitWithUndoTrack: _testTrack];
+
+    COAttributedStringChunk *chunkZ = [[COAttributedStringChunk alloc] initWithObjectGraphContext: graph];
+    chunkZ.text = @"z";
+    string.chunks = @[chunkX, chunkY, chunkZ];
+    [ctx commit];
+
+    UKObjectsEqual(@"xyz", string.string);
+
+    [_testTrack undo];
+
+    UKObjectsEqual(@"xz", [persistentRoot.rootObject string]);
+
+    COEditingContext *ctx2 = [self newContext];
+    COPersistentRoot *ctx2persistentRoot = [ctx2 persistentRootForUUID: persistentRoot.UUID];
+
+    UKObjectsEqual(@"xz", [ctx2persistentRoot.rootObject string]);
+}
+
 - (void)testUndoCreateBranch
 {
     COPersistentRoot *persistentRoot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
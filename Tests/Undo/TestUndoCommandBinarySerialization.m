@@ -0,0 +1,108 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "TestCommon.h"
+#import "COUndoCommandBinarySerialization.h"
+#import "COJSONSerialization.h"
+
+@interface TestUndoCommandBinarySerialization : NSObject <UKTest>
+@end
+
+
+@implementation TestUndoCommandBinarySerialization
+
+- (NSDictionary *)commandWithItemCount: (NSUInteger)count
+{
+    NSMutableArray *items = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [items addObject: @{ @"uuid" : [ETUUID UUID].stringValue,
+                             @"label" : [NSString stringWithFormat: @"Item %d", (int)i],
+                             @"count" : @(i * 1000000) }];
+    }
+    return @{ @"class" : @"COCommandSetCurrentVersionForBranch",
+              @"persistentRoot" : [ETUUID UUID].stringValue,
+              @"items" : items,
+              @"ratio" : @0.25,
+              @"negative" : @(-70000),
+              @"inversed" : @YES,
+              @"missing" : [NSNull null] };
+}
+
+- (void)testRoundTrip
+{
+    NSDictionary *command = [self commandWithItemCount: 3];
+    NSData *data = COUndoCommandDataWithJSONObject(command, NO);
+
+    UKObjectsEqual(command, COUndoCommandJSONObjectWithData(data));
+    UKTrue(data.length < CODataWithJSONObject(command, NULL).length);
+}
+
+- (void)testBooleansAreKept
+{
+    NSArray *values = A(@YES, @NO, @1, @0);
+    NSArray *decodedValues = COUndoCommandJSONObjectWithData(COUndoCommandDataWithJSONObject(values, NO));
+
+    // @1 is equal to @YES, so we compare the JSON
+    UKStringsEqual(@"[true,false,1,0]",
+                   [[NSString alloc] initWithData: CODataWithJSONObject(decodedValues, NULL)
+                                         encoding: NSUTF8StringEncoding]);
+}
+
+- (void)testCharNumbersAreNotBooleans
+{
+    NSArray *values = A(@((unsigned char)7), @((char)-3), @((unsigned char)1));
+    NSArray *decodedValues = COUndoCommandJSONObjectWithData(COUndoCommandDataWithJSONObject(values, NO));
+
+    UKObjectsEqual(values, decodedValues);
+    // @1 is equal to @YES, so we compare the JSON
+    UKStringsEqual(@"[7,-3,1]",
+                   [[NSString alloc] initWithData: CODataWithJSONObject(decodedValues, NULL)
+                                         encoding: NSUTF8StringEncoding]);
+}
+
+- (void)testStringsResemblingUUIDsAreKept
+{
+    NSString *uppercaseUUID = [ETUUID UUID].stringValue.uppercaseString;
+    NSString *truncatedUUID = [[ETUUID UUID].stringValue substringFromIndex: 1];
+    NSArray *strings = A(uppercaseUUID, truncatedUUID, @"", @"héllo");
+
+    UKObjectsEqual(strings, COUndoCommandJSONObjectWithData(COUndoCommandDataWithJSONObject(strings, NO)));
+}
+
+- (void)testCompression
+{
+    NSDictionary *command = [self commandWithItemCount: 100];
+    NSData *uncompressedData = COUndoCommandDataWithJSONObject(command, NO);
+    NSData *compressedData = COUndoCommandDataWithJSONObject(command, YES);
+
+    UKTrue(compressedData.length < uncompressedData.length);
+    UKObjectsEqual(command, COUndoCommandJSONObjectWithData(compressedData));
+}
+
+- (void)testSmallCommandIsNotCompressed
+{
+    NSDictionary *command = @{ @"class" : @"COCommandGroup" };
+
+    UKObjectsEqual(COUndoCommandDataWithJSONObject(command, NO),
+                   COUndoCommandDataWithJSONObject(command, YES));
+}
+
+- (void)testJSONData
+{
+    NSDictionary *command = [self commandWithItemCount: 2];
+
+    UKObjectsEqual(command, COUndoCommandJSONObjectWithData(CODataWithJSONObject(command, NULL)));
+}
+
+- (void)testInvalidJSONObject
+{
+    UKRaisesException(COUndoCommandDataWithJSONObject(@{ @"date" : [NSDate date] }, NO));
+}
+
+@end
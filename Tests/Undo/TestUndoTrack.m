@@ -184,6 +184,31 @@ static COEndOfUndoTrackPlaceholderNode *placeholderNode = nil;
     UKObjectsEqual(group, [secondTrackInstance currentNode]);
 }
 
+- (void)testReloadedCommandsLoadedLazily
+{
+    COCommandGroup *group1 = [self switchToNewBranch];
+    [_track recordCommand: group1];
+    COCommandGroup *group2 = [self switchToNewBranch];
+    [_track recordCommand: group2];
+
+    COUndoTrack *secondTrackInstance = [COUndoTrack trackForName: TEST_TRACK
+                                                     withContext: ctx];
+    NSArray *nodes = secondTrackInstance.nodes;
+    COCommandGroup *reloadedGroup1 = nodes[1];
+    COCommandGroup *reloadedGroup2 = nodes[2];
+
+    UKObjectsEqual(A(placeholderNode, group1, group2), nodes);
+    UKIntsEqual(group2.sequenceNumber, reloadedGroup2.sequenceNumber);
+    UKFalse(reloadedGroup1.loaded);
+    UKFalse(reloadedGroup2.loaded);
+
+    UKObjectsEqual([group2.contents.firstObject branchUUID],
+                   [reloadedGroup2.contents.firstObject branchUUID]);
+    UKTrue(reloadedGroup2.loaded);
+    UKObjectsSame(secondTrackInstance, [reloadedGroup2.contents.firstObject parentUndoTrack]);
+    UKFalse(reloadedGroup1.loaded);
+}
+
 - (void)testFirstCommandParent
 {
     COCommandGroup *group = [[COCommandGroup alloc] init];
@@ -226,6 +251,92 @@ static COEndOfUndoTrackPlaceholderNode *placeholderNode = nil;
     UKObjectsEqual(group2.UUID, state.currentCommandUUID);
 }
 
+- (void)testNodesInRangeAndIndexOfNode
+{
+    COCommandGroup *group1 = [[COCommandGroup alloc] init];
+    COCommandGroup *group2 = [[COCommandGroup alloc] init];
+    COCommandGroup *divergentGroup = [[COCommandGroup alloc] init];
+    [_track recordCommand: group1];
+    [_track recordCommand: group2];
+
+    UKIntsEqual(3, _track.count);
+    UKObjectsEqual(A(group1, group2), [_track nodesInRange: NSMakeRange(1, 2)]);
+    UKIntsEqual(0, [_track indexOfNode: placeholderNode]);
+    UKIntsEqual(2, [_track indexOfNode: group2]);
+
+    [_track setCurrentNode: placeholderNode];
+    [_track recordCommand: divergentGroup];
+
+    UKObjectsEqual(A(placeholderNode, divergentGroup), _track.nodes);
+    UKIntsEqual(1, [_track indexOfNode: divergentGroup]);
+    UKIntsEqual(NSNotFound, [_track indexOfNode: group2]);
+}
+
+- (void)testRecordCommandDiscardsRedoAndCoalescedNodes
+{
+    COCommandGroup *group1 = [[COCommandGroup alloc] init];
+    COCommandGroup *group2 = [[COCommandGroup alloc] init];
+    COCommandGroup *group3 = [[COCommandGroup alloc] init];
+    COCommandGroup *group4 = [[COCommandGroup alloc] init];
+    COCommandGroup *group5 = [[COCommandGroup alloc] init];
+    [_track recordCommand: group1];
+    [_track recordCommand: group2];
+    [_track setCurrentNode: group1];
+    [_track recordCommand: group3];
+
+    UKObjectsEqual(A(placeholderNode, group1, group3), _track.nodes);
+    UKIntsEqual(NSNotFound, [_track indexOfNode: group2]);
+    UKIntsEqual(2, [_track indexOfNode: group3]);
+
+    [_track beginCoalescing];
+    [_track recordCommand: group4];
+    [_track recordCommand: group5];
+    [_track endCoalescing];
+
+    UKObjectsEqual(A(placeholderNode, group1, group3, group5), _track.nodes);
+    UKIntsEqual(NSNotFound, [_track indexOfNode: group4]);
+    UKIntsEqual(3, [_track indexOfNode: group5]);
+
+    COUndoTrack *secondTrackInstance = [COUndoTrack trackForName: TEST_TRACK withContext: ctx];
+
+    UKObjectsEqual([_track.nodes valueForKey: @"UUID"], [secondTrackInstance.nodes valueForKey: @"UUID"]);
+}
+
+- (void)testSetCurrentNodeAcrossManyNodes
+{
+    COPersistentRoot *proot = [ctx insertNewPersistentRootWithEntityName: @"OutlineItem"];
+    [ctx commitWithUndoTrack: _track];
+    CORevision *firstRevision = proot.currentRevision;
+
+    for (int i = 0; i < 10; i++)
+    {
+        [proot.rootObject setLabel: [NSString stringWithFormat: @"%d", i]];
+        [ctx commitWithUndoTrack: _track];
+    }
+    CORevision *lastRevision = proot.currentRevision;
+
+    [_track setCurrentNode: _track.nodes[1]];
+
+    UKObjectsEqual(firstRevision, proot.currentRevision);
+    UKObjectsEqual(lastRevision, proot.currentBranch.headRevision);
+    UKObjectsEqual(_track.nodes[1], _track.currentNode);
+
+    [_track setCurrentNode: _track.nodes.lastObject];
+
+    UKObjectsEqual(lastRevision, proot.currentRevision);
+    UKObjectsEqual(lastRevision, proot.currentBranch.headRevision);
+
+    [_track setCurrentNode: placeholderNode];
+
+    UKTrue(proot.deleted);
+    UKObjectsEqual(placeholderNode, _track.currentNode);
+
+    [_track setCurrentNode: _track.nodes[5]];
+
+    UKFalse(proot.deleted);
+    UKObjectsEqual(@"3", [proot.rootObject label]);
+}
+
 - (void)testUndoAndRedoOneNode
 {
     COCommandGroup *group1 = [[COCommandGroup alloc] init];
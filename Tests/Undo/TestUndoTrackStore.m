@@ -6,6 +6,9 @@
  */
 
 #import "TestCommon.h"
+#import "FMDatabase.h"
+#import "FMDatabaseAdditions.h"
+#import "COJSONSerialization.h"
 
 @interface COUndoTrackStore (TestUndoTrackStore)
 - (BOOL)commitTransaction;
@@ -191,6 +194,96 @@
                    SA([_store allCommandUUIDsOnTrackWithName: @"test1"]));
 }
 
+- (void)testCommandSkeletons
+{
+    COUndoTrackSerializedCommand *cmd1 = [self makeCommandWithParent: nil track: @"test1"];
+    COUndoTrackSerializedCommand *cmd1a = [self makeCommandWithParent: cmd1.UUID track: @"test1"];
+    COUndoTrackSerializedCommand *cmd1b = [self makeCommandWithParent: cmd1.UUID track: @"test1"];
+    COUndoTrackSerializedCommand *cmd2 = [self makeCommandWithParent: cmd1b.UUID track: @"test1"];
+
+    [_store beginTransaction];
+    [_store addCommand: cmd1];
+    [_store addCommand: cmd1a];
+    [_store addCommand: cmd1b];
+    [_store addCommand: cmd2];
+    [_store commitTransaction];
+
+    NSArray *skeletons = [_store commandSkeletonsUpToCommandUUID: cmd2.UUID];
+
+    UKObjectsEqual(A(cmd1.UUID, cmd1b.UUID, cmd2.UUID), [[skeletons mappedCollection] UUID]);
+    UKObjectsEqual(A(@(cmd1.sequenceNumber), @(cmd1b.sequenceNumber), @(cmd2.sequenceNumber)),
+                   [[skeletons mappedCollection] valueForKey: @"sequenceNumber"]);
+    UKNil([skeletons[0] parentUUID]);
+    UKObjectsEqual(cmd1b.UUID, [skeletons[2] parentUUID]);
+    UKNil([skeletons[2] JSONData]);
+    UKObjectsSame(_store, [skeletons[2] store]);
+
+    UKTrue([_store loadPayloadForCommand: skeletons[2]]);
+    [self checkCommand: skeletons[2] isEqualToCommand: cmd2];
+    UKNil([skeletons[2] store]);
+
+    UKObjectsEqual(A(cmd1.UUID, cmd1a.UUID, cmd1b.UUID, cmd2.UUID),
+                   [[[_store commandSkeletonsOnTrackWithName: @"test1"] mappedCollection] UUID]);
+}
+
+- (void)testCommandSkeletonsStopAtDeletedCommand
+{
+    COUndoTrackSerializedCommand *cmd1 = [self makeCommandWithParent: nil track: @"test1"];
+    COUndoTrackSerializedCommand *cmd2 = [self makeCommandWithParent: cmd1.UUID track: @"test1"];
+    COUndoTrackSerializedCommand *cmd3 = [self makeCommandWithParent: cmd2.UUID track: @"test1"];
+
+    [_store beginTransaction];
+    [_store addCommand: cmd1];
+    [_store addCommand: cmd2];
+    [_store addCommand: cmd3];
+    [_store commitTransaction];
+
+    [_store markCommandsAsDeletedForUUIDs: @[cmd1.UUID]];
+
+    UKObjectsEqual(A(cmd2.UUID, cmd3.UUID),
+                   [[[_store commandSkeletonsUpToCommandUUID: cmd3.UUID] mappedCollection] UUID]);
+    UKObjectsEqual(@[], [_store commandSkeletonsUpToCommandUUID: cmd1.UUID]);
+}
+
+- (void)testMigrationFromJSONEncoding
+{
+    COUndoTrackSerializedCommand *cmd1 = [self makeCommandWithParent: nil track: @"test1"];
+    COUndoTrackSerializedCommand *cmd2 = [self makeCommandWithParent: cmd1.UUID track: @"test1"];
+
+    cmd2.JSONData = @{ @"uuid" : [ETUUID UUID].stringValue, @"contents" : @[@1, @2.5, [NSNull null]] };
+
+    [_store beginTransaction];
+    [_store addCommand: cmd1];
+    [_store addCommand: cmd2];
+    [_store commitTransaction];
+
+    // Rewrite the commands as an undo track store version 1 would
+    FMDatabase *db = [FMDatabase databaseWithPath:
+        [[SQLiteStoreTestCase undoTrackStoreURL].path stringByAppendingPathComponent: @"undo.sqlite"]];
+    [db open];
+
+    for (COUndoTrackSerializedCommand *cmd in @[cmd1, cmd2])
+    {
+        [db executeUpdate: @"UPDATE commands SET data = ?, metadata = ? WHERE uuid = ?",
+                           CODataWithJSONObject(cmd.JSONData, NULL),
+                           CODataWithJSONObject(cmd.metadata, NULL),
+                           [cmd.UUID dataValue]];
+    }
+    [db executeUpdate: @"UPDATE storeMetadata SET version = 1"];
+    [db executeUpdate: @"DROP INDEX commands_by_track"];
+
+    COUndoTrackStore *migratedStore =
+        [[COUndoTrackStore alloc] initWithURL: [SQLiteStoreTestCase undoTrackStoreURL]];
+
+    [self checkCommand: [migratedStore commandForUUID: cmd1.UUID] isEqualToCommand: cmd1];
+    [self checkCommand: [migratedStore commandForUUID: cmd2.UUID] isEqualToCommand: cmd2];
+
+    UKIntsEqual(2, [db intForQuery: @"SELECT version FROM storeMetadata"]);
+    UKIntsEqual(0, [db intForQuery: @"SELECT COUNT(*) FROM commands WHERE hex(substr(data, 1, 1)) = '7B'"]);
+    UKTrue([db boolForQuery: @"SELECT COUNT(*) > 0 FROM sqlite_master WHERE name = 'commands_by_track'"]);
+    [db close];
+}
+
 @end
 
 
@@ -33,6 +33,11 @@ NS_ASSUME_NONNULL_BEGIN
     ETUUID *_parentUUID;
     NSDate *_timestamp;
     int64_t _sequenceNumber;
+    /**
+     * The skeleton whose payload is decoded on first access to -contents or
+     * -metadata, or nil once decoded.
+     */
+    COUndoTrackSerializedCommand *_unloadedCommand;
 }
 
 
@@ -164,6 +169,10 @@ NS_ASSUME_NONNULL_BEGIN
  * <init />
  * Initializes a command group from a serialized represention and with a parent 
  * undo track.
+ *
+ * If the serialized command is a skeleton (its store is not nil), the atomic
+ * commands and the metadata are only loaded and decoded when -contents or
+ * -metadata are accessed.
  */
 - (instancetype)initWithSerializedCommand: (COUndoTrackSerializedCommand *)aCommand
                                     owner: (nullable COUndoTrack *)anOwner NS_DESIGNATED_INITIALIZER;
@@ -172,6 +181,10 @@ NS_ASSUME_NONNULL_BEGIN
  * Returns a serialized represention.
  */
 @property (nonatomic, readonly, strong) COUndoTrackSerializedCommand *serializedCommand;
+/**
+ * Returns whether the atomic commands and the metadata have been decoded.
+ */
+@property (nonatomic, readonly, getter=isLoaded) BOOL loaded;
 
 @end
 
@@ -18,7 +18,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 
 @implementation COCommandGroup
 
-@synthesize UUID = _UUID, contents = _contents, metadata = _metadata;
+@synthesize UUID = _UUID;
 @synthesize timestamp = _timestamp;
 @synthesize sequenceNumber = _sequenceNumber;
 @synthesize parentUUID = _parentUUID;
@@ -52,9 +52,16 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
     NILARG_EXCEPTION_TEST(aCommand);
     SUPERINIT;
     _parentUndoTrack = anOwner;
-    _contents = [self commandsFromPropertyList: aCommand.JSONData
-                               parentUndoTrack: anOwner];
-    _metadata = aCommand.metadata;
+    if (aCommand.store != nil)
+    {
+        _unloadedCommand = aCommand;
+    }
+    else
+    {
+        _contents = [self commandsFromPropertyList: aCommand.JSONData
+                                   parentUndoTrack: anOwner];
+        _metadata = aCommand.metadata;
+    }
     _UUID = aCommand.UUID;
     if (aCommand.parentUUID == nil)
     {
@@ -70,11 +77,62 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
     return self;
 }
 
+- (BOOL)isLoaded
+{
+    return _unloadedCommand == nil;
+}
+
+- (void)loadIfNeeded
+{
+    if (_unloadedCommand == nil)
+        return;
+
+    COUndoTrackSerializedCommand *command = _unloadedCommand;
+    BOOL isErasedCommand = ![command.store loadPayloadForCommand: command];
+
+    _unloadedCommand = nil;
+
+    if (isErasedCommand)
+    {
+        NSLog(@"Command %@ was erased from the undo track store before being loaded", _UUID);
+        _contents = [NSMutableArray new];
+        return;
+    }
+
+    _contents = [self commandsFromPropertyList: command.JSONData
+                               parentUndoTrack: _parentUndoTrack];
+    _metadata = command.metadata;
+}
+
+- (NSMutableArray *)contents
+{
+    [self loadIfNeeded];
+    return _contents;
+}
+
+- (void)setContents: (NSMutableArray *)contents
+{
+    [self loadIfNeeded];
+    _contents = [contents copy];
+}
+
+- (NSDictionary *)metadata
+{
+    [self loadIfNeeded];
+    return _metadata;
+}
+
+- (void)setMetadata: (NSDictionary *)metadata
+{
+    [self loadIfNeeded];
+    _metadata = [metadata copy];
+}
+
 - (COUndoTrackSerializedCommand *)serializedCommand
 {
     COUndoTrackSerializedCommand *cmd = [COUndoTrackSerializedCommand new];
     cmd.JSONData = [self commandsPropertyList];
-    cmd.metadata = _metadata;
+    cmd.metadata = self.metadata;
     cmd.UUID = _UUID;
     if ([_parentUUID isEqual: [COEndOfUndoTrackPlaceholderNode sharedInstance].UUID])
     {
@@ -92,7 +150,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 
 - (id)commandsPropertyList
 {
-    return @{kCOCommandContents: [[_contents mappedCollection] propertyList]};
+    return @{kCOCommandContents: [[self.contents mappedCollection] propertyList]};
 }
 
 - (NSMutableArray *)commandsFromPropertyList: (NSDictionary *)plist
@@ -127,7 +185,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 {
     NSMutableArray *inversedCommands = [NSMutableArray array];
 
-    for (COCommand *command in _contents)
+    for (COCommand *command in self.contents)
     {
         // Insert the inverses back to front, so the inverse of the most recent
         // action will be first.
@@ -140,7 +198,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 - (NSMutableArray *)copiedCommands
 {
     NSMutableArray *commands = [NSMutableArray array];
-    for (COCommand *command in _contents)
+    for (COCommand *command in self.contents)
     {
         [commands addObject: [command copy]];
     }
@@ -165,7 +223,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 {
     NILARG_EXCEPTION_TEST(aContext);
 
-    for (COCommand *command in _contents)
+    for (COCommand *command in self.contents)
     {
         if (![command canApplyToContext: aContext])
         {
@@ -179,7 +237,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 {
     NILARG_EXCEPTION_TEST(aContext);
 
-    for (COCommand *command in _contents)
+    for (COCommand *command in self.contents)
     {
         [command applyToContext: aContext];
     }
@@ -192,7 +250,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
     NILARG_EXCEPTION_TEST(ctx);
     NILARG_EXCEPTION_TEST(txn);
 
-    for (COCommand *command in _contents)
+    for (COCommand *command in self.contents)
     {
         [command addToStoreTransaction: txn
                   withRevisionMetadata: metadata
@@ -213,7 +271,8 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 - (void)setParentUndoTrack: (COUndoTrack *)parentUndoTrack
 {
     _parentUndoTrack = parentUndoTrack;
-    for (COCommand *childCommand in self.contents)
+    // Commands not loaded yet get the parent undo track when they are decoded
+    for (COCommand *childCommand in _contents)
     {
         childCommand.parentUndoTrack = parentUndoTrack;
     }
@@ -226,7 +285,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 - (ETUUID *)persistentRootUUID
 {
     // This is kind of a hack
-    for (COCommand *command in [_contents reverseObjectEnumerator])
+    for (COCommand *command in [self.contents reverseObjectEnumerator])
     {
         if (command.persistentRootUUID != nil)
             return command.persistentRootUUID;
@@ -296,7 +355,7 @@ static NSString *const kCOCommandMetadata = @"COCommandMetadata";
 
 - (id)content
 {
-    return _contents;
+    return self.contents;
 }
 
 - (NSArray *)contentArray
@@ -0,0 +1,83 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+
+@class COCommand;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @group Undo
+ * @abstract Composes a command sequence into its net effect per branch and
+ * persistent root.
+ *
+ * COUndoTrack uses it to apply a jump across many nodes (e.g. from the newest
+ * to the oldest node) as a few commands, rather than applying every
+ * intermediate command to the store transaction.
+ *
+ * Each command added is folded into the last command that touched the same
+ * branch or persistent root, when both can be composed:
+ *
+ * <list>
+ * <item>branch version changes that chain (r0 -> r1 then r1 -> r2) become a
+ * single change (r0 -> r2)</item>
+ * <item>current branch and metadata changes keep the first old value and the
+ * last new value</item>
+ * <item>a deletion followed by an undeletion (or the reverse) cancels out</item>
+ * </list>
+ *
+ * Other commands are kept in order. A persistent root command is never folded
+ * across a branch command of the same persistent root (and vice versa), so the
+ * commands that depend on each other are not reordered.
+ *
+ * The added commands are not mutated, they are copied before folding.
+ */
+@interface COCommandNetEffect : NSObject
+{
+    @private
+    NSMutableArray *_commands;
+    NSMutableArray *_revisionMetadata;
+    NSMutableDictionary *_lastIndexForBranchUUID;
+    NSMutableDictionary *_lastIndexForPersistentRootUUID;
+}
+
+
+/** @taskunit Composing Commands */
+
+
+/**
+ * Folds the given command into the net effect.
+ *
+ * For a command group, its contents are added in order.
+ *
+ * The revision metadata is passed back by -enumerateCommandsUsingBlock: for
+ * the resulting command. When commands are folded, the metadata of the last
+ * one is retained.
+ */
+- (void)addCommand: (COCommand *)aCommand
+    withRevisionMetadata: (nullable NSDictionary<NSString *, id> *)metadata;
+
+
+/** @taskunit Net Effect */
+
+
+/**
+ * The composed commands in order, excluding the commands that cancel out or
+ * have no effect.
+ */
+@property (nonatomic, readonly) NSArray<COCommand *> *commands;
+/**
+ * Enumerates -commands along with their revision metadata.
+ */
+- (void)enumerateCommandsUsingBlock: (void (^)(COCommand *command,
+                                               NSDictionary<NSString *, id> * _Nullable metadata))aBlock;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,227 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COCommandNetEffect.h"
+#import "COCommand.h"
+#import "COCommandGroup.h"
+#import "COCommandDeleteBranch.h"
+#import "COCommandUndeleteBranch.h"
+#import "COCommandSetBranchMetadata.h"
+#import "COCommandSetCurrentBranch.h"
+#import "COCommandSetCurrentVersionForBranch.h"
+#import "COCommandDeletePersistentRoot.h"
+#import "COCommandUndeletePersistentRoot.h"
+#import "COCommandSetPersistentRootMetadata.h"
+
+@implementation COCommandNetEffect
+
+- (instancetype)init
+{
+    SUPERINIT;
+    _commands = [NSMutableArray new];
+    _revisionMetadata = [NSMutableArray new];
+    _lastIndexForBranchUUID = [NSMutableDictionary new];
+    _lastIndexForPersistentRootUUID = [NSMutableDictionary new];
+    return self;
+}
+
+static BOOL isBranchCommand(COCommand *aCommand)
+{
+    return [aCommand isKindOfClass: [COCommandSetCurrentVersionForBranch class]]
+        || [aCommand isKindOfClass: [COCommandSetBranchMetadata class]]
+        || [aCommand isKindOfClass: [COCommandDeleteBranch class]]
+        || [aCommand isKindOfClass: [COCommandUndeleteBranch class]];
+}
+
+static BOOL isCommandPairOfClasses(COCommand *aCommand, COCommand *nextCommand, Class aClass, Class nextClass)
+{
+    return [aCommand isKindOfClass: aClass] && [nextCommand isKindOfClass: nextClass];
+}
+
+/**
+ * Returns the command resulting from applying aCommand then nextCommand,
+ * [NSNull null] if they cancel out, or nil if they cannot be composed.
+ */
+static id composedCommandPair(COCommand *aCommand, COCommand *nextCommand)
+{
+    if (isCommandPairOfClasses(aCommand, nextCommand,
+                               [COCommandSetCurrentVersionForBranch class],
+                               [COCommandSetCurrentVersionForBranch class]))
+    {
+        COCommandSetCurrentVersionForBranch *setVersion = (COCommandSetCurrentVersionForBranch *)aCommand;
+        COCommandSetCurrentVersionForBranch *nextSetVersion = (COCommandSetCurrentVersionForBranch *)nextCommand;
+
+        if (![nextSetVersion.oldRevisionUUID isEqual: setVersion.revisionUUID]
+            || ![nextSetVersion.oldHeadRevisionUUID isEqual: setVersion.headRevisionUUID])
+        {
+            return nil;
+        }
+
+        COCommandSetCurrentVersionForBranch *composed = [setVersion copy];
+        composed.revisionUUID = nextSetVersion.revisionUUID;
+        composed.headRevisionUUID = nextSetVersion.headRevisionUUID;
+        return composed;
+    }
+    else if (isCommandPairOfClasses(aCommand, nextCommand,
+                                    [COCommandSetCurrentBranch class],
+                                    [COCommandSetCurrentBranch class]))
+    {
+        COCommandSetCurrentBranch *setBranch = (COCommandSetCurrentBranch *)aCommand;
+        COCommandSetCurrentBranch *nextSetBranch = (COCommandSetCurrentBranch *)nextCommand;
+
+        if (![nextSetBranch.oldBranchUUID isEqual: setBranch.branchUUID])
+            return nil;
+
+        COCommandSetCurrentBranch *composed = [setBranch copy];
+        composed.branchUUID = nextSetBranch.branchUUID;
+        return composed;
+    }
+    else if (isCommandPairOfClasses(aCommand, nextCommand,
+                                    [COCommandSetBranchMetadata class],
+                                    [COCommandSetBranchMetadata class]))
+    {
+        COCommandSetBranchMetadata *composed = [aCommand copy];
+        composed.metadata = ((COCommandSetBranchMetadata *)nextCommand).metadata;
+        return composed;
+    }
+    else if (isCommandPairOfClasses(aCommand, nextCommand,
+                                    [COCommandSetPersistentRootMetadata class],
+                                    [COCommandSetPersistentRootMetadata class]))
+    {
+        COCommandSetPersistentRootMetadata *composed = [aCommand copy];
+        composed.metadata = ((COCommandSetPersistentRootMetadata *)nextCommand).metadata;
+        return composed;
+    }
+    else if (isCommandPairOfClasses(aCommand, nextCommand,
+                                    [COCommandDeletePersistentRoot class],
+                                    [COCommandUndeletePersistentRoot class])
+          || isCommandPairOfClasses(aCommand, nextCommand,
+                                    [COCommandUndeletePersistentRoot class],
+                                    [COCommandDeletePersistentRoot class])
+          || isCommandPairOfClasses(aCommand, nextCommand,
+                                    [COCommandDeleteBranch class],
+                                    [COCommandUndeleteBranch class])
+          || isCommandPairOfClasses(aCommand, nextCommand,
+                                    [COCommandUndeleteBranch class],
+                                    [COCommandDeleteBranch class]))
+    {
+        return [NSNull null];
+    }
+    return nil;
+}
+
+static BOOL isNoOpCommand(COCommand *aCommand)
+{
+    if ([aCommand isKindOfClass: [COCommandSetCurrentVersionForBranch class]])
+    {
+        COCommandSetCurrentVersionForBranch *setVersion = (COCommandSetCurrentVersionForBranch *)aCommand;
+
+        return [setVersion.revisionUUID isEqual: setVersion.oldRevisionUUID]
+            && [setVersion.headRevisionUUID isEqual: setVersion.oldHeadRevisionUUID];
+    }
+    else if ([aCommand isKindOfClass: [COCommandSetCurrentBranch class]])
+    {
+        COCommandSetCurrentBranch *setBranch = (COCommandSetCurrentBranch *)aCommand;
+
+        return [setBranch.branchUUID isEqual: setBranch.oldBranchUUID];
+    }
+    return NO;
+}
+
+- (void)removeLastIndexesForBranchesOfPersistentRootUUID: (ETUUID *)aPersistentRootUUID
+{
+    for (ETUUID *branchUUID in _lastIndexForBranchUUID.allKeys)
+    {
+        COCommand *command = _commands[[_lastIndexForBranchUUID[branchUUID] unsignedIntegerValue]];
+
+        if ([command.persistentRootUUID isEqual: aPersistentRootUUID])
+        {
+            [_lastIndexForBranchUUID removeObjectForKey: branchUUID];
+        }
+    }
+}
+
+- (void)addCommand: (COCommand *)aCommand
+    withRevisionMetadata: (NSDictionary *)metadata
+{
+    NILARG_EXCEPTION_TEST(aCommand);
+
+    if ([aCommand isKindOfClass: [COCommandGroup class]])
+    {
+        for (COCommand *command in ((COCommandGroup *)aCommand).contents)
+        {
+            [self addCommand: command withRevisionMetadata: metadata];
+        }
+        return;
+    }
+
+    const BOOL isBranch = isBranchCommand(aCommand);
+    ETUUID *key = (isBranch ? [(id)aCommand branchUUID] : aCommand.persistentRootUUID);
+    NSMutableDictionary *lastIndexForKey =
+        (isBranch ? _lastIndexForBranchUUID : _lastIndexForPersistentRootUUID);
+    NSNumber *lastIndex = lastIndexForKey[key];
+
+    if (lastIndex != nil)
+    {
+        const NSUInteger i = lastIndex.unsignedIntegerValue;
+        id composed = composedCommandPair(_commands[i], aCommand);
+
+        if (composed == [NSNull null])
+        {
+            _commands[i] = composed;
+            _revisionMetadata[i] = composed;
+            [lastIndexForKey removeObjectForKey: key];
+            return;
+        }
+        else if (composed != nil)
+        {
+            _commands[i] = composed;
+            _revisionMetadata[i] = (metadata != nil ? metadata : [NSNull null]);
+            return;
+        }
+    }
+
+    // Prevent folding commands across this one when they depend on it
+    if (isBranch)
+    {
+        [_lastIndexForPersistentRootUUID removeObjectForKey: aCommand.persistentRootUUID];
+    }
+    else
+    {
+        [self removeLastIndexesForBranchesOfPersistentRootUUID: aCommand.persistentRootUUID];
+    }
+
+    lastIndexForKey[key] = @(_commands.count);
+    [_commands addObject: aCommand];
+    [_revisionMetadata addObject: (metadata != nil ? metadata : [NSNull null])];
+}
+
+- (void)enumerateCommandsUsingBlock: (void (^)(COCommand *command, NSDictionary *metadata))aBlock
+{
+    [_commands enumerateObjectsUsingBlock: ^(id command, NSUInteger i, BOOL *stop)
+    {
+        if (command == [NSNull null] || isNoOpCommand(command))
+            return;
+
+        id metadata = _revisionMetadata[i];
+
+        aBlock(command, (metadata != [NSNull null] ? metadata : nil));
+    }];
+}
+
+- (NSArray *)commands
+{
+    NSMutableArray *commands = [NSMutableArray new];
+
+    [self enumerateCommandsUsingBlock: ^(COCommand *command, NSDictionary *metadata)
+    {
+        [commands addObject: command];
+    }];
+    return commands;
+}
+
+@end
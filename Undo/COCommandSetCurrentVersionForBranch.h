@@ -7,7 +7,7 @@
 
 #import "COCommand.h"
 
-@class CORevision;
+@class CORevision, CODiffManager;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -22,6 +22,9 @@ NS_ASSUME_NONNULL_BEGIN
 
     // Non-persistent
     ETUUID *_currentRevisionBeforeSelectiveApply;
+    NSMutableDictionary *_modifiedItemGraphsByRevisionUUID;
+    CODiffManager *_selectiveApplyDiff;
+    BOOL _loadedWholeItemGraphs;
 }
 
 
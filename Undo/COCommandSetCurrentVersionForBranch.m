@@ -13,6 +13,7 @@
 #import "COBranch.h"
 #import "COBranch+Private.h"
 #import "COItem.h"
+#import "COSQLiteStore.h"
 
 #import "COLeastCommonAncestor.h"
 #import "CODiffManager.h"
@@ -69,24 +70,167 @@ static NSString *const kCOCommandNewHeadRevisionID = @"COCommandNewHeadRevisionI
     inverse.revisionUUID = _oldRevisionUUID;
     inverse.oldHeadRevisionUUID = _newHeadRevisionUUID;
     inverse.headRevisionUUID = _oldHeadRevisionUUID;
+
+    // The modified items are the same in both directions
+    if (_modifiedItemGraphsByRevisionUUID == nil)
+    {
+        _modifiedItemGraphsByRevisionUUID = [NSMutableDictionary new];
+    }
+    inverse->_modifiedItemGraphsByRevisionUUID = _modifiedItemGraphsByRevisionUUID;
     return inverse;
 }
 
-- (CODiffManager *)diffToSelectivelyApplyToBranchCurrentRevision: (ETUUID *)currentRevisionUUID
-                                          assumingEditingContext: (COEditingContext *)aContext
+- (void)setOldRevisionUUID: (ETUUID *)aRevisionUUID
+{
+    _oldRevisionUUID = [aRevisionUUID copy];
+    [self discardSelectiveApplyCache];
+}
+
+- (void)setRevisionUUID: (ETUUID *)aRevisionUUID
 {
-    COItemGraph *currentGraph = [aContext.store itemGraphForRevisionUUID: currentRevisionUUID
-                                                          persistentRoot: _persistentRootUUID];
+    _newRevisionUUID = [aRevisionUUID copy];
+    [self discardSelectiveApplyCache];
+}
 
-    COItemGraph *oldGraph = [aContext.store itemGraphForRevisionUUID: _oldRevisionUUID
-                                                      persistentRoot: _persistentRootUUID];
-    COItemGraph *newGraph = [aContext.store itemGraphForRevisionUUID: _newRevisionUUID
-                                                      persistentRoot: _persistentRootUUID];
+- (void)discardSelectiveApplyCache
+{
+    // Don't empty the dictionary, the inverse command can still use it
+    _modifiedItemGraphsByRevisionUUID = nil;
+    _selectiveApplyDiff = nil;
+    _loadedWholeItemGraphs = NO;
+}
 
-    CODiffManager *diff1 = [CODiffManager diffItemGraph: oldGraph
-                                          withItemGraph: newGraph
-                             modelDescriptionRepository: aContext.modelDescriptionRepository
-                                       sourceIdentifier: @"diff1"];
+/**
+ * Discards the cached item graphs and diff once applied, when they cover the 
+ * whole persistent root, so an undo track doesn't keep two item graphs per
+ * command in memory.
+ */
+- (void)discardWholeItemGraphs
+{
+    if (!_loadedWholeItemGraphs)
+        return;
+
+    // Emptied rather than released, so the inverse command doesn't keep them
+    [_modifiedItemGraphsByRevisionUUID removeAllObjects];
+    _selectiveApplyDiff = nil;
+    _loadedWholeItemGraphs = NO;
+}
+
+/**
+ * Loads the items that differ between the old and new revisions, as they are
+ * in each revision.
+ *
+ * When a revision is an ancestor of the other, the modified items are read
+ * from the store delta between them, rather than loading the whole graphs.
+ * The whole graphs are still loaded when some modified items use another diff
+ * algorithm than COItemGraphDiff.
+ */
+- (void)loadModifiedItemGraphsAssumingEditingContext: (COEditingContext *)aContext
+{
+    COSQLiteStore *store = aContext.store;
+    ETUUID *baseRevisionUUID = _oldRevisionUUID;
+    ETUUID *finalRevisionUUID = _newRevisionUUID;
+    COItemGraph *baseGraph = nil;
+    COItemGraph *finalGraph = nil;
+
+    // For an undo, the new revision is usually an ancestor of the old one
+    if (CORevisionUUIDEqualToOrParent(_newRevisionUUID, _oldRevisionUUID, _persistentRootUUID, aContext))
+    {
+        baseRevisionUUID = _newRevisionUUID;
+        finalRevisionUUID = _oldRevisionUUID;
+    }
+
+    if (CORevisionUUIDEqualToOrParent(baseRevisionUUID, finalRevisionUUID, _persistentRootUUID, aContext))
+    {
+        finalGraph = [store partialItemGraphFromRevisionUUID: baseRevisionUUID
+                                              toRevisionUUID: finalRevisionUUID
+                                              persistentRoot: _persistentRootUUID];
+        baseGraph = [store itemGraphForRevisionUUID: baseRevisionUUID
+                                     persistentRoot: _persistentRootUUID
+                                restrictToItemUUIDs: [NSSet setWithArray: finalGraph.itemUUIDs]];
+
+        ETModelDescriptionRepository *repo = aContext.modelDescriptionRepository;
+
+        if (![CODiffManager itemsUseItemGraphDiff: finalGraph.items modelDescriptionRepository: repo]
+            || ![CODiffManager itemsUseItemGraphDiff: baseGraph.items modelDescriptionRepository: repo])
+        {
+            baseGraph = nil;
+            finalGraph = nil;
+        }
+    }
+
+    if (baseGraph == nil || finalGraph == nil)
+    {
+        baseGraph = [store itemGraphForRevisionUUID: baseRevisionUUID
+                                     persistentRoot: _persistentRootUUID];
+        finalGraph = [store itemGraphForRevisionUUID: finalRevisionUUID
+                                      persistentRoot: _persistentRootUUID];
+        _loadedWholeItemGraphs = YES;
+    }
+    ETAssert(baseGraph != nil);
+    ETAssert(finalGraph != nil);
+
+    if (_modifiedItemGraphsByRevisionUUID == nil)
+    {
+        _modifiedItemGraphsByRevisionUUID = [NSMutableDictionary new];
+    }
+    _modifiedItemGraphsByRevisionUUID[baseRevisionUUID] = baseGraph;
+    _modifiedItemGraphsByRevisionUUID[finalRevisionUUID] = finalGraph;
+}
+
+- (COItemGraph *)modifiedItemGraphForRevisionUUID: (ETUUID *)aRevisionUUID
+                           assumingEditingContext: (COEditingContext *)aContext
+{
+    if (_modifiedItemGraphsByRevisionUUID[_oldRevisionUUID] == nil
+        || _modifiedItemGraphsByRevisionUUID[_newRevisionUUID] == nil)
+    {
+        [self loadModifiedItemGraphsAssumingEditingContext: aContext];
+    }
+    return _modifiedItemGraphsByRevisionUUID[aRevisionUUID];
+}
+
+- (NSSet *)modifiedItemUUIDsAssumingEditingContext: (COEditingContext *)aContext
+{
+    COItemGraph *oldGraph = [self modifiedItemGraphForRevisionUUID: _oldRevisionUUID
+                                            assumingEditingContext: aContext];
+    COItemGraph *newGraph = [self modifiedItemGraphForRevisionUUID: _newRevisionUUID
+                                            assumingEditingContext: aContext];
+    NSMutableSet *itemUUIDs = [NSMutableSet setWithArray: oldGraph.itemUUIDs];
+
+    [itemUUIDs addObjectsFromArray: newGraph.itemUUIDs];
+    return itemUUIDs;
+}
+
+- (CODiffManager *)selectiveApplyDiffAssumingEditingContext: (COEditingContext *)aContext
+{
+    if (_selectiveApplyDiff == nil)
+    {
+        COItemGraph *oldGraph = [self modifiedItemGraphForRevisionUUID: _oldRevisionUUID
+                                                assumingEditingContext: aContext];
+        COItemGraph *newGraph = [self modifiedItemGraphForRevisionUUID: _newRevisionUUID
+                                                assumingEditingContext: aContext];
+
+        _selectiveApplyDiff = [CODiffManager diffItemGraph: oldGraph
+                                             withItemGraph: newGraph
+                                modelDescriptionRepository: aContext.modelDescriptionRepository
+                                          sourceIdentifier: @"diff1"];
+    }
+    return _selectiveApplyDiff;
+}
+
+/**
+ * Returns the items modified between the old and new revisions, with the
+ * old→new changes merged into the current ones.
+ *
+ * currentGraph must contain the current state of the items returned by
+ * -modifiedItemUUIDsAssumingEditingContext:, other items are ignored.
+ */
+- (COItemGraph *)itemGraphBySelectivelyApplyingToItemGraph: (id <COItemGraph>)currentGraph
+                                    assumingEditingContext: (COEditingContext *)aContext
+{
+    COItemGraph *oldGraph = [self modifiedItemGraphForRevisionUUID: _oldRevisionUUID
+                                            assumingEditingContext: aContext];
+    CODiffManager *diff1 = [self selectiveApplyDiffAssumingEditingContext: aContext];
     CODiffManager *diff2 = [CODiffManager diffItemGraph: oldGraph
                                           withItemGraph: currentGraph
                              modelDescriptionRepository: aContext.modelDescriptionRepository
@@ -100,7 +244,31 @@ static NSString *const kCOCommandNewHeadRevisionID = @"COCommandNewHeadRevisionI
         [merged resolveConflictsFavoringSourceIdentifier: @"diff1"];
     }
 
-    return merged;
+    COItemGraph *result = [[COItemGraph alloc] initWithItemGraph: oldGraph];
+    [merged applyTo: result];
+    return result;
+}
+
+/**
+ * Returns the items in aGraph that don't exist or are different in
+ * currentGraph.
+ */
+static NSArray *itemsNotEqualToCurrentItems(COItemGraph *aGraph, id <COItemGraph> currentGraph)
+{
+    NSMutableArray *items = [NSMutableArray array];
+
+    for (ETUUID *uuid in aGraph.itemUUIDs)
+    {
+        COItem *replacementItem = [aGraph itemForUUID: uuid];
+        COItem *existingItem = [currentGraph itemForUUID: uuid];
+
+        if (existingItem == nil
+            || ![existingItem isEqual: replacementItem])
+        {
+            [items addObject: replacementItem];
+        }
+    }
+    return items;
 }
 
 - (BOOL)canApplyToContext: (COEditingContext *)aContext
@@ -152,30 +320,28 @@ static NSString *const kCOCommandNewHeadRevisionID = @"COCommandNewHeadRevisionI
     {
         _currentRevisionBeforeSelectiveApply = branch.currentRevision.UUID;
 
-        CODiffManager *merged = [self diffToSelectivelyApplyToBranchCurrentRevision: _currentRevisionBeforeSelectiveApply
-                                                             assumingEditingContext: aContext];
-        COItemGraph *oldGraph = [proot.store itemGraphForRevisionUUID: _oldRevisionUUID
-                                                       persistentRoot: _persistentRootUUID];
-
-        id <COItemGraph> result = [[COItemGraph alloc] initWithItemGraph: oldGraph];
-        [merged applyTo: result];
+        NSSet *itemUUIDs = [self modifiedItemUUIDsAssumingEditingContext: aContext];
+        NSMutableArray *currentItems = [NSMutableArray array];
 
-        // FIXME: Works, but an ugly API mismatch when setting object graph context contents
-        NSMutableArray *items = [NSMutableArray array];
-        for (ETUUID *uuid in result.itemUUIDs)
+        for (ETUUID *uuid in itemUUIDs)
         {
-            COItem *replacementItem = [result itemForUUID: uuid];
-            COItem *existingItem = [branch.objectGraphContext itemForUUID: uuid];
-            if (existingItem == nil
-                || ![existingItem isEqual: replacementItem])
+            COItem *item = [branch.objectGraphContext itemForUUID: uuid];
+
+            if (item != nil)
             {
-                [items addObject: replacementItem];
+                [currentItems addObject: item];
             }
         }
 
+        COItemGraph *currentGraph = [[COItemGraph alloc] initWithItems: currentItems
+                                                          rootItemUUID: branch.objectGraphContext.rootItemUUID];
+        COItemGraph *result = [self itemGraphBySelectivelyApplyingToItemGraph: currentGraph
+                                                       assumingEditingContext: aContext];
+
         // FIXME: Handle cross-persistent root relationship constraint violations,
         // if we introduce those
-        [branch.objectGraphContext insertOrUpdateItems: items];
+        [branch.objectGraphContext insertOrUpdateItems: itemsNotEqualToCurrentItems(result, currentGraph)];
+        [self discardWholeItemGraphs];
 
         // N.B. newHeadRevisionID is intentionally ignored here, it only applies
         // if we were able to do a non-selective undo.
@@ -239,36 +405,19 @@ static NSString *const kCOCommandNewHeadRevisionID = @"COCommandNewHeadRevisionI
     {
         _currentRevisionBeforeSelectiveApply = branchCurrentRevisionUUID;
 
-        CODiffManager *merged = [self diffToSelectivelyApplyToBranchCurrentRevision: branchCurrentRevisionUUID
-                                                             assumingEditingContext: aContext];
-        COItemGraph *oldGraph = [proot.store itemGraphForRevisionUUID: _oldRevisionUUID
-                                                       persistentRoot: _persistentRootUUID];
-
-        COItemGraph *result = [[COItemGraph alloc] initWithItemGraph: oldGraph];
-        [merged applyTo: result];
-
-        ETUUID *newRevisionUUID = [ETUUID UUID];
-
-        // Filter out unmodified items
-        // FIXME: Ugly
-
-        COItemGraph *branchCurrentGraph = [aContext.store itemGraphForRevisionUUID: branchCurrentRevisionUUID
-                                                                    persistentRoot: _persistentRootUUID];
-        NSMutableArray *necessaryItems = [NSMutableArray array];
-        for (ETUUID *uuid in result.itemUUIDs)
-        {
-            COItem *replacementItem = [result itemForUUID: uuid];
-            COItem *existingItem = [branchCurrentGraph itemForUUID: uuid];
-            if (existingItem == nil
-                || ![existingItem isEqual: replacementItem])
-            {
-                [necessaryItems addObject: replacementItem];
-            }
-        }
+        COItemGraph *currentGraph =
+            [aContext.store itemGraphForRevisionUUID: branchCurrentRevisionUUID
+                                      persistentRoot: _persistentRootUUID
+                                 restrictToItemUUIDs: [self modifiedItemUUIDsAssumingEditingContext: aContext]];
+        COItemGraph *result = [self itemGraphBySelectivelyApplyingToItemGraph: currentGraph
+                                                       assumingEditingContext: aContext];
 
         // Replace result with just the necessary items
-        result = [[COItemGraph alloc] initWithItems: necessaryItems
+        result = [[COItemGraph alloc] initWithItems: itemsNotEqualToCurrentItems(result, currentGraph)
                                        rootItemUUID: result.rootItemUUID];
+        [self discardWholeItemGraphs];
+
+        ETUUID *newRevisionUUID = [ETUUID UUID];
 
         [txn writeRevisionWithModifiedItems: result
                                revisionUUID: newRevisionUUID
@@ -345,6 +494,9 @@ static NSString *const kCOCommandNewHeadRevisionID = @"COCommandNewHeadRevisionI
     aCopy->_newRevisionUUID = _newRevisionUUID;
     aCopy->_oldHeadRevisionUUID = _oldHeadRevisionUUID;
     aCopy->_newHeadRevisionUUID = _newHeadRevisionUUID;
+    aCopy->_modifiedItemGraphsByRevisionUUID = _modifiedItemGraphsByRevisionUUID;
+    aCopy->_selectiveApplyDiff = _selectiveApplyDiff;
+    aCopy->_loadedWholeItemGraphs = _loadedWholeItemGraphs;
     return aCopy;
 }
 
@@ -88,6 +88,24 @@ NS_ASSUME_NONNULL_BEGIN
  * much as possible.
  */
 @property (nonatomic, readonly) NSArray<id <COTrackNode>> *nodes;
+/**
+ * Returns the nodes in the given range on the track.
+ *
+ * Unlike -nodes, doesn't copy the whole node list, so a history UI can show
+ * a window on a long track cheaply.
+ *
+ * For a range that goes beyond the track end, raises an NSRangeException.
+ *
+ * See also -count and -indexOfNode:.
+ */
+- (NSArray<id <COTrackNode>> *)nodesInRange: (NSRange)range;
+/**
+ * Returns the position of the node on the track, or NSNotFound if the node
+ * doesn't belong to the track.
+ *
+ * The node is looked up by UUID, so this doesn't scan the track.
+ */
+- (NSUInteger)indexOfNode: (id <COTrackNode>)aNode;
 
 /**
  * Returns the node that follows aNode on the track when back is NO, otherwise
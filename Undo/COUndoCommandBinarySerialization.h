@@ -0,0 +1,38 @@
+/**
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Serializes the JSON object of an undo command (or its metadata) into the
+ * binary format stored by COUndoTrackStore.
+ *
+ * The data starts with a format byte, followed by the tokens written with
+ * COBinaryWriter.h functions (the same tokens than COItem+Binary). Strings
+ * that represent UUIDs are written as 16 raw bytes. JSON has no data values,
+ * so booleans are written as one byte data tokens, and are decoded as
+ * booleans rather than integers.
+ *
+ * If compressed is YES and the encoded object is large enough, the tokens are
+ * compressed with zlib when it makes them smaller.
+ *
+ * For an object that is not a valid JSON object, raises a
+ * NSInvalidArgumentException.
+ */
+NSData *COUndoCommandDataWithJSONObject(id JSONObject, BOOL compressed);
+/**
+ * Deserializes data returned by COUndoCommandDataWithJSONObject() into a JSON
+ * object.
+ *
+ * For data that was serialized with CODataWithJSONObject() (undo track stores
+ * created with older CoreObject versions), parses it as JSON.
+ */
+id COUndoCommandJSONObjectWithData(NSData *data);
+
+NS_ASSUME_NONNULL_END
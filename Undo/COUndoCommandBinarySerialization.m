@@ -0,0 +1,370 @@
+/*
+    Copyright (C) 2026 agent <agent@local>
+
+    Date:  October 2026
+    License:  MIT  (see COPYING)
+ */
+
+#import "COUndoCommandBinarySerialization.h"
+#import "COBinaryWriter.h"
+#import "COBinaryReader.h"
+#import "COJSONSerialization.h"
+#import <EtoileFoundation/EtoileFoundation.h>
+#include <zlib.h>
+
+/**
+ * Encoded commands smaller than this are not worth compressing.
+ */
+static const NSUInteger COUndoCommandCompressionThreshold = 512;
+
+typedef NS_ENUM(uint8_t, COUndoCommandDataFormat)
+{
+    /** Followed by the tokens */
+    COUndoCommandDataFormatBinary = 'b',
+    /** Followed by the 32-bit big-endian length of the tokens, then the
+        compressed tokens */
+    COUndoCommandDataFormatCompressedBinary = 'z'
+};
+
+static inline uint32_t readUint32(const unsigned char *bytes)
+{
+    uint32_t unswapped;
+    memcpy(&unswapped, bytes, 4);
+    return NSSwapBigIntToHost(unswapped);
+}
+
+static inline void writeUint32(unsigned char *bytes, uint32_t value)
+{
+    uint32_t swapped = NSSwapHostIntToBig(value);
+    memcpy(bytes, &swapped, 4);
+}
+
+// Writing
+
+static inline BOOL isHexCharacter(unichar c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * Returns the UUID represented by the string, or nil if the string is not a
+ * UUID string that -[ETUUID stringValue] would return unchanged.
+ */
+static ETUUID *UUIDFromString(NSString *aString)
+{
+    if (aString.length != 36)
+        return nil;
+
+    for (NSUInteger i = 0; i < 36; i++)
+    {
+        const unichar c = [aString characterAtIndex: i];
+        const BOOL isDash = (i == 8 || i == 13 || i == 18 || i == 23);
+
+        if (isDash ? c != '-' : !isHexCharacter(c))
+            return nil;
+    }
+
+    ETUUID *uuid = [ETUUID UUIDWithString: aString];
+    return [uuid.stringValue isEqualToString: aString] ? uuid : nil;
+}
+
+/**
+ * Returns whether the number is a boolean (e.g. as returned by JSON parsers).
+ *
+ * -objCType can't tell booleans from char numbers, so we check the class
+ * +[NSNumber numberWithBool:] returns (__NSCFBoolean on Mac OS X, NSBoolNumber
+ * on GNUstep).
+ */
+static inline BOOL isBooleanNumber(NSNumber *aNumber)
+{
+    return [aNumber isKindOfClass: [@YES class]];
+}
+
+static void writeJSONObject(co_buffer_t *dest, id anObject)
+{
+    if ([anObject isKindOfClass: [NSDictionary class]])
+    {
+        co_buffer_begin_object(dest);
+        [anObject enumerateKeysAndObjectsUsingBlock: ^(id key, id value, BOOL *stop)
+        {
+            co_buffer_store_string(dest, key);
+            writeJSONObject(dest, value);
+        }];
+        co_buffer_end_object(dest);
+    }
+    else if ([anObject isKindOfClass: [NSArray class]])
+    {
+        co_buffer_begin_array(dest);
+        for (id element in anObject)
+        {
+            writeJSONObject(dest, element);
+        }
+        co_buffer_end_array(dest);
+    }
+    else if ([anObject isKindOfClass: [NSString class]])
+    {
+        ETUUID *uuid = UUIDFromString(anObject);
+
+        if (uuid != nil)
+        {
+            co_buffer_store_uuid(dest, uuid);
+        }
+        else
+        {
+            co_buffer_store_string(dest, anObject);
+        }
+    }
+    else if ([anObject isKindOfClass: [NSNumber class]])
+    {
+        const char *type = [anObject objCType];
+
+        if (isBooleanNumber(anObject))
+        {
+            const unsigned char value = [anObject boolValue];
+            co_buffer_store_bytes(dest, &value, 1);
+        }
+        else if (strcmp(type, @encode(double)) == 0 || strcmp(type, @encode(float)) == 0)
+        {
+            co_buffer_store_double(dest, [anObject doubleValue]);
+        }
+        else
+        {
+            co_buffer_store_integer(dest, [anObject longLongValue]);
+        }
+    }
+    else if ([anObject isKindOfClass: [NSNull class]])
+    {
+        co_buffer_store_null(dest);
+    }
+    else
+    {
+        [NSException raise: NSInvalidArgumentException
+                    format: @"Unsupported JSON object class: %@", [anObject class]];
+    }
+}
+
+/**
+ * Returns nil when compression doesn't make the tokens smaller.
+ */
+static NSData *compressedDataWithTokens(const unsigned char *tokens, size_t length)
+{
+    const size_t headerLength = 1 + 4;
+    uLongf compressedLength = compressBound(length);
+    NSMutableData *data = [NSMutableData dataWithLength: headerLength + compressedLength];
+    unsigned char *bytes = data.mutableBytes;
+
+    if (compress2(bytes + headerLength, &compressedLength, tokens, length, Z_DEFAULT_COMPRESSION) != Z_OK
+        || compressedLength >= length)
+    {
+        return nil;
+    }
+
+    bytes[0] = COUndoCommandDataFormatCompressedBinary;
+    writeUint32(bytes + 1, (uint32_t)length);
+    data.length = headerLength + compressedLength;
+
+    return data;
+}
+
+NSData *COUndoCommandDataWithJSONObject(id JSONObject, BOOL compressed)
+{
+    NILARG_EXCEPTION_TEST(JSONObject);
+
+    co_buffer_t buffer;
+    co_buffer_init(&buffer);
+    NSData *data = nil;
+
+    @try
+    {
+        co_buffer_store_uint8(&buffer, COUndoCommandDataFormatBinary);
+        writeJSONObject(&buffer, JSONObject);
+
+        const unsigned char *bytes = co_buffer_get_data(&buffer);
+        const size_t length = co_buffer_get_length(&buffer);
+
+        if (compressed && length - 1 >= COUndoCommandCompressionThreshold)
+        {
+            data = compressedDataWithTokens(bytes + 1, length - 1);
+        }
+        if (data == nil)
+        {
+            data = [NSData dataWithBytes: bytes length: length];
+        }
+    }
+    @finally
+    {
+        co_buffer_free(&buffer);
+    }
+
+    return data;
+}
+
+// Reading
+
+/**
+ * Builds the JSON object while the tokens are read.
+ */
+@interface COJSONObjectBuilder : NSObject
+{
+    NSMutableArray *_containers;
+    NSMutableArray *_pendingKeys;
+    id _JSONObject;
+}
+
+@property (nonatomic, readonly) id JSONObject;
+
+- (void)addValue: (id)aValue;
+- (void)beginContainer: (id)aContainer;
+- (void)endContainer;
+
+@end
+
+@implementation COJSONObjectBuilder
+
+@synthesize JSONObject = _JSONObject;
+
+- (instancetype)init
+{
+    SUPERINIT;
+    _containers = [NSMutableArray new];
+    _pendingKeys = [NSMutableArray new];
+    return self;
+}
+
+- (void)addValue: (id)aValue
+{
+    id container = _containers.lastObject;
+
+    if (container == nil)
+    {
+        _JSONObject = aValue;
+    }
+    else if ([container isKindOfClass: [NSMutableArray class]])
+    {
+        [container addObject: aValue];
+    }
+    else if (_pendingKeys.lastObject == [NSNull null])
+    {
+        // Keys are always strings, even when they could be written as UUIDs
+        [_pendingKeys replaceObjectAtIndex: _pendingKeys.count - 1 withObject: aValue];
+    }
+    else
+    {
+        container[_pendingKeys.lastObject] = aValue;
+        [_pendingKeys replaceObjectAtIndex: _pendingKeys.count - 1 withObject: [NSNull null]];
+    }
+}
+
+- (void)beginContainer: (id)aContainer
+{
+    [_containers addObject: aContainer];
+    [_pendingKeys addObject: [NSNull null]];
+}
+
+- (void)endContainer
+{
+    id container = _containers.lastObject;
+
+    [_containers removeLastObject];
+    [_pendingKeys removeLastObject];
+    [self addValue: container];
+}
+
+@end
+
+static void readInt64(void *context, int64_t value)
+{
+    [(__bridge COJSONObjectBuilder *)context addValue: @(value)];
+}
+
+static void readDouble(void *context, double value)
+{
+    [(__bridge COJSONObjectBuilder *)context addValue: @(value)];
+}
+
+static void readString(void *context, NSString *value)
+{
+    [(__bridge COJSONObjectBuilder *)context addValue: value];
+}
+
+static void readUUID(void *context, ETUUID *uuid)
+{
+    [(__bridge COJSONObjectBuilder *)context addValue: uuid.stringValue];
+}
+
+static void readBytes(void *context, const unsigned char *bytes, size_t length)
+{
+    if (length != 1)
+    {
+        [NSException raise: NSInternalInconsistencyException
+                    format: @"Unexpected data in an undo command"];
+    }
+    [(__bridge COJSONObjectBuilder *)context addValue: (bytes[0] != 0 ? @YES : @NO)];
+}
+
+static void readBeginObject(void *context)
+{
+    [(__bridge COJSONObjectBuilder *)context beginContainer: [NSMutableDictionary new]];
+}
+
+static void readBeginArray(void *context)
+{
+    [(__bridge COJSONObjectBuilder *)context beginContainer: [NSMutableArray new]];
+}
+
+static void readEndContainer(void *context)
+{
+    [(__bridge COJSONObjectBuilder *)context endContainer];
+}
+
+static void readNull(void *context)
+{
+    [(__bridge COJSONObjectBuilder *)context addValue: [NSNull null]];
+}
+
+static id JSONObjectWithTokens(const unsigned char *tokens, size_t length)
+{
+    COJSONObjectBuilder *builder = [COJSONObjectBuilder new];
+    co_reader_callback_t callbacks = {
+        readInt64,
+        readDouble,
+        readString,
+        readUUID,
+        readBytes,
+        readBeginObject,
+        readEndContainer,
+        readBeginArray,
+        readEndContainer,
+        readNull
+    };
+
+    co_reader_read(tokens, length, (__bridge void *)builder, callbacks);
+    return builder.JSONObject;
+}
+
+id COUndoCommandJSONObjectWithData(NSData *data)
+{
+    NILARG_EXCEPTION_TEST(data);
+
+    const unsigned char *bytes = data.bytes;
+    const NSUInteger length = data.length;
+
+    if (length > 0 && bytes[0] == COUndoCommandDataFormatBinary)
+    {
+        return JSONObjectWithTokens(bytes + 1, length - 1);
+    }
+    else if (length > 5 && bytes[0] == COUndoCommandDataFormatCompressedBinary)
+    {
+        uLongf tokensLength = readUint32(bytes + 1);
+        NSMutableData *tokens = [NSMutableData dataWithLength: tokensLength];
+
+        if (uncompress(tokens.mutableBytes, &tokensLength, bytes + 5, length - 5) != Z_OK
+            || tokensLength != tokens.length)
+        {
+            [NSException raise: NSInternalInconsistencyException
+                        format: @"Failed to decompress an undo command"];
+        }
+        return JSONObjectWithTokens(tokens.bytes, tokensLength);
+    }
+    return COJSONObjectWithData(data, NULL);
+}
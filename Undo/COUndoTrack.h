@@ -23,7 +23,7 @@ NS_ASSUME_NONNULL_BEGIN
                  undoTrack: (nullable COUndoTrack *)undoTrack
                      error: (COError *_Nullable *_Nullable)anError;
 - (void)applyCommand: (COCommandGroup *)command;
-- (void)applyCommand: (COCommandGroup *)command
+- (void)applyCommand: (COCommand *)command
   toStoreTransaction: (COStoreTransaction *)txn
 withRevisionMetadata: (nullable NSDictionary<NSString *, id> *)metadata;
 @end
@@ -111,9 +111,11 @@ extern NSString *const kCOUndoTrackName;
 @private
     NSString *_name;
     NSMutableArray *_nodesOnCurrentUndoBranch;
+    NSMutableDictionary *_nodeIndexesByUUID;
     NSMutableDictionary *_commandsByUUID;
     id <COUndoTrackContext> _editingContext;
     NSMutableDictionary *_trackStateForName;
+    BOOL _allCommandsLoaded;
 
     BOOL _coalescing;
     ETUUID *_lastCoalescedCommandUUID;
@@ -15,6 +15,7 @@
 #import "COCommandGroup.h"
 #import "COEndOfUndoTrackPlaceholderNode.h"
 #import "COCommandSetCurrentVersionForBranch.h"
+#import "COCommandNetEffect.h"
 #import "COStoreTransaction.h"
 
 extern NSString *const kCOCommandUUID;
@@ -115,7 +116,7 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
 
 - (id <COTrackNode>)nextNodeOnTrackFrom: (id <COTrackNode>)aNode backwards: (BOOL)back
 {
-    NSInteger nodeIndex = [self.nodes indexOfObject: aNode];
+    NSInteger nodeIndex = [self indexOfNode: aNode];
 
     if (nodeIndex == NSNotFound)
     {
@@ -133,13 +134,13 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
         nodeIndex++;
     }
 
-    BOOL hasNoPreviousOrNextNode = (nodeIndex < 0 || nodeIndex >= self.nodes.count);
+    BOOL hasNoPreviousOrNextNode = (nodeIndex < 0 || nodeIndex >= _nodesOnCurrentUndoBranch.count);
 
     if (hasNoPreviousOrNextNode)
     {
         return nil;
     }
-    return self.nodes[nodeIndex];
+    return _nodesOnCurrentUndoBranch[nodeIndex];
 }
 
 
@@ -152,6 +153,26 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
     return [_nodesOnCurrentUndoBranch copy];
 }
 
+- (NSArray *)nodesInRange: (NSRange)range
+{
+    [self loadIfNeeded];
+    return [_nodesOnCurrentUndoBranch subarrayWithRange: range];
+}
+
+- (NSUInteger)indexOfNode: (id <COTrackNode>)aNode
+{
+    NILARG_EXCEPTION_TEST(aNode);
+    [self loadIfNeeded];
+
+    NSNumber *index = _nodeIndexesByUUID[aNode.UUID];
+
+    if (index == nil)
+        return NSNotFound;
+
+    ETAssert([_nodesOnCurrentUndoBranch[index.unsignedIntegerValue] isEqual: aNode]);
+    return index.unsignedIntegerValue;
+}
+
 - (id <COTrackNode>)currentNode
 {
     id <COTrackNode> result = [self currentCommandGroup];
@@ -163,8 +184,8 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
 - (BOOL)setCurrentNode: (id <COTrackNode>)node
 {
     [self endCoalescing];
-    const NSUInteger currentIndex = [_nodesOnCurrentUndoBranch indexOfObject: [self currentNode]];
-    const NSUInteger targetIndex = [_nodesOnCurrentUndoBranch indexOfObject: node];
+    const NSUInteger currentIndex = [self indexOfNode: [self currentNode]];
+    const NSUInteger targetIndex = [self indexOfNode: node];
 
     ETAssert(currentIndex != NSNotFound);
 
@@ -237,10 +258,11 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
     {
         if ([temp isEqual: node])
         {
-            return result;
+            // Collected from the target node backwards
+            return [[result reverseObjectEnumerator] allObjects];
         }
 
-        [result insertObject: temp atIndex: 0];
+        [result addObject: temp];
     }
 
     [NSException raise: NSGenericException format: @"Didn't find target node"];
@@ -250,14 +272,14 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
 - (BOOL)setCurrentNodeToDivergentNode: (id <COTrackNode>)node
 {
     NILARG_EXCEPTION_TEST(node);
-    ETAssert(![_nodesOnCurrentUndoBranch containsObject: node]);
+    ETAssert([self indexOfNode: node] == NSNotFound);
     ETAssert(![node isEqual: [self currentNode]]);
 
     id <COTrackNode> commonAncestor = [self commonAncestorForNode: [self currentNode]
                                                           andNode: node];
 
-    const NSUInteger commonAncestorIndex = [_nodesOnCurrentUndoBranch indexOfObject: commonAncestor];
-    const NSUInteger currentIndex = [_nodesOnCurrentUndoBranch indexOfObject: [self currentNode]];
+    const NSUInteger commonAncestorIndex = [self indexOfNode: commonAncestor];
+    const NSUInteger currentIndex = [self indexOfNode: [self currentNode]];
     ETAssert(commonAncestorIndex != NSNotFound);
     ETAssert(currentIndex != NSNotFound);
 
@@ -366,8 +388,9 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
 
     // Check our state
     COUndoTrackState *storeState = [self.store stateForTrackName: _name];
-    if (!([state.headCommandUUID isEqual: storeState.headCommandUUID]
-          && [state.currentCommandUUID isEqual: storeState.currentCommandUUID]))
+    const BOOL isStale = !([state.headCommandUUID isEqual: storeState.headCommandUUID]
+                           && [state.currentCommandUUID isEqual: storeState.currentCommandUUID]);
+    if (isStale)
     {
         NSLog(@"In-memory snapshot is stale");
         state = storeState;
@@ -427,10 +450,48 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
 
     ETAssert([self.store commitTransactionWithCompletionHandler: ^()
     {
-        [self reloadNodesOnCurrentBranch];
+        if (isStale || ![self appendRecordedCommand: aCommand])
+        {
+            [self reloadNodesOnCurrentBranch];
+        }
+        else
+        {
+            [self didUpdate];
+        }
     }]);
 }
 
+/**
+ * Updates the in-memory nodes for a command just recorded, without reloading
+ * the track.
+ *
+ * The nodes after the command parent (the redo nodes or the coalesced
+ * command) are discarded, and the command is appended.
+ *
+ * Returns NO if the command parent is not on the current branch, in this case
+ * the track must be reloaded.
+ */
+- (BOOL)appendRecordedCommand: (COCommandGroup *)aCommand
+{
+    NSNumber *parentIndex = _nodeIndexesByUUID[aCommand.parentUUID];
+
+    if (parentIndex == nil)
+        return NO;
+
+    const NSUInteger start = parentIndex.unsignedIntegerValue + 1;
+    const NSRange discardedRange = NSMakeRange(start, _nodesOnCurrentUndoBranch.count - start);
+
+    for (id <COTrackNode> node in [_nodesOnCurrentUndoBranch subarrayWithRange: discardedRange])
+    {
+        [_nodeIndexesByUUID removeObjectForKey: node.UUID];
+    }
+    [_nodesOnCurrentUndoBranch removeObjectsInRange: discardedRange];
+
+    _nodeIndexesByUUID[aCommand.UUID] = @(_nodesOnCurrentUndoBranch.count);
+    [_nodesOnCurrentUndoBranch addObject: aCommand];
+    return YES;
+}
+
 - (void)clear
 {
     [self.store beginTransaction];
@@ -438,6 +499,8 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
     ETAssert([self.store commitTransactionWithCompletionHandler: ^() { }]);
 
     _nodesOnCurrentUndoBranch = nil;
+    _nodeIndexesByUUID = nil;
+    _allCommandsLoaded = NO;
     [_commandsByUUID removeAllObjects];
     [_trackStateForName removeAllObjects];
 }
@@ -445,6 +508,7 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
 - (NSArray *)allCommands
 {
     [self loadIfNeeded];
+    [self loadAllCommandsIfNeeded];
 
     NSSortDescriptor *descriptor = [NSSortDescriptor sortDescriptorWithKey: @"sequenceNumber"
                                                                  ascending: YES];
@@ -518,29 +582,51 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
 
 /**
  * Undo and redo the given commands, in order
+ *
+ * The commands are composed into their net effect per branch and persistent
+ * root, so jumping across many nodes results in a single version change per
+ * branch (see COCommandNetEffect).
  */
 - (void)undo: (NSArray *)undo1 redo: (NSArray *)redo1 undo: (NSArray *)undo2 redo: (NSArray *)redo2
 {
     ETAssert(undo1.count == 0 || redo1.count == 0);
     ETAssert(undo2.count == 0 || redo2.count == 0);
 
-    COStoreTransaction *txn = [COStoreTransaction new];
+    COCommandNetEffect *netEffect = [COCommandNetEffect new];
+    NSMutableSet *changedTrackNames = [NSMutableSet new];
 
     for (COCommandGroup *cmd in undo1)
     {
-        [self doCommand: cmd inverse: YES addToStoreTransaction: txn];
+        [self doCommand: cmd inverse: YES addToNetEffect: netEffect changedTrackNames: changedTrackNames];
     }
     for (COCommandGroup *cmd in redo1)
     {
-        [self doCommand: cmd inverse: NO addToStoreTransaction: txn];
+        [self doCommand: cmd inverse: NO addToNetEffect: netEffect changedTrackNames: changedTrackNames];
     }
     for (COCommandGroup *cmd in undo2)
     {
-        [self doCommand: cmd inverse: YES addToStoreTransaction: txn];
+        [self doCommand: cmd inverse: YES addToNetEffect: netEffect changedTrackNames: changedTrackNames];
     }
     for (COCommandGroup *cmd in redo2)
     {
-        [self doCommand: cmd inverse: NO addToStoreTransaction: txn];
+        [self doCommand: cmd inverse: NO addToNetEffect: netEffect changedTrackNames: changedTrackNames];
+    }
+
+    COStoreTransaction *txn = [COStoreTransaction new];
+
+    [netEffect enumerateCommandsUsingBlock: ^(COCommand *command, NSDictionary *metadata)
+    {
+        command.parentUndoTrack = self;
+        [_context applyCommand: command
+            toStoreTransaction: txn
+          withRevisionMetadata: metadata];
+    }];
+
+    // Write out the new store state, once per track
+
+    for (NSString *trackName in changedTrackNames)
+    {
+        [self.store setTrackState: _trackStateForName[trackName]];
     }
 
     [self commitStoreTransaction: txn];
@@ -566,12 +652,12 @@ NSString *const kCOUndoTrackName = @"COUndoTrackName";
     ETAssert(ok);
 }
 
-- (void)    doCommand: (COCommandGroup *)aCommand
-              inverse: (BOOL)inverse
-addToStoreTransaction: (COStoreTransaction *)txn
+- (void)doCommand: (COCommandGroup *)aCommand
+          inverse: (BOOL)inverse
+   addToNetEffect: (COCommandNetEffect *)netEffect
+changedTrackNames: (NSMutableSet *)changedTrackNames
 {
     COCommandGroup *commandToApply = (inverse ? aCommand.inverse : aCommand);
-    commandToApply.parentUndoTrack = self;
 
     NSMutableDictionary *md = [aCommand.metadata mutableCopy];
     NSNumber *inversedValue = aCommand.metadata[kCOCommitMetadataUndoInitialBaseInversed];
@@ -586,9 +672,7 @@ addToStoreTransaction: (COStoreTransaction *)txn
         [md addEntriesFromDictionary: self.customRevisionMetadata];
     }
 
-    [_context applyCommand: commandToApply
-        toStoreTransaction: txn
-      withRevisionMetadata: md];
+    [netEffect addCommand: commandToApply withRevisionMetadata: md];
 
     // Update the current command for this track.
 
@@ -600,8 +684,17 @@ addToStoreTransaction: (COStoreTransaction *)txn
     if ([newCurrentNodeUUID isEqual: [COEndOfUndoTrackPlaceholderNode sharedInstance].UUID])
         newCurrentNodeUUID = nil;
 
+    /* The current command is always equal to or a parent of the head command,
+       so undoing it cannot move the head. When redoing a command on the
+       current branch, the head doesn't move either (for a pattern track,
+       the current branch mixes several tracks, so we must walk the parents). */
+    const BOOL isOnCurrentBranch = (newCurrentNodeUUID != nil
+        && ![self isKindOfClass: [COPatternUndoTrack class]]
+        && _nodeIndexesByUUID[newCurrentNodeUUID] != nil);
     ETUUID *newHeadNodeUUID;
-    if (newCurrentNodeUUID == nil
+    if (inverse
+        || isOnCurrentBranch
+        || newCurrentNodeUUID == nil
         || [self isCommandUUID: newCurrentNodeUUID
   equalToOrParentOfCommandUUID: currentTrackState.headCommandUUID])
     {
@@ -612,15 +705,13 @@ addToStoreTransaction: (COStoreTransaction *)txn
         newHeadNodeUUID = newCurrentNodeUUID;
     }
 
-    // Write out the new store state
-
     COUndoTrackState *newStoreState = [COUndoTrackState new];
     newStoreState.trackName = trackName;
     newStoreState.currentCommandUUID = newCurrentNodeUUID;
     newStoreState.headCommandUUID = newHeadNodeUUID;
 
-    [self.store setTrackState: newStoreState];
     _trackStateForName[trackName] = newStoreState;
+    [changedTrackNames addObject: trackName];
 }
 
 - (void)setParentPointersForCommandGroup: (COCommandGroup *)aCommand
@@ -690,42 +781,38 @@ addToStoreTransaction: (COStoreTransaction *)txn
 
         for (COUndoTrackState *trackState in _trackStateForName.allValues)
         {
+            if (trackState.headCommandUUID == nil)
+                continue;
+
             NSMutableArray *targetArray = redoNodes;
-            ETUUID *commandUUID = trackState.headCommandUUID;
+            // Retrieve the commands from the head back to the oldest one in a
+            // single query, without decoding them
+            NSArray *skeletons = [self.store commandSkeletonsUpToCommandUUID: trackState.headCommandUUID];
 
-            while (commandUUID != nil && ![commandUUID isEqual: [COEndOfUndoTrackPlaceholderNode sharedInstance].UUID])
+            for (COUndoTrackSerializedCommand *skeleton in [skeletons reverseObjectEnumerator])
             {
-                if ([commandUUID isEqual: trackState.currentCommandUUID])
+                if ([skeleton.UUID isEqual: trackState.currentCommandUUID])
                     targetArray = undoNodes;
 
-                COCommandGroup *command = [self commandForUUID: commandUUID];
-                BOOL isDeletedCommand = (command == nil);
-
-                if (isDeletedCommand)
-                {
-                    break;
-                }
-
-                ETAssert([command.UUID isEqual: commandUUID]);
-
-                [targetArray addObject: command];
-                commandUUID = command.parentUUID;
-            }
-
-            // Also make sure all commands have been loaded, including divergent ones
-            for (ETUUID *uuid in [self.store allCommandUUIDsOnTrackWithName: _name])
-            {
-                [self commandForUUID: uuid];
+                [targetArray addObject: [self commandForSerializedCommand: skeleton]];
             }
         }
 
-        // Now, sort the nodes
+        // Now, sort the nodes (each track is already sorted)
 
-        [undoNodes sortUsingDescriptors:
-            @[[NSSortDescriptor sortDescriptorWithKey: @"sequenceNumber" ascending: YES]]];
+        if (_trackStateForName.count > 1)
+        {
+            [undoNodes sortUsingDescriptors:
+                @[[NSSortDescriptor sortDescriptorWithKey: @"sequenceNumber" ascending: YES]]];
 
-        [redoNodes sortUsingDescriptors:
-            @[[NSSortDescriptor sortDescriptorWithKey: @"sequenceNumber" ascending: YES]]];
+            [redoNodes sortUsingDescriptors:
+                @[[NSSortDescriptor sortDescriptorWithKey: @"sequenceNumber" ascending: YES]]];
+        }
+        else
+        {
+            [undoNodes setArray: [[undoNodes reverseObjectEnumerator] allObjects]];
+            [redoNodes setArray: [[redoNodes reverseObjectEnumerator] allObjects]];
+        }
 
         [_nodesOnCurrentUndoBranch addObject: [COEndOfUndoTrackPlaceholderNode sharedInstance]];
         [_nodesOnCurrentUndoBranch addObjectsFromArray: undoNodes];
@@ -735,12 +822,24 @@ addToStoreTransaction: (COStoreTransaction *)txn
     {
         [_nodesOnCurrentUndoBranch setArray: @[[COEndOfUndoTrackPlaceholderNode sharedInstance]]];
     }
+    [self reloadNodeIndexes];
     [self didUpdate];
 }
 
+- (void)reloadNodeIndexes
+{
+    _nodeIndexesByUUID = [[NSMutableDictionary alloc] initWithCapacity: _nodesOnCurrentUndoBranch.count];
+
+    [_nodesOnCurrentUndoBranch enumerateObjectsUsingBlock: ^(id <COTrackNode> node, NSUInteger i, BOOL *stop)
+    {
+        _nodeIndexesByUUID[node.UUID] = @(i);
+    }];
+}
+
 - (void)reload
 {
     _nodesOnCurrentUndoBranch = [NSMutableArray new];
+    _allCommandsLoaded = NO;
 
     // May be empty if we are uncommitted
     NSArray *matchingNames = [self.store trackNamesMatchingGlobPattern: _name];
@@ -786,6 +885,38 @@ addToStoreTransaction: (COStoreTransaction *)txn
     return command;
 }
 
+/**
+ * Returns a command from the _commandsByUUID, or a command whose contents will
+ * be loaded lazily from the given skeleton if it's not present.
+ */
+- (COCommandGroup *)commandForSerializedCommand: (COUndoTrackSerializedCommand *)aSkeleton
+{
+    COCommandGroup *command = _commandsByUUID[aSkeleton.UUID];
+
+    if (command == nil)
+    {
+        command = [self loadSerializedCommand: aSkeleton];
+    }
+    return command;
+}
+
+/**
+ * Makes sure all commands have been loaded, including divergent ones.
+ *
+ * Their contents are only decoded when accessed.
+ */
+- (void)loadAllCommandsIfNeeded
+{
+    if (_allCommandsLoaded)
+        return;
+
+    for (COUndoTrackSerializedCommand *skeleton in [self.store commandSkeletonsOnTrackWithName: _name])
+    {
+        [self commandForSerializedCommand: skeleton];
+    }
+    _allCommandsLoaded = YES;
+}
+
 - (COCommandGroup *)loadSerializedCommand: (COUndoTrackSerializedCommand *)serializedCommand
 {
     COCommandGroup *command = [[COCommandGroup alloc] initWithSerializedCommand: serializedCommand
@@ -984,6 +1115,12 @@ static void coalesceOps(NSMutableArray *ops)
     return YES;
 }
 
+- (NSUInteger)count
+{
+    [self loadIfNeeded];
+    return _nodesOnCurrentUndoBranch.count;
+}
+
 - (id)content
 {
     return self.nodes;
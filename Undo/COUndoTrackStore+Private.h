@@ -30,15 +30,26 @@ extern NSString *const COUndoTrackStoreTrackCurrentCommandUUID;
  */
 extern NSString *const COUndoTrackStoreTrackCompacted;
 
+/**
+ * A command row in the undo track store.
+ *
+ * When -store is not nil, the command is a skeleton whose -JSONData and
+ * -metadata are not loaded yet, see -[COUndoTrackStore loadPayloadForCommand:].
+ */
 @interface COUndoTrackSerializedCommand : NSObject
 
-@property (nonatomic, readwrite, strong) id JSONData;
+@property (nonatomic, readwrite, strong, nullable) id JSONData;
 @property (nonatomic, readwrite, copy, nullable) NSDictionary<NSString *, id> *metadata;
 @property (nonatomic, readwrite, copy) ETUUID *UUID;
 @property (nonatomic, readwrite, copy, nullable) ETUUID *parentUUID;
 @property (nonatomic, readwrite, copy) NSString *trackName;
 @property (nonatomic, readwrite, copy) NSDate *timestamp;
 @property (nonatomic, readwrite, assign) int64_t sequenceNumber;
+/**
+ * The store from which -JSONData and -metadata can be loaded, or nil if they
+ * are already loaded.
+ */
+@property (nonatomic, readwrite, strong, nullable) COUndoTrackStore *store;
 
 @end
 
@@ -175,6 +186,37 @@ extern NSString *const COUndoTrackStoreTrackCompacted;
  * See -markCommandsAsDeletedForUUIDs:.
  */
 - (NSArray<ETUUID *> *)allCommandUUIDsOnTrackWithName: (NSString *)aName;
+/**
+ * Returns the skeletons for the given command and its ancestors, ordered by
+ * sequence number (the oldest ancestor first).
+ *
+ * The ancestors are retrieved with a single recursive query, that stops at the
+ * first command marked as deleted.
+ *
+ * The returned skeletons contain no -JSONData and -metadata, these can be
+ * loaded later with -loadPayloadForCommand:.
+ *
+ * If the UUID corresponds to a deleted command, returns an empty array.
+ */
+- (NSArray<COUndoTrackSerializedCommand *> *)commandSkeletonsUpToCommandUUID: (ETUUID *)aUUID;
+/**
+ * Returns the skeletons for all the commands on a given track, ordered by
+ * sequence number.
+ *
+ * This doesn't include commands marked as deleted.
+ *
+ * See also -commandSkeletonsUpToCommandUUID:.
+ */
+- (NSArray<COUndoTrackSerializedCommand *> *)commandSkeletonsOnTrackWithName: (NSString *)aName;
+/**
+ * Loads -JSONData and -metadata for a skeleton and sets its -store to nil.
+ *
+ * Commands marked as deleted can still be loaded, until the deletions are
+ * finalized.
+ *
+ * Returns NO if the command doesn't exist in the store anymore.
+ */
+- (BOOL)loadPayloadForCommand: (COUndoTrackSerializedCommand *)aCommand;
 
 
 /** @taskunit History Compaction Integration */
@@ -9,6 +9,7 @@
 #include <dispatch/dispatch.h>
 
 @class COUndoTrack;
+@class COSQLiteStore, COStoreMetrics;
 @class FMDatabase;
 @class ETUUID;
 
@@ -31,6 +32,12 @@ NS_ASSUME_NONNULL_BEGIN
  * at run-time and reload the instance returned by +[COUndoTrackStore defaultStore], 
  * since other applications can be using it.
  *
+ * An undo track store can also be hosted in a CoreObject store database (see
+ * -initWithStore:). For an editing context bound to this CoreObject store, each
+ * undoable commit then writes the new revisions and the undo command in a
+ * single transaction: there is a single sync to disk per commit, and a crash
+ * cannot leave the undo tracks out of sync with the store.
+ *
  * @section Current Limitations
  *
  * For now, COUndoTrackStore doesn't post distributed notifications, so undo 
@@ -50,6 +57,9 @@ NS_ASSUME_NONNULL_BEGIN
     NSMutableDictionary *_modifiedTrackStateForTrackName;
     dispatch_queue_t _queue;
     dispatch_semaphore_t _transactionLock;
+    COSQLiteStore *_hostStore;
+    BOOL _compressesCommands;
+    COStoreMetrics *_metrics;
 }
 
 
@@ -73,6 +83,22 @@ NS_ASSUME_NONNULL_BEGIN
  * raises a NSInvalidArgumentException.
  */
 - (instancetype)initWithURL: (NSURL *)aURL NS_DESIGNATED_INITIALIZER;
+/**
+ * Returns a new store whose tracks and commands are persisted in the database
+ * of the given CoreObject store.
+ *
+ * The database connection, queue and commit lock are shared with the
+ * CoreObject store. When an undo track store transaction is underway,
+ * -[COSQLiteStore commitStoreTransaction:] joins it, so the store changes and
+ * the undo track changes are committed together.
+ *
+ * Unlike the stores initialized with -initWithURL:, the undo track tables
+ * belong to the CoreObject store, so they cannot be shared with other
+ * CoreObject stores.
+ *
+ * For a nil argument, raises a NSInvalidArgumentException.
+ */
+- (instancetype)initWithStore: (COSQLiteStore *)aStore NS_DESIGNATED_INITIALIZER;
 - (instancetype)init NS_UNAVAILABLE;
 
 /** @taskunit Basic Properties */
@@ -84,6 +110,35 @@ NS_ASSUME_NONNULL_BEGIN
  * See also -initWithURL:.
  */
 @property (nonatomic, readonly) NSURL *URL;
+/**
+ * The CoreObject store hosting the undo track tables, or nil if the receiver
+ * has its own database.
+ *
+ * See also -initWithStore:.
+ */
+@property (nonatomic, readonly, nullable) COSQLiteStore *hostStore;
+/**
+ * Whether large commands are compressed when they are written to the
+ * database.
+ *
+ * Commands are always stored in a compact binary encoding. Compression
+ * reduces the database size for commands touching many objects, at the cost
+ * of some CPU time when recording and loading them.
+ *
+ * Commands already written are not rewritten when this property changes.
+ *
+ * By default, returns YES.
+ */
+@property (nonatomic, readwrite, assign) BOOL compressesCommands;
+/**
+ * The metrics where commit latencies and transaction lock waits are recorded.
+ *
+ * For an undo track store hosted in a CoreObject store, returns the metrics of
+ * the host store.
+ *
+ * See -[COSQLiteStore metrics].
+ */
+@property (nonatomic, readonly) COStoreMetrics *metrics;
 
 @end
 
@@ -8,11 +8,14 @@
 #import "COUndoTrackStore.h"
 #import "COUndoTrackStore+Private.h"
 #import "COUndoTrack.h"
+#import "COSQLiteStore+Private.h"
+#import "COStoreMetrics.h"
 #import "FMDatabase.h"
 #import "FMDatabaseAdditions.h"
 #import "CODateSerialization.h"
 #import "COEndOfUndoTrackPlaceholderNode.h"
 #import "COJSONSerialization.h"
+#import "COUndoCommandBinarySerialization.h"
 #import "COSQLiteUtilities.h"
 #import "CODistributedNotificationCenter.h"
 
@@ -26,9 +29,11 @@ NSString *const COUndoTrackStoreTrackHeadCommandUUID = @"COUndoTrackStoreTrackHe
 NSString *const COUndoTrackStoreTrackCurrentCommandUUID = @"COUndoTrackStoreTrackCurrentCommandUUID";
 NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacted";
 
+static const int currentVersion = 2;
+
 @implementation COUndoTrackSerializedCommand
 
-@synthesize JSONData, metadata, UUID, parentUUID, trackName, timestamp, sequenceNumber;
+@synthesize JSONData, metadata, UUID, parentUUID, trackName, timestamp, sequenceNumber, store;
 
 @end
 
@@ -109,12 +114,20 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
  already done.) Both databases are still in a consistent state. 
  Also, as far as I understand, this should be really rare in practice
  ( BEGIN EXCLUSIVE TRANSACTION succeeds, some writes succeed, but the COMMIT fails).
+
+ For an undo track store hosted in a COSQLiteStore database, the transaction
+ above is a shared transaction of the COSQLiteStore, and the editing context
+ changes are committed as a savepoint inside it, so both databases can never
+ get out of sync. Attaching undo.sqlite to the store database would not be
+ enough: in WAL mode, SQLite doesn't guarantee a transaction spanning several
+ attached databases to be atomic.
  
  */
 
 @implementation COUndoTrackStore
 
-@synthesize URL = _URL;
+@synthesize URL = _URL, hostStore = _hostStore, compressesCommands = _compressesCommands;
+@synthesize metrics = _metrics;
 
 + (NSURL *)defaultStoreURL
 {
@@ -143,6 +156,8 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
     SUPERINIT;
 
     _URL = aURL;
+    _compressesCommands = YES;
+    _metrics = [COStoreMetrics new];
     _modifiedTrackStateForTrackName = [NSMutableDictionary new];
     _queue = dispatch_queue_create([[NSString stringWithFormat: @"COUndoTrackStore-%p",
                                                                 self] UTF8String], NULL);
@@ -185,6 +200,44 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
     return self;
 }
 
+- (instancetype)initWithStore: (COSQLiteStore *)aStore
+{
+    NILARG_EXCEPTION_TEST(aStore);
+    SUPERINIT;
+
+    _URL = aStore.URL;
+    _hostStore = aStore;
+    _compressesCommands = YES;
+    _metrics = aStore.metrics;
+    _modifiedTrackStateForTrackName = [NSMutableDictionary new];
+    _queue = aStore.queue;
+    _transactionLock = aStore.commitLock;
+#ifdef GNUSTEP
+    dispatch_retain(_queue);
+    dispatch_retain(_transactionLock);
+#endif
+
+    __block BOOL ok = YES;
+
+    // The store could be committing in another thread
+    dispatch_semaphore_wait(_transactionLock, DISPATCH_TIME_FOREVER);
+
+    dispatch_sync(_queue,
+        ^()
+        {
+            _db = aStore.database;
+            ok = [self setupSchema];
+        });
+
+    dispatch_semaphore_signal(_transactionLock);
+
+    if (!ok)
+    {
+        return nil;
+    }
+    return self;
+}
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wnonnull"
 
@@ -199,10 +252,14 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
 {
     assert(dispatch_get_current_queue() != _queue);
 
-    dispatch_sync(_queue, ^()
+    // The database belongs to the host store
+    if (_hostStore == nil)
     {
-        [_db close];
-    });
+        dispatch_sync(_queue, ^()
+        {
+            [_db close];
+        });
+    }
 
 #ifdef GNUSTEP
     // For GNUstep, ARC doesn't manage libdispatch objects since libobjc2 doesn't support it 
@@ -212,6 +269,82 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
 #endif
 }
 
+/**
+ * The CoreObject store has its own storeMetadata table.
+ */
+- (NSString *)metadataTableName
+{
+    return (_hostStore != nil ? @"undoStoreMetadata" : @"storeMetadata");
+}
+
+/**
+ * Version 2 replaced the JSON encoding of commands with
+ * COUndoCommandDataWithJSONObject().
+ *
+ * Returns NO if a command can't be migrated, the caller must then roll back
+ * the transaction.
+ */
+- (BOOL)migrateFromVersion: (int)aVersion
+{
+    assert(dispatch_get_current_queue() == _queue);
+    ETAssert([_db inTransaction]);
+
+    if (aVersion < 2)
+    {
+        const int batchSize = 1000;
+        int64_t lastID = 0;
+        BOOL done = NO;
+
+        while (!done)
+        {
+            NSMutableArray *rows = [NSMutableArray new];
+            FMResultSet *rs = [_db executeQuery: @"SELECT id, data, metadata FROM commands "
+                                                  "WHERE id > ? ORDER BY id LIMIT ?", @(lastID), @(batchSize)];
+
+            while ([rs next])
+            {
+                NSData *metadata = [rs dataForColumnIndex: 2];
+
+                [rows addObject: @[@([rs int64ForColumnIndex: 0]),
+                                   [rs dataForColumnIndex: 1],
+                                   (metadata != nil ? metadata : [NSNull null])]];
+            }
+            [rs close];
+
+            for (NSArray *row in rows)
+            {
+                NSData *data = [self serialize: COJSONObjectWithData(row[1], NULL)];
+                id metadata = row[2];
+
+                if (metadata != [NSNull null])
+                {
+                    metadata = [self serialize: COJSONObjectWithData(metadata, NULL)];
+                }
+
+                if (data == nil || metadata == nil)
+                {
+                    NSLog(@"Error, undo track store command %@ cannot be migrated, its JSON is invalid", row[0]);
+                    return NO;
+                }
+
+                if (![_db executeUpdate: @"UPDATE commands SET data = ?, metadata = ? WHERE id = ?",
+                                         data, metadata, row[0]])
+                {
+                    NSLog(@"Error %d migrating undo track store command %@: %@",
+                          [_db lastErrorCode], row[0], [_db lastErrorMessage]);
+                    return NO;
+                }
+            }
+
+            lastID = [rows.lastObject[0] longLongValue];
+            done = (rows.count < batchSize);
+        }
+    }
+
+    return [_db executeUpdate: [NSString stringWithFormat: @"UPDATE %@ SET version = ?", self.metadataTableName],
+                               @(currentVersion)];
+}
+
 - (BOOL)setupSchema
 {
     assert(dispatch_get_current_queue() == _queue);
@@ -229,17 +362,21 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
 
     /* Store Metadata table (including schema version) */
 
-    if (![_db tableExists: @"storeMetadata"])
+    NSString *metadataTable = self.metadataTableName;
+    int version = currentVersion;
+
+    if (![_db tableExists: metadataTable])
     {
-        [_db executeUpdate: @"CREATE TABLE storeMetadata(version INTEGER)"];
-        [_db executeUpdate: @"INSERT INTO storeMetadata VALUES(1)"];
+        [_db executeUpdate: [NSString stringWithFormat: @"CREATE TABLE %@(version INTEGER)", metadataTable]];
+        [_db executeUpdate: [NSString stringWithFormat: @"INSERT INTO %@ VALUES(?)", metadataTable],
+                            @(currentVersion)];
     }
     else
     {
-        int version = [_db intForQuery: @"SELECT version FROM storeMetadata"];
-        if (1 != version)
+        version = [_db intForQuery: [NSString stringWithFormat: @"SELECT version FROM %@", metadataTable]];
+        if (version < 1 || version > currentVersion)
         {
-            NSLog(@"Error, undo track store version %d, only version 1 is supported", version);
+            NSLog(@"Error, undo track store version %d cannot be migrated to %d", version, currentVersion);
             [_db rollback];
             return NO;
         }
@@ -257,6 +394,19 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
         "FOREIGN KEY(headid) REFERENCES commands(id), "
         "FOREIGN KEY(currentid) REFERENCES commands(id))"];
 
+    // Covers the track queries, including the ones ordered by id
+    [_db executeUpdate: @"CREATE INDEX IF NOT EXISTS commands_by_track ON commands(trackname, deleted, id, uuid)"];
+    // Covers the compaction queries (few commands are marked as deleted)
+    [_db executeUpdate: @"CREATE INDEX IF NOT EXISTS deleted_commands_by_track ON commands(trackname) "
+                         "WHERE deleted = 1"];
+
+    if (version < currentVersion && ![self migrateFromVersion: version])
+    {
+        NSLog(@"Error, undo track store version %d cannot be migrated to %d", version, currentVersion);
+        [_db rollback];
+        return NO;
+    }
+
     [_db commit];
 
     if ([_db hadError])
@@ -275,7 +425,7 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
 
         [_db executeUpdate: @"DELETE FROM tracks"];
         [_db executeUpdate: @"DELETE FROM commands"];
-        [_db executeUpdate: @"DROP TABLE IF EXISTS storeMetadata"];
+        [_db executeUpdate: [NSString stringWithFormat: @"DROP TABLE IF EXISTS %@", self.metadataTableName]];
         [_db commit];
 
         [_modifiedTrackStateForTrackName removeAllObjects];
@@ -288,9 +438,15 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
 {
     ETAssert([NSThread isMainThread]);
 
+    // Takes the transaction lock too, and joins the transaction underway if any
+    if (_hostStore != nil)
+        return [_hostStore beginSharedTransaction];
+
     // If there is a background operation (e.g. mark as deleted, vacuum) underway,
     // wait until it is finished
+    const uint64_t waitStartTime = COStoreMetricsNow();
     dispatch_semaphore_wait(_transactionLock, DISPATCH_TIME_FOREVER);
+    [_metrics recordDurationSince: waitStartTime forMetric: COStoreMetricCommitLockWaitTime];
 
     __block BOOL ok = NO;
 
@@ -315,8 +471,26 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
 - (BOOL)commitTransactionWithCompletionHandler: (void (^)(void))completion
 {
     ETAssert([NSThread isMainThread]);
+    const uint64_t startTime = COStoreMetricsNow();
     __block BOOL ok = NO;
 
+    if (_hostStore != nil)
+    {
+        ok = [_hostStore commitSharedTransaction];
+
+        if (ok)
+        {
+            completion();
+            // When nested in another shared transaction, wait until it is durable
+            [_hostStore performAfterSharedTransaction: ^()
+            {
+                [self postCommitNotifications];
+            }];
+        }
+        [_metrics recordDurationSince: startTime forMetric: COStoreMetricUndoCommitLatency];
+        return ok;
+    }
+
     dispatch_sync(_queue,
         ^()
         {
@@ -329,6 +503,7 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
         [self postCommitNotifications];
     }
     dispatch_semaphore_signal(_transactionLock);
+    [_metrics recordDurationSince: startTime forMetric: COStoreMetricUndoCommitLatency];
     return ok;
 }
 
@@ -465,17 +640,122 @@ NSString *const COUndoTrackStoreTrackCompacted = @"COUndoTrackStoreTrackCompacte
     return result;
 }
 
+- (COUndoTrackSerializedCommand *)commandSkeletonFromResultSet: (FMResultSet *)rs
+{
+    assert(dispatch_get_current_queue() == _queue);
+    COUndoTrackSerializedCommand *result = [COUndoTrackSerializedCommand new];
+
+    result.UUID = [ETUUID UUIDWithData: [rs dataForColumnIndex: 1]];
+    ETAssert(![result.UUID isEqual: [COEndOfUndoTrackPlaceholderNode sharedInstance].UUID]);
+
+    if ([rs dataForColumnIndex: 2] != nil)
+    {
+        result.parentUUID = [ETUUID UUIDWithData: [rs dataForColumnIndex: 2]];
+        ETAssert(![result.parentUUID isEqual: [COEndOfUndoTrackPlaceholderNode sharedInstance].UUID]);
+    }
+
+    result.trackName = [rs stringForColumnIndex: 3];
+    result.timestamp = CODateFromJavaTimestamp([rs numberForColumnIndex: 4]);
+    result.sequenceNumber = [rs int64ForColumnIndex: 0];
+    result.store = self;
+    return result;
+}
+
+- (NSArray *)commandSkeletonsUpToCommandUUID: (ETUUID *)aUUID
+{
+    NILARG_EXCEPTION_TEST(aUUID);
+    assert(dispatch_get_current_queue() != _queue);
+    NSMutableArray *result = [NSMutableArray new];
+
+    dispatch_sync(_queue,
+        ^()
+        {
+            FMResultSet *rs = [_db executeQuery:
+                @"WITH RECURSIVE ancestors(id) AS ("
+                    "SELECT id FROM commands WHERE uuid = ? AND deleted = 0 "
+                    "UNION ALL "
+                    "SELECT parent.id FROM ancestors "
+                    "JOIN commands AS c ON c.id = ancestors.id "
+                    "JOIN commands AS parent ON parent.id = c.parentid "
+                    "WHERE parent.deleted = 0) "
+                "SELECT c.id, c.uuid, parent.uuid AS parentuuid, c.trackname, c.timestamp "
+                    "FROM ancestors "
+                    "JOIN commands AS c ON c.id = ancestors.id "
+                    "LEFT OUTER JOIN commands AS parent ON c.parentid = parent.id "
+                    "ORDER BY c.id", [aUUID dataValue]];
+
+            while ([rs next])
+            {
+                [result addObject: [self commandSkeletonFromResultSet: rs]];
+            }
+            [rs close];
+        });
+
+    return result;
+}
+
+- (NSArray *)commandSkeletonsOnTrackWithName: (NSString *)aName
+{
+    NILARG_EXCEPTION_TEST(aName);
+    assert(dispatch_get_current_queue() != _queue);
+    NSMutableArray *result = [NSMutableArray new];
+
+    dispatch_sync(_queue,
+        ^()
+        {
+            FMResultSet *rs = [_db executeQuery:
+                @"SELECT c.id, c.uuid, parent.uuid AS parentuuid, c.trackname, c.timestamp "
+                    "FROM commands AS c "
+                    "LEFT OUTER JOIN commands AS parent ON c.parentid = parent.id "
+                    "WHERE c.trackname = ? AND c.deleted = 0 "
+                    "ORDER BY c.id", aName];
+
+            while ([rs next])
+            {
+                [result addObject: [self commandSkeletonFromResultSet: rs]];
+            }
+            [rs close];
+        });
+
+    return result;
+}
+
+- (BOOL)loadPayloadForCommand: (COUndoTrackSerializedCommand *)aCommand
+{
+    NILARG_EXCEPTION_TEST(aCommand);
+    assert(dispatch_get_current_queue() != _queue);
+    __block BOOL found = NO;
+
+    dispatch_sync(_queue,
+        ^()
+        {
+            FMResultSet *rs = [_db executeQuery: @"SELECT data, metadata FROM commands WHERE uuid = ?",
+                                                 [aCommand.UUID dataValue]];
+
+            if ([rs next])
+            {
+                aCommand.JSONData = [self deserialize: [rs dataForColumnIndex: 0]];
+                aCommand.metadata = [self deserialize: [rs dataForColumnIndex: 1]];
+                aCommand.store = nil;
+                found = YES;
+            }
+            [rs close];
+        });
+
+    return found;
+}
+
 - (NSData *)serialize: (id)json
 {
     if (json != nil)
-        return CODataWithJSONObject(json, NULL);
+        return COUndoCommandDataWithJSONObject(json, _compressesCommands);
     return nil;
 }
 
 - (id)deserialize: (NSData *)data
 {
     if (data != nil)
-        return COJSONObjectWithData(data, NULL);
+        return COUndoCommandJSONObjectWithData(data);
     return nil;
 }
 
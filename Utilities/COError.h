@@ -93,3 +93,8 @@ extern const NSInteger kCOValidationError;
  * See -[COError errors].
  */
 extern const NSInteger kCOValidationMultipleErrorsError;
+/**
+ * Reported when decoding bytes that are truncated or malformed (e.g. items or
+ * messages received from a synchronizer peer).
+ */
+extern const NSInteger kCOCorruptedDataError;
@@ -64,3 +64,4 @@
 NSString *const kCOCoreObjectErrorDomain = @"kCOCoreObjectErrorDomain";
 const NSInteger kCOValidationError = 0;
 const NSInteger kCOValidationMultipleErrorsError = 1;
+const NSInteger kCOCorruptedDataError = 2;